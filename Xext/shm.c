@@ -99,6 +99,7 @@ typedef struct _ShmScrPrivateRec {
 } ShmScrPrivateRec;
 
 static PixmapPtr fbShmCreatePixmap(XSHM_CREATE_PIXMAP_ARGS);
+static void fbShmPutImage(XSHM_PUT_IMAGE_ARGS);
 static int ShmDetachSegment(void *value, XID shmseg);
 static void ShmResetProc(ExtensionEntry *extEntry);
 static void SShmCompletionEvent(xShmCompletionEvent *from,
@@ -120,6 +121,7 @@ static DevPrivateKeyRec shmPixmapPrivateKeyRec;
 #define shmPixmapPrivateKey (&shmPixmapPrivateKeyRec)
 static ShmFuncs miFuncs = { NULL, NULL };
 static ShmFuncs fbFuncs = { fbShmCreatePixmap, NULL };
+static ShmFuncs fbPutImageFuncs = { fbShmCreatePixmap, fbShmPutImage };
 
 #define ShmGetScreenPriv(s) ((ShmScrPrivateRec *)dixLookupPrivate(&(s)->devPrivates, shmScrPrivateKey))
 
@@ -271,6 +273,17 @@ ShmRegisterFbFuncs(ScreenPtr pScreen)
     ShmRegisterFuncs(pScreen, &fbFuncs);
 }
 
+/*
+ * For screens that fb renders to on its own.  Screens with an acceleration
+ * architecture on top, such as glamor, also get ShmRegisterFbFuncs from
+ * miScreenInit but must not be handed the segment as a source pixmap.
+ */
+void
+ShmRegisterFbPutImage(ScreenPtr pScreen)
+{
+    ShmRegisterFuncs(pScreen, &fbPutImageFuncs);
+}
+
 static int
 ProcShmQueryVersion(ClientPtr client)
 {
@@ -518,6 +531,51 @@ doShmPutImage(DrawablePtr dst, GCPtr pGC,
     }
 }
 
+/*
+ * Puts that PutImage cannot take directly, onto pixmaps in plain memory:
+ * wrap the segment in a scratch pixmap header and copy the requested
+ * rectangle from there.  The copy is clipped to the destination by
+ * CopyArea/CopyPlane, which keeps damage and sprite wrappers informed,
+ * and fb turns it into a single blit per clip box without staging the
+ * image in a temporary pixmap.
+ */
+static void
+fbShmPutImage(DrawablePtr dst, GCPtr pGC,
+              int depth, unsigned int format,
+              int w, int h, int sx, int sy, int sw, int sh, int dx, int dy,
+              char *data)
+{
+    PixmapPtr pDstPix, pPixmap;
+
+    if (dst->type == DRAWABLE_WINDOW)
+        pDstPix = (*dst->pScreen->GetWindowPixmap) ((WindowPtr) dst);
+    else
+        pDstPix = (PixmapPtr) dst;
+
+    if ((format == XYPixmap && depth != 1) || !pDstPix->devPrivate.ptr) {
+        doShmPutImage(dst, pGC, depth, format, w, h, sx, sy, sw, sh, dx, dy,
+                      data);
+        return;
+    }
+
+    pPixmap = GetScratchPixmapHeader(dst->pScreen, w, h, depth,
+                                     BitsPerPixel(depth),
+                                     PixmapBytePad(w, depth), data);
+    if (!pPixmap) {
+        doShmPutImage(dst, pGC, depth, format, w, h, sx, sy, sw, sh, dx, dy,
+                      data);
+        return;
+    }
+
+    if (format == XYBitmap)
+        (void) (*pGC->ops->CopyPlane) (&pPixmap->drawable, dst, pGC, sx, sy,
+                                       sw, sh, dx, dy, 1L);
+    else
+        (void) (*pGC->ops->CopyArea) (&pPixmap->drawable, dst, pGC, sx, sy,
+                                      sw, sh, dx, dy);
+    FreeScratchPixmapHeader(pPixmap);
+}
+
 static int
 ProcShmPutImage(ClientPtr client)
 {
@@ -525,6 +583,7 @@ ProcShmPutImage(ClientPtr client)
     DrawablePtr pDraw;
     long length;
     ShmDescPtr shmdesc;
+    ShmScrPrivateRec *screen_priv;
 
     REQUEST(xShmPutImageReq);
 
@@ -582,6 +641,7 @@ ProcShmPutImage(ClientPtr client)
         return BadValue;
     }
 
+    screen_priv = ShmGetScreenPriv(pDraw->pScreen);
     if ((((stuff->format == ZPixmap) && (stuff->srcX == 0)) ||
          ((stuff->format != ZPixmap) &&
           (stuff->srcX < screenInfo.bitmapScanlinePad) &&
@@ -595,6 +655,15 @@ ProcShmPutImage(ClientPtr client)
                                stuff->srcX, stuff->format,
                                shmdesc->addr + stuff->offset +
                                (stuff->srcY * length));
+    else if (screen_priv->shmFuncs->PutImage)
+        (*screen_priv->shmFuncs->PutImage) (pDraw, pGC, stuff->depth,
+                                            stuff->format,
+                                            stuff->totalWidth,
+                                            stuff->totalHeight,
+                                            stuff->srcX, stuff->srcY,
+                                            stuff->srcWidth, stuff->srcHeight,
+                                            stuff->dstX, stuff->dstY,
+                                            shmdesc->addr + stuff->offset);
     else
         doShmPutImage(pDraw, pGC, stuff->depth, stuff->format,
                       stuff->totalWidth, stuff->totalHeight,
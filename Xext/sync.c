@@ -110,6 +110,10 @@ static const char *WARN_INVALID_COUNTER_ALARM =
 
 static void SyncComputeBracketValues(SyncCounter *);
 
+static Bool SyncIndexInsert(SyncCounter *, SyncTrigger *);
+
+static Bool SyncIndexRemove(SyncCounter *, SyncTrigger *);
+
 static void SyncInitServerTime(void);
 
 static void SyncInitIdleTime(void);
@@ -139,7 +143,8 @@ SyncCheckWarnIsCounter(const SyncObject * pSync, const char *warning)
 
 /*  Each counter maintains a simple linked list of triggers that are
  *  interested in the counter.  The two functions below are used to
- *  delete and add triggers on this list.
+ *  delete and add triggers on this list, and on the counter's trigger
+ *  index (see SyncIndexInsert).
  */
 void
 SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
@@ -164,6 +169,14 @@ SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
                 pTrigger->pSync->pTriglist = pCur->next;
 
             free(pCur);
+            if (SYNC_COUNTER == pTrigger->pSync->type) {
+                /* taken out of the index while it is being fired */
+                if (!xorg_list_is_empty(&pTrigger->pending))
+                    xorg_list_del(&pTrigger->pending);
+                else
+                    SyncIndexRemove((SyncCounter *) pTrigger->pSync,
+                                    pTrigger);
+            }
             break;
         }
 
@@ -203,6 +216,13 @@ SyncAddTriggerToSyncObject(SyncTrigger * pTrigger)
         return BadAlloc;
 
     pCur->pTrigger = pTrigger;
+    if (SYNC_COUNTER == pTrigger->pSync->type) {
+        xorg_list_init(&pTrigger->pending);
+        if (!SyncIndexInsert((SyncCounter *) pTrigger->pSync, pTrigger)) {
+            free(pCur);
+            return BadAlloc;
+        }
+    }
     pCur->next = pTrigger->pSync->pTriglist;
     pTrigger->pSync->pTriglist = pCur;
 
@@ -312,6 +332,190 @@ SyncCheckTriggerFence(SyncTrigger * pTrigger, CARD64 unused)
     return (pFence == NULL || pFence->funcs.CheckTriggered(pFence));
 }
 
+/*  Triggers on a counter are also indexed: one array per test type,
+ *  sorted by test value.  A counter change then only has to look at the
+ *  triggers whose threshold lies between the old and the new value, and
+ *  the bracket values of system counters come from a binary search.
+ *  Triggers with some other CheckTrigger are kept unsorted and are always
+ *  checked.
+ */
+#define SYNC_INDEX_OTHER	4
+#define SYNC_INDEX_TYPES	5
+
+typedef struct _SyncTriggerEntry {
+    CARD64 value;               /* test_value when indexed */
+    SyncTrigger *pTrigger;
+} SyncTriggerEntry;
+
+typedef struct _SyncTriggerIndex {
+    SyncTriggerEntry *entries[SYNC_INDEX_TYPES];
+    int num[SYNC_INDEX_TYPES];
+    int size[SYNC_INDEX_TYPES];
+} SyncTriggerIndex;
+
+static int
+SyncIndexType(SyncTrigger * pTrigger)
+{
+    if (pTrigger->CheckTrigger == SyncCheckTriggerPositiveTransition)
+        return XSyncPositiveTransition;
+    if (pTrigger->CheckTrigger == SyncCheckTriggerNegativeTransition)
+        return XSyncNegativeTransition;
+    if (pTrigger->CheckTrigger == SyncCheckTriggerPositiveComparison)
+        return XSyncPositiveComparison;
+    if (pTrigger->CheckTrigger == SyncCheckTriggerNegativeComparison)
+        return XSyncNegativeComparison;
+    return SYNC_INDEX_OTHER;
+}
+
+/* First entry of the type with a value >= value, or > value if after */
+static int
+SyncIndexSearch(SyncTriggerIndex * pIndex, int type, CARD64 value, Bool after)
+{
+    SyncTriggerEntry *entries = pIndex->entries[type];
+    int lo = 0, hi = pIndex->num[type];
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if (XSyncValueLessThan(entries[mid].value, value) ||
+            (after && XSyncValueEqual(entries[mid].value, value)))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Make room for one more entry of the type */
+static Bool
+SyncIndexReserve(SyncCounter * pCounter, int type)
+{
+    SyncTriggerIndex *pIndex = pCounter->pTrigIndex;
+    SyncTriggerEntry *entries;
+    int size;
+
+    if (!pIndex) {
+        pIndex = calloc(1, sizeof(SyncTriggerIndex));
+        if (!pIndex)
+            return FALSE;
+        pCounter->pTrigIndex = pIndex;
+    }
+
+    if (pIndex->num[type] < pIndex->size[type])
+        return TRUE;
+
+    size = pIndex->size[type] ? pIndex->size[type] * 2 : 8;
+    entries = reallocarray(pIndex->entries[type], size,
+                           sizeof(SyncTriggerEntry));
+    if (!entries)
+        return FALSE;
+    pIndex->entries[type] = entries;
+    pIndex->size[type] = size;
+    return TRUE;
+}
+
+static Bool
+SyncIndexInsert(SyncCounter * pCounter, SyncTrigger * pTrigger)
+{
+    SyncTriggerIndex *pIndex;
+    int type = SyncIndexType(pTrigger);
+    SyncTriggerEntry *entries;
+    int at;
+
+    if (!SyncIndexReserve(pCounter, type))
+        return FALSE;
+
+    pIndex = pCounter->pTrigIndex;
+    entries = pIndex->entries[type];
+    if (type == SYNC_INDEX_OTHER)
+        at = pIndex->num[type];
+    else
+        at = SyncIndexSearch(pIndex, type, pTrigger->test_value, TRUE);
+    memmove(entries + at + 1, entries + at,
+            (pIndex->num[type] - at) * sizeof(SyncTriggerEntry));
+    entries[at].value = pTrigger->test_value;
+    entries[at].pTrigger = pTrigger;
+    pIndex->num[type]++;
+    return TRUE;
+}
+
+/* The trigger may have changed since it was indexed, so look everywhere */
+static Bool
+SyncIndexRemove(SyncCounter * pCounter, SyncTrigger * pTrigger)
+{
+    SyncTriggerIndex *pIndex = pCounter->pTrigIndex;
+    SyncTriggerEntry *entries;
+    int type, i;
+
+    if (!pIndex)
+        return FALSE;
+
+    for (type = 0; type < SYNC_INDEX_TYPES; type++) {
+        entries = pIndex->entries[type];
+        for (i = 0; i < pIndex->num[type]; i++) {
+            if (entries[i].pTrigger == pTrigger) {
+                pIndex->num[type]--;
+                memmove(entries + i, entries + i + 1,
+                        (pIndex->num[type] - i) * sizeof(SyncTriggerEntry));
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/* Move entries [first, last) of the type onto a list of triggers to fire */
+static void
+SyncIndexTake(SyncTriggerIndex * pIndex, int type, int first, int last,
+              struct xorg_list *list)
+{
+    SyncTriggerEntry *entries = pIndex->entries[type];
+    int i;
+
+    if (first >= last)
+        return;
+    for (i = first; i < last; i++)
+        xorg_list_append(&entries[i].pTrigger->pending, list);
+    memmove(entries + first, entries + last,
+            (pIndex->num[type] - last) * sizeof(SyncTriggerEntry));
+    pIndex->num[type] -= last - first;
+}
+
+static void
+SyncIndexFree(SyncCounter * pCounter)
+{
+    SyncTriggerIndex *pIndex = pCounter->pTrigIndex;
+    int type;
+
+    if (!pIndex)
+        return;
+    for (type = 0; type < SYNC_INDEX_TYPES; type++)
+        free(pIndex->entries[type]);
+    free(pIndex);
+    pCounter->pTrigIndex = NULL;
+}
+
+/*  Called after a trigger's test type or test value changed outside of
+ *  SyncChangeCounter, which puts the triggers it fires back itself.
+ *  Returns TRUE if the trigger was moved.
+ */
+static Bool
+SyncReindexTrigger(SyncTrigger * pTrigger)
+{
+    SyncCounter *pCounter = (SyncCounter *) pTrigger->pSync;
+
+    if (!pCounter || SYNC_COUNTER != pCounter->sync.type ||
+        !xorg_list_is_empty(&pTrigger->pending))
+        return FALSE;
+
+    /* If there is no room, the old entry is better than none */
+    if (!SyncIndexReserve(pCounter, SyncIndexType(pTrigger)) ||
+        !SyncIndexRemove(pCounter, pTrigger))
+        return FALSE;
+    SyncIndexInsert(pCounter, pTrigger);
+    return TRUE;
+}
+
 static int
 SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
                 RESTYPE resType, Mask changes)
@@ -398,6 +602,7 @@ SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
             XSyncValueAdd(&pTrigger->test_value, pCounter->value,
                           pTrigger->wait_value, &overflow);
             if (overflow) {
+                SyncReindexTrigger(pTrigger);
                 client->errorValue = XSyncValueHigh32(pTrigger->wait_value);
                 return BadValue;
             }
@@ -411,8 +616,10 @@ SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
         if ((rc = SyncAddTriggerToSyncObject(pTrigger)) != Success)
             return rc;
     }
-    else if (pCounter && IsSystemCounter(pCounter)) {
-        SyncComputeBracketValues(pCounter);
+    else if (pCounter) {
+        SyncReindexTrigger(pTrigger);
+        if (IsSystemCounter(pCounter))
+            SyncComputeBracketValues(pCounter);
     }
 
     return Success;
@@ -602,6 +809,8 @@ SyncAlarmTriggerFired(SyncTrigger * pTrigger)
      */
     SyncSendAlarmNotifyEvents(pAlarm);
     pTrigger->test_value = new_test_value;
+    if (SyncReindexTrigger(pTrigger) && IsSystemCounter(pCounter))
+        SyncComputeBracketValues(pCounter);
 }
 
 /*  This function is called when an Await unblocks, either as a result
@@ -713,16 +922,58 @@ SyncUpdateCounter(SyncCounter *pCounter, CARD64 newval)
 void
 SyncChangeCounter(SyncCounter * pCounter, CARD64 newval)
 {
-    SyncTriggerList *ptl, *pnext;
+    SyncTriggerIndex *pIndex = pCounter->pTrigIndex;
+    SyncTrigger *pTrigger;
+    struct xorg_list fire, fired;
     CARD64 oldval;
+    int lo, hi;
 
     oldval = SyncUpdateCounter(pCounter, newval);
 
-    /* run through triggers to see if any become true */
-    for (ptl = pCounter->sync.pTriglist; ptl; ptl = pnext) {
-        pnext = ptl->next;
-        if ((*ptl->pTrigger->CheckTrigger) (ptl->pTrigger, oldval))
-            (*ptl->pTrigger->TriggerFired) (ptl->pTrigger);
+    /*  Take the triggers that may have become true out of the index.
+     *  A trigger deleted while we fire (an Await going away) drops off
+     *  these lists; the rest are put back with their new test values.
+     */
+    xorg_list_init(&fire);
+    xorg_list_init(&fired);
+    if (pIndex) {
+        hi = SyncIndexSearch(pIndex, XSyncPositiveComparison, newval, TRUE);
+        SyncIndexTake(pIndex, XSyncPositiveComparison, 0, hi, &fire);
+
+        lo = SyncIndexSearch(pIndex, XSyncNegativeComparison, newval, FALSE);
+        SyncIndexTake(pIndex, XSyncNegativeComparison, lo,
+                      pIndex->num[XSyncNegativeComparison], &fire);
+
+        if (XSyncValueGreaterThan(newval, oldval)) {
+            lo = SyncIndexSearch(pIndex, XSyncPositiveTransition, oldval, TRUE);
+            hi = SyncIndexSearch(pIndex, XSyncPositiveTransition, newval, TRUE);
+            SyncIndexTake(pIndex, XSyncPositiveTransition, lo, hi, &fire);
+        }
+        else if (XSyncValueLessThan(newval, oldval)) {
+            lo = SyncIndexSearch(pIndex, XSyncNegativeTransition, newval, FALSE);
+            hi = SyncIndexSearch(pIndex, XSyncNegativeTransition, oldval, FALSE);
+            SyncIndexTake(pIndex, XSyncNegativeTransition, lo, hi, &fire);
+        }
+
+        SyncIndexTake(pIndex, SYNC_INDEX_OTHER, 0,
+                      pIndex->num[SYNC_INDEX_OTHER], &fire);
+    }
+
+    /* run through those triggers to see if any become true */
+    while (!xorg_list_is_empty(&fire)) {
+        pTrigger = xorg_list_first_entry(&fire, SyncTrigger, pending);
+        xorg_list_del(&pTrigger->pending);
+        xorg_list_append(&pTrigger->pending, &fired);
+        if ((*pTrigger->CheckTrigger) (pTrigger, oldval))
+            (*pTrigger->TriggerFired) (pTrigger);
+    }
+
+    while (!xorg_list_is_empty(&fired)) {
+        pTrigger = xorg_list_first_entry(&fired, SyncTrigger, pending);
+        xorg_list_del(&pTrigger->pending);
+        if (!SyncIndexInsert(pCounter, pTrigger))
+            ErrorF("SYNC: lost a trigger on counter 0x%x\n",
+                   (unsigned int) pCounter->sync.id);
     }
 
     if (IsSystemCounter(pCounter)) {
@@ -962,6 +1213,7 @@ SyncCreateCounter(ClientPtr client, XSyncCounter id, CARD64 initialvalue)
 
     pCounter->value = initialvalue;
     pCounter->pSysCounterInfo = NULL;
+    pCounter->pTrigIndex = NULL;
 
     if (!AddResource(id, RTCounter, (void *) pCounter))
         return NULL;
@@ -1017,11 +1269,37 @@ SyncDestroySystemCounter(void *pSysCounter)
     FreeResource(pCounter->sync.id, RT_NONE);
 }
 
+/*  Narrow the brackets to the nearest thresholds of one test type.
+ *  above_eq and below_eq say whether a threshold equal to the counter's
+ *  value bounds it from above or from below.
+ */
+static void
+SyncBracketType(SyncCounter * pCounter, int type, Bool above_eq,
+                Bool below_eq, CARD64 **ppgtval, CARD64 **ppltval)
+{
+    SyncTriggerIndex *pIndex = pCounter->pTrigIndex;
+    SysCounterInfo *psci = pCounter->pSysCounterInfo;
+    SyncTriggerEntry *entries = pIndex->entries[type];
+    int i;
+
+    i = SyncIndexSearch(pIndex, type, pCounter->value, !above_eq);
+    if (i < pIndex->num[type] &&
+        XSyncValueLessThan(entries[i].value, psci->bracket_greater)) {
+        psci->bracket_greater = entries[i].value;
+        *ppgtval = &psci->bracket_greater;
+    }
+
+    i = SyncIndexSearch(pIndex, type, pCounter->value, below_eq) - 1;
+    if (i >= 0 &&
+        XSyncValueGreaterThan(entries[i].value, psci->bracket_less)) {
+        psci->bracket_less = entries[i].value;
+        *ppltval = &psci->bracket_less;
+    }
+}
+
 static void
 SyncComputeBracketValues(SyncCounter * pCounter)
 {
-    SyncTriggerList *pCur;
-    SyncTrigger *pTrigger;
     SysCounterInfo *psci;
     CARD64 *pnewgtval = NULL;
     CARD64 *pnewltval = NULL;
@@ -1038,75 +1316,25 @@ SyncComputeBracketValues(SyncCounter * pCounter)
     XSyncMaxValue(&psci->bracket_greater);
     XSyncMinValue(&psci->bracket_less);
 
-    for (pCur = pCounter->sync.pTriglist; pCur; pCur = pCur->next) {
-        pTrigger = pCur->pTrigger;
-
-        if (pTrigger->test_type == XSyncPositiveComparison &&
-            ct != XSyncCounterNeverIncreases) {
-            if (XSyncValueLessThan(pCounter->value, pTrigger->test_value) &&
-                XSyncValueLessThan(pTrigger->test_value,
-                                   psci->bracket_greater)) {
-                psci->bracket_greater = pTrigger->test_value;
-                pnewgtval = &psci->bracket_greater;
-            }
-            else if (XSyncValueGreaterThan(pCounter->value, pTrigger->test_value) &&
-                     XSyncValueGreaterThan(pTrigger->test_value, psci->bracket_less)) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-        }
-        else if (pTrigger->test_type == XSyncNegativeComparison &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (XSyncValueGreaterThan(pCounter->value, pTrigger->test_value) &&
-                XSyncValueGreaterThan(pTrigger->test_value,
-                                      psci->bracket_less)) {
-                psci->bracket_less = pTrigger->test_value;
-                pnewltval = &psci->bracket_less;
-            }
-            else if (XSyncValueLessThan(pCounter->value, pTrigger->test_value) &&
-                     XSyncValueLessThan(pTrigger->test_value, psci->bracket_greater)) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-        }
-        else if (pTrigger->test_type == XSyncNegativeTransition &&
-                 ct != XSyncCounterNeverIncreases) {
-            if (XSyncValueGreaterOrEqual(pCounter->value, pTrigger->test_value) &&
-                XSyncValueGreaterThan(pTrigger->test_value, psci->bracket_less)) {
-                    /*
-                     * If the value is exactly equal to our threshold, we want one
-                     * more event in the negative direction to ensure we pick up
-                     * when the value is less than this threshold.
-                     */
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-            else if (XSyncValueLessThan(pCounter->value, pTrigger->test_value) &&
-                     XSyncValueLessThan(pTrigger->test_value, psci->bracket_greater)) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-        }
-        else if (pTrigger->test_type == XSyncPositiveTransition &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (XSyncValueLessOrEqual(pCounter->value, pTrigger->test_value) &&
-                XSyncValueLessThan(pTrigger->test_value, psci->bracket_greater)) {
-                    /*
-                     * If the value is exactly equal to our threshold, we
-                     * want one more event in the positive direction to
-                     * ensure we pick up when the value *exceeds* this
-                     * threshold.
-                     */
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-            else if (XSyncValueGreaterThan(pCounter->value, pTrigger->test_value) &&
-                     XSyncValueGreaterThan(pTrigger->test_value, psci->bracket_less)) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-        }
-    }                           /* end for each trigger */
+    if (pCounter->pTrigIndex) {
+        if (ct != XSyncCounterNeverIncreases)
+            SyncBracketType(pCounter, XSyncPositiveComparison, FALSE, FALSE,
+                            &pnewgtval, &pnewltval);
+        if (ct != XSyncCounterNeverDecreases)
+            SyncBracketType(pCounter, XSyncNegativeComparison, FALSE, FALSE,
+                            &pnewgtval, &pnewltval);
+        /*
+         * If the value is exactly equal to a transition's threshold, we
+         * want one more event in the direction of the transition, to pick
+         * up when the value moves past the threshold.
+         */
+        if (ct != XSyncCounterNeverIncreases)
+            SyncBracketType(pCounter, XSyncNegativeTransition, FALSE, TRUE,
+                            &pnewgtval, &pnewltval);
+        if (ct != XSyncCounterNeverDecreases)
+            SyncBracketType(pCounter, XSyncPositiveTransition, TRUE, FALSE,
+                            &pnewgtval, &pnewltval);
+    }
 
     (*psci->BracketValues) ((void *) pCounter, pnewltval, pnewgtval);
 
@@ -1160,6 +1388,7 @@ FreeCounter(void *env, XID id)
         free(pCounter->pSysCounterInfo->private);
         free(pCounter->pSysCounterInfo);
     }
+    SyncIndexFree(pCounter);
     free(pCounter);
     return Success;
 }
@@ -1597,6 +1826,7 @@ ProcSyncAwait(ClientPtr client)
 
         /* sanity checks are in SyncInitTrigger */
         pAwait->trigger.pSync = NULL;
+        xorg_list_init(&pAwait->trigger.pending);
         pAwait->trigger.value_type = pProtocolWaitConds->value_type;
         XSyncIntsToValue(&pAwait->trigger.wait_value,
                          pProtocolWaitConds->wait_value_lo,
@@ -1700,6 +1930,7 @@ ProcSyncCreateAlarm(ClientPtr client)
 
     pTrigger = &pAlarm->trigger;
     pTrigger->pSync = NULL;
+    xorg_list_init(&pTrigger->pending);
     pTrigger->value_type = XSyncAbsolute;
     XSyncIntToValue(&pTrigger->wait_value, 0L);
     pTrigger->test_type = XSyncPositiveComparison;
@@ -2063,6 +2294,7 @@ ProcSyncAwaitFence(ClientPtr client)
         }
 
         pAwait->trigger.pSync = NULL;
+        xorg_list_init(&pAwait->trigger.pending);
         /* Provide acceptable values for these unused fields to
          * satisfy SyncInitTrigger's validation logic
          */
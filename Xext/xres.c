@@ -18,6 +18,7 @@
 #include "swaprep.h"
 #include "registry.h"
 #include <X11/extensions/XResproto.h>
+#include "xresschedproto.h"
 #include "pixmapstr.h"
 #include "windowstr.h"
 #include "gcstruct.h"
@@ -496,6 +497,87 @@ ProcXResQueryClientPixmapBytes(ClientPtr client)
     return Success;
 }
 
+static int
+ProcXResSchedQueryVersion(ClientPtr client)
+{
+    xXResSchedQueryVersionReply rep = {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+        .server_major = SERVER_XRES_SCHED_MAJOR_VERSION,
+        .server_minor = SERVER_XRES_SCHED_MINOR_VERSION
+    };
+
+    REQUEST_SIZE_MATCH(xXResSchedQueryVersionReq);
+
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swaps(&rep.server_major);
+        swaps(&rep.server_minor);
+    }
+    WriteToClient(client, sizeof(xXResSchedQueryVersionReply), &rep);
+    return Success;
+}
+
+static int
+ProcXResQueryClientSchedStats(ClientPtr client)
+{
+    REQUEST(xXResQueryClientSchedStatsReq);
+    xXResQueryClientSchedStatsReply rep;
+    ClientSchedStatsRec *stats;
+    int clientID;
+
+    REQUEST_SIZE_MATCH(xXResQueryClientSchedStatsReq);
+
+    clientID = CLIENT_ID(stuff->xid);
+
+    if ((clientID >= currentMaxClients) || !clients[clientID]) {
+        client->errorValue = stuff->xid;
+        return BadValue;
+    }
+    stats = &clients[clientID]->sched_stats;
+
+    rep = (xXResQueryClientSchedStatsReply) {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(sz_xXResQueryClientSchedStatsReply -
+                                 sizeof(xGenericReply)),
+        .requests = stats->requests,
+        .requests_overflow = stats->requests >> 32,
+        .dispatch_usec = stats->dispatch_time,
+        .dispatch_usec_overflow = stats->dispatch_time >> 32,
+        .bytes_read = stats->bytes_read,
+        .bytes_read_overflow = stats->bytes_read >> 32,
+        .bytes_written = stats->bytes_written,
+        .bytes_written_overflow = stats->bytes_written >> 32,
+        .slices = stats->slices,
+        .preempted = stats->preempted,
+        .priority_raised = stats->priority_raised,
+        .priority_lowered = stats->priority_lowered,
+        .smart_priority = clients[clientID]->smart_priority
+    };
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.requests);
+        swapl(&rep.requests_overflow);
+        swapl(&rep.dispatch_usec);
+        swapl(&rep.dispatch_usec_overflow);
+        swapl(&rep.bytes_read);
+        swapl(&rep.bytes_read_overflow);
+        swapl(&rep.bytes_written);
+        swapl(&rep.bytes_written_overflow);
+        swapl(&rep.slices);
+        swapl(&rep.preempted);
+        swapl(&rep.priority_raised);
+        swapl(&rep.priority_lowered);
+        swapl(&rep.smart_priority);
+    }
+    WriteToClient(client, sz_xXResQueryClientSchedStatsReply, &rep);
+
+    return Success;
+}
+
 /** @brief Finds out if a client's information need to be put into the
     response; marks client having been handled, if that is the case.
 
@@ -1124,6 +1206,15 @@ SProcXResQueryClientPixmapBytes(ClientPtr client)
     return ProcXResQueryClientPixmapBytes(client);
 }
 
+static int
+SProcXResQueryClientSchedStats(ClientPtr client)
+{
+    REQUEST(xXResQueryClientSchedStatsReq);
+    REQUEST_SIZE_MATCH(xXResQueryClientSchedStatsReq);
+    swapl(&stuff->xid);
+    return ProcXResQueryClientSchedStats(client);
+}
+
 static int
 SProcXResQueryClientIds (ClientPtr client)
 {
@@ -1181,10 +1272,45 @@ SProcResDispatch (ClientPtr client)
     return BadRequest;
 }
 
+static int
+ProcResSchedDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+    switch (stuff->data) {
+    case X_XResSchedQueryVersion:
+        return ProcXResSchedQueryVersion(client);
+    case X_XResQueryClientSchedStats:
+        return ProcXResQueryClientSchedStats(client);
+    default: break;
+    }
+
+    return BadRequest;
+}
+
+static int
+SProcResSchedDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+    swaps(&stuff->length);
+
+    switch (stuff->data) {
+    case X_XResSchedQueryVersion:     /* nothing to swap */
+        return ProcXResSchedQueryVersion(client);
+    case X_XResQueryClientSchedStats:
+        return SProcXResQueryClientSchedStats(client);
+    default: break;
+    }
+
+    return BadRequest;
+}
+
 void
 ResExtensionInit(void)
 {
     (void) AddExtension(XRES_NAME, 0, 0,
                         ProcResDispatch, SProcResDispatch,
                         NULL, StandardMinorOpcode);
+    (void) AddExtension(XRES_SCHED_NAME, 0, 0,
+                        ProcResSchedDispatch, SProcResSchedDispatch,
+                        NULL, StandardMinorOpcode);
 }
@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef _XRESSCHEDPROTO_H_
+#define _XRESSCHEDPROTO_H_
+
+#include <X11/Xmd.h>
+
+/*
+ * X-Resource-Sched is a private extension of this X server, kept apart
+ * from X-Resource so that the latter stays at its upstream version.
+ * Clients find it with QueryExtension.  XResQueryClientSchedStats
+ * reports the smart scheduler's accounting for one client; 64-bit
+ * counters are split into low and overflow words as in
+ * XResQueryClientPixmapBytes.
+ */
+
+#define XRES_SCHED_NAME                 "X-Resource-Sched"
+
+#define X_XResSchedQueryVersion         0
+#define X_XResQueryClientSchedStats     1
+
+typedef struct {
+    CARD8 reqType;
+    CARD8 XResSchedReqType;
+    CARD16 length;
+    CARD8 client_major;
+    CARD8 client_minor;
+    CARD16 unused;
+} xXResSchedQueryVersionReq;
+#define sz_xXResSchedQueryVersionReq 8
+
+typedef struct {
+    CARD8 type;
+    CARD8 pad1;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD16 server_major;
+    CARD16 server_minor;
+    CARD32 pad2;
+    CARD32 pad3;
+    CARD32 pad4;
+    CARD32 pad5;
+    CARD32 pad6;
+} xXResSchedQueryVersionReply;
+#define sz_xXResSchedQueryVersionReply 32
+
+typedef struct {
+    CARD8 reqType;
+    CARD8 XResSchedReqType;
+    CARD16 length;
+    CARD32 xid;
+} xXResQueryClientSchedStatsReq;
+#define sz_xXResQueryClientSchedStatsReq 8
+
+typedef struct {
+    CARD8 type;
+    CARD8 pad1;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD32 requests;
+    CARD32 requests_overflow;
+    CARD32 dispatch_usec;
+    CARD32 dispatch_usec_overflow;
+    CARD32 bytes_read;
+    CARD32 bytes_read_overflow;
+    CARD32 bytes_written;
+    CARD32 bytes_written_overflow;
+    CARD32 slices;
+    CARD32 preempted;
+    CARD32 priority_raised;
+    CARD32 priority_lowered;
+    INT32 smart_priority;
+} xXResQueryClientSchedStatsReply;
+#define sz_xXResQueryClientSchedStatsReply 60
+
+#endif                          /* _XRESSCHEDPROTO_H_ */
@@ -2515,6 +2515,7 @@ MakeInputMasks(WindowPtr pWin)
 static void
 FreeInputMask(OtherInputMasks ** imask)
 {
+    FreeXI2Recipients(*imask);
     xi2mask_free(&(*imask)->xi2mask);
     free(*imask);
     *imask = NULL;
@@ -2528,6 +2529,9 @@ RecalculateDeviceDeliverableEvents(WindowPtr pWin)
     WindowPtr pChild, tmp;
     int i;
 
+    /* The window's clients or their masks changed */
+    FreeXI2Recipients(wOtherInputMasks(pWin));
+
     pChild = pWin;
     while (1) {
         if ((inputMasks = wOtherInputMasks(pChild)) != 0) {
@@ -183,6 +183,8 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
             free(cw);
             return BadAlloc;
         }
+        DamageSetMaxRects(cw->damage, COMP_DAMAGE_MAX_RECTS,
+                          COMP_DAMAGE_TILE);
 
         anyMarked = compMarkWindows(pWin, &pLayerWin);
 
@@ -101,6 +101,13 @@ typedef struct _CompWindow {
 
 #define COMP_ORIGIN_INVALID	    0x80000000
 
+/*
+ * Automatically redirected windows only need to know roughly what to copy
+ * to the parent, so keep their damage coarse rather than exact.
+ */
+#define COMP_DAMAGE_MAX_RECTS	    256
+#define COMP_DAMAGE_TILE	    64
+
 typedef struct _CompSubwindows {
     int update;
     CompClientWindowPtr clients;
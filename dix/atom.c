@@ -57,87 +57,125 @@ SOFTWARE.
 #include "dix.h"
 
 #define InitialTableSize 256
-
+#define InitialHashSize 9       /* log(2)(initial hash slots) */
+
+/*
+ * Atoms are numbered densely, so their names live in nodeTable
+ * indexed by atom.  hashTable is an open-addressed (linear probing)
+ * index from name to atom, kept at most half full; None marks an
+ * empty slot.  Atoms are never freed individually, so no deleted
+ * markers are needed.
+ */
 typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
     unsigned int fingerPrint;
+    unsigned int len;
     const char *string;
 } NodeRec, *NodePtr;
 
 static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
 static unsigned long tableLength;
-static NodePtr *nodeTable;
+static NodePtr nodeTable;
+static Atom *hashTable;
+static int hashSize;            /* log(2)(hash slots) */
 
-Atom
-MakeAtom(const char *string, unsigned len, Bool makeit)
+static unsigned int
+AtomFingerPrint(const char *string, unsigned len)
 {
-    NodePtr *np;
-    unsigned i;
-    int comp;
     unsigned int fp = 0;
+    unsigned i;
 
-    np = &atomRoot;
     for (i = 0; i < (len + 1) / 2; i++) {
         fp = fp * 27 + string[i];
         fp = fp * 27 + string[len - 1 - i];
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
+    return fp;
+}
+
+static inline unsigned int
+AtomSlot(unsigned int fp)
+{
+    return (fp * 0x9e3779b1U) >> (32 - hashSize);
+}
+
+static Bool
+ResizeHashTable(void)
+{
+    unsigned int mask, i;
+    Atom *table, a;
+    int newSize = hashSize + 1;
+
+    table = calloc(1 << newSize, sizeof(Atom));
+    if (!table)
+        return FALSE;
+    free(hashTable);
+    hashTable = table;
+    hashSize = newSize;
+    mask = (1 << hashSize) - 1;
+    for (a = None + 1; a <= lastAtom; a++) {
+        for (i = AtomSlot(nodeTable[a].fingerPrint); hashTable[i];
+             i = (i + 1) & mask);
+        hashTable[i] = a;
     }
-    if (makeit) {
-        NodePtr nd;
+    return TRUE;
+}
 
-        nd = malloc(sizeof(NodeRec));
-        if (!nd)
-            return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
-        }
-        else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
-        }
-        if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodePtr));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
-                return BAD_RESOURCE;
-            }
-            tableLength <<= 1;
-            nodeTable = table;
-        }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
+/*
+ * MakeAtom with the name's fingerprint already computed, used by
+ * MakePredeclaredAtoms whose fingerprints are generated at build time.
+ */
+Atom
+MakeAtomHashed(const char *string, unsigned len, unsigned int fp,
+               Bool makeit)
+{
+    unsigned int mask, i;
+    NodePtr nd;
+    Atom a;
+
+    mask = (1 << hashSize) - 1;
+    for (i = AtomSlot(fp); (a = hashTable[i]); i = (i + 1) & mask) {
+        nd = &nodeTable[a];
+        if (nd->fingerPrint == fp && nd->len == len &&
+            memcmp(nd->string, string, len) == 0)
+            return a;
     }
-    else
+    if (!makeit)
         return None;
+
+    if ((lastAtom + 1) >= tableLength) {
+        NodePtr table;
+
+        table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodeRec));
+        if (!table)
+            return BAD_RESOURCE;
+        tableLength <<= 1;
+        nodeTable = table;
+    }
+    if ((unsigned long) (lastAtom + 1) * 2 > (1UL << hashSize)) {
+        if (!ResizeHashTable())
+            return BAD_RESOURCE;
+        mask = (1 << hashSize) - 1;
+        for (i = AtomSlot(fp); hashTable[i]; i = (i + 1) & mask);
+    }
+
+    nd = &nodeTable[lastAtom + 1];
+    if (lastAtom < XA_LAST_PREDEFINED) {
+        nd->string = string;
+    }
+    else {
+        nd->string = strndup(string, len);
+        if (!nd->string)
+            return BAD_RESOURCE;
+    }
+    nd->fingerPrint = fp;
+    nd->len = len;
+    hashTable[i] = ++lastAtom;
+    return lastAtom;
+}
+
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    return MakeAtomHashed(string, len, AtomFingerPrint(string, len), makeit);
 }
 
 Bool
@@ -149,13 +187,9 @@ ValidAtom(Atom atom)
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > lastAtom)
         return 0;
-    return node->string;
+    return nodeTable[atom].string;
 }
 
 void
@@ -164,32 +198,23 @@ AtomError(void)
     FatalError("initializing atoms");
 }
 
-static void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
-}
-
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
+    Atom a;
+
+    if (nodeTable == NULL)
         return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
+    /*
+     * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
+     * cast here
+     */
+    for (a = XA_LAST_PREDEFINED + 1; a <= lastAtom; a++)
+        free((char *) nodeTable[a].string);
     free(nodeTable);
     nodeTable = NULL;
+    free(hashTable);
+    hashTable = NULL;
     lastAtom = None;
 }
 
@@ -198,10 +223,13 @@ InitAtoms(void)
 {
     FreeAllAtoms();
     tableLength = InitialTableSize;
-    nodeTable = xallocarray(InitialTableSize, sizeof(NodePtr));
+    nodeTable = xallocarray(InitialTableSize, sizeof(NodeRec));
     if (!nodeTable)
         AtomError();
-    nodeTable[None] = NULL;
+    hashSize = InitialHashSize;
+    hashTable = calloc(1 << hashSize, sizeof(Atom));
+    if (!hashTable)
+        AtomError();
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         AtomError();
@@ -988,6 +988,8 @@ CloseDevice(DeviceIntPtr dev)
     for (j = 0; j < dev->last.num_touches; j++)
         free(dev->last.touches[j].valuators);
     free(dev->last.touches);
+    for (j = 0; j < ARRAY_SIZE(dev->eventBuffers); j++)
+        free(dev->eventBuffers[j].events);
     dev->config_info = NULL;
     dixFreePrivates(dev->devPrivates, PRIVATE_DEVICE);
     free(dev);
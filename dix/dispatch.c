@@ -232,9 +232,19 @@ long SmartScheduleInterval = SMART_SCHEDULE_DEFAULT_INTERVAL;
 long SmartScheduleMaxSlice = SMART_SCHEDULE_MAX_SLICE;
 long SmartScheduleTime;
 int SmartScheduleLatencyLimited = 0;
+int SmartScheduleStatsInterval = 0;     /* seconds, 0 disables the log */
 static ClientPtr SmartLastClient;
 static int SmartLastIndex[SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1];
 
+/* Server-wide totals since the last -schedStats report */
+static struct {
+    uint32_t slices;
+    uint32_t preempted;
+    uint32_t slice_growths;
+} SmartScheduleTotals;
+
+static OsTimerPtr SmartScheduleStatsTimer;
+
 #ifdef SMART_DEBUG
 long SmartLastPrint;
 #endif
@@ -242,27 +252,69 @@ long SmartLastPrint;
 void Dispatch(void);
 int ProcFlush(void);
 
-static int
-SmartScheduleClient(int *clientReady, int nready)
+struct xorg_list ready_clients;
+struct xorg_list saved_ready_clients;
+struct xorg_list output_pending_clients;
+
+static void
+init_client_ready(void)
 {
-    ClientPtr pClient;
-    int i;
-    int client;
-    int bestPrio, best = 0;
+    xorg_list_init(&ready_clients);
+    xorg_list_init(&saved_ready_clients);
+    xorg_list_init(&output_pending_clients);
+}
+
+Bool
+clients_are_ready(void)
+{
+    return !xorg_list_is_empty(&ready_clients);
+}
+
+void
+mark_client_ready(ClientPtr client)
+{
+    if (xorg_list_is_empty(&client->ready))
+        xorg_list_append(&client->ready, &ready_clients);
+}
+
+/*
+ * Park a client which has input but may not run until the current
+ * server grab is released.
+ */
+void
+mark_client_saved_ready(ClientPtr client)
+{
+    xorg_list_del(&client->ready);
+    xorg_list_append(&client->ready, &saved_ready_clients);
+}
+
+void
+mark_client_not_ready(ClientPtr client)
+{
+    xorg_list_del(&client->ready);
+}
+
+static ClientPtr
+SmartScheduleClient(void)
+{
+    ClientPtr pClient, best = NULL;
     int bestRobin, robin;
     long now = SmartScheduleTime;
     long idle;
+    int nready = 0;
 
-    bestPrio = -0x7fffffff;
     bestRobin = 0;
     idle = 2 * SmartScheduleSlice;
-    for (i = 0; i < nready; i++) {
-        client = clientReady[i];
-        pClient = clients[client];
+
+    xorg_list_for_each_entry(pClient, &ready_clients, ready) {
+        nready++;
+
         /* Praise clients which haven't run in a while */
         if ((now - pClient->smart_stop_tick) >= idle) {
-            if (pClient->smart_priority < 0)
+            if (pClient->smart_priority < 0) {
                 pClient->smart_priority++;
+                pClient->sched_stats.priority_raised++;
+            }
         }
 
         /* check priority to select best client */
@@ -270,31 +322,39 @@ SmartScheduleClient(int *clientReady, int nready)
             (pClient->index -
              SmartLastIndex[pClient->smart_priority -
                             SMART_MIN_PRIORITY]) & 0xff;
-        if (pClient->smart_priority > bestPrio ||
-            (pClient->smart_priority == bestPrio && robin > bestRobin)) {
-            bestPrio = pClient->smart_priority;
+
+        /*  We implement "strict" priorities: the client with the
+         *  highest protocol priority (SetClientPriority) always wins,
+         *  and the smart scheduler only arbitrates among clients of
+         *  equal priority.
+         */
+        if (!best ||
+            pClient->priority > best->priority ||
+            (pClient->priority == best->priority &&
+             (pClient->smart_priority > best->smart_priority ||
+              (pClient->smart_priority == best->smart_priority &&
+               robin > bestRobin)))) {
+            best = pClient;
             bestRobin = robin;
-            best = client;
         }
 #ifdef SMART_DEBUG
         if ((now - SmartLastPrint) >= 5000)
-            fprintf(stderr, " %2d: %3d", client, pClient->smart_priority);
+            fprintf(stderr, " %2d: %3d", pClient->index, pClient->smart_priority);
 #endif
     }
 #ifdef SMART_DEBUG
     if ((now - SmartLastPrint) >= 5000) {
-        fprintf(stderr, " use %2d\n", best);
+        fprintf(stderr, " use %2d\n", best->index);
         SmartLastPrint = now;
     }
 #endif
-    pClient = clients[best];
-    SmartLastIndex[bestPrio - SMART_MIN_PRIORITY] = pClient->index;
+    SmartLastIndex[best->smart_priority - SMART_MIN_PRIORITY] = best->index;
     /*
      * Set current client pointer
      */
-    if (SmartLastClient != pClient) {
-        pClient->smart_start_tick = now;
-        SmartLastClient = pClient;
+    if (SmartLastClient != best) {
+        best->smart_start_tick = now;
+        SmartLastClient = best;
     }
     /*
      * Adjust slice
@@ -305,17 +365,84 @@ SmartScheduleClient(int *clientReady, int nready)
          * has run, bump the slice up to get maximal
          * performance from a single client
          */
-        if ((now - pClient->smart_start_tick) > 1000 &&
+        if ((now - best->smart_start_tick) > 1000 &&
             SmartScheduleSlice < SmartScheduleMaxSlice) {
             SmartScheduleSlice += SmartScheduleInterval;
+            SmartScheduleTotals.slice_growths++;
         }
     }
     else {
         SmartScheduleSlice = SmartScheduleInterval;
     }
+    best->sched_stats.slices++;
+    SmartScheduleTotals.slices++;
     return best;
 }
 
+/*
+ * Log the scheduler totals and the clients that used the most dispatch
+ * time since the previous report.
+ */
+#define SMART_STATS_TOP_CLIENTS 3
+
+static CARD32
+SmartScheduleStatsReport(OsTimerPtr timer, CARD32 time, void *arg)
+{
+    ClientPtr top[SMART_STATS_TOP_CLIENTS] = { NULL };
+    uint64_t used[SMART_STATS_TOP_CLIENTS] = { 0 };
+    int i, j, n = 0;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        ClientPtr client = clients[i];
+        uint64_t delta;
+
+        if (!client || client->clientGone)
+            continue;
+
+        delta = client->sched_stats.dispatch_time -
+            client->sched_stats.reported_time;
+        client->sched_stats.reported_time = client->sched_stats.dispatch_time;
+        if (!delta)
+            continue;
+
+        /* insertion into the short top list */
+        for (j = n; j > 0 && used[j - 1] < delta; j--) {
+            if (j < SMART_STATS_TOP_CLIENTS) {
+                top[j] = top[j - 1];
+                used[j] = used[j - 1];
+            }
+        }
+        if (j < SMART_STATS_TOP_CLIENTS) {
+            top[j] = client;
+            used[j] = delta;
+            if (n < SMART_STATS_TOP_CLIENTS)
+                n++;
+        }
+    }
+
+    LogMessageVerb(X_INFO, 0,
+                   "Scheduler: %u slices, %u preempted, %u slice growths, "
+                   "slice %ld ms\n", SmartScheduleTotals.slices,
+                   SmartScheduleTotals.preempted,
+                   SmartScheduleTotals.slice_growths, SmartScheduleSlice);
+    for (i = 0; i < n; i++) {
+        ClientSchedStatsRec *stats = &top[i]->sched_stats;
+        const char *name = GetClientCmdName(top[i]);
+
+        LogMessageVerb(X_INFO, 0,
+                       "Scheduler:   client %d (%s): %llu ms, %llu requests, "
+                       "%u/%u slices preempted, priority %d\n",
+                       top[i]->index, name ? name : "unknown",
+                       (unsigned long long) (used[i] / 1000),
+                       (unsigned long long) stats->requests,
+                       stats->preempted, stats->slices,
+                       top[i]->smart_priority);
+    }
+
+    memset(&SmartScheduleTotals, 0, sizeof(SmartScheduleTotals));
+    return SmartScheduleStatsInterval * 1000;
+}
+
 void
 EnableLimitedSchedulingLatency(void)
 {
@@ -336,52 +463,45 @@ DisableLimitedSchedulingLatency(void)
 void
 Dispatch(void)
 {
-    int *clientReady;           /* array of request ready clients */
     int result;
     ClientPtr client;
-    int nready;
     HWEventQueuePtr *icheck = checkForInput;
     long start_tick;
+    CARD64 start_time;
 
     nextFreeClientID = 1;
     nClients = 0;
 
-    clientReady = xallocarray(MaxClients, sizeof(int));
-    if (!clientReady)
-        return;
-
     SmartScheduleSlice = SmartScheduleInterval;
+    init_client_ready();
+
+    if (SmartScheduleStatsInterval > 0)
+        SmartScheduleStatsTimer =
+            TimerSet(SmartScheduleStatsTimer, 0,
+                     SmartScheduleStatsInterval * 1000,
+                     SmartScheduleStatsReport, NULL);
+
     while (!dispatchException) {
         if (*icheck[0] != *icheck[1]) {
             ProcessInputEvents();
             FlushIfCriticalOutputPending();
         }
 
-        nready = WaitForSomething(clientReady, ProcFlush);
+        if (!WaitForSomething(clients_are_ready(), ProcFlush))
+            continue;
 
-        if (nready) {
-            clientReady[0] = SmartScheduleClient(clientReady, nready);
-            nready = 1;
-        }
        /*****************
 	*  Handle events in round robin fashion, doing input between
 	*  each round
 	*****************/
 
-        while (!dispatchException && (--nready >= 0)) {
-            client = clients[clientReady[nready]];
-            if (!client) {
-                /* KillClient can cause this to happen */
-                continue;
-            }
-            /* GrabServer activation can cause this to be true */
-            if (grabState == GrabKickout) {
-                grabState = GrabActive;
-                break;
-            }
+        if (!dispatchException && clients_are_ready()) {
+            client = SmartScheduleClient();
+
             isItTimeToYield = FALSE;
 
             start_tick = SmartScheduleTime;
+            start_time = GetTimeInMicros();
             while (!isItTimeToYield) {
                 if (*icheck[0] != *icheck[1])
                     ProcessInputEvents();
@@ -390,8 +510,12 @@ Dispatch(void)
                 if ((SmartScheduleTime - start_tick) >= SmartScheduleSlice)
                 {
                     /* Penalize clients which consume ticks */
-                    if (client->smart_priority > SMART_MIN_PRIORITY)
+                    if (client->smart_priority > SMART_MIN_PRIORITY) {
                         client->smart_priority--;
+                        client->sched_stats.priority_lowered++;
+                    }
+                    client->sched_stats.preempted++;
+                    SmartScheduleTotals.preempted++;
                     break;
                 }
                 /* now, finally, deal with client requests */
@@ -407,6 +531,7 @@ Dispatch(void)
                 }
 
                 client->sequence++;
+                client->sched_stats.requests++;
                 client->majorOp = ((xReq *) client->requestBuffer)->reqType;
                 client->minorOp = 0;
                 if (client->majorOp >= EXTENSION_BASE) {
@@ -454,17 +579,25 @@ Dispatch(void)
                 }
             }
             FlushAllOutput();
-            client = clients[clientReady[nready]];
-            if (client)
+            /* CloseDownClient may have freed the client */
+            if (client == SmartLastClient) {
                 client->smart_stop_tick = SmartScheduleTime;
+                client->sched_stats.dispatch_time +=
+                    GetTimeInMicros() - start_time;
+            }
+            /* The grabbing client's peers were moved off the ready
+             * list by OnlyListenToOneClient, nothing left to kick out */
+            if (grabState == GrabKickout)
+                grabState = GrabActive;
         }
         dispatchException &= ~DE_PRIORITYCHANGE;
     }
 #if defined(DDXBEFORERESET)
     ddxBeforeReset();
 #endif
+    TimerFree(SmartScheduleStatsTimer);
+    SmartScheduleStatsTimer = NULL;
     KillAllClients();
-    free(clientReady);
     dispatchException &= ~DE_RESET;
     SmartScheduleLatencyLimited = 0;
     ResetOsBuffers();
@@ -2146,6 +2279,8 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             length += widthBytesLine;
         }
     }
+    /* One buffer for every strip.  GetImage need not write the padding
+     * at the end of each line, so it starts out zeroed. */
     if (!(pBuf = calloc(1, length)))
         return BadAlloc;
     WriteReplyToClient(client, sizeof(xGetImageReply), &xgi);
@@ -2180,8 +2315,17 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
             linesDone += nlines;
+
+            /* The last strip is not reused, so hand it over rather than
+             * having it copied when the client is not keeping up */
+            if (height - linesDone > 0)
+                WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
+            else {
+                WriteToClientRef(client, (int) (nlines * widthBytesLine),
+                                 pBuf, free);
+                pBuf = NULL;
+            }
         }
     }
     else {                      /* XYPixmap */
@@ -3477,7 +3621,10 @@ InitClient(ClientPtr client, int i, void *ospriv)
     QueryMinMaxKeyCodes(&client->minKC, &client->maxKC);
     client->smart_start_tick = SmartScheduleTime;
     client->smart_stop_tick = SmartScheduleTime;
+    memset(&client->sched_stats, 0, sizeof(client->sched_stats));
     client->clientIds = NULL;
+    xorg_list_init(&client->ready);
+    xorg_list_init(&client->output_pending);
 }
 
 /************************
@@ -53,10 +53,18 @@
 
 static int countValuators(DeviceEvent *ev, int *first);
 static int getValuatorEvents(DeviceEvent *ev, deviceValuator * xv);
-static int eventToKeyButtonPointer(DeviceEvent *ev, xEvent **xi, int *count);
+static int eventToCore(InternalEvent *event, EventBufferPtr buffer,
+                       xEvent **core, int *count);
+static int eventToXI(InternalEvent *ev, EventBufferPtr buffer,
+                     xEvent **xi, int *count);
+static int eventToXI2(InternalEvent *ev, EventBufferPtr buffer, xEvent **xi);
+static int eventToKeyButtonPointer(DeviceEvent *ev, EventBufferPtr buffer,
+                                   xEvent **xi, int *count);
 static int eventToDeviceChanged(DeviceChangedEvent *ev, xEvent **dcce);
-static int eventToDeviceEvent(DeviceEvent *ev, xEvent **xi);
-static int eventToRawEvent(RawDeviceEvent *ev, xEvent **xi);
+static int eventToDeviceEvent(DeviceEvent *ev, EventBufferPtr buffer,
+                              xEvent **xi);
+static int eventToRawEvent(RawDeviceEvent *ev, EventBufferPtr buffer,
+                           xEvent **xi);
 static int eventToBarrierEvent(BarrierEvent *ev, xEvent **xi);
 static int eventToTouchOwnershipEvent(TouchOwnershipEvent *ev, xEvent **xi);
 
@@ -102,6 +110,38 @@ EventIsKeyRepeat(xEvent *event)
  */
 int
 EventToCore(InternalEvent *event, xEvent **core_out, int *count_out)
+{
+    return eventToCore(event, NULL, core_out, count_out);
+}
+
+/**
+ * Return zeroed memory for len bytes of wire events. If buffer is NULL,
+ * the memory is allocated and must be freed by the caller. Otherwise the
+ * buffer's storage is grown as needed and reused, the caller must not
+ * free it.
+ */
+static xEvent *
+alloc_events(EventBufferPtr buffer, size_t len)
+{
+    if (!buffer)
+        return calloc(1, len);
+
+    if (buffer->size < len) {
+        xEvent *events = realloc(buffer->events, len);
+
+        if (!events)
+            return NULL;
+        buffer->events = events;
+        buffer->size = len;
+    }
+
+    memset(buffer->events, 0, len);
+    return buffer->events;
+}
+
+static int
+eventToCore(InternalEvent *event, EventBufferPtr buffer,
+            xEvent **core_out, int *count_out)
 {
     xEvent *core = NULL;
     int count = 0;
@@ -132,9 +172,11 @@ EventToCore(InternalEvent *event, xEvent **core_out, int *count_out)
             goto out;
         }
 
-        core = calloc(1, sizeof(*core));
-        if (!core)
-            return BadAlloc;
+        core = alloc_events(buffer, sizeof(*core));
+        if (!core) {
+            ret = BadAlloc;
+            goto out;
+        }
         count = 1;
         core->u.u.type = e->type - ET_KeyPress + KeyPress;
         core->u.u.detail = e->detail.key & 0xFF;
@@ -196,6 +238,12 @@ EventToCore(InternalEvent *event, xEvent **core_out, int *count_out)
  */
 int
 EventToXI(InternalEvent *ev, xEvent **xi, int *count)
+{
+    return eventToXI(ev, NULL, xi, count);
+}
+
+static int
+eventToXI(InternalEvent *ev, EventBufferPtr buffer, xEvent **xi, int *count)
 {
     switch (ev->any.type) {
     case ET_Motion:
@@ -205,7 +253,7 @@ EventToXI(InternalEvent *ev, xEvent **xi, int *count)
     case ET_KeyRelease:
     case ET_ProximityIn:
     case ET_ProximityOut:
-        return eventToKeyButtonPointer(&ev->device_event, xi, count);
+        return eventToKeyButtonPointer(&ev->device_event, buffer, xi, count);
     case ET_DeviceChanged:
     case ET_RawKeyPress:
     case ET_RawKeyRelease:
@@ -248,6 +296,12 @@ EventToXI(InternalEvent *ev, xEvent **xi, int *count)
  */
 int
 EventToXI2(InternalEvent *ev, xEvent **xi)
+{
+    return eventToXI2(ev, NULL, xi);
+}
+
+static int
+eventToXI2(InternalEvent *ev, EventBufferPtr buffer, xEvent **xi)
 {
     switch (ev->any.type) {
         /* Enter/FocusIn are for grabs. We don't need an actual event, since
@@ -264,7 +318,7 @@ EventToXI2(InternalEvent *ev, xEvent **xi)
     case ET_TouchBegin:
     case ET_TouchUpdate:
     case ET_TouchEnd:
-        return eventToDeviceEvent(&ev->device_event, xi);
+        return eventToDeviceEvent(&ev->device_event, buffer, xi);
     case ET_TouchOwnership:
         return eventToTouchOwnershipEvent(&ev->touch_ownership_event, xi);
     case ET_ProximityIn:
@@ -281,7 +335,7 @@ EventToXI2(InternalEvent *ev, xEvent **xi)
     case ET_RawTouchBegin:
     case ET_RawTouchUpdate:
     case ET_RawTouchEnd:
-        return eventToRawEvent(&ev->raw_event, xi);
+        return eventToRawEvent(&ev->raw_event, buffer, xi);
     case ET_BarrierHit:
     case ET_BarrierLeave:
         return eventToBarrierEvent(&ev->barrier_event, xi);
@@ -293,8 +347,43 @@ EventToXI2(InternalEvent *ev, xEvent **xi)
     return BadImplementation;
 }
 
+/**
+ * Convert the given event to the wire format of the given protocol level.
+ * If buffer is not NULL, the events are stored in the buffer's memory
+ * where possible so that repeated conversions do not allocate. The
+ * caller must check whether *xE is buffer->events and free it otherwise.
+ *
+ * @param[in] event The event to convert.
+ * @param[in] level CORE, XI or XI2.
+ * @param[in] buffer Scratch memory for the converted events, or NULL.
+ * @param[out] xE The converted events.
+ * @param[out] count Number of elements in xE.
+ *
+ * @return Success or the error code.
+ */
+int
+EventToWire(InternalEvent *event, enum InputLevel level,
+            EventBufferPtr buffer, xEvent **xE, int *count)
+{
+    int rc;
+
+    switch (level) {
+    case CORE:
+        return eventToCore(event, buffer, xE, count);
+    case XI:
+        return eventToXI(event, buffer, xE, count);
+    case XI2:
+        rc = eventToXI2(event, buffer, xE);
+        *count = (rc == Success && *xE) ? 1 : 0;
+        return rc;
+    }
+
+    return BadImplementation;
+}
+
 static int
-eventToKeyButtonPointer(DeviceEvent *ev, xEvent **xi, int *count)
+eventToKeyButtonPointer(DeviceEvent *ev, EventBufferPtr buffer,
+                        xEvent **xi, int *count)
 {
     int num_events;
     int first;                  /* dummy */
@@ -328,8 +417,9 @@ eventToKeyButtonPointer(DeviceEvent *ev, xEvent **xi, int *count)
 
     num_events++;               /* the actual event event */
 
-    *xi = calloc(num_events, sizeof(xEvent));
+    *xi = alloc_events(buffer, num_events * sizeof(xEvent));
     if (!(*xi)) {
+        *count = 0;
         return BadAlloc;
     }
 
@@ -641,7 +731,7 @@ count_bits(unsigned char *ptr, int len)
 }
 
 static int
-eventToDeviceEvent(DeviceEvent *ev, xEvent **xi)
+eventToDeviceEvent(DeviceEvent *ev, EventBufferPtr buffer, xEvent **xi)
 {
     int len = sizeof(xXIDeviceEvent);
     xXIDeviceEvent *xde;
@@ -662,7 +752,9 @@ eventToDeviceEvent(DeviceEvent *ev, xEvent **xi)
     vallen = bytes_to_int32(bits_to_bytes(MAX_VALUATORS));
     len += vallen * 4;          /* valuators mask */
 
-    *xi = calloc(1, len);
+    *xi = alloc_events(buffer, len);
+    if (!*xi)
+        return BadAlloc;
     xde = (xXIDeviceEvent *) * xi;
     xde->type = GenericEvent;
     xde->extension = IReqCode;
@@ -746,7 +838,7 @@ eventToTouchOwnershipEvent(TouchOwnershipEvent *ev, xEvent **xi)
 }
 
 static int
-eventToRawEvent(RawDeviceEvent *ev, xEvent **xi)
+eventToRawEvent(RawDeviceEvent *ev, EventBufferPtr buffer, xEvent **xi)
 {
     xXIRawEvent *raw;
     int vallen, nvals;
@@ -760,7 +852,9 @@ eventToRawEvent(RawDeviceEvent *ev, xEvent **xi)
     vallen = bytes_to_int32(bits_to_bytes(MAX_VALUATORS));
     len += vallen * 4;          /* valuators mask */
 
-    *xi = calloc(1, len);
+    *xi = alloc_events(buffer, len);
+    if (!*xi)
+        return BadAlloc;
     raw = (xXIRawEvent *) * xi;
     raw->type = GenericEvent;
     raw->extension = IReqCode;
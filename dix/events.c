@@ -2095,6 +2095,106 @@ DeliverToWindowOwner(DeviceIntPtr dev, WindowPtr win,
     return EVENT_NOT_DELIVERED;
 }
 
+/* Upper bound on the cached recipient lists per window */
+#define MAX_XI2_RECIPIENTS 16
+
+static void
+FreeXI2RecipientList(XI2Recipients *recipients)
+{
+    InputClientsPtr ic, next;
+
+    for (ic = recipients->clients; ic; ic = next) {
+        next = ic->next;
+        free(ic);
+    }
+    free(recipients);
+}
+
+/**
+ * Drop the cached XI2 recipient lists of the window. Must be called
+ * whenever the window's input clients or their XI2 masks change.
+ */
+void
+FreeXI2Recipients(OtherInputMasks *inputMasks)
+{
+    XI2Recipients *r, *next;
+
+    if (!inputMasks)
+        return;
+
+    for (r = inputMasks->xi2recipients; r; r = next) {
+        next = r->next;
+        FreeXI2RecipientList(r);
+    }
+    inputMasks->xi2recipients = NULL;
+}
+
+/**
+ * Return the window's input clients that selected for the XI2 event type
+ * from the device, building and caching the list on first use. The
+ * returned clients are copies chained through their own next pointer.
+ *
+ * @return The list, or NULL if it could not be allocated.
+ */
+static XI2Recipients *
+GetXI2Recipients(DeviceIntPtr dev, OtherInputMasks *inputMasks, int evtype)
+{
+    XI2Recipients *r, *prev = NULL;
+    InputClientsPtr others, *tail;
+    Bool master = IsMaster(dev);
+    int n = 0;
+
+    for (r = inputMasks->xi2recipients; r; prev = r, r = r->next, n++) {
+        if (r->deviceid == dev->id && r->master == master &&
+            r->evtype == evtype) {
+            if (prev) {
+                prev->next = r->next;
+                r->next = inputMasks->xi2recipients;
+                inputMasks->xi2recipients = r;
+            }
+            return r;
+        }
+    }
+
+    /* Evict the least recently used list */
+    if (n >= MAX_XI2_RECIPIENTS) {
+        for (prev = inputMasks->xi2recipients; prev->next->next;
+             prev = prev->next);
+        FreeXI2RecipientList(prev->next);
+        prev->next = NULL;
+    }
+
+    r = calloc(1, sizeof(XI2Recipients));
+    if (!r)
+        return NULL;
+    r->deviceid = dev->id;
+    r->master = master;
+    r->evtype = evtype;
+
+    tail = &r->clients;
+    for (others = inputMasks->inputClients; others; others = others->next) {
+        InputClientsPtr ic;
+
+        if (!xi2mask_isset(others->xi2mask, dev, evtype))
+            continue;
+
+        ic = malloc(sizeof(InputClients));
+        if (!ic) {
+            FreeXI2RecipientList(r);
+            return NULL;
+        }
+        *ic = *others;
+        ic->next = NULL;
+        *tail = ic;
+        tail = &ic->next;
+    }
+
+    r->next = inputMasks->xi2recipients;
+    inputMasks->xi2recipients = r;
+
+    return r;
+}
+
 /**
  * Get the list of clients that should be tried for event delivery on the
  * given window.
@@ -2113,10 +2213,15 @@ GetClientsForDelivery(DeviceIntPtr dev, WindowPtr win,
     else if (xi2_get_type(events) != 0) {
         OtherInputMasks *inputMasks = wOtherInputMasks(win);
 
+        XI2Recipients *recipients;
+
         /* Has any client selected for the event? */
         if (!WindowXI2MaskIsset(dev, win, events))
             goto out;
-        *iclients = inputMasks->inputClients;
+
+        /* Only try the clients that selected for it */
+        recipients = GetXI2Recipients(dev, inputMasks, xi2_get_type(events));
+        *iclients = recipients ? recipients->clients : inputMasks->inputClients;
     }
     else {
         OtherInputMasks *inputMasks = wOtherInputMasks(win);
@@ -2335,6 +2440,43 @@ FilterRawEvents(const ClientPtr client, const GrabPtr grab, WindowPtr root)
     return (grab->window != root) ? FALSE : SameClient(grab, client);
 }
 
+/**
+ * Convert the event to the wire format for the given level, using the
+ * device's scratch buffer for that level unless it already holds an event
+ * that is being delivered. The result must be released with
+ * ReleaseWireEvent().
+ */
+static int
+ConvertWireEvent(DeviceIntPtr dev, InternalEvent *event,
+                 enum InputLevel level, xEvent **xE, int *count)
+{
+    EventBufferPtr buffer = &dev->eventBuffers[level];
+    int rc;
+
+    /* nested delivery, don't overwrite the outer event */
+    if (buffer->busy)
+        buffer = NULL;
+
+    *xE = NULL;
+    *count = 0;
+    rc = EventToWire(event, level, buffer, xE, count);
+    if (rc == Success && buffer && *xE && *xE == buffer->events)
+        buffer->busy = TRUE;
+
+    return rc;
+}
+
+static void
+ReleaseWireEvent(DeviceIntPtr dev, enum InputLevel level, xEvent *xE)
+{
+    EventBufferPtr buffer = &dev->eventBuffers[level];
+
+    if (xE && xE == buffer->events)
+        buffer->busy = FALSE;
+    else
+        free(xE);
+}
+
 /**
  * Deliver a raw event to the grab owner (if any) and to all root windows.
  *
@@ -2349,19 +2491,21 @@ DeliverRawEvent(RawDeviceEvent *ev, DeviceIntPtr device)
 {
     GrabPtr grab = device->deviceGrab.grab;
     xEvent *xi;
-    int i, rc;
+    int i, rc, count;
     int filter;
 
-    rc = EventToXI2((InternalEvent *) ev, (xEvent **) &xi);
+    /* The grab delivery converts the event itself, do it first so both
+     * conversions can use the device's scratch buffer */
+    if (grab)
+        DeliverGrabbedEvent((InternalEvent *) ev, device, FALSE);
+
+    rc = ConvertWireEvent(device, (InternalEvent *) ev, XI2, &xi, &count);
     if (rc != Success) {
         ErrorF("[Xi] %s: XI2 conversion failed in %s (%d)\n",
                __func__, device->name, rc);
         return;
     }
 
-    if (grab)
-        DeliverGrabbedEvent((InternalEvent *) ev, device, FALSE);
-
     filter = GetEventFilter(device, xi);
 
     for (i = 0; i < screenInfo.numScreens; i++) {
@@ -2391,7 +2535,7 @@ DeliverRawEvent(RawDeviceEvent *ev, DeviceIntPtr device)
         }
     }
 
-    free(xi);
+    ReleaseWireEvent(device, XI2, xi);
 }
 
 /* If the event goes to dontClient, don't send it and return 0.  if
@@ -2646,40 +2790,35 @@ DeliverEvent(DeviceIntPtr dev, xEvent *xE, int count,
     return deliveries;
 }
 
+/**
+ * An event converted to one wire format. The conversion happens the first
+ * time a window on the propagation path wants the event at that level and
+ * is reused for all further windows.
+ */
+typedef struct {
+    Bool converted;
+    int rc;
+    xEvent *events;
+    int count;
+} WireEvent;
+
 static int
 DeliverOneEvent(InternalEvent *event, DeviceIntPtr dev, enum InputLevel level,
-                WindowPtr win, Window child, GrabPtr grab)
+                WireEvent *wire, WindowPtr win, Window child, GrabPtr grab)
 {
-    xEvent *xE = NULL;
-    int count = 0;
-    int deliveries = 0;
-    int rc;
-
-    switch (level) {
-    case XI2:
-        rc = EventToXI2(event, &xE);
-        count = 1;
-        break;
-    case XI:
-        rc = EventToXI(event, &xE, &count);
-        break;
-    case CORE:
-        rc = EventToCore(event, &xE, &count);
-        break;
-    default:
-        rc = BadImplementation;
-        break;
+    if (!wire->converted) {
+        wire->rc = ConvertWireEvent(dev, event, level,
+                                    &wire->events, &wire->count);
+        wire->converted = TRUE;
+        BUG_WARN_MSG(wire->rc != Success && wire->rc != BadMatch,
+                     "%s: conversion to level %d failed with rc %d\n",
+                     dev->name, level, wire->rc);
     }
 
-    if (rc == Success) {
-        deliveries = DeliverEvent(dev, xE, count, win, child, grab);
-        free(xE);
-    }
-    else
-        BUG_WARN_MSG(rc != BadMatch,
-                     "%s: conversion to level %d failed with rc %d\n",
-                     dev->name, level, rc);
-    return deliveries;
+    if (wire->rc != Success)
+        return 0;
+
+    return DeliverEvent(dev, wire->events, wire->count, win, child, grab);
 }
 
 /**
@@ -2708,6 +2847,8 @@ DeliverDeviceEvents(WindowPtr pWin, InternalEvent *event, GrabPtr grab,
     Window child = None;
     int deliveries = 0;
     int mask;
+    WireEvent wire[XI2 + 1] = { { FALSE } };
+    enum InputLevel level;
 
     verify_internal_event(event);
 
@@ -2715,23 +2856,24 @@ DeliverDeviceEvents(WindowPtr pWin, InternalEvent *event, GrabPtr grab,
         if ((mask = EventIsDeliverable(dev, event->any.type, pWin))) {
             /* XI2 events first */
             if (mask & EVENT_XI2_MASK) {
-                deliveries =
-                    DeliverOneEvent(event, dev, XI2, pWin, child, grab);
+                deliveries = DeliverOneEvent(event, dev, XI2, &wire[XI2],
+                                             pWin, child, grab);
                 if (deliveries > 0)
                     break;
             }
 
             /* XI events */
             if (mask & EVENT_XI1_MASK) {
-                deliveries = DeliverOneEvent(event, dev, XI, pWin, child, grab);
+                deliveries = DeliverOneEvent(event, dev, XI, &wire[XI],
+                                             pWin, child, grab);
                 if (deliveries > 0)
                     break;
             }
 
             /* Core event */
             if ((mask & EVENT_CORE_MASK) && IsMaster(dev) && dev->coreEvents) {
-                deliveries =
-                    DeliverOneEvent(event, dev, CORE, pWin, child, grab);
+                deliveries = DeliverOneEvent(event, dev, CORE, &wire[CORE],
+                                             pWin, child, grab);
                 if (deliveries > 0)
                     break;
             }
@@ -2748,6 +2890,11 @@ DeliverDeviceEvents(WindowPtr pWin, InternalEvent *event, GrabPtr grab,
         pWin = pWin->parent;
     }
 
+    for (level = CORE; level <= XI2; level++) {
+        if (wire[level].converted && wire[level].rc == Success)
+            ReleaseWireEvent(dev, level, wire[level].events);
+    }
+
     return deliveries;
 }
 
@@ -4154,8 +4301,7 @@ DeliverOneGrabbedEvent(InternalEvent *event, DeviceIntPtr dev,
 
     switch (level) {
     case XI2:
-        rc = EventToXI2(event, &xE);
-        count = 1;
+        rc = ConvertWireEvent(dev, event, XI2, &xE, &count);
         if (rc == Success) {
             int evtype = xi2_get_type(xE);
 
@@ -4168,12 +4314,12 @@ DeliverOneGrabbedEvent(InternalEvent *event, DeviceIntPtr dev,
             mask = grab->deviceMask;
         else
             mask = grab->eventMask;
-        rc = EventToXI(event, &xE, &count);
+        rc = ConvertWireEvent(dev, event, XI, &xE, &count);
         if (rc == Success)
             filter = GetEventFilter(dev, xE);
         break;
     case CORE:
-        rc = EventToCore(event, &xE, &count);
+        rc = ConvertWireEvent(dev, event, CORE, &xE, &count);
         mask = grab->eventMask;
         if (rc == Success)
             filter = GetEventFilter(dev, xE);
@@ -4200,7 +4346,8 @@ DeliverOneGrabbedEvent(InternalEvent *event, DeviceIntPtr dev,
                      "%s: conversion to mode %d failed on %d with %d\n",
                      dev->name, level, event->any.type, rc);
 
-    free(xE);
+    if (rc == Success)
+        ReleaseWireEvent(dev, level, xE);
     return deliveries;
 }
 
@@ -11,143 +11,92 @@
 #include <X11/Xatom.h>
 #include "misc.h"
 #include "dix.h"
+
+/* fingerprints are those computed by MakeAtom() */
+static const struct {
+    const char *name;
+    unsigned int len;
+    unsigned int fingerPrint;
+    Atom atom;
+} predeclared[] = {
+    { "PRIMARY", 7, 0x26dca209U, XA_PRIMARY },
+    { "SECONDARY", 9, 0x66ee91e6U, XA_SECONDARY },
+    { "ARC", 3, 0x00144d66U, XA_ARC },
+    { "ATOM", 4, 0x00146a13U, XA_ATOM },
+    { "BITMAP", 6, 0x3b11e9e3U, XA_BITMAP },
+    { "CARDINAL", 8, 0x4248f22aU, XA_CARDINAL },
+    { "COLORMAP", 8, 0xaa9eaa2fU, XA_COLORMAP },
+    { "CURSOR", 6, 0x3c00d682U, XA_CURSOR },
+    { "CUT_BUFFER0", 11, 0xbe17df4eU, XA_CUT_BUFFER0 },
+    { "CUT_BUFFER1", 11, 0x81e25807U, XA_CUT_BUFFER1 },
+    { "CUT_BUFFER2", 11, 0x45acd0c0U, XA_CUT_BUFFER2 },
+    { "CUT_BUFFER3", 11, 0x09774979U, XA_CUT_BUFFER3 },
+    { "CUT_BUFFER4", 11, 0xcd41c232U, XA_CUT_BUFFER4 },
+    { "CUT_BUFFER5", 11, 0x910c3aebU, XA_CUT_BUFFER5 },
+    { "CUT_BUFFER6", 11, 0x54d6b3a4U, XA_CUT_BUFFER6 },
+    { "CUT_BUFFER7", 11, 0x18a12c5dU, XA_CUT_BUFFER7 },
+    { "DRAWABLE", 8, 0x1efe5d0eU, XA_DRAWABLE },
+    { "FONT", 4, 0x0015fde9U, XA_FONT },
+    { "INTEGER", 7, 0x74ff8f33U, XA_INTEGER },
+    { "PIXMAP", 6, 0x470b2c29U, XA_PIXMAP },
+    { "POINT", 5, 0x472d8cabU, XA_POINT },
+    { "RECTANGLE", 9, 0x394d7c04U, XA_RECTANGLE },
+    { "RESOURCE_MANAGER", 16, 0x0c8ab61aU, XA_RESOURCE_MANAGER },
+    { "RGB_COLOR_MAP", 13, 0x49516a12U, XA_RGB_COLOR_MAP },
+    { "RGB_BEST_MAP", 12, 0x57304a57U, XA_RGB_BEST_MAP },
+    { "RGB_BLUE_MAP", 12, 0x5730205fU, XA_RGB_BLUE_MAP },
+    { "RGB_DEFAULT_MAP", 15, 0x5ddb09f1U, XA_RGB_DEFAULT_MAP },
+    { "RGB_GRAY_MAP", 12, 0x5731da50U, XA_RGB_GRAY_MAP },
+    { "RGB_GREEN_MAP", 13, 0x4c9d8d65U, XA_RGB_GREEN_MAP },
+    { "RGB_RED_MAP", 11, 0x5734eae9U, XA_RGB_RED_MAP },
+    { "STRING", 6, 0x49567a11U, XA_STRING },
+    { "VISUALID", 8, 0xd6df46ffU, XA_VISUALID },
+    { "WINDOW", 6, 0x4d40b774U, XA_WINDOW },
+    { "WM_COMMAND", 10, 0x9624b99cU, XA_WM_COMMAND },
+    { "WM_HINTS", 8, 0xa485b8ffU, XA_WM_HINTS },
+    { "WM_CLIENT_MACHINE", 17, 0x49db5696U, XA_WM_CLIENT_MACHINE },
+    { "WM_ICON_NAME", 12, 0x9568b8c8U, XA_WM_ICON_NAME },
+    { "WM_ICON_SIZE", 12, 0x29c33232U, XA_WM_ICON_SIZE },
+    { "WM_NAME", 7, 0x6102df0cU, XA_WM_NAME },
+    { "WM_NORMAL_HINTS", 15, 0x35ca44caU, XA_WM_NORMAL_HINTS },
+    { "WM_SIZE_HINTS", 13, 0x3afdd794U, XA_WM_SIZE_HINTS },
+    { "WM_ZOOM_HINTS", 13, 0x4c827c1aU, XA_WM_ZOOM_HINTS },
+    { "MIN_SPACE", 9, 0xd38044f6U, XA_MIN_SPACE },
+    { "NORM_SPACE", 10, 0xecd817ddU, XA_NORM_SPACE },
+    { "MAX_SPACE", 9, 0x602b278cU, XA_MAX_SPACE },
+    { "END_SPACE", 9, 0x30246c6fU, XA_END_SPACE },
+    { "SUPERSCRIPT_X", 13, 0xb5ac9450U, XA_SUPERSCRIPT_X },
+    { "SUPERSCRIPT_Y", 13, 0x413e5b21U, XA_SUPERSCRIPT_Y },
+    { "SUBSCRIPT_X", 11, 0x108d9a04U, XA_SUBSCRIPT_X },
+    { "SUBSCRIPT_Y", 11, 0xd45812bdU, XA_SUBSCRIPT_Y },
+    { "UNDERLINE_POSITION", 18, 0x0eb4b2deU, XA_UNDERLINE_POSITION },
+    { "UNDERLINE_THICKNESS", 19, 0xa25f47daU, XA_UNDERLINE_THICKNESS },
+    { "STRIKEOUT_ASCENT", 16, 0x3d6ec7b3U, XA_STRIKEOUT_ASCENT },
+    { "STRIKEOUT_DESCENT", 17, 0x4bfa27f7U, XA_STRIKEOUT_DESCENT },
+    { "ITALIC_ANGLE", 12, 0x86184188U, XA_ITALIC_ANGLE },
+    { "X_HEIGHT", 8, 0x3a165c90U, XA_X_HEIGHT },
+    { "QUAD_WIDTH", 10, 0xb54aca8eU, XA_QUAD_WIDTH },
+    { "WEIGHT", 6, 0x4d271ba2U, XA_WEIGHT },
+    { "POINT_SIZE", 10, 0xea93d2f8U, XA_POINT_SIZE },
+    { "RESOLUTION", 10, 0x5f54a03eU, XA_RESOLUTION },
+    { "COPYRIGHT", 9, 0x8b288e95U, XA_COPYRIGHT },
+    { "NOTICE", 6, 0x44fde68cU, XA_NOTICE },
+    { "FONT_NAME", 9, 0x081e11c2U, XA_FONT_NAME },
+    { "FAMILY_NAME", 11, 0x064d2ccfU, XA_FAMILY_NAME },
+    { "FULL_NAME", 9, 0xa34fb606U, XA_FULL_NAME },
+    { "CAP_HEIGHT", 10, 0x725dd502U, XA_CAP_HEIGHT },
+    { "WM_CLASS", 8, 0xa47d7785U, XA_WM_CLASS },
+    { "WM_TRANSIENT_FOR", 16, 0xc49f63c7U, XA_WM_TRANSIENT_FOR },
+};
+
 void
 MakePredeclaredAtoms(void)
 {
-    if (MakeAtom("PRIMARY", 7, 1) != XA_PRIMARY)
-        AtomError();
-    if (MakeAtom("SECONDARY", 9, 1) != XA_SECONDARY)
-        AtomError();
-    if (MakeAtom("ARC", 3, 1) != XA_ARC)
-        AtomError();
-    if (MakeAtom("ATOM", 4, 1) != XA_ATOM)
-        AtomError();
-    if (MakeAtom("BITMAP", 6, 1) != XA_BITMAP)
-        AtomError();
-    if (MakeAtom("CARDINAL", 8, 1) != XA_CARDINAL)
-        AtomError();
-    if (MakeAtom("COLORMAP", 8, 1) != XA_COLORMAP)
-        AtomError();
-    if (MakeAtom("CURSOR", 6, 1) != XA_CURSOR)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER0", 11, 1) != XA_CUT_BUFFER0)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER1", 11, 1) != XA_CUT_BUFFER1)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER2", 11, 1) != XA_CUT_BUFFER2)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER3", 11, 1) != XA_CUT_BUFFER3)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER4", 11, 1) != XA_CUT_BUFFER4)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER5", 11, 1) != XA_CUT_BUFFER5)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER6", 11, 1) != XA_CUT_BUFFER6)
-        AtomError();
-    if (MakeAtom("CUT_BUFFER7", 11, 1) != XA_CUT_BUFFER7)
-        AtomError();
-    if (MakeAtom("DRAWABLE", 8, 1) != XA_DRAWABLE)
-        AtomError();
-    if (MakeAtom("FONT", 4, 1) != XA_FONT)
-        AtomError();
-    if (MakeAtom("INTEGER", 7, 1) != XA_INTEGER)
-        AtomError();
-    if (MakeAtom("PIXMAP", 6, 1) != XA_PIXMAP)
-        AtomError();
-    if (MakeAtom("POINT", 5, 1) != XA_POINT)
-        AtomError();
-    if (MakeAtom("RECTANGLE", 9, 1) != XA_RECTANGLE)
-        AtomError();
-    if (MakeAtom("RESOURCE_MANAGER", 16, 1) != XA_RESOURCE_MANAGER)
-        AtomError();
-    if (MakeAtom("RGB_COLOR_MAP", 13, 1) != XA_RGB_COLOR_MAP)
-        AtomError();
-    if (MakeAtom("RGB_BEST_MAP", 12, 1) != XA_RGB_BEST_MAP)
-        AtomError();
-    if (MakeAtom("RGB_BLUE_MAP", 12, 1) != XA_RGB_BLUE_MAP)
-        AtomError();
-    if (MakeAtom("RGB_DEFAULT_MAP", 15, 1) != XA_RGB_DEFAULT_MAP)
-        AtomError();
-    if (MakeAtom("RGB_GRAY_MAP", 12, 1) != XA_RGB_GRAY_MAP)
-        AtomError();
-    if (MakeAtom("RGB_GREEN_MAP", 13, 1) != XA_RGB_GREEN_MAP)
-        AtomError();
-    if (MakeAtom("RGB_RED_MAP", 11, 1) != XA_RGB_RED_MAP)
-        AtomError();
-    if (MakeAtom("STRING", 6, 1) != XA_STRING)
-        AtomError();
-    if (MakeAtom("VISUALID", 8, 1) != XA_VISUALID)
-        AtomError();
-    if (MakeAtom("WINDOW", 6, 1) != XA_WINDOW)
-        AtomError();
-    if (MakeAtom("WM_COMMAND", 10, 1) != XA_WM_COMMAND)
-        AtomError();
-    if (MakeAtom("WM_HINTS", 8, 1) != XA_WM_HINTS)
-        AtomError();
-    if (MakeAtom("WM_CLIENT_MACHINE", 17, 1) != XA_WM_CLIENT_MACHINE)
-        AtomError();
-    if (MakeAtom("WM_ICON_NAME", 12, 1) != XA_WM_ICON_NAME)
-        AtomError();
-    if (MakeAtom("WM_ICON_SIZE", 12, 1) != XA_WM_ICON_SIZE)
-        AtomError();
-    if (MakeAtom("WM_NAME", 7, 1) != XA_WM_NAME)
-        AtomError();
-    if (MakeAtom("WM_NORMAL_HINTS", 15, 1) != XA_WM_NORMAL_HINTS)
-        AtomError();
-    if (MakeAtom("WM_SIZE_HINTS", 13, 1) != XA_WM_SIZE_HINTS)
-        AtomError();
-    if (MakeAtom("WM_ZOOM_HINTS", 13, 1) != XA_WM_ZOOM_HINTS)
-        AtomError();
-    if (MakeAtom("MIN_SPACE", 9, 1) != XA_MIN_SPACE)
-        AtomError();
-    if (MakeAtom("NORM_SPACE", 10, 1) != XA_NORM_SPACE)
-        AtomError();
-    if (MakeAtom("MAX_SPACE", 9, 1) != XA_MAX_SPACE)
-        AtomError();
-    if (MakeAtom("END_SPACE", 9, 1) != XA_END_SPACE)
-        AtomError();
-    if (MakeAtom("SUPERSCRIPT_X", 13, 1) != XA_SUPERSCRIPT_X)
-        AtomError();
-    if (MakeAtom("SUPERSCRIPT_Y", 13, 1) != XA_SUPERSCRIPT_Y)
-        AtomError();
-    if (MakeAtom("SUBSCRIPT_X", 11, 1) != XA_SUBSCRIPT_X)
-        AtomError();
-    if (MakeAtom("SUBSCRIPT_Y", 11, 1) != XA_SUBSCRIPT_Y)
-        AtomError();
-    if (MakeAtom("UNDERLINE_POSITION", 18, 1) != XA_UNDERLINE_POSITION)
-        AtomError();
-    if (MakeAtom("UNDERLINE_THICKNESS", 19, 1) != XA_UNDERLINE_THICKNESS)
-        AtomError();
-    if (MakeAtom("STRIKEOUT_ASCENT", 16, 1) != XA_STRIKEOUT_ASCENT)
-        AtomError();
-    if (MakeAtom("STRIKEOUT_DESCENT", 17, 1) != XA_STRIKEOUT_DESCENT)
-        AtomError();
-    if (MakeAtom("ITALIC_ANGLE", 12, 1) != XA_ITALIC_ANGLE)
-        AtomError();
-    if (MakeAtom("X_HEIGHT", 8, 1) != XA_X_HEIGHT)
-        AtomError();
-    if (MakeAtom("QUAD_WIDTH", 10, 1) != XA_QUAD_WIDTH)
-        AtomError();
-    if (MakeAtom("WEIGHT", 6, 1) != XA_WEIGHT)
-        AtomError();
-    if (MakeAtom("POINT_SIZE", 10, 1) != XA_POINT_SIZE)
-        AtomError();
-    if (MakeAtom("RESOLUTION", 10, 1) != XA_RESOLUTION)
-        AtomError();
-    if (MakeAtom("COPYRIGHT", 9, 1) != XA_COPYRIGHT)
-        AtomError();
-    if (MakeAtom("NOTICE", 6, 1) != XA_NOTICE)
-        AtomError();
-    if (MakeAtom("FONT_NAME", 9, 1) != XA_FONT_NAME)
-        AtomError();
-    if (MakeAtom("FAMILY_NAME", 11, 1) != XA_FAMILY_NAME)
-        AtomError();
-    if (MakeAtom("FULL_NAME", 9, 1) != XA_FULL_NAME)
-        AtomError();
-    if (MakeAtom("CAP_HEIGHT", 10, 1) != XA_CAP_HEIGHT)
-        AtomError();
-    if (MakeAtom("WM_CLASS", 8, 1) != XA_WM_CLASS)
-        AtomError();
-    if (MakeAtom("WM_TRANSIENT_FOR", 16, 1) != XA_WM_TRANSIENT_FOR)
-        AtomError();
+    int i;
+
+    for (i = 0; i < sizeof(predeclared) / sizeof(predeclared[0]); i++)
+        if (MakeAtomHashed(predeclared[i].name, predeclared[i].len,
+                           predeclared[i].fingerPrint, TRUE) !=
+            predeclared[i].atom)
+            AtomError();
 }
@@ -163,6 +163,7 @@ dix_main(int argc, char *argv[], char *envp[])
         InitBlockAndWakeupHandlers();
         /* Perform any operating system dependent initializations you'd like */
         OsInit();
+        InputThreadPreInit();
         if (serverGeneration == 1) {
             CreateWellKnownSockets();
             for (i = 1; i < LimitClients; i++)
@@ -265,6 +266,7 @@ dix_main(int argc, char *argv[], char *envp[])
 
         InitCoreDevices();
         InitInput(argc, argv);
+        InputThreadInit();
         InitAndStartDevices();
         ReserveClientIds(serverClient);
 
@@ -372,6 +374,7 @@ dix_main(int argc, char *argv[], char *envp[])
 
         if (dispatchException & DE_TERMINATE) {
             CloseWellKnownConnections();
+            InputThreadFini();
         }
 
         OsCleanup((dispatchException & DE_TERMINATE) != 0);
@@ -86,6 +86,187 @@ PrintPropertys(WindowPtr pWin)
 }
 #endif
 
+/*
+ * Windows with many properties (the root window in particular) get an
+ * open-addressed hash from atom to the first property of that name on
+ * userProps.  The list remains authoritative and keeps the order seen
+ * by ListProperties; the index only short-circuits the lookup walk.
+ * A name can appear more than once when an XACE module
+ * polyinstantiates properties, which is why the first match is kept.
+ */
+
+#define PROP_INDEX_MIN 16       /* index windows with this many properties */
+#define PROP_INDEX_DROP 4       /* and drop it again below this many */
+
+typedef struct _PropertyIndex {
+    int count;                  /* properties on userProps */
+    int used;                   /* occupied slots */
+    int bits;                   /* log2 of the number of slots */
+    PropertyPtr slots[0];
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline unsigned
+PropertyHash(Atom name, int bits)
+{
+    return ((CARD32) name * 0x9e3779b9U) >> (32 - bits);
+}
+
+static int
+PropertyIndexSlot(PropertyIndexPtr index, Atom name)
+{
+    unsigned mask = (1U << index->bits) - 1;
+    unsigned i = PropertyHash(name, index->bits);
+
+    while (index->slots[i] && index->slots[i]->propertyName != name)
+        i = (i + 1) & mask;
+    return i;
+}
+
+static PropertyIndexPtr
+PropertyIndexAlloc(int bits)
+{
+    PropertyIndexPtr index;
+
+    index = calloc(1, sizeof(PropertyIndexRec) +
+                   (sizeof(PropertyPtr) << bits));
+    if (index)
+        index->bits = bits;
+    return index;
+}
+
+/* Point name's slot at pProp, adding the slot if needed */
+static void
+PropertyIndexSet(PropertyIndexPtr index, PropertyPtr pProp)
+{
+    int i = PropertyIndexSlot(index, pProp->propertyName);
+
+    if (!index->slots[i])
+        index->used++;
+    index->slots[i] = pProp;
+}
+
+static void
+PropertyIndexRemove(PropertyIndexPtr index, Atom name)
+{
+    unsigned mask = (1U << index->bits) - 1;
+    unsigned i = PropertyIndexSlot(index, name);
+    unsigned j, k;
+
+    if (!index->slots[i])
+        return;
+
+    /* Backward-shift deletion keeps probe chains intact without tombstones */
+    for (j = (i + 1) & mask; index->slots[j]; j = (j + 1) & mask) {
+        k = PropertyHash(index->slots[j]->propertyName, index->bits);
+        if (((j - k) & mask) >= ((j - i) & mask)) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i] = NULL;
+    index->used--;
+}
+
+/* Build an index for the current userProps list; NULL on failure */
+static PropertyIndexPtr
+PropertyIndexBuild(PropertyPtr props, int count)
+{
+    PropertyIndexPtr index;
+    PropertyPtr pProp;
+    int bits = 4;
+
+    while ((1 << bits) < count * 2)
+        bits++;
+    index = PropertyIndexAlloc(bits);
+    if (!index)
+        return NULL;
+
+    index->count = count;
+    for (pProp = props; pProp; pProp = pProp->next) {
+        int i = PropertyIndexSlot(index, pProp->propertyName);
+
+        /* walking from the head, the first entry of a name wins */
+        if (!index->slots[i]) {
+            index->slots[i] = pProp;
+            index->used++;
+        }
+    }
+    return index;
+}
+
+/* pProp has just been pushed on the head of pWin's userProps */
+static void
+PropertyIndexAdd(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+
+    if (!index) {
+        PropertyPtr p;
+        int count = 0;
+
+        for (p = pWin->optional->userProps; p; p = p->next)
+            count++;
+        if (count >= PROP_INDEX_MIN)
+            pWin->optional->propIndex =
+                PropertyIndexBuild(pWin->optional->userProps, count);
+        return;
+    }
+
+    index->count++;
+    if (index->used * 2 >= (1 << index->bits)) {
+        PropertyIndexPtr bigger;
+
+        bigger = PropertyIndexBuild(pWin->optional->userProps, index->count);
+        free(index);
+        pWin->optional->propIndex = bigger;
+        return;
+    }
+    PropertyIndexSet(index, pProp);
+}
+
+/*
+ * Remove pProp from pWin's userProps and keep the index in step.  This
+ * may free the window's optional record once the last property is gone.
+ */
+static void
+UnlinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+    PropertyPtr prevProp;
+
+    if (index) {
+        if (--index->count < PROP_INDEX_DROP) {
+            free(index);
+            pWin->optional->propIndex = NULL;
+        }
+        else if (index->slots[PropertyIndexSlot(index, pProp->propertyName)] ==
+                 pProp) {
+            PropertyPtr next;
+
+            for (next = pProp->next; next; next = next->next)
+                if (next->propertyName == pProp->propertyName)
+                    break;
+            if (next)
+                PropertyIndexSet(index, next);
+            else
+                PropertyIndexRemove(index, pProp->propertyName);
+        }
+    }
+
+    if (pWin->optional->userProps == pProp) {
+        /* Takes care of head */
+        if (!(pWin->optional->userProps = pProp->next))
+            CheckWindowOptionalNeed(pWin);
+    }
+    else {
+        /* Need to traverse to find the previous element */
+        prevProp = pWin->optional->userProps;
+        while (prevProp->next != pProp)
+            prevProp = prevProp->next;
+        prevProp->next = pProp->next;
+    }
+}
+
 int
 dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
                   ClientPtr client, Mask access_mode)
@@ -95,9 +276,16 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    if (pWin->optional && pWin->optional->propIndex) {
+        PropertyIndexPtr index = pWin->optional->propIndex;
+
+        pProp = index->slots[PropertyIndexSlot(index, propertyName)];
+    }
+    else {
+        for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
+            if (pProp->propertyName == propertyName)
+                break;
+    }
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -284,6 +472,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
         }
         pProp->next = pWin->optional->userProps;
         pWin->optional->userProps = pProp;
+        PropertyIndexAdd(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -357,7 +546,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -365,18 +554,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp->propertyName);
         free(pProp->data);
@@ -399,8 +577,11 @@ DeleteAllWindowProperties(WindowPtr pWin)
         pProp = pNextProp;
     }
 
-    if (pWin->optional)
+    if (pWin->optional) {
         pWin->optional->userProps = NULL;
+        free(pWin->optional->propIndex);
+        pWin->optional->propIndex = NULL;
+    }
 }
 
 static int
@@ -432,7 +613,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -535,18 +716,7 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
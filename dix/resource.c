@@ -105,8 +105,13 @@ Equipment Corporation.
  *      A resource ID is a 32 bit quantity, the upper 2 bits of which are
  *	off-limits for client-visible resources.  The next 8 bits are
  *      used as client ID, and the low 22 bits come from the client.
- *	A resource ID is "hashed" by extracting and xoring subfields
- *      (varying with the size of the hash table).
+ *
+ *      Each client has an open-addressed (linear probing) table keyed
+ *      by resource ID.  All resources sharing an ID hang off a single
+ *      slot, newest first.  When the table fills up a larger one is
+ *      allocated and the old slots are migrated a few at a time by
+ *      subsequent AddResource calls, so no single request pays for
+ *      rehashing the whole table.
  *
  *      It is sometimes necessary for the server to create an ID that looks
  *      like it belongs to a client.  This ID, however,  must not be one
@@ -149,31 +154,53 @@ Equipment Corporation.
 #define TypeNameString(t) LookupResourceName(t)
 #endif
 
-static void RebuildTable(int    /*client */
-    );
-
 #define SERVER_MINID 32
 
-#define INITBUCKETS 64
-#define INITHASHSIZE 6
-#define MAXHASHSIZE 11
+#define INITHASHSIZE 6          /* log(2)(initial slots) */
+#define REHASH_STEP 8           /* old slots migrated per AddResource */
 
 typedef struct _Resource {
-    struct _Resource *next;
+    struct _Resource *next;     /* older resource with the same id */
     XID id;
     RESTYPE type;
     void *value;
 } ResourceRec, *ResourcePtr;
 
+/*
+ * A slot is empty when res is NULL and deleted when res is
+ * SLOT_DELETED; deleted slots keep probe sequences intact until
+ * the table is rebuilt.
+ */
+typedef struct _ResourceSlot {
+    XID id;
+    ResourcePtr res;
+} ResourceSlotRec, *ResourceSlotPtr;
+
+typedef struct _ResourceTable {
+    ResourceSlotPtr slots;
+    int size;                   /* 0 or a power of two */
+    int hashsize;               /* log(2)(size) */
+    int used;                   /* live and deleted slots */
+    int serial;                 /* identifies this table to walkers */
+} ResourceTableRec, *ResourceTablePtr;
+
 typedef struct _ClientResource {
-    ResourcePtr *resources;
+    ResourceTableRec table;     /* new resources are added here */
+    ResourceTableRec old;       /* being migrated into table */
+    int migrate;                /* next slot of old to migrate */
+    int generation;             /* bumped when either table is replaced */
+    int walking;                /* nested resource walks in progress */
     int elements;
-    int buckets;
-    int hashsize;               /* log(2)(buckets) */
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
 
+static ResourceRec deletedResource;
+static int tableSerial;
+
+#define SLOT_DELETED (&deletedResource)
+#define SlotLive(slot) ((slot)->res && (slot)->res != SLOT_DELETED)
+
 RESTYPE lastResourceType;
 static RESTYPE lastResourceClass;
 RESTYPE TypeMask;
@@ -623,6 +650,210 @@ ResourceClientBits(void)
     return (ilog2(LimitClients));
 }
 
+static Bool
+InitResourceTable(ResourceTablePtr table, int hashsize)
+{
+    table->slots = calloc(1 << hashsize, sizeof(ResourceSlotRec));
+    if (!table->slots)
+        return FALSE;
+    table->size = 1 << hashsize;
+    table->hashsize = hashsize;
+    table->used = 0;
+    table->serial = ++tableSerial;
+    return TRUE;
+}
+
+/* Fibonacci hashing spreads the sequential IDs clients allocate */
+static inline unsigned int
+SlotHash(XID id, int hashsize)
+{
+    return ((CARD32) id * 0x9e3779b1U) >> (32 - hashsize);
+}
+
+static ResourceSlotPtr
+TableFindSlot(ResourceTablePtr table, XID id)
+{
+    unsigned int mask, i;
+    ResourceSlotPtr slot;
+
+    if (!table->size)
+        return NULL;
+    mask = table->size - 1;
+    for (i = SlotHash(id, table->hashsize);; i = (i + 1) & mask) {
+        slot = &table->slots[i];
+        if (!slot->res)
+            return NULL;
+        if (slot->id == id && slot->res != SLOT_DELETED)
+            return slot;
+    }
+}
+
+/* Claim a slot for id, which must not already be in the table */
+static ResourceSlotPtr
+TableInsertSlot(ResourceTablePtr table, XID id)
+{
+    unsigned int mask, i;
+    ResourceSlotPtr slot;
+
+    mask = table->size - 1;
+    for (i = SlotHash(id, table->hashsize);; i = (i + 1) & mask) {
+        slot = &table->slots[i];
+        if (!slot->res) {
+            table->used++;
+            break;
+        }
+        if (slot->res == SLOT_DELETED)
+            break;
+    }
+    slot->id = id;
+    slot->res = NULL;
+    return slot;
+}
+
+static ResourceSlotPtr
+FindSlot(ClientResourceRec *rrec, XID id)
+{
+    ResourceSlotPtr slot;
+
+    slot = TableFindSlot(&rrec->table, id);
+    if (!slot && rrec->old.slots)
+        slot = TableFindSlot(&rrec->old, id);
+    return slot;
+}
+
+/*
+ * Walkers number the slots old table first.  While a walk is in
+ * progress, AddResource neither migrates slots nor rebuilds the table
+ * until it is about to fill up.
+ */
+static ResourceSlotPtr
+NthSlot(ClientResourceRec *rrec, int n)
+{
+    if (n < rrec->old.size)
+        return &rrec->old.slots[n];
+    n -= rrec->old.size;
+    if (n < rrec->table.size)
+        return &rrec->table.slots[n];
+    return NULL;
+}
+
+/*
+ * Remember the walk position n by the table holding it, so that it
+ * can be found again after the tables are replaced.
+ */
+static void
+SaveWalkPosition(ClientResourceRec *rrec, int n, int *serial, int *index)
+{
+    if (n < rrec->old.size) {
+        *serial = rrec->old.serial;
+        *index = n;
+    }
+    else {
+        *serial = rrec->table.serial;
+        *index = n - rrec->old.size;
+    }
+}
+
+/*
+ * A table that is still around keeps its slots where they were; the
+ * table being filled becomes the old one on a rebuild.  Only when the
+ * walked table has been migrated away completely is there no position
+ * to resume from, and the walk starts over.
+ */
+static int
+RestoreWalkPosition(ClientResourceRec *rrec, int serial, int index)
+{
+    if (rrec->old.slots && rrec->old.serial == serial)
+        return index;
+    if (rrec->table.serial == serial)
+        return rrec->old.size + index;
+    return 0;
+}
+
+/* Whether res is still chained off slot */
+static Bool
+SlotHolds(ResourceSlotPtr slot, ResourcePtr res)
+{
+    ResourcePtr this;
+
+    if (!SlotLive(slot))
+        return FALSE;
+    for (this = slot->res; this; this = this->next)
+        if (this == res)
+            return TRUE;
+    return FALSE;
+}
+
+/* Remove res, found at *prev in the chain hanging off slot */
+static inline void
+SlotUnlink(ResourceSlotPtr slot, ResourcePtr *prev, ResourcePtr res)
+{
+    *prev = res->next;
+    if (!slot->res)
+        slot->res = SLOT_DELETED;
+}
+
+static void
+MigrateSlots(ClientResourceRec *rrec, int count)
+{
+    ResourceSlotPtr slot, dest;
+
+    while (rrec->old.slots && count-- > 0) {
+        slot = &rrec->old.slots[rrec->migrate];
+        if (SlotLive(slot)) {
+            dest = TableInsertSlot(&rrec->table, slot->id);
+            dest->res = slot->res;
+            slot->res = SLOT_DELETED;
+        }
+        if (++rrec->migrate == rrec->old.size) {
+            free(rrec->old.slots);
+            memset(&rrec->old, 0, sizeof(ResourceTableRec));
+            rrec->migrate = 0;
+            rrec->generation++;
+        }
+    }
+}
+
+/*
+ * Finish any pending migration before walking, so that the walked
+ * table is only replaced if it fills up twice during the walk.  Short
+ * of that, every resource present when the walk starts is seen once.
+ */
+static void
+BeginWalk(ClientResourceRec *rrec)
+{
+    if (!rrec->walking && rrec->old.slots)
+        MigrateSlots(rrec, rrec->old.size - rrec->migrate);
+    rrec->walking++;
+}
+
+/*
+ * Start moving the client's resources into a fresh table.  The
+ * table doubles when at least half of it holds live resources;
+ * otherwise it is rebuilt at the same size to drop deleted slots.
+ */
+static Bool
+RebuildTable(ClientResourceRec *rrec)
+{
+    ResourceTableRec fresh;
+    int hashsize;
+
+    if (rrec->old.slots)
+        MigrateSlots(rrec, rrec->old.size - rrec->migrate);
+
+    hashsize = rrec->table.hashsize;
+    if (rrec->elements * 2 >= rrec->table.size)
+        hashsize++;
+    if (hashsize >= 31 || !InitResourceTable(&fresh, hashsize))
+        return FALSE;
+
+    rrec->old = rrec->table;
+    rrec->table = fresh;
+    rrec->migrate = 0;
+    rrec->generation++;
+    return TRUE;
+}
+
 /*****************
  * InitClientResources
  *    When a new client is created, call this to allocate space
@@ -632,7 +863,7 @@ ResourceClientBits(void)
 Bool
 InitClientResources(ClientPtr client)
 {
-    int i, j;
+    int i;
 
     if (client == serverClient) {
         lastResourceType = RT_LASTPREDEF;
@@ -644,13 +875,13 @@ InitClientResources(ClientPtr client)
             return FALSE;
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
-    clientTable[i = client->index].resources =
-        malloc(INITBUCKETS * sizeof(ResourcePtr));
-    if (!clientTable[i].resources)
+    i = client->index;
+    if (!InitResourceTable(&clientTable[i].table, INITHASHSIZE))
         return FALSE;
-    clientTable[i].buckets = INITBUCKETS;
+    memset(&clientTable[i].old, 0, sizeof(ResourceTableRec));
+    clientTable[i].migrate = 0;
+    clientTable[i].walking = 0;
     clientTable[i].elements = 0;
-    clientTable[i].hashsize = INITHASHSIZE;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
@@ -659,9 +890,6 @@ InitClientResources(ClientPtr client)
     clientTable[i].fakeID = client->clientAsMask |
         (client->index ? SERVER_BIT : SERVER_MINID);
     clientTable[i].endFakeID = (clientTable[i].fakeID | RESOURCE_ID_MASK) + 1;
-    for (j = 0; j < INITBUCKETS; j++) {
-        clientTable[i].resources[j] = NULL;
-    }
     return TRUE;
 }
 
@@ -696,15 +924,10 @@ HashResourceID(XID id, int numBits)
 static XID
 AvailableID(int client, XID id, XID maxid, XID goodid)
 {
-    ResourcePtr res;
-
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
-        while (res && (res->id != id))
-            res = res->next;
-        if (!res)
+        if (!FindSlot(&clientTable[client], id))
             return id;
     }
     return 0;
@@ -714,9 +937,9 @@ void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
     XID id, maxid;
-    ResourcePtr *resp;
-    ResourcePtr res;
-    int i;
+    ResourceSlotPtr slot;
+    XID resid;
+    int n;
     XID goodid;
 
     id = (Mask) client << CLIENTOFFSET;
@@ -724,18 +947,18 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
-            if ((res->id < id) || (res->id > maxid))
-                continue;
-            if (((res->id - id) >= (maxid - res->id)) ?
-                (goodid = AvailableID(client, id, res->id - 1, goodid)) :
-                !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
-                maxid = res->id - 1;
-            else
-                id = res->id + 1;
-        }
+    for (n = 0; (slot = NthSlot(&clientTable[client], n)); n++) {
+        if (!SlotLive(slot))
+            continue;
+        resid = slot->id;
+        if ((resid < id) || (resid > maxid))
+            continue;
+        if (((resid - id) >= (maxid - resid)) ?
+            (goodid = AvailableID(client, id, resid - 1, goodid)) :
+            !(goodid = AvailableID(client, resid + 1, maxid, goodid)))
+            maxid = resid - 1;
+        else
+            id = resid + 1;
     }
     if (id > maxid)
         id = maxid = 0;
@@ -813,79 +1036,54 @@ AddResource(XID id, RESTYPE type, void *value)
 {
     int client;
     ClientResourceRec *rrec;
-    ResourcePtr res, *head;
+    ResourcePtr res;
+    ResourceSlotPtr slot, oldslot;
 
 #ifdef XSERVER_DTRACE
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
 #endif
     client = CLIENT_ID(id);
     rrec = &clientTable[client];
-    if (!rrec->buckets) {
+    if (!rrec->table.slots) {
         ErrorF("[dix] AddResource(%lx, %x, %lx), client=%d \n",
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
-        RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
+    if (!rrec->walking)
+        MigrateSlots(rrec, REHASH_STEP);
     res = malloc(sizeof(ResourceRec));
     if (!res) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
-    res->next = *head;
+    /* Keep the load factor (including deleted slots) under 3/4, but let
+     * the table fill up rather than move slots under a walker */
+    if ((rrec->walking ? rrec->table.used + 2 > rrec->table.size :
+         (rrec->table.used + 1) * 4 > rrec->table.size * 3) &&
+        !RebuildTable(rrec) && rrec->table.used + 1 >= rrec->table.size) {
+        free(res);
+        (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
+        return FALSE;
+    }
+    slot = TableFindSlot(&rrec->table, id);
+    if (!slot) {
+        oldslot = rrec->old.slots ? TableFindSlot(&rrec->old, id) : NULL;
+        slot = TableInsertSlot(&rrec->table, id);
+        if (oldslot) {
+            slot->res = oldslot->res;
+            oldslot->res = SLOT_DELETED;
+        }
+    }
+    res->next = slot->res;
     res->id = id;
     res->type = type;
     res->value = value;
-    *head = res;
+    slot->res = res;
     rrec->elements++;
     CallResourceStateCallback(ResourceStateAdding, res);
     return TRUE;
 }
 
-static void
-RebuildTable(int client)
-{
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
-
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
-
-    j = 2 * clientTable[client].buckets;
-    tails =  xallocarray(j, sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources =  xallocarray(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
-}
-
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
@@ -901,34 +1099,27 @@ void
 FreeResource(XID id, RESTYPE skipDeleteFuncType)
 {
     int cid;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
-    int elements;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.slots) {
+        rrec = &clientTable[cid];
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id) {
-                RESTYPE rtype = res->type;
+        /* the slot may move while a resource is being freed */
+        while ((slot = FindSlot(rrec, id))) {
+            RESTYPE rtype;
 
+            res = slot->res;
+            rtype = res->type;
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(res->id, res->type,
+                                  res->value, TypeNameString(res->type));
 #endif
-                *prev = res->next;
-                elements = --*eltptr;
-
-                doFreeResource(res, rtype == skipDeleteFuncType);
+            SlotUnlink(slot, &slot->res, res);
+            rrec->elements--;
 
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
-            }
-            else
-                prev = &res->next;
+            doFreeResource(res, rtype == skipDeleteFuncType);
         }
     }
 }
@@ -937,20 +1128,23 @@ void
 FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
+    ResourceSlotPtr slot;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
+    ResourcePtr *prev;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.slots) {
+        slot = FindSlot(&clientTable[cid], id);
+        if (!slot)
+            return;
 
-        prev = head;
+        prev = &slot->res;
         while ((res = *prev)) {
-            if (res->id == id && res->type == type) {
+            if (res->type == type) {
 #ifdef XSERVER_DTRACE
                 XSERVER_RESOURCE_FREE(res->id, res->type,
                                       res->value, TypeNameString(res->type));
 #endif
-                *prev = res->next;
+                SlotUnlink(slot, prev, res);
                 clientTable[cid].elements--;
 
                 doFreeResource(res, skipFree);
@@ -973,13 +1167,16 @@ Bool
 ChangeResourceValue(XID id, RESTYPE rtype, void *value)
 {
     int cid;
+    ResourceSlotPtr slot;
     ResourcePtr res;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.slots) {
+        slot = FindSlot(&clientTable[cid], id);
+        if (!slot)
+            return FALSE;
 
-        for (; res; res = res->next)
-            if ((res->id == id) && (res->type == rtype)) {
+        for (res = slot->res; res; res = res->next)
+            if (res->type == rtype) {
                 res->value = value;
                 return TRUE;
             }
@@ -997,27 +1194,37 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    int n, elements, generation, serial, index;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    BeginWalk(rrec);
+    for (n = 0; (slot = NthSlot(rrec, n)); n++) {
+        if (!SlotLive(slot))
+            continue;
+        for (this = slot->res; this; this = next) {
             next = this->next;
             if (!type || this->type == type) {
-                elements = *eltptr;
+                elements = rrec->elements;
+                generation = rrec->generation;
+                SaveWalkPosition(rrec, n, &serial, &index);
                 (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
+                if (rrec->generation != generation) {
+                    n = RestoreWalkPosition(rrec, serial, index);
+                    slot = NthSlot(rrec, n);
+                    elements = -1;
+                }
+                if (rrec->elements != elements && next && !SlotHolds(slot, next))
+                    next = SlotLive(slot) ? slot->res : NULL;  /* start over */
             }
         }
     }
+    rrec->walking--;
 }
 
 void FindSubResources(void *resource,
@@ -1032,25 +1239,35 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    int n, elements, generation, serial, index;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    BeginWalk(rrec);
+    for (n = 0; (slot = NthSlot(rrec, n)); n++) {
+        if (!SlotLive(slot))
+            continue;
+        for (this = slot->res; this; this = next) {
             next = this->next;
-            elements = *eltptr;
+            elements = rrec->elements;
+            generation = rrec->generation;
+            SaveWalkPosition(rrec, n, &serial, &index);
             (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
+            if (rrec->generation != generation) {
+                n = RestoreWalkPosition(rrec, serial, index);
+                slot = NthSlot(rrec, n);
+                elements = -1;
+            }
+            if (rrec->elements != elements && next && !SlotHolds(slot, next))
+                next = SlotLive(slot) ? slot->res : NULL;      /* start over */
         }
     }
+    rrec->walking--;
 }
 
 void *
@@ -1058,17 +1275,20 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
     void *value;
-    int i;
+    int n;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    rrec = &clientTable[client->index];
+    for (n = 0; (slot = NthSlot(rrec, n)); n++) {
+        if (!SlotLive(slot))
+            continue;
+        for (this = slot->res; this; this = next) {
             next = this->next;
             if (!type || this->type == type) {
                 /* workaround func freeing the type as DRI1 does */
@@ -1084,19 +1304,21 @@ LookupClientResourceComplex(ClientPtr client,
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this;
     ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
+    int n, elements, generation, serial, index;
 
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
+    rrec = &clientTable[client->index];
+    BeginWalk(rrec);
+    for (n = 0; (slot = NthSlot(rrec, n)); n++) {
+        if (!SlotLive(slot))
+            continue;
+        prev = &slot->res;
         while ((this = *prev)) {
             RESTYPE rtype = this->type;
 
@@ -1105,27 +1327,38 @@ FreeClientNeverRetainResources(ClientPtr client)
                 XSERVER_RESOURCE_FREE(this->id, this->type,
                                       this->value, TypeNameString(this->type));
 #endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
+                SlotUnlink(slot, prev, this);
+                rrec->elements--;
+                elements = rrec->elements;
+                generation = rrec->generation;
+                SaveWalkPosition(rrec, n, &serial, &index);
 
                 doFreeResource(this, FALSE);
 
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
+                if (rrec->generation != generation) {
+                    n = RestoreWalkPosition(rrec, serial, index);
+                    slot = NthSlot(rrec, n);
+                    elements = -1;
+                }
+                if (!SlotLive(slot))
+                    break;
+                if (rrec->elements != elements)
+                    prev = &slot->res;          /* prev may no longer be valid */
             }
             else
                 prev = &this->next;
         }
     }
+    rrec->walking--;
 }
 
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this;
-    int j;
+    int n, generation, serial, index;
 
     /* This routine shouldn't be called with a null client, but just in
        case ... */
@@ -1135,8 +1368,9 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
+    rrec = &clientTable[client->index];
+    BeginWalk(rrec);
+    for (n = 0; (slot = NthSlot(rrec, n)); n++) {
         /* It may seem silly to update the head of this resource list as
            we delete the members, since the entire list will be deleted any way,
            but there are some resource deletion functions "FreeClientPixels" for
@@ -1146,24 +1380,31 @@ FreeClientResources(ClientPtr client)
            head, just like in FreeResource. I hope that this doesn't slow down
            mass deletion appreciably. PRH */
 
-        ResourcePtr *head;
-
-        head = &resources[j];
-
-        for (this = *head; this; this = *head) {
+        while (SlotLive(slot)) {
+            this = slot->res;
 #ifdef XSERVER_DTRACE
             XSERVER_RESOURCE_FREE(this->id, this->type,
                                   this->value, TypeNameString(this->type));
 #endif
-            *head = this->next;
-            clientTable[client->index].elements--;
+            SlotUnlink(slot, &slot->res, this);
+            rrec->elements--;
+            generation = rrec->generation;
+            SaveWalkPosition(rrec, n, &serial, &index);
 
             doFreeResource(this, FALSE);
+
+            if (rrec->generation != generation) {
+                n = RestoreWalkPosition(rrec, serial, index);
+                slot = NthSlot(rrec, n);
+            }
         }
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    rrec->walking--;
+    free(rrec->table.slots);
+    free(rrec->old.slots);
+    memset(&rrec->table, 0, sizeof(ResourceTableRec));
+    memset(&rrec->old, 0, sizeof(ResourceTableRec));
+    rrec->migrate = 0;
 }
 
 void
@@ -1172,7 +1413,7 @@ FreeAllResources(void)
     int i;
 
     for (i = currentMaxClients; --i >= 0;) {
-        if (clientTable[i].buckets)
+        if (clientTable[i].table.slots)
             FreeClientResources(clients[i]);
     }
 }
@@ -1213,12 +1454,13 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if ((cid < LimitClients) && clientTable[cid].table.slots) {
+        ResourceSlotPtr slot = FindSlot(&clientTable[cid], id);
 
-        for (; res; res = res->next)
-            if (res->id == id && res->type == rtype)
-                break;
+        if (slot)
+            for (res = slot->res; res; res = res->next)
+                if (res->type == rtype)
+                    break;
     }
     if (!res)
         return resourceTypes[rtype & TypeMask].errorValue;
@@ -1246,12 +1488,13 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if ((cid < LimitClients) && clientTable[cid].table.slots) {
+        ResourceSlotPtr slot = FindSlot(&clientTable[cid], id);
 
-        for (; res; res = res->next)
-            if (res->id == id && (res->type & rclass))
-                break;
+        if (slot)
+            for (res = slot->res; res; res = res->next)
+                if ((res->type & rclass))
+                    break;
     }
     if (!res)
         return BadValue;
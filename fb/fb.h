@@ -428,6 +428,21 @@ typedef void (*FinishWrapProcPtr) (DrawablePtr pDraw);
 
 #endif
 
+/*
+ * Large operations are drawn as horizontal bands on several threads
+ * (see ParallelBands), except through the access wrappers, which are
+ * not thread safe.
+ */
+#ifdef FB_ACCESS_WRAPPER
+#define fbParallelBands(y1, y2, width, proc, closure) do {	\
+	if ((y2) > (y1))					\
+	    (*(proc)) ((y1), (y2), (closure));			\
+} while (0)
+#else
+#define fbParallelBands(y1, y2, width, proc, closure) \
+	ParallelBands(y1, y2, width, proc, closure)
+#endif
+
 extern _X_EXPORT DevPrivateKey
 fbGetScreenPrivateKey(void);
 
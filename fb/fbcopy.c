@@ -28,17 +28,7 @@
 
 #include "fb.h"
 
-void
-fbCopyNtoN(DrawablePtr pSrcDrawable,
-           DrawablePtr pDstDrawable,
-           GCPtr pGC,
-           BoxPtr pbox,
-           int nbox,
-           int dx,
-           int dy, Bool reverse, Bool upsidedown, Pixel bitplane, void *closure)
-{
-    CARD8 alu = pGC ? pGC->alu : GXcopy;
-    FbBits pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES;
+typedef struct {
     FbBits *src;
     FbStride srcStride;
     int srcBpp;
@@ -47,37 +37,106 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
     FbStride dstStride;
     int dstBpp;
     int dstXoff, dstYoff;
+    BoxPtr pbox;
+    int nbox;
+    int dx, dy;
+    Bool reverse, upsidedown;
+    CARD8 alu;
+    FbBits pm;
+} FbCopyBandRec;
 
-    fbGetDrawable(pSrcDrawable, src, srcStride, srcBpp, srcXoff, srcYoff);
-    fbGetDrawable(pDstDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
+/* Copy the rows y1 to y2 - 1 of every box */
+static void
+fbCopyNtoNBand(int y1, int y2, void *closure)
+{
+    FbCopyBandRec *c = closure;
+    BoxPtr pbox = c->pbox;
+    int nbox = c->nbox;
+    int boxY1, boxY2;
 
-    while (nbox--) {
+    for (; nbox--; pbox++) {
+        boxY1 = max(pbox->y1, y1);
+        boxY2 = min(pbox->y2, y2);
+        if (boxY2 <= boxY1)
+            continue;
 #ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
-        if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown) {
-            if (!pixman_blt
-                ((uint32_t *) src, (uint32_t *) dst, srcStride, dstStride,
-                 srcBpp, dstBpp, (pbox->x1 + dx + srcXoff),
-                 (pbox->y1 + dy + srcYoff), (pbox->x1 + dstXoff),
-                 (pbox->y1 + dstYoff), (pbox->x2 - pbox->x1),
-                 (pbox->y2 - pbox->y1)))
-                goto fallback;
-            else
-                goto next;
+        if (c->pm == FB_ALLONES && c->alu == GXcopy &&
+            !c->reverse && !c->upsidedown) {
+            if (pixman_blt((uint32_t *) c->src, (uint32_t *) c->dst,
+                           c->srcStride, c->dstStride,
+                           c->srcBpp, c->dstBpp,
+                           (pbox->x1 + c->dx + c->srcXoff),
+                           (boxY1 + c->dy + c->srcYoff),
+                           (pbox->x1 + c->dstXoff),
+                           (boxY1 + c->dstYoff), (pbox->x2 - pbox->x1),
+                           (boxY2 - boxY1)))
+                continue;
         }
- fallback:
 #endif
-        fbBlt(src + (pbox->y1 + dy + srcYoff) * srcStride,
-              srcStride,
-              (pbox->x1 + dx + srcXoff) * srcBpp,
-              dst + (pbox->y1 + dstYoff) * dstStride,
-              dstStride,
-              (pbox->x1 + dstXoff) * dstBpp,
-              (pbox->x2 - pbox->x1) * dstBpp,
-              (pbox->y2 - pbox->y1), alu, pm, dstBpp, reverse, upsidedown);
-#ifndef FB_ACCESS_WRAPPER
- next:
-#endif
-        pbox++;
+        fbBlt(c->src + (boxY1 + c->dy + c->srcYoff) * c->srcStride,
+              c->srcStride,
+              (pbox->x1 + c->dx + c->srcXoff) * c->srcBpp,
+              c->dst + (boxY1 + c->dstYoff) * c->dstStride,
+              c->dstStride,
+              (pbox->x1 + c->dstXoff) * c->dstBpp,
+              (pbox->x2 - pbox->x1) * c->dstBpp,
+              (boxY2 - boxY1), c->alu, c->pm, c->dstBpp,
+              c->reverse, c->upsidedown);
+    }
+}
+
+void
+fbCopyNtoN(DrawablePtr pSrcDrawable,
+           DrawablePtr pDstDrawable,
+           GCPtr pGC,
+           BoxPtr pbox,
+           int nbox,
+           int dx,
+           int dy, Bool reverse, Bool upsidedown, Pixel bitplane, void *closure)
+{
+    FbCopyBandRec c;
+    int y1, y2, i;
+    long area;
+
+    c.alu = pGC ? pGC->alu : GXcopy;
+    c.pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES;
+    c.pbox = pbox;
+    c.nbox = nbox;
+    c.dx = dx;
+    c.dy = dy;
+    c.reverse = reverse;
+    c.upsidedown = upsidedown;
+
+    fbGetDrawable(pSrcDrawable, c.src, c.srcStride, c.srcBpp,
+                  c.srcXoff, c.srcYoff);
+    fbGetDrawable(pDstDrawable, c.dst, c.dstStride, c.dstBpp,
+                  c.dstXoff, c.dstYoff);
+
+    /*
+     * Bands may only run in parallel if none of them reads rows another
+     * one writes: that is, between different pixmaps, or when copying
+     * within rows.  Boxes are copied one after the other, in the order
+     * given, otherwise.
+     */
+    if (nbox > 0 && (c.src != c.dst || dy == 0)) {
+        y1 = pbox[0].y1;
+        y2 = pbox[0].y2;
+        area = 0;
+        for (i = 0; i < nbox; i++) {
+            y1 = min(y1, pbox[i].y1);
+            y2 = max(y2, pbox[i].y2);
+            area += (long) (pbox[i].x2 - pbox[i].x1) *
+                (pbox[i].y2 - pbox[i].y1);
+        }
+        if (y2 > y1)
+            fbParallelBands(y1, y2, area / (y2 - y1), fbCopyNtoNBand, &c);
+    }
+    else {
+        for (i = 0; i < nbox; i++) {
+            c.pbox = &pbox[i];
+            c.nbox = 1;
+            fbCopyNtoNBand(pbox[i].y1, pbox[i].y2, &c);
+        }
     }
     fbFinishAccess(pDstDrawable);
     fbFinishAccess(pSrcDrawable);
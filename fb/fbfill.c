@@ -108,8 +108,9 @@ fbStipple(FbBits * dst, FbStride dstStride,
     }
 }
 
-void
-fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
+static void
+fbFillRows(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width,
+           int height)
 {
     FbBits *dst;
     FbStride dstStride;
@@ -220,11 +221,42 @@ fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
     fbFinishAccess(pDrawable);
 }
 
+typedef struct {
+    DrawablePtr pDrawable;
+    GCPtr pGC;
+    RegionPtr pClip;
+    int x1, x2;
+    FbBits and, xor;
+} FbFillBandRec;
+
+static void
+fbFillBand(int y1, int y2, void *closure)
+{
+    FbFillBandRec *c = closure;
+
+    fbFillRows(c->pDrawable, c->pGC, c->x1, y1, c->x2 - c->x1, y2 - y1);
+}
+
 void
-fbSolidBoxClipped(DrawablePtr pDrawable,
-                  RegionPtr pClip,
-                  int x1, int y1, int x2, int y2, FbBits and, FbBits xor)
+fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
 {
+    FbFillBandRec c = {
+        .pDrawable = pDrawable,
+        .pGC = pGC,
+        .x1 = x,
+        .x2 = x + width
+    };
+
+    fbParallelBands(y, y + height, width, fbFillBand, &c);
+}
+
+static void
+fbSolidBoxClippedBand(int y1, int y2, void *closure)
+{
+    FbFillBandRec *c = closure;
+    DrawablePtr pDrawable = c->pDrawable;
+    int x1 = c->x1, x2 = c->x2;
+    FbBits and = c->and, xor = c->xor;
     FbBits *dst;
     FbStride dstStride;
     int dstBpp;
@@ -235,7 +267,7 @@ fbSolidBoxClipped(DrawablePtr pDrawable,
 
     fbGetDrawable(pDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
 
-    for (nbox = RegionNumRects(pClip), pbox = RegionRects(pClip);
+    for (nbox = RegionNumRects(c->pClip), pbox = RegionRects(c->pClip);
          nbox--; pbox++) {
         partX1 = pbox->x1;
         if (partX1 < x1)
@@ -272,3 +304,20 @@ fbSolidBoxClipped(DrawablePtr pDrawable,
     }
     fbFinishAccess(pDrawable);
 }
+
+void
+fbSolidBoxClipped(DrawablePtr pDrawable,
+                  RegionPtr pClip,
+                  int x1, int y1, int x2, int y2, FbBits and, FbBits xor)
+{
+    FbFillBandRec c = {
+        .pDrawable = pDrawable,
+        .pClip = pClip,
+        .x1 = x1,
+        .x2 = x2,
+        .and = and,
+        .xor = xor
+    };
+
+    fbParallelBands(y1, y2, x2 - x1, fbSolidBoxClippedBand, &c);
+}
@@ -90,6 +90,7 @@ fbOverlayCloseScreen(ScreenPtr pScreen)
         (*pScreen->DestroyPixmap) (pScrPriv->layer[i].u.run.pixmap);
         RegionUninit(&pScrPriv->layer[i].u.run.region);
     }
+    miPickFini(pScreen);
     return TRUE;
 }
 
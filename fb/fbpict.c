@@ -35,6 +35,42 @@
 #include "mipict.h"
 #include "fbpict.h"
 
+typedef struct {
+    CARD8 op;
+    pixman_image_t *src, *mask, *dest;
+    int xSrc, ySrc;
+    int xMask, yMask;
+    int xDst, yDst;
+    int width;
+} FbCompositeBandRec;
+
+static void
+fbCompositeBand(int y1, int y2, void *closure)
+{
+    FbCompositeBandRec *c = closure;
+    int dy = y1 - c->yDst;
+
+    pixman_image_composite(c->op, c->src, c->mask, c->dest,
+                           c->xSrc, c->ySrc + dy, c->xMask, c->yMask + dy,
+                           c->xDst, y1, c->width, y2 - y1);
+}
+
+/* The pixmap behind a picture, NULL for solid fills and gradients */
+static PixmapPtr
+fbPicturePixmap(PicturePtr pPict)
+{
+    PixmapPtr pPixmap;
+    int xoff, yoff;
+
+    if (!pPict || !pPict->pDrawable)
+        return NULL;
+    fbGetDrawablePixmap(pPict->pDrawable, pPixmap, xoff, yoff);
+    fbFinishAccess(pPict->pDrawable);
+    (void) xoff;
+    (void) yoff;
+    return pPixmap;
+}
+
 void
 fbComposite(CARD8 op,
             PicturePtr pSrc,
@@ -49,6 +85,8 @@ fbComposite(CARD8 op,
     int src_xoff, src_yoff;
     int msk_xoff, msk_yoff;
     int dst_xoff, dst_yoff;
+    PixmapPtr pDstPixmap;
+    Bool bands;
 
     miCompositeSourceValidate(pSrc);
     if (pMask)
@@ -59,10 +97,35 @@ fbComposite(CARD8 op,
     dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
     if (src && dest && !(pMask && !mask)) {
-        pixman_image_composite(op, src, mask, dest,
-                               xSrc + src_xoff, ySrc + src_yoff,
-                               xMask + msk_xoff, yMask + msk_yoff,
-                               xDst + dst_xoff, yDst + dst_yoff, width, height);
+        FbCompositeBandRec c = {
+            .op = op,
+            .src = src,
+            .mask = mask,
+            .dest = dest,
+            .xSrc = xSrc + src_xoff,
+            .ySrc = ySrc + src_yoff,
+            .xMask = xMask + msk_xoff,
+            .yMask = yMask + msk_yoff,
+            .xDst = xDst + dst_xoff,
+            .yDst = yDst + dst_yoff,
+            .width = width
+        };
+
+        /* Bands may only run in parallel if none of them reads rows
+         * another one writes, so not when drawing to the source or the
+         * mask.  pixman validates the images on first use; do that
+         * here rather than racing on it from several threads. */
+        pDstPixmap = fbPicturePixmap(pDst);
+        bands = ParallelThreads != 1 && height > 1 &&
+            fbPicturePixmap(pSrc) != pDstPixmap &&
+            fbPicturePixmap(pMask) != pDstPixmap;
+        if (bands) {
+            fbCompositeBand(c.yDst, c.yDst + 1, &c);
+            fbParallelBands(c.yDst + 1, c.yDst + height, width,
+                            fbCompositeBand, &c);
+        }
+        else
+            fbCompositeBand(c.yDst, c.yDst + height, &c);
     }
 
     free_pixman_pict(pSrc, src);
@@ -481,12 +544,208 @@ image_from_pict_internal(PicturePtr pict, Bool has_clip, int *xoff, int *yoff,
     return image;
 }
 
+#ifndef FB_ACCESS_WRAPPER
+
+/*
+ * Building a pixman image for a drawable picture on every composite
+ * costs a clip region copy and a handful of setters, which is most of
+ * the work for small operations.  The image only depends on picture
+ * state that render reports to the screen, so keep it on the picture
+ * and drop it from those hooks.  The pixmap and serial numbers are
+ * checked as well, to catch windows being redirected and pixmaps whose
+ * header is modified underneath us.
+ *
+ * Source-only pictures are not cached: they never reach the screen
+ * hooks and are cheap to build anyway.  Neither are pictures with an
+ * alpha map, which can change without the picture hearing about it.
+ * The access wrappers need the image destroyed after each operation to
+ * finish access, so wfb always rebuilds.
+ */
+typedef struct {
+    pixman_image_t *image;
+    PixmapPtr pixmap;
+    FbBits *bits;
+    FbStride stride;
+    int pixXoff, pixYoff;
+    unsigned long serial;
+    unsigned long drawableSerial;
+    unsigned long pixmapSerial;
+    int xoff, yoff;
+} FbPictImageRec;
+
+typedef struct {
+    FbPictImageRec image[2];    /* indexed by has_clip */
+} FbPictPrivRec, *FbPictPrivPtr;
+
+typedef struct {
+    DestroyPictureProcPtr DestroyPicture;
+    ChangePictureProcPtr ChangePicture;
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureTransformProcPtr ChangePictureTransform;
+    ChangePictureFilterProcPtr ChangePictureFilter;
+} FbPictScreenPrivRec, *FbPictScreenPrivPtr;
+
+static DevPrivateKeyRec fbPictPrivateKeyRec;
+static DevPrivateKeyRec fbPictScreenPrivateKeyRec;
+
+#define fbGetPictPrivate(pict) ((FbPictPrivPtr) \
+    dixLookupPrivate(&(pict)->devPrivates, &fbPictPrivateKeyRec))
+#define fbGetPictScreenPrivate(pScreen) ((FbPictScreenPrivPtr) \
+    dixLookupPrivate(&(pScreen)->devPrivates, &fbPictScreenPrivateKeyRec))
+
+static void
+fbDropPictImages(PicturePtr pict)
+{
+    FbPictPrivPtr priv = fbGetPictPrivate(pict);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (priv->image[i].image) {
+            pixman_image_unref(priv->image[i].image);
+            priv->image[i].image = NULL;
+        }
+    }
+}
+
+static void
+fbDestroyPicture(PicturePtr pict)
+{
+    FbPictScreenPrivPtr pScrPriv =
+        fbGetPictScreenPrivate(pict->pDrawable->pScreen);
+
+    fbDropPictImages(pict);
+    (*pScrPriv->DestroyPicture) (pict);
+}
+
+static void
+fbChangePicture(PicturePtr pict, Mask mask)
+{
+    FbPictScreenPrivPtr pScrPriv =
+        fbGetPictScreenPrivate(pict->pDrawable->pScreen);
+
+    fbDropPictImages(pict);
+    (*pScrPriv->ChangePicture) (pict, mask);
+}
+
+static void
+fbValidatePicture(PicturePtr pict, Mask mask)
+{
+    FbPictScreenPrivPtr pScrPriv =
+        fbGetPictScreenPrivate(pict->pDrawable->pScreen);
+
+    fbDropPictImages(pict);
+    (*pScrPriv->ValidatePicture) (pict, mask);
+}
+
+static int
+fbChangePictureTransform(PicturePtr pict, PictTransform * transform)
+{
+    FbPictScreenPrivPtr pScrPriv =
+        fbGetPictScreenPrivate(pict->pDrawable->pScreen);
+
+    fbDropPictImages(pict);
+    return (*pScrPriv->ChangePictureTransform) (pict, transform);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pict, int filter, xFixed * params,
+                      int nparams)
+{
+    FbPictScreenPrivPtr pScrPriv =
+        fbGetPictScreenPrivate(pict->pDrawable->pScreen);
+
+    fbDropPictImages(pict);
+    return (*pScrPriv->ChangePictureFilter) (pict, filter, params, nparams);
+}
+
+static Bool
+fbPictImageInit(ScreenPtr pScreen)
+{
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+    FbPictScreenPrivPtr pScrPriv;
+
+    if (!dixRegisterPrivateKey(&fbPictPrivateKeyRec, PRIVATE_PICTURE,
+                               sizeof(FbPictPrivRec)))
+        return FALSE;
+    if (!dixRegisterPrivateKey(&fbPictScreenPrivateKeyRec, PRIVATE_SCREEN,
+                               sizeof(FbPictScreenPrivRec)))
+        return FALSE;
+
+    pScrPriv = fbGetPictScreenPrivate(pScreen);
+    pScrPriv->DestroyPicture = ps->DestroyPicture;
+    pScrPriv->ChangePicture = ps->ChangePicture;
+    pScrPriv->ValidatePicture = ps->ValidatePicture;
+    pScrPriv->ChangePictureTransform = ps->ChangePictureTransform;
+    pScrPriv->ChangePictureFilter = ps->ChangePictureFilter;
+    ps->DestroyPicture = fbDestroyPicture;
+    ps->ChangePicture = fbChangePicture;
+    ps->ValidatePicture = fbValidatePicture;
+    ps->ChangePictureTransform = fbChangePictureTransform;
+    ps->ChangePictureFilter = fbChangePictureFilter;
+    return TRUE;
+}
+
+pixman_image_t *
+image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
+{
+    FbPictImageRec *cache;
+    PixmapPtr pixmap;
+    FbBits *bits;
+    FbStride stride;
+    int bpp, pix_xoff, pix_yoff;
+
+    if (!pict || !pict->pDrawable || pict->alphaMap)
+        return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
+
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, pix_xoff, pix_yoff);
+    fbGetPixmapBitsData(pixmap, bits, stride, bpp);
+
+    cache = &fbGetPictPrivate(pict)->image[has_clip ? 1 : 0];
+    if (cache->image &&
+        cache->pixmap == pixmap &&
+        cache->bits == bits &&
+        cache->stride == stride &&
+        cache->pixXoff == pix_xoff && cache->pixYoff == pix_yoff &&
+        cache->serial == pict->serialNumber &&
+        cache->drawableSerial == pict->pDrawable->serialNumber &&
+        cache->pixmapSerial == pixmap->drawable.serialNumber) {
+        *xoff = cache->xoff;
+        *yoff = cache->yoff;
+        return pixman_image_ref(cache->image);
+    }
+
+    if (cache->image) {
+        pixman_image_unref(cache->image);
+        cache->image = NULL;
+    }
+
+    if (!(cache->image = image_from_pict_internal(pict, has_clip, xoff, yoff,
+                                                  FALSE)))
+        return NULL;
+
+    cache->pixmap = pixmap;
+    cache->bits = bits;
+    cache->stride = stride;
+    cache->pixXoff = pix_xoff;
+    cache->pixYoff = pix_yoff;
+    cache->serial = pict->serialNumber;
+    cache->drawableSerial = pict->pDrawable->serialNumber;
+    cache->pixmapSerial = pixmap->drawable.serialNumber;
+    cache->xoff = *xoff;
+    cache->yoff = *yoff;
+    return pixman_image_ref(cache->image);
+}
+
+#else                           /* FB_ACCESS_WRAPPER */
+
 pixman_image_t *
 image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
 {
     return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
 }
 
+#endif                          /* FB_ACCESS_WRAPPER */
+
 void
 free_pixman_pict(PicturePtr pict, pixman_image_t * image)
 {
@@ -513,5 +772,10 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
     ps->AddTriangles = fbAddTriangles;
     ps->Triangles = fbTriangles;
 
+#ifndef FB_ACCESS_WRAPPER
+    if (!fbPictImageInit(pScreen))
+        return FALSE;
+#endif
+
     return TRUE;
 }
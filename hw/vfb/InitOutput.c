@@ -67,6 +67,11 @@ from The Open Group.
 #include "miline.h"
 #include "glx_extinit.h"
 #include "randrstr.h"
+#include "damage.h"
+#include "vfbdamage.h"
+#ifdef MITSHM
+#include "shmint.h"
+#endif
 
 #define VFB_DEFAULT_WIDTH      1280
 #define VFB_DEFAULT_HEIGHT     1024
@@ -75,6 +80,9 @@ from The Open Group.
 #define VFB_DEFAULT_BLACKPIXEL    0
 #define VFB_DEFAULT_LINEBIAS      0
 #define XWD_WINDOW_NAME_LEN      60
+#define VFB_CHANGE_COUNT_LEN     16     /* padded, pfbMemory stays 16-aligned */
+#define VFB_DAMAGE_MAX_RECTS    256     /* per frame, see DamageSetMaxRects */
+#define VFB_DAMAGE_TILE_SIZE     64
 
 typedef struct {
     int width;
@@ -88,18 +96,28 @@ typedef struct {
     char *pfbMemory;
     XWDColor *pXWDCmap;
     XWDFileHeader *pXWDHeader;
+    CARD32 *pChangeCount;
+    CARD32 changeCount;
+    DamagePtr pDamage;
+    Bool headerChanged;
+    VfbDamageHeaderRec *pDamageRing;
     Pixel blackPixel;
     Pixel whitePixel;
     unsigned int lineBias;
     CloseScreenProcPtr closeScreen;
+    CreateScreenResourcesProcPtr createScreenResources;
 
 #ifdef HAVE_MMAP
     int mmap_fd;
     char mmap_file[MAXPATHLEN];
+    char damage_file[MAXPATHLEN];
+    char notify_file[MAXPATHLEN];
+    int notify_fd;
 #endif
 
 #ifdef HAS_SHM
     int shmid;
+    int damage_shmid;
 #endif
 } vfbScreenInfo, *vfbScreenInfoPtr;
 
@@ -124,6 +142,7 @@ typedef enum { NORMAL_MEMORY_FB, SHARED_MEMORY_FB, MMAPPED_FILE_FB } fbMemType;
 static fbMemType fbmemtype = NORMAL_MEMORY_FB;
 static char needswap = 0;
 static Bool Render = TRUE;
+static Bool dirtyRects = FALSE;
 
 #define swapcopy16(_dst, _src) \
     if (needswap) { CARD16 _s = _src; cpswaps(_s, _dst); } \
@@ -172,6 +191,10 @@ ddxGiveUp(enum ExitCode error)
                 ErrorF("unlink %s failed, %s",
                        vfbScreens[i].mmap_file, strerror(errno));
             }
+            if (vfbScreens[i].pDamageRing) {
+                unlink(vfbScreens[i].damage_file);
+                unlink(vfbScreens[i].notify_file);
+            }
         }
         break;
 #else                           /* HAVE_MMAP */
@@ -186,6 +209,8 @@ ddxGiveUp(enum ExitCode error)
                 perror("shmdt");
                 ErrorF("shmdt failed, %s", strerror(errno));
             }
+            if (vfbScreens[i].pDamageRing)
+                shmdt((char *) vfbScreens[i].pDamageRing);
         }
         break;
 #else                           /* HAS_SHM */
@@ -251,6 +276,11 @@ ddxUseMsg(void)
 #ifdef HAS_SHM
     ErrorF("-shmem                 put framebuffers in shared memory\n");
 #endif
+
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+    ErrorF("-dirtyrects            publish changed rectangles next to the "
+           "framebuffers\n");
+#endif
 }
 
 int
@@ -378,6 +408,13 @@ ddxProcessArgument(int argc, char *argv[], int i)
     }
 #endif
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+    if (strcmp(argv[i], "-dirtyrects") == 0) {  /* -dirtyrects */
+        dirtyRects = TRUE;
+        return 1;
+    }
+#endif
+
     return 0;
 }
 
@@ -407,6 +444,7 @@ vfbInstallColormap(ColormapPtr pmap)
         swapcopy32(pXWDHeader->blue_mask, pVisual->blueMask);
         swapcopy32(pXWDHeader->bits_per_rgb, pVisual->bitsPerRGBValue);
         swapcopy32(pXWDHeader->colormap_entries, pVisual->ColormapEntries);
+        vfbScreens[pmap->pScreen->myNum].headerChanged = TRUE;
 
         ppix = xallocarray(entries, sizeof(Pixel));
         prgb = xallocarray(entries, sizeof(xrgb));
@@ -459,6 +497,7 @@ vfbStoreColors(ColormapPtr pmap, int ndef, xColorItem * pdefs)
             swapcopy16(pXWDCmap[pdefs[i].pixel].blue, pdefs[i].blue);
         }
     }
+    vfbScreens[pmap->pScreen->myNum].headerChanged = TRUE;
 }
 
 static Bool
@@ -467,28 +506,118 @@ vfbSaveScreen(ScreenPtr pScreen, int on)
     return TRUE;
 }
 
-#ifdef HAVE_MMAP
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
 
-/* this flushes any changes to the screens out to the mmapped file */
+#ifdef HAVE_MMAP
 static void
-vfbBlockHandler(void *blockData, OSTimePtr pTimeout, void *pReadmask)
+vfbSyncRange(char *start, size_t len)
 {
-    int i;
-
-    for (i = 0; i < vfbNumScreens; i++) {
 #ifdef MS_ASYNC
-        if (-1 == msync((caddr_t) vfbScreens[i].pXWDHeader,
-                        (size_t) vfbScreens[i].sizeInBytes, MS_ASYNC))
+    if (-1 == msync((caddr_t) start, len, MS_ASYNC))
 #else
-        /* silly NetBSD and who else? */
-        if (-1 == msync((caddr_t) vfbScreens[i].pXWDHeader,
-                        (size_t) vfbScreens[i].sizeInBytes))
+    /* silly NetBSD and who else? */
+    if (-1 == msync((caddr_t) start, len))
 #endif
-        {
-            perror("msync");
-            ErrorF("msync failed, %s", strerror(errno));
+    {
+        perror("msync");
+        ErrorF("msync failed, %s", strerror(errno));
+    }
+}
+
+/* flush the pages holding the header and the damaged scanlines out to the
+ * mmapped file */
+static void
+vfbSyncDamage(vfbScreenInfoPtr pvfb, RegionPtr pRegion)
+{
+    static uintptr_t pagemask;
+    char *base = (char *) pvfb->pXWDHeader;
+    BoxPtr pBox = RegionRects(pRegion);
+    int nBox = RegionNumRects(pRegion);
+    uintptr_t start, end, s, e;
+
+    if (!pagemask)
+        pagemask = sysconf(_SC_PAGESIZE) - 1;
+
+    /* the header and colormap, which hold the change count */
+    start = (uintptr_t) base;
+    end = (uintptr_t) pvfb->pfbMemory;
+
+    /* boxes are sorted by y, so adjacent scanline ranges can be merged */
+    for (; nBox--; pBox++) {
+        s = (uintptr_t) (pvfb->pfbMemory +
+                         pBox->y1 * pvfb->paddedBytesWidth) & ~pagemask;
+        e = (uintptr_t) (pvfb->pfbMemory + pBox->y2 * pvfb->paddedBytesWidth);
+        if (s > ((end + pagemask) & ~pagemask)) {
+            vfbSyncRange((char *) start, end - start);
+            start = s;
         }
+        end = max(end, e);
+    }
+    vfbSyncRange((char *) start, end - start);
+}
+#endif                          /* HAVE_MMAP */
+
+/* append the frame's changed rectangles to the dirty rectangle ring, see
+ * vfbdamage.h */
+static void
+vfbPublishDamage(vfbScreenInfoPtr pvfb, RegionPtr pRegion)
+{
+    VfbDamageHeaderRec *ring = pvfb->pDamageRing;
+    VfbDamageRectRec *rects = (VfbDamageRectRec *) &ring[1];
+    BoxPtr pBox = RegionRects(pRegion);
+    int nBox = RegionNumRects(pRegion);
+    CARD32 head = ring->head;
+
+    for (; nBox--; pBox++, head++) {
+        VfbDamageRectRec *r = &rects[head % VFB_DAMAGE_NRECTS];
+
+        r->frame = pvfb->changeCount;
+        r->x1 = pBox->x1;
+        r->y1 = pBox->y1;
+        r->x2 = pBox->x2;
+        r->y2 = pBox->y2;
+    }
+
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->frame, pvfb->changeCount, __ATOMIC_RELEASE);
+
+#ifdef HAVE_MMAP
+    if (pvfb->notify_fd >= 0) {
+        char c = 0;
+
+        /* the consumer is behind if the fifo is full, it will see this
+         * frame anyway */
+        if (write(pvfb->notify_fd, &c, 1) < 0 && errno != EAGAIN)
+            ErrorF("write %s failed, %s", pvfb->notify_file, strerror(errno));
     }
+#endif
+}
+
+/* publish changes to the screen: bump the change count and, for mmapped
+ * files, flush the damaged part of the framebuffer */
+static void
+vfbBlockHandler(void *blockData, OSTimePtr pTimeout, void *pReadmask)
+{
+    ScreenPtr pScreen = blockData;
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    RegionPtr pRegion = DamageRegion(pvfb->pDamage);
+
+    if (!RegionNotEmpty(pRegion) && !pvfb->headerChanged)
+        return;
+
+    pvfb->changeCount++;
+    swapcopy32(*pvfb->pChangeCount, pvfb->changeCount);
+
+    if (pvfb->pDamageRing)
+        vfbPublishDamage(pvfb, pRegion);
+
+#ifdef HAVE_MMAP
+    if (fbmemtype == MMAPPED_FILE_FB)
+        vfbSyncDamage(pvfb, pRegion);
+#endif
+
+    DamageEmpty(pvfb->pDamage);
+    pvfb->headerChanged = FALSE;
 }
 
 static void
@@ -496,6 +625,10 @@ vfbWakeupHandler(void *blockData, int result, void *pReadmask)
 {
 }
 
+#endif                          /* HAVE_MMAP || HAS_SHM */
+
+#ifdef HAVE_MMAP
+
 static void
 vfbAllocateMmappedFramebuffer(vfbScreenInfoPtr pvfb)
 {
@@ -538,11 +671,6 @@ vfbAllocateMmappedFramebuffer(vfbScreenInfoPtr pvfb)
         pvfb->pXWDHeader = NULL;
         return;
     }
-
-    if (!RegisterBlockAndWakeupHandlers(vfbBlockHandler, vfbWakeupHandler,
-                                        NULL)) {
-        pvfb->pXWDHeader = NULL;
-    }
 }
 #endif                          /* HAVE_MMAP */
 
@@ -574,6 +702,117 @@ vfbAllocateSharedMemoryFramebuffer(vfbScreenInfoPtr pvfb)
 }
 #endif                          /* HAS_SHM */
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+
+#ifdef HAVE_MMAP
+static void
+vfbAllocateMmappedDamageRing(vfbScreenInfoPtr pvfb, size_t size)
+{
+    int fd;
+    void *ring;
+
+    snprintf(pvfb->damage_file, sizeof(pvfb->damage_file),
+             "%s/Xvfb_screen%d.damage", pfbdir, (int) (pvfb - vfbScreens));
+    snprintf(pvfb->notify_file, sizeof(pvfb->notify_file),
+             "%s/Xvfb_screen%d.notify", pfbdir, (int) (pvfb - vfbScreens));
+
+    fd = open(pvfb->damage_file, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd == -1) {
+        ErrorF("open %s failed, %s", pvfb->damage_file, strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, size) == -1) {
+        ErrorF("ftruncate %s failed, %s", pvfb->damage_file, strerror(errno));
+        close(fd);
+        return;
+    }
+    ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        ErrorF("mmap %s failed, %s", pvfb->damage_file, strerror(errno));
+        return;
+    }
+
+    /* opened read-write so that it does not wait for a reader */
+    unlink(pvfb->notify_file);
+    if (mkfifo(pvfb->notify_file, 0666) == -1 ||
+        (pvfb->notify_fd = open(pvfb->notify_file,
+                                O_RDWR | O_NONBLOCK | O_CLOEXEC)) == -1) {
+        ErrorF("fifo %s failed, %s", pvfb->notify_file, strerror(errno));
+        munmap(ring, size);
+        return;
+    }
+
+    pvfb->pDamageRing = ring;
+}
+#endif                          /* HAVE_MMAP */
+
+#ifdef HAS_SHM
+static void
+vfbAllocateSharedMemoryDamageRing(vfbScreenInfoPtr pvfb, size_t size)
+{
+    void *ring;
+
+    pvfb->damage_shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0777);
+    if (pvfb->damage_shmid < 0) {
+        ErrorF("shmget %d bytes failed, %s", (int) size, strerror(errno));
+        return;
+    }
+
+    ring = shmat(pvfb->damage_shmid, 0, 0);
+    if (ring == (void *) -1) {
+        ErrorF("shmat failed, %s", strerror(errno));
+        return;
+    }
+    memset(ring, 0, size);
+    pvfb->pDamageRing = ring;
+
+    ErrorF("screen %d damage shmid %d\n", (int) (pvfb - vfbScreens),
+           pvfb->damage_shmid);
+}
+#endif                          /* HAS_SHM */
+
+static Bool
+vfbAllocateDamageRing(vfbScreenInfoPtr pvfb)
+{
+    size_t size = sizeof(VfbDamageHeaderRec) +
+        VFB_DAMAGE_NRECTS * sizeof(VfbDamageRectRec);
+
+    if (pvfb->pDamageRing)
+        return TRUE;            /* already done */
+
+#ifdef HAVE_MMAP
+    pvfb->notify_fd = -1;
+#endif
+
+    switch (fbmemtype) {
+#ifdef HAVE_MMAP
+    case MMAPPED_FILE_FB:
+        vfbAllocateMmappedDamageRing(pvfb, size);
+        break;
+#endif
+#ifdef HAS_SHM
+    case SHARED_MEMORY_FB:
+        vfbAllocateSharedMemoryDamageRing(pvfb, size);
+        break;
+#endif
+    default:
+        ErrorF("-dirtyrects needs -fbdir or -shmem\n");
+        return FALSE;
+    }
+
+    if (!pvfb->pDamageRing)
+        return FALSE;
+
+    pvfb->pDamageRing->nrects = VFB_DAMAGE_NRECTS;
+    pvfb->pDamageRing->frame = pvfb->changeCount;
+    pvfb->pDamageRing->magic = VFB_DAMAGE_MAGIC;
+
+    return TRUE;
+}
+
+#endif                          /* HAVE_MMAP || HAS_SHM */
+
 static char *
 vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
 {
@@ -599,10 +838,11 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
         pvfb->ncolors = 1 << nplanes_per_color_component;
     }
 
-    /* add extra bytes for XWDFileHeader, window name, and colormap */
+    /* add extra bytes for XWDFileHeader, window name, change count and
+     * colormap */
 
     pvfb->sizeInBytes += SIZEOF(XWDheader) + XWD_WINDOW_NAME_LEN +
-        pvfb->ncolors * SIZEOF(XWDColor);
+        VFB_CHANGE_COUNT_LEN + pvfb->ncolors * SIZEOF(XWDColor);
 
     pvfb->pXWDHeader = NULL;
     switch (fbmemtype) {
@@ -630,9 +870,11 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
     }
 
     if (pvfb->pXWDHeader) {
-        pvfb->pXWDCmap = (XWDColor *) ((char *) pvfb->pXWDHeader
-                                       + SIZEOF(XWDheader) +
-                                       XWD_WINDOW_NAME_LEN);
+        pvfb->pChangeCount = (CARD32 *) ((char *) pvfb->pXWDHeader
+                                         + SIZEOF(XWDheader) +
+                                         XWD_WINDOW_NAME_LEN);
+        pvfb->pXWDCmap = (XWDColor *) ((char *) pvfb->pChangeCount
+                                       + VFB_CHANGE_COUNT_LEN);
         pvfb->pfbMemory = (char *) (pvfb->pXWDCmap + pvfb->ncolors);
 
         return pvfb->pfbMemory;
@@ -686,8 +928,14 @@ vfbWriteXWDFileHeader(ScreenPtr pScreen)
         hostname[0] = 0;
     else
         hostname[XWD_WINDOW_NAME_LEN - 1] = 0;
-    sprintf((char *) (pXWDHeader + 1), "Xvfb %s:%s.%d", hostname, display,
-            pScreen->myNum);
+    snprintf((char *) (pXWDHeader + 1), XWD_WINDOW_NAME_LEN, "Xvfb %s:%s.%d",
+             hostname, display, pScreen->myNum);
+
+    /* the change count follows the name, xwd readers skip it and its
+     * padding as part of the header */
+
+    memset(pvfb->pChangeCount, 0, VFB_CHANGE_COUNT_LEN);
+    swapcopy32(*pvfb->pChangeCount, pvfb->changeCount);
 
     /* write colormap pixel slot values */
 
@@ -729,6 +977,15 @@ vfbCloseScreen(ScreenPtr pScreen)
 
     pScreen->CloseScreen = pvfb->closeScreen;
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+    if (pvfb->pDamage) {
+        RemoveBlockAndWakeupHandlers(vfbBlockHandler, vfbWakeupHandler,
+                                     pScreen);
+        DamageDestroy(pvfb->pDamage);
+        pvfb->pDamage = NULL;
+    }
+#endif
+
     /*
      * fb overwrites miCloseScreen, so do this here
      */
@@ -739,6 +996,48 @@ vfbCloseScreen(ScreenPtr pScreen)
     return pScreen->CloseScreen(pScreen);
 }
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+/* track what is drawn to the screen so that only changed pages need to be
+ * flushed to the mmapped file, and readers can tell that the screen changed */
+static Bool
+vfbCreateScreenResources(ScreenPtr pScreen)
+{
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    PixmapPtr pPixmap;
+    Bool ret;
+
+    pScreen->CreateScreenResources = pvfb->createScreenResources;
+    ret = (*pScreen->CreateScreenResources) (pScreen);
+    pScreen->CreateScreenResources = vfbCreateScreenResources;
+
+    if (!ret)
+        return FALSE;
+
+    pvfb->pDamage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+                                 pScreen, NULL);
+    if (!pvfb->pDamage)
+        return FALSE;
+
+    if (!RegisterBlockAndWakeupHandlers(vfbBlockHandler, vfbWakeupHandler,
+                                        pScreen)) {
+        DamageDestroy(pvfb->pDamage);
+        pvfb->pDamage = NULL;
+        return FALSE;
+    }
+
+    /* keep the rectangle lists short enough for consumers to encode tile
+     * by tile */
+    if (pvfb->pDamageRing)
+        DamageSetMaxRects(pvfb->pDamage, VFB_DAMAGE_MAX_RECTS,
+                          VFB_DAMAGE_TILE_SIZE);
+
+    pPixmap = (*pScreen->GetScreenPixmap) (pScreen);
+    DamageRegister(&pPixmap->drawable, pvfb->pDamage);
+
+    return TRUE;
+}
+#endif                          /* HAVE_MMAP || HAS_SHM */
+
 static Bool
 vfbRROutputValidateMode(ScreenPtr           pScreen,
                         RROutputPtr         output,
@@ -882,6 +1181,11 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!pbits)
         return FALSE;
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+    if (dirtyRects && !vfbAllocateDamageRing(pvfb))
+        return FALSE;
+#endif
+
     switch (pvfb->depth) {
     case 8:
         miSetVisualTypesAndMasks(8,
@@ -931,6 +1235,11 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!ret)
         return FALSE;
 
+#ifdef MITSHM
+    /* fb does all of the rendering, ShmPutImage can copy from the segment */
+    ShmRegisterFbPutImage(pScreen);
+#endif
+
     if (!vfbRandRInit(pScreen))
        return FALSE;
 
@@ -953,6 +1262,15 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     pvfb->closeScreen = pScreen->CloseScreen;
     pScreen->CloseScreen = vfbCloseScreen;
 
+#if defined(HAVE_MMAP) || defined(HAS_SHM)
+    if (fbmemtype != NORMAL_MEMORY_FB) {
+        if (!DamageSetup(pScreen))
+            return FALSE;
+        pvfb->createScreenResources = pScreen->CreateScreenResources;
+        pScreen->CreateScreenResources = vfbCreateScreenResources;
+    }
+#endif
+
     return ret;
 
 }                               /* end vfbScreenInit */
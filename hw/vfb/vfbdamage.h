@@ -0,0 +1,69 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _VFBDAMAGE_H_
+#define _VFBDAMAGE_H_
+
+#include <X11/Xmd.h>
+
+/*
+ * Dirty rectangle ring published by Xvfb -dirtyrects next to each screen's
+ * framebuffer: the file Xvfb_screen<n>.damage in the -fbdir directory, or
+ * a shared memory segment whose id is printed at startup with -shmem.
+ *
+ * It holds a VfbDamageHeaderRec followed by nrects VfbDamageRectRecs.
+ * Every time the screen changes, the server appends the changed
+ * rectangles of that frame, tagged with the frame number, then advances
+ * head and finally frame.  frame is the same value as the change count in
+ * the xwd header.
+ *
+ * head counts rectangles, modulo 2^32; rectangle number h is stored at
+ * index (h % nrects).  A consumer keeps its own tail.  If head - tail
+ * exceeds nrects, or does so when head is read again after copying the
+ * rectangles out, some were overwritten and the whole screen must be
+ * assumed dirty.
+ *
+ * With -fbdir, one byte is also written to the fifo Xvfb_screen<n>.notify
+ * in the same directory for every frame, so consumers can wait for
+ * changes with poll() instead of spinning.  Bytes are not written while
+ * the fifo is full.
+ */
+
+#define VFB_DAMAGE_MAGIC        0x52445658      /* "XVDR" */
+#define VFB_DAMAGE_NRECTS       4096
+
+/* In the byte order of the server */
+typedef struct {
+    CARD32 magic;
+    CARD32 nrects;
+    CARD32 head;
+    CARD32 frame;
+    CARD32 pad[12];
+} VfbDamageHeaderRec;
+
+typedef struct {
+    CARD32 frame;
+    INT16 x1, y1, x2, y2;
+} VfbDamageRectRec;
+
+#endif                          /* _VFBDAMAGE_H_ */
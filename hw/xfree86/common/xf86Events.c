@@ -305,6 +305,18 @@ xf86SigioReadInput(int fd, void *closure)
     errno = errno_save;
 }
 
+/*
+ * xf86ThreadReadInput --
+ *    input thread callback, called with the input lock held.
+ */
+static void
+xf86ThreadReadInput(int fd, int ready, void *closure)
+{
+    InputInfoPtr pInfo = closure;
+
+    pInfo->read_input(pInfo);
+}
+
 /*
  * xf86AddEnabledDevice --
  *
@@ -312,6 +324,9 @@ xf86SigioReadInput(int fd, void *closure)
 void
 xf86AddEnabledDevice(InputInfoPtr pInfo)
 {
+    if (InputThreadRegisterDev(pInfo->fd, xf86ThreadReadInput, pInfo))
+        return;
+
     if (!xf86InstallSIGIOHandler(pInfo->fd, xf86SigioReadInput, pInfo)) {
         AddEnabledDevice(pInfo->fd);
     }
@@ -324,6 +339,9 @@ xf86AddEnabledDevice(InputInfoPtr pInfo)
 void
 xf86RemoveEnabledDevice(InputInfoPtr pInfo)
 {
+    if (InputThreadUnregisterDev(pInfo->fd))
+        return;
+
     if (!xf86RemoveSIGIOHandler(pInfo->fd)) {
         RemoveEnabledDevice(pInfo->fd);
     }
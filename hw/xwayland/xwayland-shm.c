@@ -39,6 +39,57 @@ struct xwl_pixmap {
     int fd;
     void *data;
     size_t size;
+    Bool busy;                  /* attached, not released yet */
+    struct xorg_list link_cache;
+    CARD32 cache_time;
+};
+
+/*
+ * Shared memory of destroyed pixmaps, kept for reuse by pixmaps of the same
+ * size class so that creating one does not need a new file, mapping and
+ * pool.  Sizes are rounded up to a quarter of a power of two, which bounds
+ * the waste to 25%.  Entries are dropped after XWL_SHM_CACHE_EXPIRE ms or
+ * when the cache would grow past its limits.  The compositor may read from
+ * a buffer until it releases it, so a pixmap destroyed before that waits on
+ * the busy list and goes into the cache from the release event.
+ */
+#define XWL_SHM_CACHE_MAX_SIZE      (64 * 1024 * 1024)
+#define XWL_SHM_CACHE_MAX_COUNT     32
+#define XWL_SHM_CACHE_EXPIRE        5000
+
+static struct {
+    struct xorg_list list;      /* most recently released first */
+    struct xorg_list busy;
+    size_t size;
+    int count;
+    OsTimerPtr timer;
+    uint32_t hits, misses, expired, rejected;
+} xwl_shm_cache = {
+    .list = { &xwl_shm_cache.list, &xwl_shm_cache.list },
+    .busy = { &xwl_shm_cache.busy, &xwl_shm_cache.busy }
+};
+
+struct xwl_swapchain_buffer {
+    struct wl_buffer *buffer;
+    char *data;
+    RegionRec stale;            /* not yet copied from the window pixmap */
+    Bool busy;                  /* held by the compositor */
+};
+
+/*
+ * Buffers the window contents are copied into before they are handed to
+ * the compositor, so that X rendering never touches memory the
+ * compositor may be reading.  Each buffer only needs the parts that
+ * changed since it was last attached.
+ */
+struct xwl_swapchain {
+    int width, height, depth;
+    int stride;
+    int fd;
+    void *data;
+    size_t size;
+    int length;
+    struct xwl_swapchain_buffer buffers[XWL_SWAPCHAIN_MAX];
 };
 
 #ifndef HAVE_MKOSTEMP
@@ -170,29 +221,77 @@ shm_format_for_depth(int depth)
     }
 }
 
-PixmapPtr
-xwl_shm_create_pixmap(ScreenPtr screen,
-                      int width, int height, int depth, unsigned int hint)
+static size_t
+xwl_shm_cache_class_size(size_t size)
+{
+    int shift = 0;
+
+    if (size < 4096)
+        size = 4096;
+
+    /* round up to a multiple of 2^shift, where the result is 5 to 8 such
+     * multiples */
+    while ((size - 1) >> shift >= 8)
+        shift++;
+
+    return (((size - 1) >> shift) + 1) << shift;
+}
+
+static void
+xwl_shm_cache_free(struct xwl_pixmap *xwl_pixmap)
+{
+    xorg_list_del(&xwl_pixmap->link_cache);
+    xwl_shm_cache.size -= xwl_pixmap->size;
+    xwl_shm_cache.count--;
+
+    munmap(xwl_pixmap->data, xwl_pixmap->size);
+    close(xwl_pixmap->fd);
+    free(xwl_pixmap);
+}
+
+static CARD32
+xwl_shm_cache_expire(OsTimerPtr timer, CARD32 time, void *arg)
+{
+    struct xwl_pixmap *xwl_pixmap, *next;
+
+    xorg_list_for_each_entry_safe(xwl_pixmap, next,
+                                  &xwl_shm_cache.list, link_cache) {
+        if ((INT32) (time - xwl_pixmap->cache_time) >= XWL_SHM_CACHE_EXPIRE) {
+            xwl_shm_cache_free(xwl_pixmap);
+            xwl_shm_cache.expired++;
+        }
+    }
+
+    return xwl_shm_cache.count ? XWL_SHM_CACHE_EXPIRE : 0;
+}
+
+/* Return shared memory for at least size bytes, from the cache if possible */
+static struct xwl_pixmap *
+xwl_shm_cache_get(size_t size)
 {
-    PixmapPtr pixmap;
     struct xwl_pixmap *xwl_pixmap;
-    size_t size, stride;
 
-    if (hint == CREATE_PIXMAP_USAGE_GLYPH_PICTURE ||
-        (width == 0 && height == 0) || depth < 15)
-        return fbCreatePixmap(screen, width, height, depth, hint);
+    size = xwl_shm_cache_class_size(size);
 
-    pixmap = fbCreatePixmap(screen, 0, 0, depth, hint);
-    if (!pixmap)
-        return NULL;
+    xorg_list_for_each_entry(xwl_pixmap, &xwl_shm_cache.list, link_cache) {
+        if (xwl_pixmap->size == size) {
+            xorg_list_del(&xwl_pixmap->link_cache);
+            xwl_shm_cache.size -= size;
+            xwl_shm_cache.count--;
+            xwl_shm_cache.hits++;
+            return xwl_pixmap;
+        }
+    }
+
+    xwl_shm_cache.misses++;
 
     xwl_pixmap = malloc(sizeof *xwl_pixmap);
     if (xwl_pixmap == NULL)
-        goto err_destroy_pixmap;
+        return NULL;
 
-    stride = PixmapBytePad(width, depth);
-    size = stride * height;
     xwl_pixmap->buffer = NULL;
+    xwl_pixmap->busy = FALSE;
+    xorg_list_init(&xwl_pixmap->link_cache);
     xwl_pixmap->size = size;
     xwl_pixmap->fd = os_create_anonymous_file(size);
     if (xwl_pixmap->fd < 0)
@@ -203,21 +302,142 @@ xwl_shm_create_pixmap(ScreenPtr screen,
     if (xwl_pixmap->data == MAP_FAILED)
         goto err_close_fd;
 
+    return xwl_pixmap;
+
+ err_close_fd:
+    close(xwl_pixmap->fd);
+ err_free_xwl_pixmap:
+    free(xwl_pixmap);
+
+    return NULL;
+}
+
+static void
+xwl_shm_cache_put(struct xwl_pixmap *xwl_pixmap)
+{
+    struct xwl_pixmap *oldest;
+
+    if (xwl_pixmap->busy) {
+        xorg_list_add(&xwl_pixmap->link_cache, &xwl_shm_cache.busy);
+        return;
+    }
+
+    if (xwl_pixmap->buffer) {
+        wl_buffer_destroy(xwl_pixmap->buffer);
+        xwl_pixmap->buffer = NULL;
+    }
+
+    xorg_list_init(&xwl_pixmap->link_cache);
+    xwl_shm_cache.size += xwl_pixmap->size;
+    xwl_shm_cache.count++;
+
+    if (xwl_pixmap->size > XWL_SHM_CACHE_MAX_SIZE) {
+        xwl_shm_cache_free(xwl_pixmap);
+        xwl_shm_cache.rejected++;
+        return;
+    }
+
+    xwl_pixmap->cache_time = GetTimeInMillis();
+    xorg_list_add(&xwl_pixmap->link_cache, &xwl_shm_cache.list);
+
+    /* make room by dropping the entries that were released first */
+    while (xwl_shm_cache.size > XWL_SHM_CACHE_MAX_SIZE ||
+           xwl_shm_cache.count > XWL_SHM_CACHE_MAX_COUNT) {
+        oldest = xorg_list_last_entry(&xwl_shm_cache.list,
+                                      struct xwl_pixmap, link_cache);
+        xwl_shm_cache_free(oldest);
+        xwl_shm_cache.rejected++;
+    }
+
+    if (!xwl_shm_cache.timer)
+        xwl_shm_cache.timer = TimerSet(NULL, 0, XWL_SHM_CACHE_EXPIRE,
+                                       xwl_shm_cache_expire, NULL);
+    else if (xwl_shm_cache.count == 1)
+        TimerSet(xwl_shm_cache.timer, 0, XWL_SHM_CACHE_EXPIRE,
+                 xwl_shm_cache_expire, NULL);
+}
+
+static void
+xwl_shm_buffer_release(void *data, struct wl_buffer *buffer)
+{
+    struct xwl_pixmap *xwl_pixmap = data;
+
+    xwl_pixmap->busy = FALSE;
+
+    /* the pixmap is gone and was waiting on the busy list */
+    if (!xorg_list_is_empty(&xwl_pixmap->link_cache)) {
+        xorg_list_del(&xwl_pixmap->link_cache);
+        xwl_shm_cache_put(xwl_pixmap);
+    }
+}
+
+static const struct wl_buffer_listener xwl_shm_buffer_listener = {
+    xwl_shm_buffer_release
+};
+
+/*
+ * Log how well the cache worked and release its memory.  Called after the
+ * last pixmap is destroyed, but before the display is disconnected.
+ */
+void
+xwl_shm_cache_fini(void)
+{
+    struct xwl_pixmap *xwl_pixmap, *next;
+
+    /* buffers the compositor still holds are not used any more */
+    xorg_list_for_each_entry_safe(xwl_pixmap, next,
+                                  &xwl_shm_cache.busy, link_cache) {
+        xorg_list_del(&xwl_pixmap->link_cache);
+        xwl_pixmap->busy = FALSE;
+        xwl_shm_cache_put(xwl_pixmap);
+    }
+
+    LogMessageVerb(X_INFO, 3, "xwayland: shm cache: %u hits, %u misses, "
+                   "%u expired, %u rejected\n", xwl_shm_cache.hits,
+                   xwl_shm_cache.misses, xwl_shm_cache.expired,
+                   xwl_shm_cache.rejected);
+
+    xorg_list_for_each_entry_safe(xwl_pixmap, next,
+                                  &xwl_shm_cache.list, link_cache)
+        xwl_shm_cache_free(xwl_pixmap);
+
+    TimerFree(xwl_shm_cache.timer);
+    xwl_shm_cache.timer = NULL;
+}
+
+PixmapPtr
+xwl_shm_create_pixmap(ScreenPtr screen,
+                      int width, int height, int depth, unsigned int hint)
+{
+    PixmapPtr pixmap;
+    struct xwl_pixmap *xwl_pixmap;
+    size_t size, stride;
+
+    if (hint == CREATE_PIXMAP_USAGE_GLYPH_PICTURE ||
+        (width == 0 && height == 0) || depth < 15)
+        return fbCreatePixmap(screen, width, height, depth, hint);
+
+    pixmap = fbCreatePixmap(screen, 0, 0, depth, hint);
+    if (!pixmap)
+        return NULL;
+
+    stride = PixmapBytePad(width, depth);
+    size = stride * height;
+    xwl_pixmap = xwl_shm_cache_get(size);
+    if (xwl_pixmap == NULL)
+        goto err_destroy_pixmap;
+
     if (!(*screen->ModifyPixmapHeader) (pixmap, width, height, depth,
                                         BitsPerPixel(depth),
                                         stride, xwl_pixmap->data))
-        goto err_munmap;
+        goto err_release;
 
     xwl_pixmap_set_private(pixmap, xwl_pixmap);
 
     return pixmap;
 
- err_munmap:
-    munmap(xwl_pixmap->data, size);
- err_close_fd:
-    close(xwl_pixmap->fd);
- err_free_xwl_pixmap:
-    free(xwl_pixmap);
+ err_release:
+    xwl_shm_cache_put(xwl_pixmap);
  err_destroy_pixmap:
     fbDestroyPixmap(pixmap);
 
@@ -229,17 +449,13 @@ xwl_shm_destroy_pixmap(PixmapPtr pixmap)
 {
     struct xwl_pixmap *xwl_pixmap = xwl_pixmap_get(pixmap);
 
-    if (xwl_pixmap && pixmap->refcnt == 1) {
-        if (xwl_pixmap->buffer)
-            wl_buffer_destroy(xwl_pixmap->buffer);
-        munmap(xwl_pixmap->data, xwl_pixmap->size);
-        close(xwl_pixmap->fd);
-        free(xwl_pixmap);
-    }
+    if (xwl_pixmap && pixmap->refcnt == 1)
+        xwl_shm_cache_put(xwl_pixmap);
 
     return fbDestroyPixmap(pixmap);
 }
 
+/* Return the pixmap's buffer, which the caller attaches to a surface */
 struct wl_buffer *
 xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap)
 {
@@ -248,6 +464,8 @@ xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap)
     struct wl_shm_pool *pool;
     uint32_t format;
 
+    xwl_pixmap->busy = TRUE;
+
     if (xwl_pixmap->buffer)
         return xwl_pixmap->buffer;
 
@@ -259,6 +477,8 @@ xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap)
                                                    pixmap->drawable.width,
                                                    pixmap->drawable.height,
                                                    pixmap->devKind, format);
+    wl_buffer_add_listener(xwl_pixmap->buffer,
+                           &xwl_shm_buffer_listener, xwl_pixmap);
 
     wl_shm_pool_destroy(pool);
 
@@ -292,3 +512,176 @@ xwl_shm_create_screen_resources(ScreenPtr screen)
 
     return screen->devPrivate != NULL;
 }
+
+static void
+xwl_swapchain_buffer_release(void *data, struct wl_buffer *buffer)
+{
+    struct xwl_swapchain_buffer *xwl_buffer = data;
+
+    xwl_buffer->busy = FALSE;
+}
+
+static const struct wl_buffer_listener xwl_swapchain_buffer_listener = {
+    xwl_swapchain_buffer_release
+};
+
+void
+xwl_shm_swapchain_destroy(struct xwl_swapchain *swapchain)
+{
+    int i;
+
+    if (!swapchain)
+        return;
+
+    for (i = 0; i < swapchain->length; i++) {
+        if (swapchain->buffers[i].buffer)
+            wl_buffer_destroy(swapchain->buffers[i].buffer);
+        RegionUninit(&swapchain->buffers[i].stale);
+    }
+    munmap(swapchain->data, swapchain->size);
+    close(swapchain->fd);
+    free(swapchain);
+}
+
+static struct xwl_swapchain *
+xwl_swapchain_create(struct xwl_screen *xwl_screen, PixmapPtr pixmap)
+{
+    struct xwl_swapchain *swapchain;
+    struct wl_shm_pool *pool;
+    BoxRec box;
+    uint32_t format;
+    size_t size;
+    int i;
+
+    swapchain = calloc(1, sizeof *swapchain);
+    if (!swapchain)
+        return NULL;
+
+    swapchain->width = pixmap->drawable.width;
+    swapchain->height = pixmap->drawable.height;
+    swapchain->depth = pixmap->drawable.depth;
+    swapchain->stride = PixmapBytePad(swapchain->width, swapchain->depth);
+    swapchain->length = xwl_screen->swapchain_length;
+
+    size = swapchain->stride * swapchain->height;
+    swapchain->size = size * swapchain->length;
+    swapchain->fd = os_create_anonymous_file(swapchain->size);
+    if (swapchain->fd < 0)
+        goto err_free_swapchain;
+
+    swapchain->data = mmap(NULL, swapchain->size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, swapchain->fd, 0);
+    if (swapchain->data == MAP_FAILED)
+        goto err_close_fd;
+
+    pool = wl_shm_create_pool(xwl_screen->shm, swapchain->fd, swapchain->size);
+    format = shm_format_for_depth(swapchain->depth);
+
+    box.x1 = box.y1 = 0;
+    box.x2 = swapchain->width;
+    box.y2 = swapchain->height;
+
+    for (i = 0; i < swapchain->length; i++) {
+        struct xwl_swapchain_buffer *xwl_buffer = &swapchain->buffers[i];
+
+        xwl_buffer->data = (char *) swapchain->data + i * size;
+        xwl_buffer->buffer =
+            wl_shm_pool_create_buffer(pool, i * size,
+                                      swapchain->width, swapchain->height,
+                                      swapchain->stride, format);
+        wl_buffer_add_listener(xwl_buffer->buffer,
+                               &xwl_swapchain_buffer_listener, xwl_buffer);
+        RegionInit(&xwl_buffer->stale, &box, 1);
+    }
+
+    wl_shm_pool_destroy(pool);
+
+    return swapchain;
+
+ err_close_fd:
+    close(swapchain->fd);
+ err_free_swapchain:
+    free(swapchain);
+
+    return NULL;
+}
+
+static void
+xwl_swapchain_copy(struct xwl_swapchain *swapchain,
+                   struct xwl_swapchain_buffer *xwl_buffer, PixmapPtr pixmap)
+{
+    int cpp = pixmap->drawable.bitsPerPixel / 8;
+    BoxPtr box = RegionRects(&xwl_buffer->stale);
+    int nbox = RegionNumRects(&xwl_buffer->stale);
+    char *src = pixmap->devPrivate.ptr;
+
+    for (; nbox--; box++) {
+        int len = (box->x2 - box->x1) * cpp;
+        int y;
+
+        for (y = box->y1; y < box->y2; y++)
+            memcpy(xwl_buffer->data + y * swapchain->stride + box->x1 * cpp,
+                   src + y * pixmap->devKind + box->x1 * cpp, len);
+    }
+
+    RegionEmpty(&xwl_buffer->stale);
+}
+
+/*
+ * Return a buffer of the window's swapchain that holds the current
+ * contents of pixmap, or NULL if the compositor holds all of them.
+ * damage is what changed in pixmap since the last call.
+ */
+struct wl_buffer *
+xwl_shm_swapchain_get_wl_buffer(struct xwl_window *xwl_window,
+                                PixmapPtr pixmap, RegionPtr damage)
+{
+    struct xwl_screen *xwl_screen = xwl_window->xwl_screen;
+    struct xwl_swapchain *swapchain = xwl_window->swapchain;
+    struct xwl_swapchain_buffer *xwl_buffer = NULL;
+    RegionRec stale;
+    BoxRec box;
+    int i;
+
+    /* Only plain pixels can be copied, e.g. not 8 bit glyph pixmaps */
+    if (pixmap->drawable.bitsPerPixel < 16)
+        return xwl_shm_pixmap_get_wl_buffer(pixmap);
+
+    if (swapchain &&
+        (swapchain->width != pixmap->drawable.width ||
+         swapchain->height != pixmap->drawable.height ||
+         swapchain->depth != pixmap->drawable.depth)) {
+        xwl_shm_swapchain_destroy(swapchain);
+        swapchain = xwl_window->swapchain = NULL;
+    }
+
+    if (!swapchain) {
+        swapchain = xwl_window->swapchain =
+            xwl_swapchain_create(xwl_screen, pixmap);
+        if (!swapchain)
+            return xwl_shm_pixmap_get_wl_buffer(pixmap);
+    }
+
+    box.x1 = box.y1 = 0;
+    box.x2 = swapchain->width;
+    box.y2 = swapchain->height;
+    RegionInit(&stale, &box, 1);
+    RegionIntersect(&stale, &stale, damage);
+
+    for (i = 0; i < swapchain->length; i++) {
+        RegionUnion(&swapchain->buffers[i].stale,
+                    &swapchain->buffers[i].stale, &stale);
+        if (!xwl_buffer && !swapchain->buffers[i].busy)
+            xwl_buffer = &swapchain->buffers[i];
+    }
+
+    RegionUninit(&stale);
+
+    if (!xwl_buffer)
+        return NULL;
+
+    xwl_swapchain_copy(swapchain, xwl_buffer, pixmap);
+    xwl_buffer->busy = TRUE;
+
+    return xwl_buffer->buffer;
+}
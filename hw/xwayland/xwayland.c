@@ -68,6 +68,8 @@ ddxUseMsg(void)
     ErrorF("-rootless              run rootless, requires wm support\n");
     ErrorF("-wm fd                 create X client for wm on given fd\n");
     ErrorF("-listen fd             add give fd as a listen socket\n");
+    ErrorF("-swapchain n           copy windows into %d to %d shm buffers "
+           "for the compositor\n", XWL_SWAPCHAIN_MIN, XWL_SWAPCHAIN_MAX);
 }
 
 int
@@ -86,10 +88,18 @@ ddxProcessArgument(int argc, char *argv[], int i)
     else if (strcmp(argv[i], "-shm") == 0) {
         return 1;
     }
+    else if (strcmp(argv[i], "-swapchain") == 0) {
+        return 2;
+    }
 
     return 0;
 }
 
+/* Damage beyond this many boxes is rounded out to tiles before it is
+ * posted, see DamageSetMaxRects */
+#define XWL_MAX_DAMAGE_RECTS 64
+#define XWL_DAMAGE_TILE_SIZE 64
+
 static DevPrivateKeyRec xwl_window_private_key;
 static DevPrivateKeyRec xwl_screen_private_key;
 static DevPrivateKeyRec xwl_pixmap_private_key;
@@ -106,6 +116,7 @@ xwl_close_screen(ScreenPtr screen)
     struct xwl_screen *xwl_screen = xwl_screen_get(screen);
     struct xwl_output *xwl_output, *next_xwl_output;
     struct xwl_seat *xwl_seat, *next_xwl_seat;
+    Bool ret;
 
     xorg_list_for_each_entry_safe(xwl_output, next_xwl_output,
                                   &xwl_screen->output_list, link)
@@ -117,12 +128,15 @@ xwl_close_screen(ScreenPtr screen)
 
     RemoveNotifyFd(xwl_screen->wayland_fd);
 
-    wl_display_disconnect(xwl_screen->display);
-
+    /* the screen pixmap is destroyed here, and its memory cached */
     screen->CloseScreen = xwl_screen->CloseScreen;
+    ret = screen->CloseScreen(screen);
+
+    xwl_shm_cache_fini();
+    wl_display_disconnect(xwl_screen->display);
     free(xwl_screen);
 
-    return screen->CloseScreen(screen);
+    return ret;
 }
 
 static void
@@ -287,6 +301,8 @@ xwl_realize_window(WindowPtr window)
 
     DamageRegister(&window->drawable, xwl_window->damage);
     DamageSetReportAfterOp(xwl_window->damage, TRUE);
+    DamageSetMaxRects(xwl_window->damage, XWL_MAX_DAMAGE_RECTS,
+                      XWL_DAMAGE_TILE_SIZE);
 
     dixSetPrivate(&window->devPrivates, &xwl_window_private_key, xwl_window);
     xorg_list_init(&xwl_window->link_damage);
@@ -337,6 +353,7 @@ xwl_unrealize_window(WindowPtr window)
     DamageDestroy(xwl_window->damage);
     if (xwl_window->frame_callback)
         wl_callback_destroy(xwl_window->frame_callback);
+    xwl_shm_swapchain_destroy(xwl_window->swapchain);
 
     free(xwl_window);
     dixSetPrivate(&window->devPrivates, &xwl_window_private_key, NULL);
@@ -369,6 +386,7 @@ xwl_screen_post_damage(struct xwl_screen *xwl_screen)
     struct xwl_window *xwl_window, *next_xwl_window;
     RegionPtr region;
     BoxPtr box;
+    int nbox;
     struct wl_buffer *buffer;
     PixmapPtr pixmap;
 
@@ -381,19 +399,33 @@ xwl_screen_post_damage(struct xwl_screen *xwl_screen)
 
         region = DamageRegion(xwl_window->damage);
         pixmap = (*xwl_screen->screen->GetWindowPixmap) (xwl_window->window);
+        buffer = NULL;
 
 #if GLAMOR_HAS_GBM
         if (xwl_screen->glamor)
             buffer = xwl_glamor_pixmap_get_wl_buffer(pixmap);
 #endif
-        if (!xwl_screen->glamor)
-            buffer = xwl_shm_pixmap_get_wl_buffer(pixmap);
+        if (!xwl_screen->glamor) {
+            if (xwl_screen->swapchain_length)
+                buffer = xwl_shm_swapchain_get_wl_buffer(xwl_window, pixmap,
+                                                         region);
+            else
+                buffer = xwl_shm_pixmap_get_wl_buffer(pixmap);
+        }
+
+        /* The compositor still holds all of the window's buffers, try
+         * again once it releases one. */
+        if (!buffer)
+            continue;
 
         wl_surface_attach(xwl_window->surface, buffer, 0, 0);
 
-        box = RegionExtents(region);
-        wl_surface_damage(xwl_window->surface, box->x1, box->y1,
-                          box->x2 - box->x1, box->y2 - box->y1);
+        /* The damage is kept to at most XWL_MAX_DAMAGE_RECTS boxes */
+        box = RegionRects(region);
+        nbox = RegionNumRects(region);
+        for (; nbox--; box++)
+            wl_surface_damage(xwl_window->surface, box->x1, box->y1,
+                              box->x2 - box->x1, box->y2 - box->y1);
 
         xwl_window->frame_callback = wl_surface_frame(xwl_window->surface);
         wl_callback_add_listener(xwl_window->frame_callback, &frame_listener, xwl_window);
@@ -588,6 +620,14 @@ xwl_screen_init(ScreenPtr pScreen, int argc, char **argv)
         else if (strcmp(argv[i], "-shm") == 0) {
             xwl_screen->glamor = 0;
         }
+        else if (strcmp(argv[i], "-swapchain") == 0) {
+            xwl_screen->swapchain_length = atoi(argv[i + 1]);
+            i++;
+            if (xwl_screen->swapchain_length < XWL_SWAPCHAIN_MIN ||
+                xwl_screen->swapchain_length > XWL_SWAPCHAIN_MAX)
+                FatalError("-swapchain must be between %d and %d\n",
+                           XWL_SWAPCHAIN_MIN, XWL_SWAPCHAIN_MAX);
+        }
     }
 
     if (xwl_screen->listen_fd_count > 0) {
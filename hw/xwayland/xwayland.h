@@ -55,6 +55,7 @@ struct xwl_screen {
     int listen_fd_count;
     int rootless;
     int glamor;
+    int swapchain_length;
 
     CreateScreenResourcesProcPtr CreateScreenResources;
     CloseScreenProcPtr CloseScreen;
@@ -102,8 +103,13 @@ struct xwl_window {
     DamagePtr damage;
     struct xorg_list link_damage;
     struct wl_callback *frame_callback;
+    struct xwl_swapchain *swapchain;
 };
 
+/* Bounds for -swapchain */
+#define XWL_SWAPCHAIN_MIN 2
+#define XWL_SWAPCHAIN_MAX 4
+
 #define MODIFIER_META 0x01
 
 struct xwl_touch {
@@ -181,6 +187,11 @@ PixmapPtr xwl_shm_create_pixmap(ScreenPtr screen, int width, int height,
                                 int depth, unsigned int hint);
 Bool xwl_shm_destroy_pixmap(PixmapPtr pixmap);
 struct wl_buffer *xwl_shm_pixmap_get_wl_buffer(PixmapPtr pixmap);
+void xwl_shm_cache_fini(void);
+struct wl_buffer *xwl_shm_swapchain_get_wl_buffer(struct xwl_window *xwl_window,
+                                                  PixmapPtr pixmap,
+                                                  RegionPtr damage);
+void xwl_shm_swapchain_destroy(struct xwl_swapchain *swapchain);
 
 
 Bool xwl_glamor_init(struct xwl_screen *xwl_screen);
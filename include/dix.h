@@ -271,6 +271,11 @@ extern _X_EXPORT Atom MakeAtom(const char * /*string */ ,
                                unsigned /*len */ ,
                                Bool /*makeit */ );
 
+extern _X_HIDDEN Atom MakeAtomHashed(const char * /*string */ ,
+                                     unsigned /*len */ ,
+                                     unsigned int /*fingerprint */ ,
+                                     Bool /*makeit */ );
+
 extern _X_EXPORT Bool ValidAtom(Atom /*atom */ );
 
 extern _X_EXPORT const char *NameForAtom(Atom /*atom */ );
@@ -31,6 +31,7 @@ SOFTWARE.
 #include "gc.h"
 #include "pixmap.h"
 #include "privates.h"
+#include "list.h"
 #include <X11/Xmd.h>
 
 /*
@@ -73,6 +74,22 @@ typedef struct _saveSet {
 #define SaveSetAssignToRoot(ss,tr)  ((ss).toRoot = (tr))
 #define SaveSetAssignMap(ss,m)      ((ss).map = (m))
 
+/*
+ * Per-client scheduler accounting, reported through X-Resource and the
+ * -schedStats log.  Times are in microseconds.
+ */
+typedef struct _ClientSchedStats {
+    uint64_t requests;          /* requests dispatched */
+    uint64_t dispatch_time;     /* time spent running the client's slices */
+    uint64_t bytes_read;        /* request bytes read from the connection */
+    uint64_t bytes_written;     /* reply/event bytes written to it */
+    uint32_t slices;            /* times picked by the scheduler */
+    uint32_t preempted;         /* slices cut short by the time limit */
+    uint32_t priority_raised;   /* smart_priority boosts for idling */
+    uint32_t priority_lowered;  /* smart_priority penalties for preemption */
+    uint64_t reported_time;     /* dispatch_time at the last -schedStats log */
+} ClientSchedStatsRec;
+
 typedef struct _Client {
     void *requestBuffer;
     void *osPrivate;             /* for OS layer, including scheduler */
@@ -112,6 +129,11 @@ typedef struct _Client {
 #if XTRANS_SEND_FDS
     int req_fds;
 #endif
+
+    struct xorg_list ready;     /* List of clients ready to run */
+    struct xorg_list output_pending; /* List of clients with output queued */
+
+    ClientSchedStatsRec sched_stats;
 } ClientRec;
 
 #if XTRANS_SEND_FDS
@@ -130,6 +152,7 @@ extern long SmartScheduleTime;
 extern long SmartScheduleInterval;
 extern long SmartScheduleSlice;
 extern long SmartScheduleMaxSlice;
+extern int SmartScheduleStatsInterval;
 #if HAVE_SETITIMER
 extern Bool SmartScheduleSignalEnable;
 #else
@@ -143,6 +166,52 @@ extern void SmartScheduleStopTimer(void);
 
 extern void SmartScheduleInit(void);
 
+/*
+ * Clients with requests to process and clients with buffered output.
+ * These replace the fd_set masks the OS layer used to scan on every
+ * wakeup, so the cost of scheduling only depends on the number of
+ * clients which actually have something to do.
+ */
+extern struct xorg_list ready_clients;
+extern struct xorg_list saved_ready_clients;
+extern struct xorg_list output_pending_clients;
+
+extern Bool clients_are_ready(void);
+
+/* Client has requests queued or data on the network */
+extern void mark_client_ready(ClientPtr client);
+
+/* Client has requests queued, but is waiting for a server grab to end */
+extern void mark_client_saved_ready(ClientPtr client);
+
+/* Client has no requests queued and no data on the network */
+extern void mark_client_not_ready(ClientPtr client);
+
+static inline Bool
+client_is_ready(ClientPtr client)
+{
+    return !xorg_list_is_empty(&client->ready);
+}
+
+static inline void
+output_pending_mark(ClientPtr client)
+{
+    if (!client->clientGone && xorg_list_is_empty(&client->output_pending))
+        xorg_list_append(&client->output_pending, &output_pending_clients);
+}
+
+static inline void
+output_pending_clear(ClientPtr client)
+{
+    xorg_list_del(&client->output_pending);
+}
+
+static inline Bool
+any_output_pending(void)
+{
+    return !xorg_list_is_empty(&output_pending_clients);
+}
+
 /* This prototype is used pervasively in Xext, dix */
 #define DISPATCH_PROC(func) int func(ClientPtr /* client */)
 
@@ -214,6 +214,9 @@ extern int
 extern void
  RecalculateDeviceDeliverableEvents(WindowPtr /* pWin */ );
 
+extern void
+ FreeXI2Recipients(OtherInputMasks * /* inputMasks */ );
+
 extern int
  InputClientGone(WindowPtr /* pWin */ ,
                  XID /* id */ );
@@ -128,6 +128,7 @@ typedef struct _SpriteRec *SpritePtr;
 typedef struct _TouchClassRec *TouchClassPtr;
 typedef struct _TouchPointInfo *TouchPointInfoPtr;
 typedef struct _DDXTouchPointInfo *DDXTouchPointInfoPtr;
+typedef struct _EventBuffer *EventBufferPtr;
 typedef union _GrabMask GrabMask;
 
 typedef struct _ValuatorMask ValuatorMask;
@@ -712,4 +713,20 @@ extern _X_HIDDEN void input_constrain_cursor(DeviceIntPtr pDev, ScreenPtr screen
                                              int *out_x, int *out_y,
                                              int *nevents, InternalEvent* events);
 
+/* Input thread, see os/inputthread.c */
+extern _X_EXPORT Bool InputThreadEnable;
+
+extern _X_EXPORT void input_lock(void);
+extern _X_EXPORT void input_unlock(void);
+extern _X_EXPORT Bool in_input_thread(void);
+
+extern void InputThreadPreInit(void);
+extern void InputThreadInit(void);
+extern void InputThreadFini(void);
+
+extern _X_EXPORT Bool InputThreadRegisterDev(int fd,
+                                             NotifyFdProcPtr readInputProc,
+                                             void *readInputArgs);
+extern _X_EXPORT Bool InputThreadUnregisterDev(int fd);
+
 #endif                          /* INPUT_H */
@@ -121,6 +121,21 @@ typedef struct _InputClients {
     struct _XI2Mask *xi2mask;
 } InputClients;
 
+/**
+ * The clients on a window that selected for one XI2 event type from one
+ * device. Built on first delivery and dropped whenever the window's
+ * selections change, so that delivery does not have to test every
+ * client's masks for every event.
+ */
+typedef struct _XI2Recipients {
+    struct _XI2Recipients *next;
+    int deviceid;
+    Bool master;                  /**< IsMaster() of the device */
+    int evtype;
+    /** Copies of the selecting InputClients, chained through next */
+    InputClientsPtr clients;
+} XI2Recipients;
+
 /**
  * Combined XI event masks from all devices.
  *
@@ -149,6 +164,9 @@ typedef struct _OtherInputMasks {
     InputClientsPtr inputClients;
     /* XI2 event masks. One per device, each bit is a mask of (1 << type) */
     struct _XI2Mask *xi2mask;
+    /** Recently delivered XI2 events and their recipients, most recent
+     * first */
+    XI2Recipients *xi2recipients;
 } OtherInputMasks;
 
 /*
@@ -528,6 +546,16 @@ typedef struct _SpriteInfoRec {
 #define KEYBOARD_OR_FLOAT       5       /* Keyboard master for this device or this device if floating */
 #define POINTER_OR_FLOAT        6       /* Pointer master for this device or this device if floating */
 
+/**
+ * Space for an event converted to wire format, reused from one event to the
+ * next. See EventToWire().
+ */
+typedef struct _EventBuffer {
+    xEvent *events;
+    size_t size;                /**< in bytes */
+    Bool busy;                  /**< holds an event that is being delivered */
+} EventBufferRec;
+
 typedef struct _DeviceIntRec {
     DeviceRec public;
     DeviceIntPtr next;
@@ -599,6 +627,9 @@ typedef struct _DeviceIntRec {
     int xtest_master_id;
 
     struct _SyncCounter *idle_counter;
+
+    /* Events converted to wire format for delivery, per InputLevel */
+    EventBufferRec eventBuffers[XI2 + 1];
 } DeviceIntRec;
 
 typedef struct {
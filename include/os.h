@@ -93,7 +93,7 @@ extern _X_EXPORT void (*OsVendorVErrorFProc) (const char *,
 _X_ATTRIBUTE_PRINTF(1, 0);
 #endif
 
-extern _X_EXPORT int WaitForSomething(int *     /*pClientsReady */,
+extern _X_EXPORT Bool WaitForSomething(Bool /*clients_are_ready */,
     int *(ProcFlush)(void)
     );
 
@@ -120,6 +120,10 @@ extern _X_EXPORT void SetCriticalOutputPending(void);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+extern _X_EXPORT int WriteToClientRef(ClientPtr /*who */ , int /*count */ ,
+                                      void * /*buf */ ,
+                                      void (* /*release */ ) (void *));
+
 extern _X_EXPORT void ResetOsBuffers(void);
 
 extern _X_EXPORT void InitConnectionLimits(void);
@@ -157,6 +161,7 @@ typedef void (*NotifyFdProcPtr)(int fd, int ready, void *data);
 #define X_NOTIFY_NONE   0
 #define X_NOTIFY_READ   1
 #define X_NOTIFY_WRITE  2
+#define X_NOTIFY_ERROR  4       /* don't need to select for, always reported */
 
 extern _X_EXPORT Bool SetNotifyFd(int fd, NotifyFdProcPtr notify_fd, int mask, void *data);
 
@@ -210,6 +215,18 @@ extern _X_EXPORT void TimerCheck(void);
 extern _X_EXPORT void TimerCancel(OsTimerPtr /* pTimer */ );
 extern _X_EXPORT void TimerFree(OsTimerPtr /* pTimer */ );
 
+typedef void (*ParallelBandProc) (int /* y1 */ ,
+                                  int /* y2 */ ,
+                                  void * /* closure */ );
+
+extern _X_EXPORT int ParallelThreads;
+
+extern _X_EXPORT void ParallelBands(int /* y1 */ ,
+                                    int /* y2 */ ,
+                                    int /* width */ ,
+                                    ParallelBandProc /* proc */ ,
+                                    void * /* closure */ );
+
 extern _X_EXPORT void SetScreenSaverTimer(void);
 extern _X_EXPORT void FreeScreenSaverTimer(void);
 
@@ -149,6 +149,10 @@
 #define SERVER_XRES_MAJOR_VERSION		1
 #define SERVER_XRES_MINOR_VERSION		2
 
+/* X-Resource-Sched, private to this server */
+#define SERVER_XRES_SCHED_MAJOR_VERSION		1
+#define SERVER_XRES_SCHED_MINOR_VERSION		0
+
 /* XvMC */
 #define SERVER_XVMC_MAJOR_VERSION		1
 #define SERVER_XVMC_MINOR_VERSION		1
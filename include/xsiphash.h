@@ -0,0 +1,24 @@
+#ifndef XSIPHASH_H
+#define XSIPHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keyed 128-bit hash (SipHash-2-4).  Unlike x_sha1_*, the context lives
+ * with the caller and none of these can fail.
+ */
+typedef struct {
+    uint64_t v[4];
+    unsigned char tail[8];
+    size_t len;
+} x_siphash_ctx;
+
+void x_siphash_init(x_siphash_ctx *ctx, const unsigned char key[16]);
+
+void x_siphash_update(x_siphash_ctx *ctx, const void *data, size_t size);
+
+/* Place the hash in result */
+void x_siphash_final(x_siphash_ctx *ctx, unsigned char result[16]);
+
+#endif
@@ -478,6 +478,12 @@ extern _X_EXPORT void miMarkUnrealizedWindow(WindowPtr /*pChild */ ,
                                              Bool       /*fromConfigure */
     );
 
+extern _X_EXPORT Bool miPickInit(ScreenPtr pScreen);
+
+extern _X_EXPORT void miPickInvalidate(ScreenPtr pScreen);
+
+extern _X_EXPORT void miPickFini(ScreenPtr pScreen);
+
 extern _X_EXPORT WindowPtr miSpriteTrace(SpritePtr pSprite, int x, int y);
 
 extern _X_EXPORT WindowPtr miXYToWindow(ScreenPtr pScreen, SpritePtr pSprite, int x, int y);
@@ -75,10 +75,22 @@ typedef struct _Event {
     DeviceIntPtr pDev;          /* device this event _originated_ from */
 } EventRec, *EventPtr;
 
+/*
+ * The queue is a single-producer, single-consumer ring.  Producers
+ * (the input thread, SIGIO handlers, DDX event threads and the main
+ * thread itself) are serialized by the input lock and only ever write
+ * tail; mieqProcessInputEvents is the only consumer, only writes head
+ * and takes no lock at all.  Each side publishes its index with a
+ * release store after it is done with the slot, and loads the other
+ * side's index with an acquire load before touching slots.
+ *
+ * Since the producer cannot know whether the consumer is still copying
+ * the last queued event, consecutive motion events are coalesced when
+ * they are dequeued rather than when they are queued.
+ */
 typedef struct _EventQueue {
     HWEventQueueType head, tail;        /* long for SetInputCheck */
     CARD32 lastEventTime;       /* to avoid time running backwards */
-    int lastMotion;             /* device ID if last event motion? */
     EventRec *events;           /* our queue as an array */
     size_t nevents;             /* the number of buckets in our queue */
     size_t dropped;             /* counter for number of consecutive dropped events */
@@ -87,9 +99,16 @@ typedef struct _EventQueue {
 
 static EventQueueRec miEventQueue;
 
+#if defined(__GNUC__) || defined(__clang__)
+#define mieqLoadIndex(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define mieqStoreIndex(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#define mieqLoadIndex(p)        (*(volatile HWEventQueueType *) (p))
+#define mieqStoreIndex(p, v)    (*(volatile HWEventQueueType *) (p) = (v))
+#endif
+
 #ifdef XQUARTZ
 #include  <pthread.h>
-static pthread_mutex_t miEventQueueMutex = PTHREAD_MUTEX_INITIALIZER;
 
 extern BOOL serverRunning;
 extern pthread_mutex_t serverRunningMutex;
@@ -115,14 +134,15 @@ mieqNumEnqueued(EventQueuePtr eventQueue)
 
     if (eventQueue->nevents) {
         /* % is not well-defined with negative numbers... sigh */
-        n_enqueued = eventQueue->tail - eventQueue->head + eventQueue->nevents;
+        n_enqueued = mieqLoadIndex(&eventQueue->tail) -
+            mieqLoadIndex(&eventQueue->head) + eventQueue->nevents;
         if (n_enqueued >= eventQueue->nevents)
             n_enqueued -= eventQueue->nevents;
     }
     return n_enqueued;
 }
 
-/* Pre-condition: Called with miEventQueueMutex held */
+/* Pre-condition: Called from the consumer, with no other consumer running */
 static Bool
 mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
 {
@@ -143,13 +163,14 @@ mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
         return FALSE;
     }
 
-    n_enqueued = mieqNumEnqueued(eventQueue);
-
-    /* We block signals, so an mieqEnqueue triggered by SIGIO does not
-     * write to our queue as we are modifying it.
+    /* We block signals and take the input lock, so an mieqEnqueue from
+     * SIGIO or the input thread does not write to our queue as we are
+     * modifying it.
      */
     OsBlockSignals();
 
+    n_enqueued = mieqNumEnqueued(eventQueue);
+
     /* First copy the existing events */
     first_hunk = eventQueue->nevents - eventQueue->head;
     memcpy(new_events,
@@ -234,42 +255,34 @@ mieqReservedCandidate(InternalEvent *e)
 }
 
 /*
- * Must be reentrant with ProcessInputEvents.  Assumption: mieqEnqueue
- * will never be interrupted.  If this is called from both signal
- * handlers and regular code, make sure the signal is suspended when
- * called from regular code.
+ * Must be reentrant with ProcessInputEvents, which may run concurrently
+ * on another thread.  Producers serialize on the input lock; if this is
+ * called from both signal handlers and regular code, make sure the
+ * signal is suspended when called from regular code.
  */
 
 void
 mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 {
-    unsigned int oldtail = miEventQueue.tail;
+    HWEventQueueType oldtail;
     InternalEvent *evt;
-    int isMotion = 0;
     int evlen;
     Time time;
     size_t n_enqueued;
 
 #ifdef XQUARTZ
     wait_for_server_init();
-    pthread_mutex_lock(&miEventQueueMutex);
 #endif
+    input_lock();
 
     verify_internal_event(e);
 
+    oldtail = miEventQueue.tail;
     n_enqueued = mieqNumEnqueued(&miEventQueue);
 
-    /* avoid merging events from different devices */
-    if (e->any.type == ET_Motion)
-        isMotion = pDev->id;
-
-    if (isMotion && isMotion == miEventQueue.lastMotion &&
-        oldtail != miEventQueue.head) {
-        oldtail = (oldtail - 1) % miEventQueue.nevents;
-    }
-    else if ((n_enqueued + 1 == miEventQueue.nevents) ||
-             ((n_enqueued + 1 >= miEventQueue.nevents - QUEUE_RESERVED_SIZE) &&
-              !mieqReservedCandidate(e))) {
+    if ((n_enqueued + 1 == miEventQueue.nevents) ||
+        ((n_enqueued + 1 >= miEventQueue.nevents - QUEUE_RESERVED_SIZE) &&
+         !mieqReservedCandidate(e))) {
         /* Toss events which come in late.  Usually this means your server's
          * stuck in an infinite loop somewhere, but SIGIO is still getting
          * handled.
@@ -296,9 +309,7 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
             xorg_backtrace();
         }
 
-#ifdef XQUARTZ
-        pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+        input_unlock();
         return;
     }
 
@@ -317,11 +328,8 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
     miEventQueue.events[oldtail].pScreen = pDev ? EnqueueScreen(pDev) : NULL;
     miEventQueue.events[oldtail].pDev = pDev;
 
-    miEventQueue.lastMotion = isMotion;
-    miEventQueue.tail = (oldtail + 1) % miEventQueue.nevents;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    mieqStoreIndex(&miEventQueue.tail, (oldtail + 1) % miEventQueue.nevents);
+    input_unlock();
 }
 
 /**
@@ -342,31 +350,21 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 void
 mieqSwitchScreen(DeviceIntPtr pDev, ScreenPtr pScreen, Bool set_dequeue_screen)
 {
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
+    input_lock();
     EnqueueScreen(pDev) = pScreen;
     if (set_dequeue_screen)
         DequeueScreen(pDev) = pScreen;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+    input_unlock();
 }
 
 void
 mieqSetHandler(int event, mieqHandler handler)
 {
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
     if (handler && miEventQueue.handlers[event])
         ErrorF("[mi] mieq: warning: overriding existing handler %p with %p for "
                "event %d\n", miEventQueue.handlers[event], handler, event);
 
     miEventQueue.handlers[event] = handler;
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
 }
 
 /**
@@ -570,6 +568,19 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
     }
 }
 
+/* Is the event in slot @next a motion event that supersedes @e? */
+static Bool
+mieqCoalesceMotion(EventRec *e, HWEventQueueType next, HWEventQueueType tail)
+{
+    EventRec *n;
+
+    if (next == tail || e->events->any.type != ET_Motion || !e->pDev)
+        return FALSE;
+
+    n = &miEventQueue.events[next];
+    return n->events->any.type == ET_Motion && n->pDev == e->pDev;
+}
+
 /* Call this from ProcessInputEvents(). */
 void
 mieqProcessInputEvents(void)
@@ -578,13 +589,10 @@ mieqProcessInputEvents(void)
     ScreenPtr screen;
     InternalEvent event;
     DeviceIntPtr dev = NULL, master = NULL;
+    HWEventQueueType head, tail, next;
     size_t n_enqueued;
     static Bool inProcessInputEvents = FALSE;
 
-#ifdef XQUARTZ
-    pthread_mutex_lock(&miEventQueueMutex);
-#endif
-
     /*
      * report an error if mieqProcessInputEvents() is called recursively;
      * this can happen, e.g., if something in the mieqProcessDeviceEvent()
@@ -605,25 +613,34 @@ mieqProcessInputEvents(void)
     }
 
     if (miEventQueue.dropped) {
+        input_lock();
         ErrorF("[mi] EQ processing has resumed after %lu dropped events.\n",
                (unsigned long) miEventQueue.dropped);
         ErrorF
             ("[mi] This may be caused by a misbehaving driver monopolizing the server's resources.\n");
         miEventQueue.dropped = 0;
+        input_unlock();
     }
 
-    while (miEventQueue.head != miEventQueue.tail) {
-        e = &miEventQueue.events[miEventQueue.head];
+    head = miEventQueue.head;
+    while (head != (tail = mieqLoadIndex(&miEventQueue.tail))) {
+        e = &miEventQueue.events[head];
+        next = (head + 1) % miEventQueue.nevents;
+
+        /* Only the most recent of consecutive motions matters */
+        if (mieqCoalesceMotion(e, next, tail)) {
+            mieqStoreIndex(&miEventQueue.head, next);
+            head = next;
+            continue;
+        }
 
         event = *e->events;
         dev = e->pDev;
         screen = e->pScreen;
 
-        miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
-
-#ifdef XQUARTZ
-        pthread_mutex_unlock(&miEventQueueMutex);
-#endif
+        /* The slot may be reused as soon as head moves past it */
+        mieqStoreIndex(&miEventQueue.head, next);
+        head = next;
 
         master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
 
@@ -646,15 +663,7 @@ mieqProcessInputEvents(void)
                event.any.type == ET_TouchUpdate) &&
               event.device_event.flags & TOUCH_POINTER_EMULATED)))
             miPointerUpdateSprite(dev);
-
-#ifdef XQUARTZ
-        pthread_mutex_lock(&miEventQueueMutex);
-#endif
     }
 
     inProcessInputEvents = FALSE;
-
-#ifdef XQUARTZ
-    pthread_mutex_unlock(&miEventQueueMutex);
-#endif
 }
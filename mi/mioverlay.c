@@ -728,6 +728,9 @@ miOverlayValidateTree(WindowPtr pParent, WindowPtr pChild,      /* first child e
     Bool overlap;
     WindowPtr newParent;
 
+    if (!pParent->parent)
+        miPickInvalidate(pScreen);
+
     if (!pPriv->underlayMarked)
         goto SKIP_UNDERLAY;
 
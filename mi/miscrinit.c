@@ -121,6 +121,7 @@ miModifyPixmapHeader(PixmapPtr pPixmap, int width, int height, int depth,
 static Bool
 miCloseScreen(ScreenPtr pScreen)
 {
+    miPickFini(pScreen);
     return ((*pScreen->DestroyPixmap) ((PixmapPtr) pScreen->devPrivate));
 }
 
@@ -273,6 +274,8 @@ miScreenInit(ScreenPtr pScreen, void *pbits,  /* pointer to screen bits */
     pScreen->SetShape = miSetShape;
     pScreen->MarkUnrealizedWindow = miMarkUnrealizedWindow;
     pScreen->XYToWindow = miXYToWindow;
+    if (!miPickInit(pScreen))
+        return FALSE;
 
     miSetZeroLineBias(pScreen, DEFAULTZEROLINEBIAS);
 
@@ -543,6 +543,13 @@ getBorderClip(WindowPtr pWin)
  *	extra operations done in miComputeClips, but this is much faster
  *	e.g. when only one child has moved...
  *
+ *	Only the part of pParent's clipList under the old borderClips and
+ *	new borderSizes of the marked children can change, so the rest of
+ *	it is left out of totalClip and merged back in at the end. With
+ *	thousands of children the parent's clipList can hold tens of
+ *	thousands of rectangles, and this keeps the per-child region
+ *	arithmetic proportional to the area that actually changed.
+ *
  *-----------------------------------------------------------------------
  */
  /*ARGSUSED*/ int
@@ -561,6 +568,11 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
     RegionRec childUnion;       /* the space covered by borderSize for
                                  * all marked children */
     RegionRec exposed;          /* For intermediate calculations */
+    RegionRec changed;          /* the old borderClips and new borderSizes
+                                 * of the marked children: the only part
+                                 * of pParent's clipList which may change */
+    RegionRec oldClip;          /* pParent's clipList within changed */
+    Bool incremental;
     ScreenPtr pScreen;
     WindowPtr pWin;
     Bool overlap;
@@ -571,6 +583,10 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
     if (pChild == NullWindow)
         pChild = pParent->firstChild;
 
+    /* the top-level windows may have changed */
+    if (!pParent->parent)
+        miPickInvalidate(pScreen);
+
     RegionNull(&childClip);
     RegionNull(&exposed);
 
@@ -582,6 +598,7 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
      */
     RegionNull(&totalClip);
     viewvals = 0;
+    incremental = FALSE;
     if (RegionBroken(&pParent->clipList) && !RegionBroken(&pParent->borderClip)) {
         kind = VTBroken;
         /*
@@ -630,6 +647,23 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
             }
         }
         RegionValidate(&totalClip, &overlap);
+
+        /*
+         * Outside the area the marked children used to take up and now
+         * cover, pParent's clipList stays as it is; work only on the
+         * piece of it inside that area.
+         */
+        if (kind != VTStack && !RegionBroken(&pParent->clipList)) {
+            incremental = TRUE;
+            RegionNull(&changed);
+            RegionCopy(&changed, &totalClip);
+            for (pWin = pChild; pWin; pWin = pWin->nextSib)
+                if (pWin->valdata && pWin->viewable)
+                    RegionAppend(&changed, &pWin->borderSize);
+            RegionValidate(&changed, &overlap);
+            RegionNull(&oldClip);
+            RegionIntersect(&oldClip, &pParent->clipList, &changed);
+        }
     }
 
     /*
@@ -641,7 +675,8 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
 
     overlap = TRUE;
     if (kind != VTStack) {
-        RegionUnion(&totalClip, &totalClip, &pParent->clipList);
+        RegionUnion(&totalClip, &totalClip,
+                    incremental ? &oldClip : &pParent->clipList);
         if (viewvals > 1) {
             /*
              * precompute childUnion to discover whether any of them
@@ -721,15 +756,25 @@ miValidateTree(WindowPtr pParent,       /* Parent to validate */
          * exposures and obscures as per miComputeClips and reset the parent's
          * clipList.
          */
-        RegionSubtract(&pParent->valdata->after.exposed,
-                       &totalClip, &pParent->clipList);
+        RegionSubtract(&pParent->valdata->after.exposed, &totalClip,
+                       incremental ? &oldClip : &pParent->clipList);
         /* fall through */
     case VTMap:
-        RegionCopy(&pParent->clipList, &totalClip);
+        if (incremental) {
+            RegionSubtract(&pParent->clipList, &pParent->clipList, &changed);
+            RegionUnion(&pParent->clipList, &pParent->clipList, &totalClip);
+        }
+        else
+            RegionCopy(&pParent->clipList, &totalClip);
         pParent->drawable.serialNumber = NEXT_SERIAL_NUMBER;
         break;
     }
 
+    if (incremental) {
+        RegionUninit(&changed);
+        RegionUninit(&oldClip);
+    }
+
     RegionUninit(&totalClip);
     RegionUninit(&exposed);
     if (pScreen->ClipNotify)
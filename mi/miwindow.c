@@ -676,6 +676,9 @@ miSetShape(WindowPtr pWin, int kind)
             }
         }
     }
+    /* input shapes of top-level windows change without a ValidateTree */
+    if (pWin->parent && !pWin->parent->parent)
+        miPickInvalidate(pScreen);
     if (pWin->realized)
         WindowsRestructured();
     CheckCursorConfinement(pWin);
@@ -745,15 +748,12 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
     }
 }
 
-WindowPtr
-miSpriteTrace(SpritePtr pSprite, int x, int y)
+static Bool
+miSpriteTraceHit(WindowPtr pWin, int x, int y)
 {
-    WindowPtr pWin;
     BoxRec box;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
+    return ((pWin->mapped) &&
             (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
             (x < pWin->drawable.x + (int) pWin->drawable.width +
              wBorderWidth(pWin)) &&
@@ -773,7 +773,234 @@ miSpriteTrace(SpritePtr pSprite, int x, int y)
              * they're in X's stack. (E.g. if the native window system
              * implements some form of virtual desktop system).
              */
-            && !pWin->unhittable) {
+            && !pWin->unhittable);
+}
+
+/*
+ * Top-level windows are found through a grid over the root window.  Each
+ * cell lists, in stacking order, the mapped children of the root whose
+ * border box overlaps it, down to the first one that takes every point of
+ * the cell.  The grid is rebuilt on the first lookup after the root has
+ * been validated, and only used when the root has enough mapped children
+ * for walking them to matter.
+ */
+
+#define MI_PICK_MIN_WINDOWS	32
+#define MI_PICK_MIN_SHIFT	5
+#define MI_PICK_MAX_CELLS	64      /* per side */
+
+typedef struct {
+    Bool valid;
+    Bool enabled;               /* enough windows to use the grid */
+    BoxRec box;                 /* the root window when built */
+    int shift;                  /* cells are 1 << shift pixels square */
+    int cols, rows;
+    int *cells;                 /* cols * rows + 1 offsets into windows */
+    unsigned char *covered;     /* per cell, while building */
+    int sizeCells;
+    WindowPtr *windows;
+    int numWindows;
+    int sizeWindows;
+} miPickRec, *miPickPtr;
+
+static DevPrivateKeyRec miPickScreenKeyRec;
+
+#define miPickGetScreen(s) ((miPickPtr) \
+    dixLookupPrivate(&(s)->devPrivates, &miPickScreenKeyRec))
+
+Bool
+miPickInit(ScreenPtr pScreen)
+{
+    return dixRegisterPrivateKey(&miPickScreenKeyRec, PRIVATE_SCREEN,
+                                 sizeof(miPickRec));
+}
+
+void
+miPickInvalidate(ScreenPtr pScreen)
+{
+    if (dixPrivateKeyRegistered(&miPickScreenKeyRec))
+        miPickGetScreen(pScreen)->valid = FALSE;
+}
+
+void
+miPickFini(ScreenPtr pScreen)
+{
+    miPickPtr pick;
+
+    if (!dixPrivateKeyRegistered(&miPickScreenKeyRec))
+        return;
+    pick = miPickGetScreen(pScreen);
+    free(pick->cells);
+    free(pick->covered);
+    free(pick->windows);
+    memset(pick, 0, sizeof(*pick));
+}
+
+/*
+ * Count pWin in each cell it overlaps, or with fill, store it there; the
+ * two passes must agree on which cells are already covered.
+ */
+static void
+miPickAddWindow(miPickPtr pick, WindowPtr pWin, Bool fill)
+{
+    int bw = wBorderWidth(pWin);
+    int w = pick->box.x2 - pick->box.x1, h = pick->box.y2 - pick->box.y1;
+    int x1 = max(pWin->drawable.x - bw - pick->box.x1, 0);
+    int y1 = max(pWin->drawable.y - bw - pick->box.y1, 0);
+    int x2 = min(pWin->drawable.x + (int) pWin->drawable.width + bw -
+                 pick->box.x1, w);
+    int y2 = min(pWin->drawable.y + (int) pWin->drawable.height + bw -
+                 pick->box.y1, h);
+    Bool opaque = !wBoundingShape(pWin) && !wInputShape(pWin) &&
+        !pWin->unhittable;
+    int c, r, cell;
+
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    for (r = y1 >> pick->shift; r <= (y2 - 1) >> pick->shift; r++) {
+        for (c = x1 >> pick->shift; c <= (x2 - 1) >> pick->shift; c++) {
+            cell = r * pick->cols + c;
+            if (pick->covered[cell])
+                continue;
+            if (fill)
+                pick->windows[pick->cells[cell]++] = pWin;
+            else
+                pick->cells[cell + 1]++;
+            if (opaque &&
+                x1 <= c << pick->shift &&
+                x2 >= min((c + 1) << pick->shift, w) &&
+                y1 <= r << pick->shift &&
+                y2 >= min((r + 1) << pick->shift, h))
+                pick->covered[cell] = 1;
+        }
+    }
+}
+
+static void
+miPickBuild(ScreenPtr pScreen, miPickPtr pick)
+{
+    WindowPtr pRoot = pScreen->root;
+    WindowPtr pWin;
+    int w = pRoot->drawable.width, h = pRoot->drawable.height;
+    int n = 0, numCells, i;
+
+    pick->valid = TRUE;
+    pick->enabled = FALSE;
+    pick->box.x1 = pRoot->drawable.x;
+    pick->box.y1 = pRoot->drawable.y;
+    pick->box.x2 = pRoot->drawable.x + w;
+    pick->box.y2 = pRoot->drawable.y + h;
+
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib)
+        if (pWin->mapped)
+            n++;
+    if (n < MI_PICK_MIN_WINDOWS || w <= 0 || h <= 0)
+        return;
+
+    for (pick->shift = MI_PICK_MIN_SHIFT;
+         ((w - 1) >> pick->shift) >= MI_PICK_MAX_CELLS ||
+         ((h - 1) >> pick->shift) >= MI_PICK_MAX_CELLS; pick->shift++)
+        ;
+    pick->cols = ((w - 1) >> pick->shift) + 1;
+    pick->rows = ((h - 1) >> pick->shift) + 1;
+    numCells = pick->cols * pick->rows;
+
+    if (numCells + 1 > pick->sizeCells) {
+        int *cells = reallocarray(pick->cells, numCells + 1, sizeof(int));
+        unsigned char *covered = realloc(pick->covered, numCells);
+
+        if (cells)
+            pick->cells = cells;
+        if (covered)
+            pick->covered = covered;
+        if (!cells || !covered)
+            return;
+        pick->sizeCells = numCells + 1;
+    }
+
+    /* count, then turn the counts into offsets */
+    memset(pick->cells, 0, (numCells + 1) * sizeof(int));
+    memset(pick->covered, 0, numCells);
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib)
+        if (pWin->mapped)
+            miPickAddWindow(pick, pWin, FALSE);
+    for (i = 0; i < numCells; i++)
+        pick->cells[i + 1] += pick->cells[i];
+    pick->numWindows = pick->cells[numCells];
+
+    if (pick->numWindows > pick->sizeWindows) {
+        WindowPtr *windows = reallocarray(pick->windows, pick->numWindows,
+                                          sizeof(WindowPtr));
+
+        if (!windows)
+            return;
+        pick->windows = windows;
+        pick->sizeWindows = pick->numWindows;
+    }
+
+    /* fill, using each cell's offset as its cursor, then shift them back */
+    memset(pick->covered, 0, numCells);
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib)
+        if (pWin->mapped)
+            miPickAddWindow(pick, pWin, TRUE);
+    memmove(pick->cells + 1, pick->cells, numCells * sizeof(int));
+    pick->cells[0] = 0;
+
+    pick->enabled = TRUE;
+}
+
+/*
+ * Find the child of the root at x, y.  Returns FALSE if the grid cannot
+ * answer and the children have to be walked.
+ */
+static Bool
+miPickTopLevel(ScreenPtr pScreen, int x, int y, WindowPtr *ppWin)
+{
+    WindowPtr pRoot = pScreen->root;
+    miPickPtr pick;
+    int cell, i;
+
+    if (!dixPrivateKeyRegistered(&miPickScreenKeyRec))
+        return FALSE;
+
+    pick = miPickGetScreen(pScreen);
+    if (!pick->valid ||
+        pick->box.x1 != pRoot->drawable.x ||
+        pick->box.y1 != pRoot->drawable.y ||
+        pick->box.x2 != pRoot->drawable.x + pRoot->drawable.width ||
+        pick->box.y2 != pRoot->drawable.y + pRoot->drawable.height)
+        miPickBuild(pScreen, pick);
+
+    if (!pick->enabled ||
+        x < pick->box.x1 || x >= pick->box.x2 ||
+        y < pick->box.y1 || y >= pick->box.y2)
+        return FALSE;
+
+    cell = ((y - pick->box.y1) >> pick->shift) * pick->cols +
+        ((x - pick->box.x1) >> pick->shift);
+    *ppWin = NULL;
+    for (i = pick->cells[cell]; i < pick->cells[cell + 1]; i++) {
+        if (miSpriteTraceHit(pick->windows[i], x, y)) {
+            *ppWin = pick->windows[i];
+            break;
+        }
+    }
+    return TRUE;
+}
+
+WindowPtr
+miSpriteTrace(SpritePtr pSprite, int x, int y)
+{
+    WindowPtr pWin, pParent;
+
+    pParent = DeepestSpriteWin(pSprite);
+    if (pParent->parent ||
+        !miPickTopLevel(pParent->drawable.pScreen, x, y, &pWin))
+        pWin = pParent->firstChild;
+
+    while (pWin) {
+        if (miSpriteTraceHit(pWin, x, y)) {
             if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
                 pSprite->spriteTraceSize += 10;
                 pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
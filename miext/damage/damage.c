@@ -120,6 +120,66 @@ getDrawableDamageRef(DrawablePtr pDrawable)
     DamagePtr	*pPrev = (DamagePtr *) \
 	dixLookupPrivateAddr(&(pWindow)->devPrivates, damageWinPrivateKey)
 
+/*
+ * Round a region out to tiles, doubling the tile size until it has no
+ * more than maxRects rectangles.  Once the tiles are as big as the
+ * coordinate space, what is left is the extents.
+ */
+static int
+damageTileFloor(int v, int tile)
+{
+    int r = v % tile;
+
+    return v - (r < 0 ? r + tile : r);
+}
+
+static void
+damageCoarsen(RegionPtr pRegion, int tile, int maxRects)
+{
+    RegionRec snapped;
+    BoxPtr boxes, src;
+    int i, n;
+
+    while (RegionNumRects(pRegion) > maxRects && tile < 0x10000) {
+        n = RegionNumRects(pRegion);
+        src = RegionRects(pRegion);
+        boxes = xallocarray(n, sizeof(BoxRec));
+        if (!boxes)
+            break;
+        for (i = 0; i < n; i++) {
+            boxes[i].x1 = max(damageTileFloor(src[i].x1, tile), MINSHORT);
+            boxes[i].y1 = max(damageTileFloor(src[i].y1, tile), MINSHORT);
+            boxes[i].x2 = min(damageTileFloor(src[i].x2 + tile - 1, tile),
+                              MAXSHORT);
+            boxes[i].y2 = min(damageTileFloor(src[i].y2 + tile - 1, tile),
+                              MAXSHORT);
+        }
+        if (RegionInitBoxes(&snapped, boxes, n)) {
+            RegionCopy(pRegion, &snapped);
+            RegionUninit(&snapped);
+        }
+        else {
+            RegionUninit(&snapped);
+            free(boxes);
+            break;
+        }
+        free(boxes);
+        tile *= 2;
+    }
+
+    if (RegionNumRects(pRegion) > maxRects)
+        RegionReset(pRegion, RegionExtents(pRegion));
+}
+
+static inline void
+damageLimitRegion(DamagePtr pDamage, RegionPtr pRegion)
+{
+    if (pDamage->maxRects && RegionNumRects(pRegion) > pDamage->maxRects)
+        damageCoarsen(pRegion, pDamage->tileSize, pDamage->maxRects);
+}
+
+static void damageBatchFlush(DamagePtr pDamage);
+
 #if DAMAGE_DEBUG_ENABLE
 static void
 _damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
@@ -259,12 +319,15 @@ damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
             RegionUnion(&pDamage->pendingDamage,
                         &pDamage->pendingDamage, pDamageRegion);
 
-        /* Report damage now, if desired. */
+        /* Report damage now, if desired, after any boxes still batched */
         if (!pDamage->reportAfter) {
+            damageBatchFlush(pDamage);
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, pDamageRegion);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+                damageLimitRegion(pDamage, &pDamage->damage);
+            }
         }
 
         /*
@@ -291,9 +354,11 @@ damageRegionProcessPending(DrawablePtr pDrawable)
             /* It's possible that there is only interest in postRendering reporting. */
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, &pDamage->pendingDamage);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage,
                             &pDamage->pendingDamage);
+                damageLimitRegion(pDamage, &pDamage->damage);
+            }
         }
 
         if (pDamage->reportAfter)
@@ -302,6 +367,228 @@ damageRegionProcessPending(DrawablePtr pDrawable)
 
 }
 
+/*
+ * Damage that only accumulates -- no report function, DamageReportNone,
+ * or DamageReportNonEmpty once it has reported -- does not need its
+ * region brought up to date after every drawing operation.  Boxes for
+ * such damage are collected in a small array and folded into the
+ * region in one go when somebody asks for it or the array fills up,
+ * instead of running a region union for each primitive.
+ */
+#define DAMAGE_BATCH_SIZE 128
+
+#define BOX_INTERSECT(box, clip) { \
+    if ((box).x1 < (clip)->x1) (box).x1 = (clip)->x1; \
+    if ((box).x2 > (clip)->x2) (box).x2 = (clip)->x2; \
+    if ((box).y1 < (clip)->y1) (box).y1 = (clip)->y1; \
+    if ((box).y2 > (clip)->y2) (box).y2 = (clip)->y2; \
+    }
+
+static Bool
+damageBatchable(DamagePtr pDamage)
+{
+    if (pDamage->reportAfter)
+        return FALSE;
+    if (!pDamage->damageReport || pDamage->damageLevel == DamageReportNone)
+        return TRUE;
+    return pDamage->damageLevel == DamageReportNonEmpty &&
+        RegionNotEmpty(&pDamage->damage);
+}
+
+static void
+damageBatchFlush(DamagePtr pDamage)
+{
+    RegionRec batch;
+    int i;
+
+    if (!pDamage->nbatch)
+        return;
+
+    if (RegionInitBoxes(&batch, pDamage->batch, pDamage->nbatch)) {
+        RegionUnion(&pDamage->damage, &pDamage->damage, &batch);
+    }
+    else {
+        for (i = 0; i < pDamage->nbatch; i++) {
+            RegionReset(&batch, &pDamage->batch[i]);
+            RegionUnion(&pDamage->damage, &pDamage->damage, &batch);
+        }
+    }
+    RegionUninit(&batch);
+    pDamage->nbatch = 0;
+    damageLimitRegion(pDamage, &pDamage->damage);
+}
+
+/*
+ * Queue a box, in pDamage coordinates, for the region.  Boxes that the
+ * region or the previous box already cover are dropped, and a box that
+ * extends the previous one along a row or column is merged with it, so
+ * runs of glyphs or spans rarely take more than a slot.
+ */
+static Bool
+damageBatchAdd(DamagePtr pDamage, BoxPtr pBox)
+{
+    BoxPtr extents = &pDamage->damage.extents;
+    BoxPtr last;
+
+    if (!pDamage->damage.data &&
+        pBox->x1 >= extents->x1 && pBox->x2 <= extents->x2 &&
+        pBox->y1 >= extents->y1 && pBox->y2 <= extents->y2)
+        return TRUE;
+
+    if (pDamage->nbatch) {
+        last = &pDamage->batch[pDamage->nbatch - 1];
+        if (pBox->x1 >= last->x1 && pBox->x2 <= last->x2 &&
+            pBox->y1 >= last->y1 && pBox->y2 <= last->y2)
+            return TRUE;
+        if (pBox->y1 == last->y1 && pBox->y2 == last->y2 &&
+            pBox->x1 <= last->x2 && pBox->x2 >= last->x1) {
+            last->x1 = min(last->x1, pBox->x1);
+            last->x2 = max(last->x2, pBox->x2);
+            return TRUE;
+        }
+        if (pBox->x1 == last->x1 && pBox->x2 == last->x2 &&
+            pBox->y1 <= last->y2 && pBox->y2 >= last->y1) {
+            last->y1 = min(last->y1, pBox->y1);
+            last->y2 = max(last->y2, pBox->y2);
+            return TRUE;
+        }
+    }
+
+    if (!pDamage->batch) {
+        pDamage->batch = xallocarray(DAMAGE_BATCH_SIZE, sizeof(BoxRec));
+        if (!pDamage->batch)
+            return FALSE;
+    }
+    else if (pDamage->nbatch == DAMAGE_BATCH_SIZE)
+        damageBatchFlush(pDamage);
+
+    pDamage->batch[pDamage->nbatch++] = *pBox;
+    return TRUE;
+}
+
+/*
+ * Clip a box of damage drawn to pDrawable, in screen coordinates, the
+ * way damageRegionAppend would for pDamage, and move it to pDamage
+ * coordinates.  Returns 1 with the box, 0 when nothing is left, or -1
+ * when the clip is not a rectangle.
+ */
+static int
+damageClipBox(DamagePtr pDamage, DrawablePtr pDrawable, BoxPtr pBox,
+              BoxPtr pOut)
+{
+    ScreenPtr pScreen = pDrawable->pScreen;
+    RegionPtr pClip;
+    BoxRec box = *pBox, bounds;
+    int draw_x, draw_y;
+
+    damageScrPriv(pScreen);
+
+    if (pScrPriv->internalLevel > 0 && !pDamage->isInternal)
+        return 0;
+    if (pDamage->pDrawable->type == DRAWABLE_WINDOW &&
+        !((WindowPtr) (pDamage->pDrawable))->realized)
+        return 0;
+
+    draw_x = pDamage->pDrawable->x;
+    draw_y = pDamage->pDrawable->y;
+#ifdef COMPOSITE
+    if (!WindowDrawable(pDamage->pDrawable->type)) {
+        draw_x += ((PixmapPtr) pDamage->pDrawable)->screen_x;
+        draw_y += ((PixmapPtr) pDamage->pDrawable)->screen_y;
+    }
+#endif
+
+    if (pDamage->pDrawable->type == DRAWABLE_WINDOW) {
+        pClip = &((WindowPtr) (pDamage->pDrawable))->borderClip;
+        if (RegionNumRects(pClip) > 1)
+            return -1;
+        BOX_INTERSECT(box, RegionExtents(pClip));
+    }
+    else {
+        bounds.x1 = draw_x;
+        bounds.y1 = draw_y;
+        bounds.x2 = draw_x + pDamage->pDrawable->width;
+        bounds.y2 = draw_y + pDamage->pDrawable->height;
+        BOX_INTERSECT(box, &bounds);
+    }
+    if (box.x1 >= box.x2 || box.y1 >= box.y2)
+        return 0;
+
+    pOut->x1 = box.x1 - draw_x;
+    pOut->y1 = box.y1 - draw_y;
+    pOut->x2 = box.x2 - draw_x;
+    pOut->y2 = box.y2 - draw_y;
+    return 1;
+}
+
+/*
+ * damageRegionAppend for a single box, without building any regions
+ * when the clipping involved is rectangular.  Returns FALSE, having done
+ * nothing, when the caller has to take the region path instead.
+ */
+static Bool
+damageBoxAppend(DrawablePtr pDrawable, BoxPtr pBox, int subWindowMode)
+{
+    drawableDamage(pDrawable);
+    DamagePtr pFirst = pDamage, pNext;
+    RegionPtr pClip;
+    RegionRec region;
+    BoxRec box = *pBox, clipped;
+
+#ifdef COMPOSITE
+    if (pDrawable->type != DRAWABLE_WINDOW) {
+        int screen_x = ((PixmapPtr) pDrawable)->screen_x - pDrawable->x;
+        int screen_y = ((PixmapPtr) pDrawable)->screen_y - pDrawable->y;
+
+        box.x1 += screen_x;
+        box.x2 += screen_x;
+        box.y1 += screen_y;
+        box.y2 += screen_y;
+    }
+#endif
+
+    if (pDrawable->type == DRAWABLE_WINDOW &&
+        ((WindowPtr) (pDrawable))->backingStore == NotUseful) {
+        if (subWindowMode == ClipByChildren) {
+            pClip = &((WindowPtr) (pDrawable))->clipList;
+            if (RegionNumRects(pClip) > 1)
+                return FALSE;
+            BOX_INTERSECT(box, RegionExtents(pClip));
+            if (box.x1 >= box.x2 || box.y1 >= box.y2)
+                return TRUE;
+        }
+        else if (subWindowMode == IncludeInferiors)
+            return FALSE;
+    }
+
+    /* Make sure every damage can take the box before touching any */
+    for (; pDamage; pDamage = pDamage->pNext)
+        if (damageClipBox(pDamage, pDrawable, &box, &clipped) < 0)
+            return FALSE;
+
+    for (pDamage = pFirst; pDamage; pDamage = pNext) {
+        pNext = pDamage->pNext;
+        if (damageClipBox(pDamage, pDrawable, &box, &clipped) <= 0)
+            continue;
+
+        if (damageBatchable(pDamage) && damageBatchAdd(pDamage, &clipped))
+            continue;
+
+        RegionInit(&region, &clipped, 1);
+        if (pDamage->reportAfter)
+            RegionUnion(&pDamage->pendingDamage,
+                        &pDamage->pendingDamage, &region);
+        else if (pDamage->damageReport)
+            DamageReportDamage(pDamage, &region);
+        else {
+            RegionUnion(&pDamage->damage, &pDamage->damage, &region);
+            damageLimitRegion(pDamage, &pDamage->damage);
+        }
+        RegionUninit(&region);
+    }
+    return TRUE;
+}
+
 #if DAMAGE_DEBUG_ENABLE
 #define damageDamageBox(d,b,m) _damageDamageBox(d,b,m,__FUNCTION__)
 static void
@@ -314,6 +601,9 @@ damageDamageBox(DrawablePtr pDrawable, BoxPtr pBox, int subWindowMode)
 {
     RegionRec region;
 
+    if (damageBoxAppend(pDrawable, pBox, subWindowMode))
+        return;
+
     RegionInit(&region, pBox, 1);
 #if DAMAGE_DEBUG_ENABLE
     _damageRegionAppend(pDrawable, &region, TRUE, subWindowMode, where);
@@ -1710,6 +2000,10 @@ DamageCreate(DamageReportFunc damageReport,
     pDamage->isWindow = FALSE;
     pDamage->pDrawable = 0;
     pDamage->reportAfter = FALSE;
+    pDamage->batch = NULL;
+    pDamage->nbatch = 0;
+    pDamage->maxRects = 0;
+    pDamage->tileSize = 0;
 
     pDamage->damageReport = damageReport;
     pDamage->damageDestroy = damageDestroy;
@@ -1821,6 +2115,7 @@ DamageDestroy(DamagePtr pDamage)
     (*pScrPriv->funcs.Destroy) (pDamage);
     RegionUninit(&pDamage->damage);
     RegionUninit(&pDamage->pendingDamage);
+    free(pDamage->batch);
     dixFreeObjectWithPrivates(pDamage, PRIVATE_DAMAGE);
 }
 
@@ -1831,6 +2126,7 @@ DamageSubtract(DamagePtr pDamage, const RegionPtr pRegion)
     RegionRec pixmapClip;
     DrawablePtr pDrawable = pDamage->pDrawable;
 
+    damageBatchFlush(pDamage);
     RegionSubtract(&pDamage->damage, &pDamage->damage, pRegion);
     if (pDrawable) {
         if (pDrawable->type == DRAWABLE_WINDOW)
@@ -1858,11 +2154,13 @@ void
 DamageEmpty(DamagePtr pDamage)
 {
     RegionEmpty(&pDamage->damage);
+    pDamage->nbatch = 0;
 }
 
 RegionPtr
 DamageRegion(DamagePtr pDamage)
 {
+    damageBatchFlush(pDamage);
     return &pDamage->damage;
 }
 
@@ -1903,6 +2201,15 @@ DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter)
     pDamage->reportAfter = reportAfter;
 }
 
+void
+DamageSetMaxRects(DamagePtr pDamage, int maxRects, int tileSize)
+{
+    pDamage->maxRects = max(maxRects, 0);
+    pDamage->tileSize = max(tileSize, 1);
+    damageBatchFlush(pDamage);
+    damageLimitRegion(pDamage, &pDamage->damage);
+}
+
 DamageScreenFuncsPtr
 DamageGetScreenFuncs(ScreenPtr pScreen)
 {
@@ -1914,12 +2221,22 @@ void
 DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
 {
     BoxRec tmpBox;
-    RegionRec tmpRegion;
+    RegionRec tmpRegion, coarse;
     Bool was_empty;
 
+    /* Report what the damage will hold, not the exact region */
+    RegionNull(&coarse);
+    if (pDamage->maxRects &&
+        RegionNumRects(pDamageRegion) > pDamage->maxRects) {
+        RegionCopy(&coarse, pDamageRegion);
+        damageLimitRegion(pDamage, &coarse);
+        pDamageRegion = &coarse;
+    }
+
     switch (pDamage->damageLevel) {
     case DamageReportRawRegion:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         (*pDamage->damageReport) (pDamage, pDamageRegion, pDamage->closure);
         break;
     case DamageReportDeltaRegion:
@@ -1927,6 +2244,8 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
         RegionSubtract(&tmpRegion, pDamageRegion, &pDamage->damage);
         if (RegionNotEmpty(&tmpRegion)) {
             RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+            damageLimitRegion(pDamage, &pDamage->damage);
+            damageLimitRegion(pDamage, &tmpRegion);
             (*pDamage->damageReport) (pDamage, &tmpRegion, pDamage->closure);
         }
         RegionUninit(&tmpRegion);
@@ -1934,6 +2253,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     case DamageReportBoundingBox:
         tmpBox = *RegionExtents(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         if (!BOX_SAME(&tmpBox, RegionExtents(&pDamage->damage))) {
             (*pDamage->damageReport) (pDamage, &pDamage->damage,
                                       pDamage->closure);
@@ -1942,6 +2262,7 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     case DamageReportNonEmpty:
         was_empty = !RegionNotEmpty(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         if (was_empty && RegionNotEmpty(&pDamage->damage)) {
             (*pDamage->damageReport) (pDamage, &pDamage->damage,
                                       pDamage->closure);
@@ -1949,6 +2270,8 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
         break;
     case DamageReportNone:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        damageLimitRegion(pDamage, &pDamage->damage);
         break;
     }
+    RegionUninit(&coarse);
 }
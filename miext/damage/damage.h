@@ -110,6 +110,12 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter);
 
+/* Round the damage out to a grid of tileSize pixels whenever it grows past
+ * maxRects rectangles, so it stays cheap to report and consume.  A maxRects
+ * of 0 keeps the damage exact, which is the default. */
+extern _X_EXPORT void
+ DamageSetMaxRects(DamagePtr pDamage, int maxRects, int tileSize);
+
 extern _X_EXPORT DamageScreenFuncsPtr DamageGetScreenFuncs(ScreenPtr);
 
 extern _X_EXPORT void
@@ -50,6 +50,12 @@ typedef struct _damage {
     RegionRec pendingDamage;    /* will be flushed post submission at the latest */
     ScreenPtr pScreen;
     PrivateRec *devPrivates;
+
+    BoxPtr batch;               /* boxes not yet merged into damage */
+    int nbatch;
+
+    int maxRects;               /* see DamageSetMaxRects */
+    int tileSize;
 } DamageRec;
 
 typedef struct _damageScrPriv {
@@ -93,6 +93,7 @@ RootlessNativeWindowStateChanged(WindowPtr pWin, unsigned int state)
     winRec->is_offscreen = ((state & XP_WINDOW_STATE_OFFSCREEN) != 0);
     winRec->is_obscured = ((state & XP_WINDOW_STATE_OBSCURED) != 0);
     pWin->unhittable = winRec->is_offscreen;
+    miPickInvalidate(pWin->drawable.pScreen);
 }
 
 void
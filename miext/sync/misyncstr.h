@@ -29,6 +29,7 @@
 #define _MISYNCSTR_H_
 
 #include "dix.h"
+#include "list.h"
 #include "misync.h"
 #include "scrnintstr.h"
 #include <X11/extensions/syncconst.h>
@@ -51,6 +52,7 @@ typedef struct _SyncCounter {
     SyncObject sync;            /* Common sync object data */
     CARD64 value;               /* counter value */
     struct _SysCounterInfo *pSysCounterInfo;    /* NULL if not a system counter */
+    struct _SyncTriggerIndex *pTrigIndex;       /* triggers by test value */
 } SyncCounter;
 
 struct _SyncFence {
@@ -74,6 +76,7 @@ struct _SyncTrigger {
         );
     void (*CounterDestroyed) (struct _SyncTrigger *     /*pTrigger */
         );
+    struct xorg_list pending;   /* on SyncChangeCounter's list to fire */
 };
 
 typedef struct _SyncTriggerList {
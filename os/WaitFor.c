@@ -60,6 +60,7 @@ SOFTWARE.
 #include <X11/Xwinsock.h>
 #endif
 #include <X11/Xos.h>            /* for strings, fcntl, time */
+#include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 #include <X11/X.h>
@@ -91,39 +92,49 @@ SOFTWARE.
 #define GetErrno() errno
 #endif
 
-/* like ffs, but uses fd_mask instead of int as argument, so it works
-   when fd_mask is longer than an int, such as common 64-bit platforms */
-/* modifications by raphael */
-int
-mffs(fd_mask mask)
-{
-    int i;
-
-    if (!mask)
-        return 0;
-    i = 1;
-    while (!(mask & 1)) {
-        i++;
-        mask >>= 1;
-    }
-    return i;
-}
-
 #ifdef DPMSExtension
 #include <X11/extensions/dpmsconst.h>
 #endif
 
 struct _OsTimerRec {
-    OsTimerPtr next;
-    CARD32 expires;
-    CARD32 delta;
+    struct xorg_list list;      /* empty while the timer is not armed */
+    CARD64 expires;
     OsTimerCallback callback;
     void *arg;
+    unsigned char level;
+    unsigned char slot;
 };
 
-static void DoTimer(OsTimerPtr timer, CARD32 now, volatile OsTimerPtr *prev);
-static void CheckAllTimers(void);
-static volatile OsTimerPtr timers = NULL;
+/*
+ * Armed timers live in a hierarchical timer wheel: level 0 has one slot
+ * per millisecond for the next 64ms, each higher level slots 64 times
+ * coarser.  A slot of a higher level is cascaded down when the wheel
+ * clock reaches it, so arming and cancelling a timer is O(1) however
+ * many are active.  A bitmap per level tracks the non-empty slots.
+ *
+ * Expiry times are kept on a 64-bit millisecond clock extended from
+ * GetTimeInMillis, which only ever moves forward: the CARD32 value
+ * wrapping every 49.7 days or stepping back is absorbed here rather than
+ * being seen by the timers.
+ */
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SIZE        (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS      6
+
+static struct {
+    CARD64 clock;               /* next millisecond to run */
+    CARD64 now;                 /* extended GetTimeInMillis */
+    CARD32 last;
+    CARD64 pending[TIMER_WHEEL_LEVELS];
+    struct xorg_list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    int count;
+    Bool initialized;
+} timer_wheel;
+
+static void DoTimer(OsTimerPtr timer, CARD32 now);
+static Bool TimerRun(CARD32 now);
+static INT32 TimerTimeout(CARD32 now);
 
 /*****************
  * WaitForSomething:
@@ -137,33 +148,36 @@ static volatile OsTimerPtr timers = NULL;
  *     If the time between INPUT events is
  *     greater than ScreenSaverTime, the display is turned off (or
  *     saved, depending on the hardware).  So, WaitForSomething()
- *     has to handle this also (that's why the select() has a timeout.
- *     For more info on ClientsWithInput, see ReadRequestFromClient().
- *     pClientsReady is an array to store ready client->index values into.
+ *     has to handle this also (that's why the poll has a timeout.
+ *     For more info on the ready_clients list, see
+ *     ReadRequestFromClient().  Returns TRUE when some client is on
+ *     the ready_clients list and should be dispatched.
+ *
+ *     Client and notify fds are watched through server_poll, whose
+ *     callbacks mark clients ready as they are reported, so the cost
+ *     of a wakeup scales with the number of ready descriptors rather
+ *     than with MaxClients.
  *****************/
 
-int
-WaitForSomething(int *pClientsReady, int *(ProcFlush)(void))
+Bool
+WaitForSomething(Bool are_ready, int *(ProcFlush)(void))
 {
     int i;
     struct timeval waittime, *wt;
     INT32 timeout = 0;
-    fd_set clientsReadable;
-    fd_set clientsWritable;
-    int curclient;
-    int selecterr;
-    static int nready;
+    int pollerr;
+    static Bool were_ready;
+    Bool timer_is_running;
     fd_set devicesReadable;
     CARD32 now = 0;
-    Bool someReady = FALSE;
-    Bool someNotifyWriteReady = FALSE;
 
-    FD_ZERO(&clientsReadable);
-    FD_ZERO(&clientsWritable);
+    timer_is_running = were_ready;
 
-    if (nready)
+    if (were_ready && !are_ready) {
+        timer_is_running = FALSE;
         SmartScheduleStopTimer();
-    nready = 0;
+    }
+    were_ready = FALSE;
 
 #ifdef BUSFAULT
     busfault_check();
@@ -175,57 +189,41 @@ WaitForSomething(int *pClientsReady, int *(ProcFlush)(void))
         /* deal with any blocked jobs */
         if (workQueue)
             ProcessWorkQueue();
-        if (XFD_ANYSET(&ClientsWithInput)) {
-            someReady = TRUE;
+        are_ready = clients_are_ready();
+        if (are_ready) {
             waittime.tv_sec = 0;
             waittime.tv_usec = 0;
             wt = &waittime;
         }
-        if (someReady) {
-            XFD_COPYSET(&AllSockets, &LastSelectMask);
-            XFD_UNSET(&LastSelectMask, &ClientsWithInput);
-        }
         else {
             wt = NULL;
-            if (timers) {
+            if (timer_wheel.count) {
                 now = GetTimeInMillis();
-                timeout = timers->expires - now;
-                if (timeout > 0 && timeout > timers->delta + 250) {
-                    /* time has rewound.  reset the timers. */
-                    CheckAllTimers();
-                }
-
-                if (timers) {
-                    timeout = timers->expires - now;
-                    if (timeout < 0)
-                        timeout = 0;
-                    waittime.tv_sec = timeout / MILLI_PER_SECOND;
-                    waittime.tv_usec = (timeout % MILLI_PER_SECOND) *
-                        (1000000 / MILLI_PER_SECOND);
-                    wt = &waittime;
-                }
+                timeout = TimerTimeout(now);
+                waittime.tv_sec = timeout / MILLI_PER_SECOND;
+                waittime.tv_usec = (timeout % MILLI_PER_SECOND) *
+                    (1000000 / MILLI_PER_SECOND);
+                wt = &waittime;
             }
-            XFD_COPYSET(&AllSockets, &LastSelectMask);
         }
-
+        FD_ZERO(&LastSelectMask);
         BlockHandler((void *) &wt, (void *) &LastSelectMask);
         if (NewOutputPending)
             FlushAllOutput();
-        /* keep this check close to select() call to minimize race */
+        /* keep this check close to poll() call to minimize race */
         if (dispatchException)
             i = -1;
-        else if (AnyWritesPending) {
-            XFD_COPYSET(&ClientsWriteBlocked, &LastSelectWriteMask);
-            XFD_ORSET(&LastSelectWriteMask, &NotifyWriteFds, &LastSelectWriteMask);
-            i = Select(MaxClients, &LastSelectMask, &LastSelectWriteMask, NULL, wt);
-        }
         else {
-            if(wt) {
+            if (wt) {
                 wt->tv_sec = 0;
-                if(wt->tv_usec > 16000)     wt->tv_usec = 16000;
+                if (wt->tv_usec > 16000)
+                    wt->tv_usec = 16000;
+                timeout = (wt->tv_usec + 999) / 1000;
             }
+            else
+                timeout = -1;
 
-            i = Select(MaxClients, &LastSelectMask, NULL, NULL, wt);
+            i = ospoll_wait(server_poll, timeout);
 
             {
                 static CARD32 last = 0;
@@ -239,203 +237,263 @@ WaitForSomething(int *pClientsReady, int *(ProcFlush)(void))
                 }
             }
         }
-        selecterr = GetErrno();
+        pollerr = GetErrno();
         WakeupHandler(i, (void *) &LastSelectMask);
         if (i <= 0) {           /* An error or timeout occurred */
             if (dispatchException)
-                return 0;
+                return FALSE;
             if (i < 0) {
-                if (selecterr == EBADF) {       /* Some client disconnected */
-                    CheckConnections();
-                    if (!XFD_ANYSET(&AllClients))
-                        return 0;
-                }
-                else if (selecterr == EINVAL) {
-                    FatalError("WaitForSomething(): select: %s\n",
-                               strerror(selecterr));
+                if (pollerr == EINVAL) {
+                    FatalError("WaitForSomething(): poll: %s\n",
+                               strerror(pollerr));
                 }
-                else if (selecterr != EINTR && selecterr != EAGAIN) {
-                    ErrorF("WaitForSomething(): select: %s\n",
-                           strerror(selecterr));
+                else if (pollerr != EINTR && pollerr != EAGAIN) {
+                    ErrorF("WaitForSomething(): poll: %s\n",
+                           strerror(pollerr));
                 }
             }
-            else if (someReady) {
-                /*
-                 * If no-one else is home, bail quickly
-                 */
-                XFD_COPYSET(&ClientsWithInput, &LastSelectMask);
-                XFD_COPYSET(&ClientsWithInput, &clientsReadable);
-                break;
-            }
-            if (*checkForInput[0] != *checkForInput[1])
-                return 0;
-
-            if (timers) {
-                int expired = 0;
+        }
+        are_ready = clients_are_ready();
 
+        if (*checkForInput[0] == *checkForInput[1]) {
+            if (timer_wheel.count) {
                 now = GetTimeInMillis();
-                if ((int) (timers->expires - now) <= 0)
-                    expired = 1;
+                if (TimerRun(now))
+                    return FALSE;
+            }
+        }
 
-                if (expired) {
-                    OsBlockSignals();
-                    while (timers && (int) (timers->expires - now) <= 0)
-                        DoTimer(timers, now, &timers);
-                    OsReleaseSignals();
+        /* check here for DDXes that queue events during Block/Wakeup */
+        if (*checkForInput[0] != *checkForInput[1])
+            return FALSE;
 
-                    return 0;
-                }
-            }
+        if (are_ready) {
+            were_ready = TRUE;
+            if (!timer_is_running)
+                SmartScheduleStartTimer();
+            return TRUE;
         }
-        else {
-            fd_set tmp_set;
 
-            if (*checkForInput[0] == *checkForInput[1]) {
-                if (timers) {
-                    int expired = 0;
+        XFD_ANDSET(&devicesReadable, &LastSelectMask, &EnabledDevices);
+        if (XFD_ANYSET(&devicesReadable))
+            return FALSE;
+    }
+}
 
-                    now = GetTimeInMillis();
-                    if ((int) (timers->expires - now) <= 0)
-                        expired = 1;
+static void
+TimerWheelInit(void)
+{
+    int level, slot;
 
-                    if (expired) {
-                        OsBlockSignals();
-                        while (timers && (int) (timers->expires - now) <= 0)
-                            DoTimer(timers, now, &timers);
-                        OsReleaseSignals();
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++)
+            xorg_list_init(&timer_wheel.slots[level][slot]);
+        timer_wheel.pending[level] = 0;
+    }
+    timer_wheel.count = 0;
+    timer_wheel.last = GetTimeInMillis();
+    timer_wheel.now = timer_wheel.last;
+    timer_wheel.clock = timer_wheel.now + 1;
+    timer_wheel.initialized = TRUE;
+}
 
-                        return 0;
-                    }
-                }
-            }
-            if (someReady)
-                XFD_ORSET(&LastSelectMask, &ClientsWithInput, &LastSelectMask);
-            if (AnyWritesPending) {
-                XFD_ANDSET(&clientsWritable, &LastSelectWriteMask, &ClientsWriteBlocked);
-                if (XFD_ANYSET(&clientsWritable)) {
-                    NewOutputPending = TRUE;
-                    XFD_ORSET(&OutputPending, &clientsWritable, &OutputPending);
-                    XFD_UNSET(&ClientsWriteBlocked, &clientsWritable);
-                    if (!XFD_ANYSET(&ClientsWriteBlocked) && NumNotifyWriteFd == 0)
-                        AnyWritesPending = FALSE;
-                }
-                if (NumNotifyWriteFd != 0) {
-                    XFD_ANDSET(&tmp_set, &LastSelectWriteMask, &NotifyWriteFds);
-                    if (XFD_ANYSET(&tmp_set))
-                        someNotifyWriteReady = TRUE;
-                }
-            }
+/* Extend a GetTimeInMillis value to the wheel's 64-bit clock */
+static CARD64
+TimerClock(CARD32 now)
+{
+    INT32 delta = now - timer_wheel.last;
 
-            XFD_ANDSET(&devicesReadable, &LastSelectMask, &EnabledDevices);
-            XFD_ANDSET(&clientsReadable, &LastSelectMask, &AllClients);
+    if (!timer_wheel.initialized)
+        TimerWheelInit();
 
-            XFD_ANDSET(&tmp_set, &LastSelectMask, &NotifyReadFds);
-            if (XFD_ANYSET(&tmp_set) || someNotifyWriteReady)
-                HandleNotifyFds();
+    timer_wheel.last = now;
+    if (delta > 0)
+        timer_wheel.now += delta;
+    return timer_wheel.now;
+}
 
-            if (XFD_ANYSET(&devicesReadable) || XFD_ANYSET(&clientsReadable))
-                break;
-            /* check here for DDXes that queue events during Block/Wakeup */
-            if (*checkForInput[0] != *checkForInput[1])
-                return 0;
-        }
-    }
+static void
+TimerInsert(OsTimerPtr timer)
+{
+    CARD64 expires = timer->expires;
+    CARD64 ticks;
+    int level, slot;
+
+    if (expires < timer_wheel.clock)
+        expires = timer_wheel.clock;
+    ticks = expires - timer_wheel.clock;
 
-    nready = 0;
-    if (XFD_ANYSET(&clientsReadable)) {
-#ifndef WIN32
-        for (i = 0; i < howmany(XFD_SETSIZE, NFDBITS); i++) {
-            int highest_priority = 0;
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++)
+        if (ticks < (CARD64) 1 << (TIMER_WHEEL_BITS * (level + 1)))
+            break;
+    /* Beyond the top level; park it in the furthest slot and let the
+     * cascade place it again later */
+    if (ticks >= (CARD64) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+        expires = timer_wheel.clock +
+            ((CARD64) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+    slot = (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer->level = level;
+    timer->slot = slot;
+    xorg_list_append(&timer->list, &timer_wheel.slots[level][slot]);
+    timer_wheel.pending[level] |= (CARD64) 1 << slot;
+    timer_wheel.count++;
+}
 
-            while (clientsReadable.fds_bits[i]) {
-                int client_priority, client_index;
+static void
+TimerRemove(OsTimerPtr timer)
+{
+    xorg_list_del(&timer->list);
+    if (xorg_list_is_empty(&timer_wheel.slots[timer->level][timer->slot]))
+        timer_wheel.pending[timer->level] &= ~((CARD64) 1 << timer->slot);
+    timer_wheel.count--;
+}
 
-                curclient = mffs(clientsReadable.fds_bits[i]) - 1;
-                client_index =  /* raphael: modified */
-                    ConnectionTranslation[curclient +
-                                          (i * (sizeof(fd_mask) * 8))];
-#else
-        int highest_priority = 0;
-        fd_set savedClientsReadable;
+static inline Bool
+TimerArmed(OsTimerPtr timer)
+{
+    return !xorg_list_is_empty(&timer->list);
+}
 
-        XFD_COPYSET(&clientsReadable, &savedClientsReadable);
-        for (i = 0; i < XFD_SETCOUNT(&savedClientsReadable); i++) {
-            int client_priority, client_index;
+/* Move the slot of the given level that starts at the wheel clock down
+ * to the lower levels */
+static void
+TimerCascade(int level)
+{
+    int slot = (timer_wheel.clock >> (TIMER_WHEEL_BITS * level)) &
+        TIMER_WHEEL_MASK;
+    struct xorg_list *head = &timer_wheel.slots[level][slot];
+    struct xorg_list list;
+    OsTimerPtr timer, tmp;
 
-            curclient = XFD_FD(&savedClientsReadable, i);
-            client_index = GetConnectionTranslation(curclient);
-#endif
-            /*  We implement "strict" priorities.
-             *  Only the highest priority client is returned to
-             *  dix.  If multiple clients at the same priority are
-             *  ready, they are all returned.  This means that an
-             *  aggressive client could take over the server.
-             *  This was not considered a big problem because
-             *  aggressive clients can hose the server in so many
-             *  other ways :)
-             */
-            client_priority = clients[client_index]->priority;
-            if (nready == 0 || client_priority > highest_priority) {
-                /*  Either we found the first client, or we found
-                 *  a client whose priority is greater than all others
-                 *  that have been found so far.  Either way, we want
-                 *  to initialize the list of clients to contain just
-                 *  this client.
-                 */
-                pClientsReady[0] = client_index;
-                highest_priority = client_priority;
-                nready = 1;
-            }
-            /*  the following if makes sure that multiple same-priority
-             *  clients get batched together
-             */
-            else if (client_priority == highest_priority) {
-                pClientsReady[nready++] = client_index;
-            }
-#ifndef WIN32
-            clientsReadable.fds_bits[i] &= ~(((fd_mask) 1L) << curclient);
-        }
-#else
-            FD_CLR(curclient, &clientsReadable);
-#endif
-        }
+    if (slot == 0 && level < TIMER_WHEEL_LEVELS - 1)
+        TimerCascade(level + 1);
+
+    if (xorg_list_is_empty(head))
+        return;
+
+    xorg_list_init(&list);
+    xorg_list_append(&list, head);
+    xorg_list_del(head);
+    xorg_list_init(head);
+    timer_wheel.pending[level] &= ~((CARD64) 1 << slot);
+
+    xorg_list_for_each_entry_safe(timer, tmp, &list, list) {
+        xorg_list_del(&timer->list);
+        timer_wheel.count--;
+        TimerInsert(timer);
     }
+}
 
-    if (nready)
-        SmartScheduleStartTimer();
+/* Offset of the first pending slot after the one at 'from' in a
+ * rotating 64-slot bitmap, 1 .. 64.  Callers only ask when some slot
+ * is pending, and rotating keeps that bit, so rotated is never 0. */
+static int
+TimerNextSlot(CARD64 pending, int from)
+{
+    CARD64 rotated;
+
+    from = (from + 1) & TIMER_WHEEL_MASK;
+    rotated = from ? (pending >> from) | (pending << (TIMER_WHEEL_SIZE - from))
+                   : pending;
+    assert(rotated != 0);
+    if ((CARD32) rotated)
+        return ffs((CARD32) rotated);
+    return ffs(rotated >> 32) + 32;
+}
 
-    return nready;
+/* Earliest time the wheel has to run again.  Exact for timers in level
+ * 0; for the other levels it is when their next slot is cascaded. */
+static CARD64
+TimerNextExpiry(void)
+{
+    CARD64 next = ~(CARD64) 0;
+    CARD64 base;
+    int level, index;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!timer_wheel.pending[level])
+            continue;
+        base = timer_wheel.clock >> (TIMER_WHEEL_BITS * level);
+        index = base & TIMER_WHEEL_MASK;
+        /* The current slot is still due if the clock has not moved past
+         * its start yet */
+        if ((timer_wheel.pending[level] & ((CARD64) 1 << index)) &&
+            (base << (TIMER_WHEEL_BITS * level)) == timer_wheel.clock)
+            return timer_wheel.clock;
+        base += TimerNextSlot(timer_wheel.pending[level], index);
+        base <<= TIMER_WHEEL_BITS * level;
+        if (base < next)
+            next = base;
+    }
+    return next;
 }
 
-/* If time has rewound, re-run every affected timer.
- * Timers might drop out of the list, so we have to restart every time. */
-static void
-CheckAllTimers(void)
+/* Milliseconds until the next timer expires */
+static INT32
+TimerTimeout(CARD32 now)
+{
+    CARD64 clock = TimerClock(now);
+    CARD64 next = TimerNextExpiry();
+
+    if (next <= clock)
+        return 0;
+    if (next - clock > INT32_MAX)
+        return INT32_MAX;
+    return next - clock;
+}
+
+/* Run every timer due at 'now'; returns whether any was */
+static Bool
+TimerRun(CARD32 now)
 {
-    OsTimerPtr timer;
-    CARD32 now;
+    CARD64 clock = TimerClock(now);
+    struct xorg_list *head;
+    Bool ran = FALSE;
+    int index, skip;
 
     OsBlockSignals();
- start:
-    now = GetTimeInMillis();
+    while (timer_wheel.clock <= clock) {
+        if (!timer_wheel.count) {
+            timer_wheel.clock = clock + 1;
+            break;
+        }
+
+        index = timer_wheel.clock & TIMER_WHEEL_MASK;
+        if (index == 0)
+            TimerCascade(1);
+
+        head = &timer_wheel.slots[0][index];
+        while (!xorg_list_is_empty(head)) {
+            DoTimer(xorg_list_first_entry(head, struct _OsTimerRec, list),
+                    now);
+            ran = TRUE;
+        }
+
+        /* Skip the empty slots up to the next one or the next cascade */
+        skip = TIMER_WHEEL_SIZE - index;
+        if (timer_wheel.pending[0]) {
+            int next = TimerNextSlot(timer_wheel.pending[0], index);
 
-    for (timer = timers; timer; timer = timer->next) {
-        if (timer->expires - now > timer->delta + 250) {
-            TimerForce(timer);
-            goto start;
+            if (next < skip)
+                skip = next;
         }
+        timer_wheel.clock += skip;
+        if (timer_wheel.clock > clock + 1)
+            timer_wheel.clock = clock + 1;
     }
     OsReleaseSignals();
+    return ran;
 }
 
 static void
-DoTimer(OsTimerPtr timer, CARD32 now, volatile OsTimerPtr *prev)
+DoTimer(OsTimerPtr timer, CARD32 now)
 {
     CARD32 newTime;
 
     OsBlockSignals();
-    *prev = timer->next;
-    timer->next = NULL;
+    TimerRemove(timer);
+    xorg_list_init(&timer->list);
     OsReleaseSignals();
 
     newTime = (*timer->callback) (timer, now, timer->arg);
@@ -447,50 +505,44 @@ OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    volatile OsTimerPtr *prev;
     CARD32 now = GetTimeInMillis();
+    CARD64 clock = TimerClock(now);
 
     if (!timer) {
         timer = malloc(sizeof(struct _OsTimerRec));
         if (!timer)
             return NULL;
+        xorg_list_init(&timer->list);
     }
     else {
         OsBlockSignals();
-        for (prev = &timers; *prev; prev = &(*prev)->next) {
-            if (*prev == timer) {
-                *prev = timer->next;
-                if (flags & TimerForceOld)
-                    (void) (*timer->callback) (timer, now, timer->arg);
-                break;
-            }
+        if (TimerArmed(timer)) {
+            TimerRemove(timer);
+            xorg_list_init(&timer->list);
+            if (flags & TimerForceOld)
+                (void) (*timer->callback) (timer, now, timer->arg);
         }
         OsReleaseSignals();
     }
     if (!millis)
         return timer;
     if (flags & TimerAbsolute) {
-        timer->delta = millis - now;
-    }
-    else {
-        timer->delta = millis;
-        millis += now;
+        INT32 delta = millis - now;
+
+        timer->expires = delta > 0 ? clock + delta : clock;
     }
-    timer->expires = millis;
+    else
+        timer->expires = clock + millis;
     timer->callback = func;
     timer->arg = arg;
-    if ((int) (millis - now) <= 0) {
-        timer->next = NULL;
+    if (timer->expires <= clock) {
         millis = (*timer->callback) (timer, now, timer->arg);
         if (!millis)
             return timer;
+        timer->expires = clock + millis;
     }
     OsBlockSignals();
-    for (prev = &timers;
-         *prev && (int) ((*prev)->expires - millis) <= 0;
-         prev = &(*prev)->next);
-    timer->next = *prev;
-    *prev = timer;
+    TimerInsert(timer);
     OsReleaseSignals();
     return timer;
 }
@@ -499,15 +551,11 @@ Bool
 TimerForce(OsTimerPtr timer)
 {
     int rc = FALSE;
-    volatile OsTimerPtr *prev;
 
     OsBlockSignals();
-    for (prev = &timers; *prev; prev = &(*prev)->next) {
-        if (*prev == timer) {
-            DoTimer(timer, GetTimeInMillis(), prev);
-            rc = TRUE;
-            break;
-        }
+    if (TimerArmed(timer)) {
+        DoTimer(timer, GetTimeInMillis());
+        rc = TRUE;
     }
     OsReleaseSignals();
     return rc;
@@ -516,16 +564,12 @@ TimerForce(OsTimerPtr timer)
 void
 TimerCancel(OsTimerPtr timer)
 {
-    volatile OsTimerPtr *prev;
-
     if (!timer)
         return;
     OsBlockSignals();
-    for (prev = &timers; *prev; prev = &(*prev)->next) {
-        if (*prev == timer) {
-            *prev = timer->next;
-            break;
-        }
+    if (TimerArmed(timer)) {
+        TimerRemove(timer);
+        xorg_list_init(&timer->list);
     }
     OsReleaseSignals();
 }
@@ -542,25 +586,29 @@ TimerFree(OsTimerPtr timer)
 void
 TimerCheck(void)
 {
-    CARD32 now = GetTimeInMillis();
-
-    if (timers && (int) (timers->expires - now) <= 0) {
-        OsBlockSignals();
-        while (timers && (int) (timers->expires - now) <= 0)
-            DoTimer(timers, now, &timers);
-        OsReleaseSignals();
-    }
+    if (timer_wheel.count)
+        TimerRun(GetTimeInMillis());
 }
 
 void
 TimerInit(void)
 {
-    OsTimerPtr timer;
-
-    while ((timer = timers)) {
-        timers = timer->next;
-        free(timer);
+    OsTimerPtr timer, tmp;
+    int level, slot;
+
+    if (timer_wheel.initialized) {
+        for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++) {
+                xorg_list_for_each_entry_safe(timer, tmp,
+                                              &timer_wheel.slots[level][slot],
+                                              list) {
+                    xorg_list_del(&timer->list);
+                    free(timer);
+                }
+            }
+        }
     }
+    TimerWheelInit();
 }
 
 #ifdef DPMSExtension
@@ -53,10 +53,9 @@ SOFTWARE.
  *
  *      (WaitForSomething is in its own file)
  *
- *      In this implementation, a client socket table is not kept.
- *      Instead, what would be the index into the table is just the
- *      file descriptor of the socket.  This won't work for if the
- *      socket ids aren't small nums (0 - 2^8)
+ *      Client connections are registered with server_poll (see ospoll.c)
+ *      and report readiness through ClientReady, which puts the client
+ *      on the ready_clients list; no per-fd masks are kept for them.
  *
  *****************************************************************/
 
@@ -99,6 +98,7 @@ SOFTWARE.
 #endif
 
 #include <sys/uio.h>
+#include <poll.h>
 
 #endif                          /* WIN32 */
 #include "misc.h"               /* for typedef of pointer */
@@ -121,20 +121,12 @@ SOFTWARE.
 
 static int lastfdesc;           /* maximum file descriptor */
 
+struct ospoll *server_poll;
+
 fd_set EnabledDevices;          /* mask for input devices that are on */
-fd_set NotifyReadFds;           /* mask for other file descriptors */
-fd_set NotifyWriteFds;          /* mask for other write file descriptors */
-fd_set AllSockets;              /* select on this */
-fd_set AllClients;              /* available clients */
-fd_set LastSelectMask;          /* mask returned from last select call */
-fd_set LastSelectWriteMask;     /* mask returned from last select call */
-fd_set ClientsWithInput;        /* clients with FULL requests in buffer */
-fd_set ClientsWriteBlocked;     /* clients who cannot receive output */
-fd_set OutputPending;           /* clients with reply/event data ready to go */
+fd_set LastSelectMask;          /* legacy fds ready after the last poll */
 int MaxClients = 0;
-int NumNotifyWriteFd;           /* Number of NotifyFd members with write set */
 Bool NewOutputPending;          /* not yet attempted to write some new output */
-Bool AnyWritesPending;          /* true if some client blocked on write or NotifyFd with write */
 Bool NoListenAll;               /* Don't establish any listening sockets */
 
 static Bool RunFromSmartParent; /* send SIGUSR1 to parent process */
@@ -146,11 +138,6 @@ static Pid_t ParentProcess;
 
 static Bool debug_conns = FALSE;
 
-fd_set IgnoredClientsWithInput;
-static fd_set GrabImperviousClients;
-static fd_set SavedAllClients;
-static fd_set SavedAllSockets;
-static fd_set SavedClientsWithInput;
 int GrabInProgress = 0;
 
 static void
@@ -168,8 +155,6 @@ int *ConnectionTranslation = NULL;
 
 #undef MAXSOCKS
 #define MAXSOCKS 512
-#undef MAXSELECT
-#define MAXSELECT 512
 
 struct _ct_node {
     struct _ct_node *next;
@@ -299,9 +284,6 @@ InitConnectionLimits(void)
     if (lastfdesc < 0)
         lastfdesc = MAXSOCKS;
 
-    if (lastfdesc > MAXSELECT)
-        lastfdesc = MAXSELECT;
-
     if (lastfdesc > MAXCLIENTS) {
         lastfdesc = MAXCLIENTS;
         if (debug_conns)
@@ -319,6 +301,11 @@ InitConnectionLimits(void)
 #else
     InitConnectionTranslation();
 #endif
+
+    if (!server_poll)
+        server_poll = ospoll_create();
+    if (!server_poll)
+        FatalError("failed to allocate poll structure");
 }
 
 /*
@@ -393,10 +380,7 @@ CreateWellKnownSockets(void)
     int i;
     int partial;
 
-    FD_ZERO(&AllSockets);
-    FD_ZERO(&AllClients);
     FD_ZERO(&LastSelectMask);
-    FD_ZERO(&ClientsWithInput);
 
 #if !defined(WIN32)
     for (i = 0; i < MaxClients; i++)
@@ -497,6 +481,7 @@ ResetWellKnownSockets(void)
 
                 int newfd = _XSERVTransGetConnectionNumber(ListenTransConns[i]);
 
+                RemoveNotifyFd(ListenTransFds[i]);
                 ListenTransFds[i] = newfd;
             }
         }
@@ -521,10 +506,10 @@ CloseWellKnownConnections(void)
 
     for (i = 0; i < ListenTransCount; i++) {
         if (ListenTransConns[i] != NULL) {
-            _XSERVTransClose(ListenTransConns[i]);
-            ListenTransConns[i] = NULL;
             if (ListenTransFds != NULL)
                 RemoveNotifyFd(ListenTransFds[i]);
+            _XSERVTransClose(ListenTransConns[i]);
+            ListenTransConns[i] = NULL;
         }
     }
     ListenTransCount = 0;
@@ -752,6 +737,99 @@ ClientAuthorized(ClientPtr client,
     return ((char *) NULL);
 }
 
+/*
+ * Called from ospoll_wait when a client connection has something
+ * to report.  Readable clients are queued for the dispatcher,
+ * writable ones have their pending output flushed at the next
+ * opportunity.
+ */
+static void
+ClientReady(int fd, int xevents, void *data)
+{
+    ClientPtr client = data;
+
+    if (xevents & X_NOTIFY_ERROR) {
+        /* Errors on a client which is not being listened to will
+         * be reported again once it is listened to */
+        if (!listen_to_client(client))
+            return;
+        xevents |= X_NOTIFY_READ;
+    }
+    if (xevents & X_NOTIFY_READ)
+        mark_client_ready(client);
+    if (xevents & X_NOTIFY_WRITE) {
+        ospoll_mute(server_poll, fd, X_NOTIFY_WRITE);
+        output_pending_mark(client);
+        NewOutputPending = TRUE;
+    }
+}
+
+/*
+ * Whether requests from this client may be processed right now,
+ * taking server grabs and IgnoreClient into account.
+ */
+Bool
+listen_to_client(ClientPtr client)
+{
+    OsCommPtr oc = (OsCommPtr) client->osPrivate;
+
+    if (oc->flags & OS_COMM_IGNORED)
+        return FALSE;
+
+    if (!GrabInProgress)
+        return TRUE;
+
+    if (client->index == GrabInProgress)
+        return TRUE;
+
+    if (oc->flags & OS_COMM_GRAB_IMPERVIOUS)
+        return TRUE;
+
+    return FALSE;
+}
+
+static void
+set_poll_client(ClientPtr client)
+{
+    OsCommPtr oc = (OsCommPtr) client->osPrivate;
+
+    if (oc->trans_conn) {
+        if (listen_to_client(client))
+            ospoll_listen(server_poll, oc->fd, X_NOTIFY_READ);
+        else
+            ospoll_mute(server_poll, oc->fd, X_NOTIFY_READ);
+    }
+}
+
+/*
+ * Recompute the poll state of every client after a change in the
+ * server grab, moving ready clients between ready_clients and
+ * saved_ready_clients as required.
+ */
+static void
+set_poll_clients(void)
+{
+    ClientPtr client, tmp;
+    int i;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        client = clients[i];
+        if (client && !client->clientGone)
+            set_poll_client(client);
+    }
+
+    xorg_list_for_each_entry_safe(client, tmp, &ready_clients, ready) {
+        if (!listen_to_client(client))
+            mark_client_saved_ready(client);
+    }
+    xorg_list_for_each_entry_safe(client, tmp, &saved_ready_clients, ready) {
+        if (listen_to_client(client)) {
+            mark_client_not_ready(client);
+            mark_client_ready(client);
+        }
+    }
+}
+
 static ClientPtr
 AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
 {
@@ -762,7 +840,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
 #ifndef WIN32
            fd >= lastfdesc
 #else
-           XFD_SETCOUNT(&AllClients) >= MaxClients
+           nClients >= MaxClients
 #endif
         )
         return NullClient;
@@ -775,6 +853,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     oc->output = (ConnectionOutputPtr) NULL;
     oc->auth_id = None;
     oc->conn_time = conn_time;
+    oc->flags = 0;
     if (!(client = NextAvailableClient((void *) oc))) {
         free(oc);
         return NullClient;
@@ -785,14 +864,11 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
 #else
     SetConnectionTranslation(fd, client->index);
 #endif
-    if (GrabInProgress) {
-        FD_SET(fd, &SavedAllClients);
-        FD_SET(fd, &SavedAllSockets);
-    }
-    else {
-        FD_SET(fd, &AllClients);
-        FD_SET(fd, &AllSockets);
-    }
+    ospoll_add(server_poll, fd,
+               ospoll_trigger_edge,
+               ClientReady,
+               client);
+    set_poll_client(client);
 
 #ifdef DEBUG
     ErrorF("AllocNewConnection: client index = %d, socket fd = %d\n",
@@ -808,8 +884,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
 /*****************
  * EstablishNewConnections
  *    If anyone is waiting on listened sockets, accept them.
- *    Returns a mask with indices of new clients.  Updates AllClients
- *    and AllSockets.
+ *    Registers each accepted connection with server_poll.
  *****************/
 
 static Bool
@@ -892,16 +967,13 @@ ErrorConnMax(XtransConnInfo trans_conn)
     struct iovec iov[3];
     char order = 0;
     int whichbyte = 1;
-    struct timeval waittime;
-    fd_set mask;
+    struct pollfd pfd;
 
     /* if these seems like a lot of trouble to go to, it probably is */
-    waittime.tv_sec = BOTIMEOUT / MILLI_PER_SECOND;
-    waittime.tv_usec = (BOTIMEOUT % MILLI_PER_SECOND) *
-        (1000000 / MILLI_PER_SECOND);
-    FD_ZERO(&mask);
-    FD_SET(fd, &mask);
-    (void) Select(fd + 1, &mask, NULL, NULL, &waittime);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    (void) poll(&pfd, 1, BOTIMEOUT);
     /* try to read the byte-order of the connection */
     (void) _XSERVTransRead(trans_conn, &order, 1);
     if (order == 'l' || order == 'B' || order == 'r' || order == 'R') {
@@ -937,6 +1009,7 @@ CloseDownFileDescriptor(OsCommPtr oc)
     int connection = oc->fd;
 
     if (oc->trans_conn) {
+        ospoll_remove(server_poll, connection);
         _XSERVTransDisconnect(oc->trans_conn);
         _XSERVTransClose(oc->trans_conn);
     }
@@ -945,85 +1018,44 @@ CloseDownFileDescriptor(OsCommPtr oc)
 #else
     SetConnectionTranslation(connection, 0);
 #endif
-    FD_CLR(connection, &AllSockets);
-    FD_CLR(connection, &AllClients);
-    FD_CLR(connection, &ClientsWithInput);
-    FD_CLR(connection, &GrabImperviousClients);
-    if (GrabInProgress) {
-        FD_CLR(connection, &SavedAllSockets);
-        FD_CLR(connection, &SavedAllClients);
-        FD_CLR(connection, &SavedClientsWithInput);
-    }
-    FD_CLR(connection, &ClientsWriteBlocked);
-    if (!XFD_ANYSET(&ClientsWriteBlocked) && NumNotifyWriteFd == 0)
-        AnyWritesPending = FALSE;
-    FD_CLR(connection, &OutputPending);
 }
 
 /*****************
  * CheckConnections
  *    Some connection has died, go find which one and shut it down
- *    The file descriptor has been closed, but is still in AllClients.
- *    If would truly be wonderful if select() would put the bogus
- *    file descriptors in the exception mask, but nooooo.  So we have
- *    to check each and every socket individually.
+ *    The file descriptor has been closed, but is still registered.
+ *    Poll each client socket individually and close down any
+ *    whose descriptor is reported as invalid.
  *****************/
 
 void
 CheckConnections(void)
 {
-#ifndef WIN32
-    fd_mask mask;
-#endif
-    fd_set tmask;
-    int curclient, curoff;
     int i;
-    struct timeval notime;
     int r;
 
-#ifdef WIN32
-    fd_set savedAllClients;
-#endif
+    for (i = 1; i < currentMaxClients; i++) {
+        ClientPtr client = clients[i];
+        if (client && !client->clientGone) {
+            OsCommPtr           oc = (OsCommPtr) client->osPrivate;
+            struct pollfd       poll_fd;
 
-    notime.tv_sec = 0;
-    notime.tv_usec = 0;
+            poll_fd.fd = oc->fd;
+            poll_fd.events = POLLIN|POLLOUT;
+            poll_fd.revents = 0;
 
-#ifndef WIN32
-    for (i = 0; i < howmany(XFD_SETSIZE, NFDBITS); i++) {
-        mask = AllClients.fds_bits[i];
-        while (mask) {
-            curoff = mffs(mask) - 1;
-            curclient = curoff + (i * (sizeof(fd_mask) * 8));
-            FD_ZERO(&tmask);
-            FD_SET(curclient, &tmask);
             do {
-                r = Select(curclient + 1, &tmask, NULL, NULL, &notime);
+                r = poll(&poll_fd, 1, 0);
             } while (r < 0 && (errno == EINTR || errno == EAGAIN));
-            if (r < 0)
-                if (ConnectionTranslation[curclient] > 0)
-                    CloseDownClient(clients[ConnectionTranslation[curclient]]);
-            mask &= ~((fd_mask) 1 << curoff);
+            if (r < 0 || (poll_fd.revents & POLLNVAL))
+                CloseDownClient(client);
         }
     }
-#else
-    XFD_COPYSET(&AllClients, &savedAllClients);
-    for (i = 0; i < XFD_SETCOUNT(&savedAllClients); i++) {
-        curclient = XFD_FD(&savedAllClients, i);
-        FD_ZERO(&tmask);
-        FD_SET(curclient, &tmask);
-        do {
-            r = Select(curclient + 1, &tmask, NULL, NULL, &notime);
-        } while (r < 0 && (errno == EINTR || errno == EAGAIN));
-        if (r < 0)
-            if (GetConnectionTranslation(curclient) > 0)
-                CloseDownClient(clients[GetConnectionTranslation(curclient)]);
-    }
-#endif
 }
 
 /*****************
  * CloseDownConnection
- *    Delete client from AllClients and free resources
+ *    Stop polling the client's connection and free resources
  *****************/
 
 void
@@ -1039,6 +1071,8 @@ CloseDownConnection(ClientPtr client)
 #ifdef XDMCP
     XdmcpCloseDisplay(oc->fd);
 #endif
+    mark_client_not_ready(client);
+    output_pending_clear(client);
     CloseDownFileDescriptor(oc);
     FreeOsBuffers(oc);
     free(client->osPrivate);
@@ -1047,12 +1081,24 @@ CloseDownConnection(ClientPtr client)
         AuditF("client %d disconnected\n", client->index);
 }
 
+/*
+ * Descriptors registered through the legacy AddGeneralSocket
+ * interface are reported to block and wakeup handlers by setting
+ * them in LastSelectMask.
+ */
+static void
+HandleGeneralSocket(int fd, int xevents, void *data)
+{
+    if (fd < FD_SETSIZE)
+        FD_SET(fd, &LastSelectMask);
+}
+
 void
 AddGeneralSocket(int fd)
 {
-    FD_SET(fd, &AllSockets);
-    if (GrabInProgress)
-        FD_SET(fd, &SavedAllSockets);
+    if (ospoll_add(server_poll, fd, ospoll_trigger_level,
+                   HandleGeneralSocket, NULL))
+        ospoll_listen(server_poll, fd, X_NOTIFY_READ);
 }
 
 void
@@ -1065,9 +1111,7 @@ AddEnabledDevice(int fd)
 void
 RemoveGeneralSocket(int fd)
 {
-    FD_CLR(fd, &AllSockets);
-    if (GrabInProgress)
-        FD_CLR(fd, &SavedAllSockets);
+    ospoll_remove(server_poll, fd);
 }
 
 void
@@ -1098,10 +1142,17 @@ InitNotifyFds(void)
             RemoveNotifyFd(s->fd);
 
     xorg_list_init(&notify_fds);
-    NumNotifyWriteFd = 0;
     been_here = 1;
 }
 
+static void
+HandleNotifyFd(int fd, int xevents, void *data)
+{
+    struct notify_fd *n = data;
+
+    n->notify(n->fd, xevents, n->data);
+}
+
 /*****************
  * SetNotifyFd
  *    Registers a callback to be invoked when the specified
@@ -1125,36 +1176,24 @@ SetNotifyFd(int fd, NotifyFdProcPtr notify, int mask, void *data)
         n = calloc(1, sizeof (struct notify_fd));
         if (!n)
             return FALSE;
+        if (!ospoll_add(server_poll, fd, ospoll_trigger_level,
+                        HandleNotifyFd, n)) {
+            free(n);
+            return FALSE;
+        }
         n->fd = fd;
         xorg_list_add(&n->list, &notify_fds);
     }
 
     changes = n->mask ^ mask;
 
-    if (changes & X_NOTIFY_READ) {
-        if (mask & X_NOTIFY_READ) {
-            FD_SET(fd, &NotifyReadFds);
-            AddGeneralSocket(fd);
-        } else {
-            RemoveGeneralSocket(fd);
-            FD_CLR(fd, &NotifyReadFds);
-        }
-    }
-
-    if (changes & X_NOTIFY_WRITE) {
-        if (mask & X_NOTIFY_WRITE) {
-            FD_SET(fd, &NotifyWriteFds);
-            if (!NumNotifyWriteFd++)
-                AnyWritesPending = TRUE;
-        } else {
-            FD_CLR(fd, &NotifyWriteFds);
-            if (!--NumNotifyWriteFd)
-                if (!XFD_ANYSET(&ClientsWriteBlocked))
-                    AnyWritesPending = FALSE;
-        }
-    }
+    if (changes & mask)
+        ospoll_listen(server_poll, fd, changes & mask);
+    if (changes & n->mask)
+        ospoll_mute(server_poll, fd, changes & n->mask);
 
     if (mask == 0) {
+        ospoll_remove(server_poll, fd);
         xorg_list_del(&n->list);
         free(n);
     } else {
@@ -1166,34 +1205,12 @@ SetNotifyFd(int fd, NotifyFdProcPtr notify, int mask, void *data)
     return TRUE;
 }
 
-/*****************
- * HandlNotifyFds
- *    A WorkProc to be called when any of the registered
- *    file descriptors are readable.
- *****************/
-
-void
-HandleNotifyFds(void)
-{
-    struct notify_fd *n, *next;
-
-    xorg_list_for_each_entry_safe(n, next, &notify_fds, list) {
-        int ready = 0;
-        if ((n->mask & X_NOTIFY_READ) && FD_ISSET(n->fd, &LastSelectMask))
-            ready |= X_NOTIFY_READ;
-        if ((n->mask & X_NOTIFY_WRITE) & FD_ISSET(n->fd, &LastSelectWriteMask))
-            ready |= X_NOTIFY_WRITE;
-        if (ready != 0)
-            n->notify(n->fd, ready, n->data);
-    }
-}
-
 /*****************
  * OnlyListenToOneClient:
  *    Only accept requests from  one client.  Continue to handle new
  *    connections, but don't take any protocol requests from the new
- *    ones.  Note that if GrabInProgress is set, EstablishNewConnections
- *    needs to put new clients into SavedAllSockets and SavedAllClients.
+ *    ones.  Clients which are ready but may not run during the grab
+ *    are parked on saved_ready_clients.
  *    Note also that there is no timeout for this in the protocol.
  *    This routine is "undone" by ListenToAllClients()
  *****************/
@@ -1201,29 +1218,15 @@ HandleNotifyFds(void)
 int
 OnlyListenToOneClient(ClientPtr client)
 {
-    OsCommPtr oc = (OsCommPtr) client->osPrivate;
-    int rc, connection = oc->fd;
+    int rc;
 
     rc = XaceHook(XACE_SERVER_ACCESS, client, DixGrabAccess);
     if (rc != Success)
         return rc;
 
     if (!GrabInProgress) {
-        XFD_COPYSET(&ClientsWithInput, &SavedClientsWithInput);
-        XFD_ANDSET(&ClientsWithInput,
-                   &ClientsWithInput, &GrabImperviousClients);
-        if (FD_ISSET(connection, &SavedClientsWithInput)) {
-            FD_CLR(connection, &SavedClientsWithInput);
-            FD_SET(connection, &ClientsWithInput);
-        }
-        XFD_UNSET(&SavedClientsWithInput, &GrabImperviousClients);
-        XFD_COPYSET(&AllSockets, &SavedAllSockets);
-        XFD_COPYSET(&AllClients, &SavedAllClients);
-        XFD_UNSET(&AllSockets, &AllClients);
-        XFD_ANDSET(&AllClients, &AllClients, &GrabImperviousClients);
-        FD_SET(connection, &AllClients);
-        XFD_ORSET(&AllSockets, &AllSockets, &AllClients);
         GrabInProgress = client->index;
+        set_poll_clients();
     }
     return rc;
 }
@@ -1237,10 +1240,8 @@ void
 ListenToAllClients(void)
 {
     if (GrabInProgress) {
-        XFD_ORSET(&AllSockets, &AllSockets, &SavedAllSockets);
-        XFD_ORSET(&AllClients, &AllClients, &SavedAllClients);
-        XFD_ORSET(&ClientsWithInput, &ClientsWithInput, &SavedClientsWithInput);
         GrabInProgress = 0;
+        set_poll_clients();
     }
 }
 
@@ -1254,32 +1255,16 @@ void
 IgnoreClient(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
-    int connection = oc->fd;
 
     client->ignoreCount++;
     if (client->ignoreCount > 1)
         return;
 
     isItTimeToYield = TRUE;
-    if (!GrabInProgress || FD_ISSET(connection, &AllClients)) {
-        if (FD_ISSET(connection, &ClientsWithInput))
-            FD_SET(connection, &IgnoredClientsWithInput);
-        else
-            FD_CLR(connection, &IgnoredClientsWithInput);
-        FD_CLR(connection, &ClientsWithInput);
-        FD_CLR(connection, &AllSockets);
-        FD_CLR(connection, &AllClients);
-        FD_CLR(connection, &LastSelectMask);
-    }
-    else {
-        if (FD_ISSET(connection, &SavedClientsWithInput))
-            FD_SET(connection, &IgnoredClientsWithInput);
-        else
-            FD_CLR(connection, &IgnoredClientsWithInput);
-        FD_CLR(connection, &SavedClientsWithInput);
-        FD_CLR(connection, &SavedAllSockets);
-        FD_CLR(connection, &SavedAllClients);
-    }
+    mark_client_not_ready(client);
+
+    oc->flags |= OS_COMM_IGNORED;
+    set_poll_client(client);
 }
 
 /****************
@@ -1291,26 +1276,25 @@ void
 AttendClient(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
-    int connection = oc->fd;
+
+    if (client->clientGone) {
+        /*
+         * client is gone, so any pending requests will be dropped and its
+         * ignore count doesn't matter.
+         */
+        return;
+    }
 
     client->ignoreCount--;
     if (client->ignoreCount)
         return;
 
-    if (!GrabInProgress || GrabInProgress == client->index ||
-        FD_ISSET(connection, &GrabImperviousClients)) {
-        FD_SET(connection, &AllClients);
-        FD_SET(connection, &AllSockets);
-        FD_SET(connection, &LastSelectMask);
-        if (FD_ISSET(connection, &IgnoredClientsWithInput))
-            FD_SET(connection, &ClientsWithInput);
-    }
-    else {
-        FD_SET(connection, &SavedAllClients);
-        FD_SET(connection, &SavedAllSockets);
-        if (FD_ISSET(connection, &IgnoredClientsWithInput))
-            FD_SET(connection, &SavedClientsWithInput);
-    }
+    oc->flags &= ~OS_COMM_IGNORED;
+    set_poll_client(client);
+    if (listen_to_client(client))
+        mark_client_ready(client);
+    else
+        mark_client_saved_ready(client);
 }
 
 /* make client impervious to grabs; assume only executing client calls this */
@@ -1319,9 +1303,9 @@ void
 MakeClientGrabImpervious(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
-    int connection = oc->fd;
 
-    FD_SET(connection, &GrabImperviousClients);
+    oc->flags |= OS_COMM_GRAB_IMPERVIOUS;
+    set_poll_client(client);
 
     if (ServerGrabCallback) {
         ServerGrabInfoRec grabinfo;
@@ -1338,16 +1322,12 @@ void
 MakeClientGrabPervious(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
-    int connection = oc->fd;
 
-    FD_CLR(connection, &GrabImperviousClients);
+    oc->flags &= ~OS_COMM_GRAB_IMPERVIOUS;
+    set_poll_client(client);
     if (GrabInProgress && (GrabInProgress != client->index)) {
-        if (FD_ISSET(connection, &ClientsWithInput)) {
-            FD_SET(connection, &SavedClientsWithInput);
-            FD_CLR(connection, &ClientsWithInput);
-        }
-        FD_CLR(connection, &AllSockets);
-        FD_CLR(connection, &AllClients);
+        if (client_is_ready(client))
+            mark_client_saved_ready(client);
         isItTimeToYield = TRUE;
     }
 
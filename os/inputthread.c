@@ -0,0 +1,437 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Input thread
+ *
+ * Input devices registered with InputThreadRegisterDev are read from a
+ * dedicated thread instead of from SIGIO or the main loop, so events
+ * are queued (and the cursor moved) even while the main thread is busy
+ * dispatching.  The thread runs every device callback with the input
+ * lock held; the main thread takes the same lock through input_lock()
+ * or OsBlockSIGIO() whenever it touches state shared with the device
+ * callbacks.  The event queue itself is consumed without the lock.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <X11/Xpoll.h>
+#include "dix.h"
+#include "inputstr.h"
+#include "opaque.h"
+#include "osdep.h"
+#include "ospoll.h"
+#include "list.h"
+
+#ifdef INPUTTHREAD
+
+#include <pthread.h>
+
+Bool InputThreadEnable = TRUE;
+
+typedef enum _InputDeviceState {
+    device_state_added,
+    device_state_running,
+    device_state_removed
+} InputDeviceState;
+
+typedef struct _InputThreadDevice {
+    struct xorg_list node;
+    NotifyFdProcPtr readInputProc;
+    void *readInputArgs;
+    int fd;
+    InputDeviceState state;
+} InputThreadDevice;
+
+typedef struct {
+    pthread_t thread;
+    struct xorg_list devs;
+    struct ospoll *fds;
+    int readPipe;               /* wakes the input thread */
+    int writePipe;
+    Bool running;
+    Bool exiting;
+} InputThreadInfo;
+
+static InputThreadInfo *inputThreadInfo;
+
+/* Wakes the main thread when the input thread has queued events */
+static int mainWakePipeRead = -1;
+static int mainWakePipeWrite = -1;
+
+#ifdef PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+static pthread_mutex_t input_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+#else
+static pthread_mutex_t input_mutex;
+static pthread_once_t input_mutex_once = PTHREAD_ONCE_INIT;
+
+static void
+input_mutex_init(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&input_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+#endif
+
+void
+input_lock(void)
+{
+#ifndef PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+    pthread_once(&input_mutex_once, input_mutex_init);
+#endif
+    pthread_mutex_lock(&input_mutex);
+}
+
+void
+input_unlock(void)
+{
+    pthread_mutex_unlock(&input_mutex);
+}
+
+Bool
+in_input_thread(void)
+{
+    return inputThreadInfo && inputThreadInfo->running &&
+        pthread_equal(pthread_self(), inputThreadInfo->thread);
+}
+
+static void
+InputThreadFillPipe(int fd)
+{
+    int ret;
+    char byte = 0;
+
+    /* A full pipe already has a wakeup pending */
+    do {
+        ret = write(fd, &byte, 1);
+    } while (ret < 0 && errno == EINTR);
+}
+
+static void
+InputThreadReadPipe(int fd)
+{
+    char buf[64];
+    int ret;
+
+    do {
+        ret = read(fd, buf, sizeof(buf));
+    } while (ret == sizeof(buf) || (ret < 0 && errno == EINTR));
+}
+
+static Bool
+InputThreadMakePipe(int *readFd, int *writeFd)
+{
+    int fds[2];
+
+    if (pipe(fds) < 0)
+        return FALSE;
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    *readFd = fds[0];
+    *writeFd = fds[1];
+    return TRUE;
+}
+
+/* Main thread side of the wakeup pipe; the queued events are picked up
+ * by ProcessInputEvents once WaitForSomething returns. */
+static void
+InputThreadNotifyPipe(int fd, int ready, void *data)
+{
+    InputThreadReadPipe(fd);
+}
+
+static void
+InputReady(int fd, int xevents, void *data)
+{
+    InputThreadDevice *dev = data;
+
+    input_lock();
+    if (dev->state == device_state_running)
+        dev->readInputProc(fd, xevents, dev->readInputArgs);
+    input_unlock();
+}
+
+static void
+InputThreadPipeReady(int fd, int xevents, void *data)
+{
+    InputThreadReadPipe(fd);
+}
+
+/* Bring the thread's poll set in line with the device list.  Removals
+ * go first so a recycled fd number can be added again in the same pass. */
+static void
+InputThreadUpdateDevices(InputThreadInfo *info)
+{
+    InputThreadDevice *dev, *next;
+
+    input_lock();
+    xorg_list_for_each_entry_safe(dev, next, &info->devs, node) {
+        if (dev->state == device_state_removed) {
+            ospoll_remove(info->fds, dev->fd);
+            xorg_list_del(&dev->node);
+            free(dev);
+        }
+    }
+    xorg_list_for_each_entry(dev, &info->devs, node) {
+        if (dev->state == device_state_added) {
+            if (ospoll_add(info->fds, dev->fd, ospoll_trigger_level,
+                           InputReady, dev)) {
+                ospoll_listen(info->fds, dev->fd, X_NOTIFY_READ);
+                dev->state = device_state_running;
+            }
+            else
+                ErrorFSigSafe("input-thread: could not poll fd %d\n", dev->fd);
+        }
+    }
+    input_unlock();
+}
+
+static void *
+InputThreadDoWork(void *arg)
+{
+    InputThreadInfo *info = arg;
+
+    while (!info->exiting) {
+        InputThreadUpdateDevices(info);
+
+        if (ospoll_wait(info->fds, -1) < 0) {
+            if (errno != EINTR && errno != EAGAIN)
+                ErrorFSigSafe("input-thread: poll failed: %s\n",
+                              strerror(errno));
+            continue;
+        }
+
+        /* Let the main thread process whatever the callbacks queued */
+        if (*checkForInput[0] != *checkForInput[1])
+            InputThreadFillPipe(mainWakePipeWrite);
+    }
+
+    return NULL;
+}
+
+/**
+ * Set up the input thread state.  The thread itself is only started
+ * once the first device is registered, so servers without input
+ * devices of their own never pay for it.
+ */
+void
+InputThreadPreInit(void)
+{
+    InputThreadInfo *info;
+
+    if (!InputThreadEnable || inputThreadInfo)
+        return;
+
+    info = calloc(1, sizeof(InputThreadInfo));
+    if (!info)
+        FatalError("input-thread: could not allocate memory");
+
+    xorg_list_init(&info->devs);
+    info->fds = ospoll_create();
+    if (!info->fds)
+        FatalError("input-thread: could not create poll set");
+
+    if (!InputThreadMakePipe(&info->readPipe, &info->writePipe) ||
+        !InputThreadMakePipe(&mainWakePipeRead, &mainWakePipeWrite))
+        FatalError("input-thread: could not create pipe");
+
+    ospoll_add(info->fds, info->readPipe, ospoll_trigger_level,
+               InputThreadPipeReady, NULL);
+    ospoll_listen(info->fds, info->readPipe, X_NOTIFY_READ);
+
+    inputThreadInfo = info;
+}
+
+static void
+InputThreadStart(InputThreadInfo *info)
+{
+    sigset_t set, old;
+
+    /* Signals are handled on the main thread; the new thread inherits a
+     * fully blocked mask from the start. */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &old);
+    if (pthread_create(&info->thread, NULL, InputThreadDoWork, info) != 0)
+        FatalError("input-thread: could not start thread");
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    info->running = TRUE;
+}
+
+/**
+ * Hook the main thread up to the input thread's wakeups.  Called once
+ * per server generation, after the notify fds have been reset.
+ */
+void
+InputThreadInit(void)
+{
+    if (!inputThreadInfo)
+        return;
+
+    SetNotifyFd(mainWakePipeRead, InputThreadNotifyPipe, X_NOTIFY_READ, NULL);
+}
+
+/**
+ * Stop the input thread and release everything associated with it.
+ */
+void
+InputThreadFini(void)
+{
+    InputThreadInfo *info = inputThreadInfo;
+    InputThreadDevice *dev, *next;
+
+    if (!info)
+        return;
+
+    if (info->running) {
+        info->exiting = TRUE;
+        InputThreadFillPipe(info->writePipe);
+        pthread_join(info->thread, NULL);
+        info->running = FALSE;
+    }
+
+    xorg_list_for_each_entry_safe(dev, next, &info->devs, node) {
+        ospoll_remove(info->fds, dev->fd);
+        xorg_list_del(&dev->node);
+        free(dev);
+    }
+
+    RemoveNotifyFd(mainWakePipeRead);
+    close(info->readPipe);
+    close(info->writePipe);
+    close(mainWakePipeRead);
+    close(mainWakePipeWrite);
+    mainWakePipeRead = mainWakePipeWrite = -1;
+    ospoll_destroy(info->fds);
+
+    inputThreadInfo = NULL;
+    free(info);
+}
+
+/**
+ * Have the input thread call readInputProc whenever fd is readable.
+ * The callback runs with the input lock held.
+ *
+ * @return FALSE if the input thread is not in use; the caller is
+ *         expected to fall back to reading fd itself.
+ */
+Bool
+InputThreadRegisterDev(int fd, NotifyFdProcPtr readInputProc,
+                       void *readInputArgs)
+{
+    InputThreadInfo *info = inputThreadInfo;
+    InputThreadDevice *dev;
+
+    if (!info)
+        return FALSE;
+
+    dev = calloc(1, sizeof(InputThreadDevice));
+    if (!dev)
+        return FALSE;
+
+    dev->fd = fd;
+    dev->readInputProc = readInputProc;
+    dev->readInputArgs = readInputArgs;
+    dev->state = device_state_added;
+
+    input_lock();
+    xorg_list_append(&dev->node, &info->devs);
+    input_unlock();
+
+    if (!info->running)
+        InputThreadStart(info);
+    InputThreadFillPipe(info->writePipe);
+
+    return TRUE;
+}
+
+/**
+ * Stop reading fd from the input thread.  Once this returns the device
+ * callback is guaranteed not to run again, so the caller may close fd.
+ */
+Bool
+InputThreadUnregisterDev(int fd)
+{
+    InputThreadInfo *info = inputThreadInfo;
+    InputThreadDevice *dev;
+    Bool found = FALSE;
+
+    if (!info)
+        return FALSE;
+
+    input_lock();
+    xorg_list_for_each_entry(dev, &info->devs, node) {
+        if (dev->fd == fd && dev->state != device_state_removed) {
+            dev->state = device_state_removed;
+            found = TRUE;
+            break;
+        }
+    }
+    input_unlock();
+
+    if (found)
+        InputThreadFillPipe(info->writePipe);
+
+    return found;
+}
+
+#else                           /* INPUTTHREAD */
+
+Bool InputThreadEnable = FALSE;
+
+void input_lock(void) {}
+void input_unlock(void) {}
+Bool in_input_thread(void) { return FALSE; }
+
+void InputThreadPreInit(void) {}
+void InputThreadInit(void) {}
+void InputThreadFini(void) {}
+
+Bool
+InputThreadRegisterDev(int fd, NotifyFdProcPtr readInputProc,
+                       void *readInputArgs)
+{
+    return FALSE;
+}
+
+Bool
+InputThreadUnregisterDev(int fd)
+{
+    return FALSE;
+}
+
+#endif                          /* INPUTTHREAD */
@@ -92,13 +92,34 @@ typedef struct _connectionInput {
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
 } ConnectionInput;
 
+/*
+ * Output that could not be written immediately.  Small writes are
+ * gathered in buf; anything that does not fit there while the client is
+ * blocked is queued behind it as a list of chunks, which are written in
+ * order with writev.  A chunk either holds a copy of the data or refers
+ * to a buffer handed over with WriteToClientRef, which is released once
+ * it has been written.
+ */
+typedef struct _outputChunk {
+    struct _outputChunk *next;
+    char *data;                 /* first unwritten byte */
+    int count;                  /* unwritten bytes */
+    int size;                   /* bytes of storage after data, copies only */
+    void *base;                 /* referenced buffer, passed to release */
+    void (*release) (void *base);
+} OutputChunk;
+
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
     unsigned char *buf;
     int size;
     int count;
+    OutputChunk *chunks;        /* queued after buf */
+    OutputChunk **chunksTail;
 } ConnectionOutput;
 
+#define OUTPUT_MAX_IOV  64
+
 static ConnectionInputPtr AllocateInputBuffer(void);
 static ConnectionOutputPtr AllocateOutputBuffer(void);
 
@@ -183,10 +204,10 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
  *    are zero and the following 4 bytes are the request length.
  *
  *    Note: in order to make the server scheduler (WaitForSomething())
- *    "fair", the ClientsWithInput mask is used.  This mask tells which
- *    clients have FULL requests left in their buffers.  Clients with
+ *    "fair", the ready_clients list is used.  Clients stay on this list
+ *    while they have FULL requests left in their buffers.  Clients with
  *    partial requests require a read.  Basically, client buffers
- *    are drained before select() is called again.  But, we can't keep
+ *    are drained before the server polls again.  But, we can't keep
  *    reading from a client that is sending buckets of data (or has
  *    a partial request) because others clients need to be scheduled.
  *****************************************************************/
@@ -199,10 +220,29 @@ YieldControl(void)
 }
 
 static void
-YieldControlNoInput(int fd)
+YieldControlNoInput(ClientPtr client)
 {
+    OsCommPtr oc = (OsCommPtr) client->osPrivate;
+
     YieldControl();
-    FD_CLR(fd, &ClientsWithInput);
+    /* Client fds are edge triggered; make sure any data still
+     * sitting in the socket is reported by the next poll */
+    if (oc->trans_conn)
+        ospoll_reset_events(server_poll, oc->fd);
+    mark_client_not_ready(client);
+}
+
+static void
+AbortClient(ClientPtr client)
+{
+    OsCommPtr oc = client->osPrivate;
+
+    if (oc->trans_conn) {
+        ospoll_remove(server_poll, oc->fd);
+        _XSERVTransDisconnect(oc->trans_conn);
+        _XSERVTransClose(oc->trans_conn);
+        oc->trans_conn = NULL;
+    }
 }
 
 static void
@@ -242,7 +282,6 @@ ReadRequestFromClient(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
     ConnectionInputPtr oci = oc->input;
-    int fd = oc->fd;
     unsigned int gotnow, needed;
     int result;
     register xReq *request;
@@ -334,21 +373,31 @@ ReadRequestFromClient(ClientPtr client)
         if ((gotnow == 0) || ((oci->bufptr - oci->buffer + needed) > oci->size)) {
             /* no data, or the request is too big to fit in the buffer */
 
-            if ((gotnow > 0) && (oci->bufptr != oci->buffer))
-                /* save the data we've already read */
-                memmove(oci->buffer, oci->bufptr, gotnow);
-            if (needed > oci->size) {
-                /* make buffer bigger to accomodate request */
-                char *ibuf;
-
-                ibuf = (char *) realloc(oci->buffer, needed);
-                if (!ibuf) {
+            if (needed > oci->size ||
+                (oci->size > BUFWATERMARK && needed <= BUFSIZE)) {
+                /* Switch to a buffer sized for this request: large enough
+                 * that the rest of a big request is read straight into
+                 * place, or back to BUFSIZE once a burst of big requests
+                 * is over.  Only the partial request already read is
+                 * copied, never the stale contents of the old buffer.
+                 */
+                int size = max(needed, BUFSIZE);
+                char *ibuf = malloc(size);
+
+                if (!ibuf && needed > oci->size) {
                     YieldControlDeath();
                     return -1;
                 }
-                oci->size = needed;
-                oci->buffer = ibuf;
+                if (ibuf) {
+                    memcpy(ibuf, oci->bufptr, gotnow);
+                    free(oci->buffer);
+                    oci->buffer = oci->bufptr = ibuf;
+                    oci->size = size;
+                }
             }
+            if ((gotnow > 0) && (oci->bufptr != oci->buffer))
+                /* save the data we've already read */
+                memmove(oci->buffer, oci->bufptr, gotnow);
             oci->bufptr = oci->buffer;
             oci->bufcnt = gotnow;
         }
@@ -372,27 +421,16 @@ ReadRequestFromClient(ClientPtr client)
                 if (0)
 #endif
                 {
-                    YieldControlNoInput(fd);
+                    YieldControlNoInput(client);
                     return 0;
                 }
             }
             YieldControlDeath();
             return -1;
         }
+        client->sched_stats.bytes_read += result;
         oci->bufcnt += result;
         gotnow += result;
-        /* free up some space after huge requests */
-        if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
-            char *ibuf;
-
-            ibuf = (char *) realloc(oci->buffer, BUFSIZE);
-            if (ibuf) {
-                oci->size = BUFSIZE;
-                oci->buffer = ibuf;
-                oci->bufptr = ibuf + oci->bufcnt - gotnow;
-            }
-        }
         if (need_header && gotnow >= needed) {
             /* We wanted an xReq, now we've gotten it. */
             request = (xReq *) oci->bufptr;
@@ -409,7 +447,7 @@ ReadRequestFromClient(ClientPtr client)
         }
         if (gotnow < needed) {
             /* Still don't have enough; punt. */
-            YieldControlNoInput(fd);
+            YieldControlNoInput(client);
             return 0;
         }
     }
@@ -459,16 +497,19 @@ ReadRequestFromClient(ClientPtr client)
                 (client->big_requests &&
                  (gotnow >= sizeof(xBigReq) &&
                   gotnow >= (get_big_req_len(request, client) << 2))))
-            )
-            FD_SET(fd, &ClientsWithInput);
-        else {
-            FD_CLR(fd, &ClientsWithInput);
+            ) {
+            if (listen_to_client(client))
+                mark_client_ready(client);
+            else
+                mark_client_saved_ready(client);
         }
+        else
+            YieldControlNoInput(client);
     }
     else {
         if (!gotnow)
             AvailableInput = oc;
-        FD_CLR(fd, &ClientsWithInput);
+        YieldControlNoInput(client);
     }
     if (move_header) {
         request = (xReq *) oci->bufptr;
@@ -525,7 +566,6 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
     ConnectionInputPtr oci = oc->input;
-    int fd = oc->fd;
     int gotnow, moveup;
 
     NextAvailableInput(oc);
@@ -561,10 +601,14 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
     oci->bufptr -= count;
     gotnow += count;
     if ((gotnow >= sizeof(xReq)) &&
-        (gotnow >= (int) (get_req_len((xReq *) oci->bufptr, client) << 2)))
-        FD_SET(fd, &ClientsWithInput);
+        (gotnow >= (int) (get_req_len((xReq *) oci->bufptr, client) << 2))) {
+        if (listen_to_client(client))
+            mark_client_ready(client);
+        else
+            mark_client_saved_ready(client);
+    }
     else
-        YieldControlNoInput(fd);
+        YieldControlNoInput(client);
     return TRUE;
 }
 
@@ -579,7 +623,6 @@ ResetCurrentRequest(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
     register ConnectionInputPtr oci = oc->input;
-    int fd = oc->fd;
     register xReq *request;
     int gotnow, needed;
 
@@ -588,7 +631,7 @@ ResetCurrentRequest(ClientPtr client)
     oci->lenLastReq = 0;
     gotnow = oci->bufcnt + oci->buffer - oci->bufptr;
     if (gotnow < sizeof(xReq)) {
-        YieldControlNoInput(fd);
+        YieldControlNoInput(client);
     }
     else {
         request = (xReq *) oci->bufptr;
@@ -602,16 +645,14 @@ ResetCurrentRequest(ClientPtr client)
             }
         }
         if (gotnow >= (needed << 2)) {
-            if (FD_ISSET(fd, &AllClients)) {
-                FD_SET(fd, &ClientsWithInput);
-            }
-            else {
-                FD_SET(fd, &IgnoredClientsWithInput);
-            }
+            if (listen_to_client(client))
+                mark_client_ready(client);
+            else if (!(oc->flags & OS_COMM_IGNORED))
+                mark_client_saved_ready(client);
             YieldControl();
         }
         else
-            YieldControlNoInput(fd);
+            YieldControlNoInput(client);
     }
 }
 
@@ -628,16 +669,10 @@ ResetCurrentRequest(ClientPtr client)
 void
 FlushAllOutput(void)
 {
-    register int index, base;
-    register fd_mask mask;      /* raphael */
     OsCommPtr oc;
-    register ClientPtr client;
+    register ClientPtr client, tmp;
     Bool newoutput = NewOutputPending;
 
-#if defined(WIN32)
-    fd_set newOutputPending;
-#endif
-
     if (FlushCallback)
         CallCallbacks(&FlushCallback, NULL);
 
@@ -652,48 +687,15 @@ FlushAllOutput(void)
     CriticalOutputPending = FALSE;
     NewOutputPending = FALSE;
 
-#ifndef WIN32
-    for (base = 0; base < howmany(XFD_SETSIZE, NFDBITS); base++) {
-        mask = OutputPending.fds_bits[base];
-        OutputPending.fds_bits[base] = 0;
-        while (mask) {
-            index = ffs(mask) - 1;
-            mask &= ~lowbit(mask);
-            if ((index =
-                 ConnectionTranslation[(base * (sizeof(fd_mask) * 8)) +
-                                       index]) == 0)
-                continue;
-            client = clients[index];
-            if (client->clientGone)
-                continue;
-            oc = (OsCommPtr) client->osPrivate;
-            if (FD_ISSET(oc->fd, &ClientsWithInput)) {
-                FD_SET(oc->fd, &OutputPending); /* set the bit again */
-                NewOutputPending = TRUE;
-            }
-            else
-                (void) FlushClient(client, oc, (char *) NULL, 0);
-        }
-    }
-#else                           /* WIN32 */
-    FD_ZERO(&newOutputPending);
-    for (base = 0; base < XFD_SETCOUNT(&OutputPending); base++) {
-        index = XFD_FD(&OutputPending, base);
-        if ((index = GetConnectionTranslation(index)) == 0)
-            continue;
-        client = clients[index];
+    xorg_list_for_each_entry_safe(client, tmp, &output_pending_clients, output_pending) {
         if (client->clientGone)
             continue;
-        oc = (OsCommPtr) client->osPrivate;
-        if (FD_ISSET(oc->fd, &ClientsWithInput)) {
-            FD_SET(oc->fd, &newOutputPending);  /* set the bit again */
-            NewOutputPending = TRUE;
-        }
-        else
+        if (!client_is_ready(client)) {
+            oc = (OsCommPtr) client->osPrivate;
             (void) FlushClient(client, oc, (char *) NULL, 0);
+        } else
+            NewOutputPending = TRUE;
     }
-    XFD_COPYSET(&newOutputPending, &OutputPending);
-#endif                          /* WIN32 */
 }
 
 void
@@ -720,8 +722,96 @@ SetCriticalOutputPending(void)
  *    this routine as int.
  *****************/
 
-int
-WriteToClient(ClientPtr who, int count, const void *__buf)
+static int FlushClientRef(ClientPtr who, OsCommPtr oc, const void *extraBuf,
+                          int extraCount, void (*release) (void *));
+
+static void
+ReleaseOutputChunk(OutputChunk *chunk)
+{
+    if (chunk->release)
+        chunk->release(chunk->base);
+    free(chunk);
+}
+
+static void
+FreeOutputChunks(ConnectionOutputPtr oco)
+{
+    OutputChunk *chunk;
+
+    while ((chunk = oco->chunks)) {
+        oco->chunks = chunk->next;
+        ReleaseOutputChunk(chunk);
+    }
+    oco->chunksTail = &oco->chunks;
+}
+
+/* Queue count bytes (plus padding) behind everything already pending,
+ * referring to buf when release is given, copying it otherwise. */
+static Bool
+QueueOutputChunk(ConnectionOutputPtr oco, const char *buf, int count,
+                 int padBytes, void *base, void (*release) (void *))
+{
+    OutputChunk *last = oco->chunksTail == &oco->chunks ? NULL :
+        (OutputChunk *) ((char *) oco->chunksTail -
+                         offsetof(OutputChunk, next));
+    OutputChunk **prevTail = oco->chunksTail;
+    OutputChunk *chunk, *ref = NULL;
+    int size;
+
+    if (release) {
+        chunk = calloc(1, sizeof(OutputChunk));
+        if (!chunk)
+            return FALSE;
+        chunk->data = (char *) buf;
+        chunk->count = count;
+        chunk->base = base;
+        chunk->release = release;
+        *oco->chunksTail = chunk;
+        oco->chunksTail = &chunk->next;
+        buf = NULL;
+        count = 0;
+        if (!padBytes)
+            return TRUE;
+        last = ref = chunk;
+    }
+
+    /* Append to the last copying chunk if there is room */
+    if (last && !last->release &&
+        last->count + count + padBytes <= last->size) {
+        memcpy(last->data + last->count, buf, count);
+        memset(last->data + last->count + count, 0, padBytes);
+        last->count += count + padBytes;
+        return TRUE;
+    }
+
+    size = max(count + padBytes, BUFSIZE);
+    chunk = malloc(sizeof(OutputChunk) + size);
+    if (!chunk) {
+        /* The caller still owns buf on failure */
+        if (ref) {
+            *prevTail = NULL;
+            oco->chunksTail = prevTail;
+            free(ref);
+        }
+        return FALSE;
+    }
+    chunk->next = NULL;
+    chunk->data = (char *) (chunk + 1);
+    chunk->size = size;
+    chunk->base = NULL;
+    chunk->release = NULL;
+    if (count)
+        memcpy(chunk->data, buf, count);
+    memset(chunk->data + count, 0, padBytes);
+    chunk->count = count + padBytes;
+    *oco->chunksTail = chunk;
+    oco->chunksTail = &chunk->next;
+    return TRUE;
+}
+
+static int
+WriteToClientInternal(ClientPtr who, int count, const void *__buf,
+                      void (*release) (void *))
 {
     OsCommPtr oc;
     ConnectionOutputPtr oco;
@@ -731,8 +821,11 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
 #ifdef DEBUG_COMMUNICATION
     Bool multicount = FALSE;
 #endif
-    if (!count || !who || who == serverClient || who->clientGone)
+    if (!count || !who || who == serverClient || who->clientGone) {
+        if (release)
+            release((void *) buf);
         return 0;
+    }
     oc = who->osPrivate;
     oco = oc->output;
 #ifdef DEBUG_COMMUNICATION
@@ -781,12 +874,10 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
             FreeOutputs = oco->next;
         }
         else if (!(oco = AllocateOutputBuffer())) {
-            if (oc->trans_conn) {
-                _XSERVTransDisconnect(oc->trans_conn);
-                _XSERVTransClose(oc->trans_conn);
-                oc->trans_conn = NULL;
-            }
+            AbortClient(who);
             MarkClientException(who);
+            if (release)
+                release((void *) buf);
             return -1;
         }
         oc->output = oco;
@@ -834,9 +925,24 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
+    if (oco->chunks) {
+        /* The client is blocked; queue behind what is already waiting */
+        if (!QueueOutputChunk(oco, buf, count, padBytes, (void *) buf,
+                              release)) {
+            AbortClient(who);
+            MarkClientException(who);
+            if (release)
+                release((void *) buf);
+            return -1;
+        }
+        NewOutputPending = TRUE;
+        output_pending_mark(who);
+        return count;
+    }
+
     if (oco->count == 0 || oco->count + count + padBytes > oco->size) {
-        FD_CLR(oc->fd, &OutputPending);
-        if (!XFD_ANYSET(&OutputPending)) {
+        output_pending_clear(who);
+        if (!any_output_pending()) {
             CriticalOutputPending = FALSE;
             NewOutputPending = FALSE;
         }
@@ -844,95 +950,159 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         if (FlushCallback)
             CallCallbacks(&FlushCallback, NULL);
 
-        return FlushClient(who, oc, buf, count);
+        return FlushClientRef(who, oc, buf, count, release);
     }
 
     NewOutputPending = TRUE;
-    FD_SET(oc->fd, &OutputPending);
+    output_pending_mark(who);
     memmove((char *) oco->buf + oco->count, buf, count);
     oco->count += count;
     if (padBytes) {
         memset(oco->buf + oco->count, '\0', padBytes);
         oco->count += padBytes;
     }
+    if (release)
+        release((void *) buf);
     return count;
 }
 
+int
+WriteToClient(ClientPtr who, int count, const void *buf)
+{
+    return WriteToClientInternal(who, count, buf, NULL);
+}
+
+/*****************
+ * WriteToClientRef
+ *    Like WriteToClient, but takes ownership of buf instead of copying
+ *    it: if the data cannot be written right away it is queued by
+ *    reference.  release(buf) is called once the data has been written
+ *    or the client has gone away, possibly before this returns.
+ *****************/
+
+int
+WriteToClientRef(ClientPtr who, int count, void *buf,
+                 void (*release) (void *))
+{
+    return WriteToClientInternal(who, count, buf, release);
+}
+
  /********************
  * FlushClient()
  *    If the client isn't keeping up with us, then we try to continue
- *    buffering the data and set the apropriate bit in ClientsWritable
- *    (which is used by WaitFor in the select).  If the connection yields
+ *    buffering the data and ask server_poll to tell us when the
+ *    connection becomes writable again.  If the connection yields
  *    a permanent error, or we can't allocate any more space, we then
  *    close the connection.
  *
  **********************/
 
 int
-FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
+FlushClient(ClientPtr who, OsCommPtr oc, const void *extraBuf, int extraCount)
+{
+    return FlushClientRef(who, oc, extraBuf, extraCount, NULL);
+}
+
+/* Drop the first n written bytes of the pending output, returning how
+ * many of them went beyond it (into the caller's extra buffer). */
+static long
+ConsumeOutput(ConnectionOutputPtr oco, long n)
+{
+    OutputChunk *chunk;
+    long len;
+
+    len = min(n, oco->count);
+    if (len) {
+        oco->count -= len;
+        memmove((char *) oco->buf, (char *) oco->buf + len, oco->count);
+        n -= len;
+    }
+
+    while (n && (chunk = oco->chunks)) {
+        len = min(n, chunk->count);
+        chunk->data += len;
+        chunk->count -= len;
+        chunk->size -= len;
+        n -= len;
+        if (!chunk->count) {
+            if (!(oco->chunks = chunk->next))
+                oco->chunksTail = &oco->chunks;
+            ReleaseOutputChunk(chunk);
+        }
+    }
+    return n;
+}
+
+static int
+FlushClientRef(ClientPtr who, OsCommPtr oc, const void *__extraBuf,
+               int extraCount, void (*release) (void *))
 {
     ConnectionOutputPtr oco = oc->output;
     int connection = oc->fd;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
+    struct iovec iov[OUTPUT_MAX_IOV];
     static char padBuffer[3];
     const char *extraBuf = __extraBuf;
-    long written;
+    OutputChunk *chunk;
+    long extraWritten;
     long padsize;
-    long notWritten;
     long todo;
 
-    if (!oco)
+    if (!oco) {
+        if (release)
+            release((void *) extraBuf);
 	return 0;
-    written = 0;
+    }
+    extraWritten = 0;
     padsize = padding_for_int32(extraCount);
-    notWritten = oco->count + extraCount + padsize;
-    if (!notWritten)
+    if (!oco->count && !oco->chunks && !extraCount)
         return 0;
 
-    todo = notWritten;
-    while (notWritten) {
-        long before = written;  /* amount of whole thing written */
-        long remain = todo;     /* amount to try this time, <= notWritten */
+    todo = LONG_MAX;
+    for (;;) {
+        long remain = todo;     /* amount to try this time */
+        long pending = 0;       /* bytes not covered by the iovec */
         int i = 0;
         long len;
 
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
-         *
-         * Note that todo had better be at least 1 or else we'll end up
-         * writing 0 iovecs.
-         */
 #define InsertIOV(pointer, length) \
-	len = (length) - before; \
+	len = (length); \
 	if (len > remain) \
 	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
+	if (i == OUTPUT_MAX_IOV) \
+	    len = 0; \
+	if (len > 0) { \
 	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
+	    iov[i].iov_base = (pointer); \
 	    i++; \
 	    remain -= len; \
-	    before = 0; \
-	}
+	} \
+	if (len < (length)) \
+	    pending += (length) - len;
 
+        /* Everything already queued goes first, then the new data */
         InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
-            InsertIOV(padBuffer, padsize)
+        for (chunk = oco->chunks; chunk; chunk = chunk->next) {
+            InsertIOV(chunk->data, chunk->count)
+        }
+        if (!pending) {
+            if (extraWritten < extraCount) {
+                InsertIOV((char *) extraBuf + extraWritten,
+                          extraCount - extraWritten)
+            }
+            InsertIOV(padBuffer + max(extraWritten - extraCount, 0),
+                      padsize - max(extraWritten - extraCount, 0))
+        }
+#undef InsertIOV
 
-            errno = 0;
+        if (!i)
+            break;              /* everything was flushed out */
+
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
-            notWritten -= len;
-            todo = notWritten;
+            who->sched_stats.bytes_written += len;
+            extraWritten += ConsumeOutput(oco, len);
+            todo = LONG_MAX;
         }
         else if (ETEST(errno)
 #ifdef SUNSYSV                  /* check for another brain-damaged OS bug */
@@ -943,77 +1113,53 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 #endif
             ) {
             /* If we've arrived here, then the client is stuffed to the gills
-               and not ready to accept more.  Make a note of it and buffer
-               the rest. */
-            FD_SET(connection, &ClientsWriteBlocked);
-            AnyWritesPending = TRUE;
-
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
-                }
-            }
-            else {
-                written -= oco->count;
+               and not ready to accept more.  Make a note of it and queue
+               the rest, by reference if we were given ownership of it. */
+            long extraLeft = max(extraCount - extraWritten, 0);
+            long padLeft = padsize - max(extraWritten - extraCount, 0);
+
+            output_pending_clear(who);
+            ospoll_listen(server_poll, connection, X_NOTIFY_WRITE);
+
+            if ((extraLeft || padLeft) &&
+                !QueueOutputChunk(oco, extraBuf + extraWritten, extraLeft,
+                                  padLeft, (void *) extraBuf,
+                                  extraLeft ? release : NULL)) {
+                AbortClient(who);
+                MarkClientException(who);
                 oco->count = 0;
+                FreeOutputChunks(oco);
+                extraLeft = 0;
             }
-
-            if (notWritten > oco->size) {
-                unsigned char *obuf = NULL;
-
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
-                }
-                if (!obuf) {
-                    _XSERVTransDisconnect(oc->trans_conn);
-                    _XSERVTransClose(oc->trans_conn);
-                    oc->trans_conn = NULL;
-                    MarkClientException(who);
-                    oco->count = 0;
-                    return -1;
-                }
-                oco->size = notWritten + BUFSIZE;
-                oco->buf = obuf;
-            }
-
-            /* If the amount written extended into the padBuffer, then the
-               difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
-
-            oco->count = notWritten;    /* this will include the pad */
+            if (release && !extraLeft)
+                release((void *) extraBuf);
             /* return only the amount explicitly requested */
             return extraCount;
         }
 #ifdef EMSGSIZE                 /* check for another brain-damaged OS bug */
         else if (errno == EMSGSIZE) {
-            todo >>= 1;
+            todo = (todo - remain) >> 1;
         }
 #endif
         else {
-            if (oc->trans_conn) {
-                _XSERVTransDisconnect(oc->trans_conn);
-                _XSERVTransClose(oc->trans_conn);
-                oc->trans_conn = NULL;
-            }
+            AbortClient(who);
             MarkClientException(who);
             oco->count = 0;
+            FreeOutputChunks(oco);
+            if (release)
+                release((void *) extraBuf);
             return -1;
         }
     }
 
+    if (release)
+        release((void *) extraBuf);
+
     /* everything was flushed out */
     oco->count = 0;
-    /* check to see if this client was write blocked */
-    if (AnyWritesPending) {
-        FD_CLR(oc->fd, &ClientsWriteBlocked);
-        if (!XFD_ANYSET(&ClientsWriteBlocked) && NumNotifyWriteFd == 0)
-            AnyWritesPending = FALSE;
-    }
+    /* this client may have been write blocked */
+    if (trans_conn)
+        ospoll_mute(server_poll, connection, X_NOTIFY_WRITE);
     if (oco->size > BUFWATERMARK) {
         free(oco->buf);
         free(oco);
@@ -1062,6 +1208,8 @@ AllocateOutputBuffer(void)
     }
     oco->size = BUFSIZE;
     oco->count = 0;
+    oco->chunks = NULL;
+    oco->chunksTail = &oco->chunks;
     return oco;
 }
 
@@ -1088,6 +1236,7 @@ FreeOsBuffers(OsCommPtr oc)
         }
     }
     if ((oco = oc->output)) {
+        FreeOutputChunks(oco);
         if (FreeOutputs) {
             free(oco->buf);
             free(oco);
@@ -95,9 +95,6 @@ SOFTWARE.
 #define MAXSOCKS 512
 #endif
 
-/* MAXSELECT is the number of fds that select() can handle */
-#define MAXSELECT (sizeof(fd_set) * NBBY)
-
 #include <stddef.h>
 
 #if defined(XDMCP) || defined(HASXDMAUTH)
@@ -141,6 +138,9 @@ typedef void (*OsCloseFunc) (ClientPtr);
 typedef int (*OsFlushFunc) (ClientPtr who, struct _osComm * oc, char *extraBuf,
                             int extraCount);
 
+#define OS_COMM_GRAB_IMPERVIOUS 1
+#define OS_COMM_IGNORED         2
+
 typedef struct _osComm {
     int fd;
     ConnectionInputPtr input;
@@ -148,6 +148,7 @@ typedef struct _osComm {
     XID auth_id;                /* authorization id */
     CARD32 conn_time;           /* timestamp if not established, else 0  */
     struct _XtransConnInfo *trans_conn; /* transport connection object */
+    int flags;
 } OsCommRec, *OsCommPtr;
 
 extern int FlushClient(ClientPtr /*who */ ,
@@ -161,22 +162,18 @@ extern void FreeOsBuffers(OsCommPtr     /*oc */
 
 extern void InitNotifyFds(void);
 
-extern void HandleNotifyFds(void);
-
 #include "dix.h"
+#include "ospoll.h"
+
+extern struct ospoll *server_poll;
 
-extern fd_set AllSockets;
-extern fd_set AllClients;
+extern Bool listen_to_client(ClientPtr client);
+
+/* Devices registered through AddEnabledDevice/AddGeneralSocket are
+ * reported to block and wakeup handlers in LastSelectMask; client
+ * connections are not tracked in any fd_set */
 extern fd_set LastSelectMask;
-extern fd_set LastSelectWriteMask;
-extern fd_set WellKnownConnections;
 extern fd_set EnabledDevices;
-extern fd_set NotifyReadFds;
-extern fd_set NotifyWriteFds;
-extern fd_set ClientsWithInput;
-extern fd_set ClientsWriteBlocked;
-extern fd_set OutputPending;
-extern fd_set IgnoredClientsWithInput;
 
 #ifndef WIN32
 extern int *ConnectionTranslation;
@@ -187,18 +184,9 @@ extern void ClearConnectionTranslation(void);
 #endif
 
 extern Bool NewOutputPending;
-extern Bool AnyWritesPending;
-extern Bool NumNotifyWriteFd;
 
 extern WorkQueuePtr workQueue;
 
-/* in WaitFor.c */
-#ifdef WIN32
-typedef long int fd_mask;
-#endif
-#define ffs mffs
-extern int mffs(fd_mask);
-
 /* in access.c */
 extern Bool ComputeLocalClient(ClientPtr client);
 
@@ -0,0 +1,488 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*****************************************************************
+ * OS Dependent fd polling
+ *
+ *  ospoll_create, ospoll_destroy, ospoll_add, ospoll_remove,
+ *  ospoll_listen, ospoll_mute, ospoll_wait, ospoll_reset_events,
+ *  ospoll_data
+ *
+ *  Two backends are provided: epoll(7) where epoll_create1 is
+ *  available, and a poll(2) fallback elsewhere.  Both keep a table
+ *  indexed directly by file descriptor so that lookups are O(1), and
+ *  both only hand the callbacks the descriptors that are actually
+ *  ready, so the cost of a wakeup does not depend on how many
+ *  descriptors are being monitored.
+ *
+ *****************************************************************/
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "misc.h"
+#include "os.h"
+#include "list.h"
+#include "ospoll.h"
+
+#if !defined(HAVE_OSPOLL) && defined(HAVE_EPOLL_CREATE1)
+#include <sys/epoll.h>
+#define EPOLL           1
+#define HAVE_OSPOLL     1
+#endif
+
+#if !defined(HAVE_OSPOLL)
+#include <poll.h>
+#define POLL            1
+#define HAVE_OSPOLL     1
+#endif
+
+struct ospollfd {
+    int fd;
+    int xevents;                /* events the caller listens for */
+    int armed;                  /* edge-triggered events not yet reported */
+    enum ospoll_trigger trigger;
+    ospoll_callback_t callback;
+    void *data;
+#if EPOLL
+    Bool registered;            /* currently in the kernel epoll set */
+    struct xorg_list deleted;
+#endif
+#if POLL
+    int pos;                    /* index into the pollfd array */
+#endif
+};
+
+struct ospoll {
+    struct ospollfd **fds;      /* indexed by file descriptor */
+    int fd_size;
+#if EPOLL
+    int epoll_fd;
+    struct xorg_list deleted;
+#endif
+#if POLL
+    struct pollfd *pfds;
+    struct ospollfd **osfds;
+    int num;
+    int size;
+    Bool in_wait;
+    Bool changed;
+#endif
+};
+
+static struct ospollfd *
+ospoll_find(struct ospoll *ospoll, int fd)
+{
+    if (fd < 0 || fd >= ospoll->fd_size)
+        return NULL;
+    return ospoll->fds[fd];
+}
+
+static Bool
+ospoll_grow_fds(struct ospoll *ospoll, int fd)
+{
+    struct ospollfd **new_fds;
+    int new_size;
+
+    if (fd < ospoll->fd_size)
+        return TRUE;
+
+    new_size = ospoll->fd_size ? ospoll->fd_size : 64;
+    while (new_size <= fd)
+        new_size *= 2;
+
+    new_fds = reallocarray(ospoll->fds, new_size, sizeof(ospoll->fds[0]));
+    if (!new_fds)
+        return FALSE;
+    memset(new_fds + ospoll->fd_size, 0,
+           (new_size - ospoll->fd_size) * sizeof(new_fds[0]));
+    ospoll->fds = new_fds;
+    ospoll->fd_size = new_size;
+    return TRUE;
+}
+
+#if EPOLL
+static uint32_t
+ospoll_epoll_events(struct ospollfd *osfd)
+{
+    uint32_t events = 0;
+
+    if (osfd->xevents & X_NOTIFY_READ)
+        events |= EPOLLIN;
+    if (osfd->xevents & X_NOTIFY_WRITE)
+        events |= EPOLLOUT;
+    if (osfd->trigger == ospoll_trigger_edge)
+        events |= EPOLLET;
+    return events;
+}
+
+/* Muted descriptors are kept out of the kernel set entirely so that a
+ * hung-up level-triggered fd does not keep waking us up. */
+static void
+ospoll_epoll_update(struct ospoll *ospoll, struct ospollfd *osfd)
+{
+    struct epoll_event ev;
+
+    ev.events = ospoll_epoll_events(osfd);
+    ev.data.ptr = osfd;
+
+    if (!osfd->xevents) {
+        if (osfd->registered)
+            (void) epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_DEL, osfd->fd, &ev);
+        osfd->registered = FALSE;
+    }
+    else if (osfd->registered)
+        (void) epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_MOD, osfd->fd, &ev);
+    else if (epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_ADD, osfd->fd, &ev) == 0)
+        osfd->registered = TRUE;
+}
+
+static void
+ospoll_clean_deleted(struct ospoll *ospoll)
+{
+    struct ospollfd *osfd, *tmp;
+
+    xorg_list_for_each_entry_safe(osfd, tmp, &ospoll->deleted, deleted) {
+        xorg_list_del(&osfd->deleted);
+        free(osfd);
+    }
+}
+#endif
+
+#if POLL
+static void
+ospoll_poll_update(struct ospoll *ospoll, struct ospollfd *osfd)
+{
+    struct pollfd *pfd = &ospoll->pfds[osfd->pos];
+    int xevents = osfd->xevents;
+
+    if (osfd->trigger == ospoll_trigger_edge)
+        xevents &= osfd->armed;
+
+    pfd->events = 0;
+    if (xevents & X_NOTIFY_READ)
+        pfd->events |= POLLIN;
+    if (xevents & X_NOTIFY_WRITE)
+        pfd->events |= POLLOUT;
+
+    /* poll ignores negative descriptors; use that to keep muted fds from
+     * reporting POLLHUP over and over again */
+    pfd->fd = pfd->events ? osfd->fd : -1;
+}
+
+/* Squeeze out entries removed while callbacks were running */
+static void
+ospoll_poll_compact(struct ospoll *ospoll)
+{
+    int src, dst;
+
+    for (src = dst = 0; src < ospoll->num; src++) {
+        struct ospollfd *osfd = ospoll->osfds[src];
+
+        if (!osfd)
+            continue;
+        if (src != dst) {
+            ospoll->osfds[dst] = osfd;
+            ospoll->pfds[dst] = ospoll->pfds[src];
+            osfd->pos = dst;
+        }
+        dst++;
+    }
+    ospoll->num = dst;
+    ospoll->changed = FALSE;
+}
+#endif
+
+struct ospoll *
+ospoll_create(void)
+{
+    struct ospoll *ospoll = calloc(1, sizeof(struct ospoll));
+
+    if (!ospoll)
+        return NULL;
+#if EPOLL
+    ospoll->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (ospoll->epoll_fd < 0) {
+        free(ospoll);
+        return NULL;
+    }
+    xorg_list_init(&ospoll->deleted);
+#endif
+    return ospoll;
+}
+
+void
+ospoll_destroy(struct ospoll *ospoll)
+{
+    int fd;
+
+    if (!ospoll)
+        return;
+    for (fd = 0; fd < ospoll->fd_size; fd++)
+        free(ospoll->fds[fd]);
+    free(ospoll->fds);
+#if EPOLL
+    ospoll_clean_deleted(ospoll);
+    close(ospoll->epoll_fd);
+#endif
+#if POLL
+    free(ospoll->pfds);
+    free(ospoll->osfds);
+#endif
+    free(ospoll);
+}
+
+Bool
+ospoll_add(struct ospoll *ospoll, int fd,
+           enum ospoll_trigger trigger,
+           ospoll_callback_t callback,
+           void *data)
+{
+    struct ospollfd *osfd;
+
+    if (fd < 0)
+        return FALSE;
+
+    osfd = ospoll_find(ospoll, fd);
+    if (!osfd) {
+        if (!ospoll_grow_fds(ospoll, fd))
+            return FALSE;
+        osfd = calloc(1, sizeof(struct ospollfd));
+        if (!osfd)
+            return FALSE;
+#if POLL
+        if (ospoll->num == ospoll->size) {
+            int new_size = ospoll->size ? ospoll->size * 2 : 16;
+            struct pollfd *new_pfds;
+            struct ospollfd **new_osfds;
+
+            new_pfds = reallocarray(ospoll->pfds, new_size,
+                                    sizeof(struct pollfd));
+            if (!new_pfds) {
+                free(osfd);
+                return FALSE;
+            }
+            ospoll->pfds = new_pfds;
+            new_osfds = reallocarray(ospoll->osfds, new_size,
+                                     sizeof(struct ospollfd *));
+            if (!new_osfds) {
+                free(osfd);
+                return FALSE;
+            }
+            ospoll->osfds = new_osfds;
+            ospoll->size = new_size;
+        }
+        osfd->pos = ospoll->num++;
+        ospoll->osfds[osfd->pos] = osfd;
+        ospoll->pfds[osfd->pos].fd = -1;
+        ospoll->pfds[osfd->pos].events = 0;
+        ospoll->pfds[osfd->pos].revents = 0;
+#endif
+        osfd->fd = fd;
+        ospoll->fds[fd] = osfd;
+    }
+    osfd->trigger = trigger;
+    osfd->callback = callback;
+    osfd->data = data;
+#if EPOLL
+    if (osfd->registered)
+        ospoll_epoll_update(ospoll, osfd);
+#endif
+#if POLL
+    ospoll_poll_update(ospoll, osfd);
+#endif
+    return TRUE;
+}
+
+void
+ospoll_remove(struct ospoll *ospoll, int fd)
+{
+    struct ospollfd *osfd = ospoll_find(ospoll, fd);
+
+    if (!osfd)
+        return;
+
+    ospoll->fds[fd] = NULL;
+    osfd->callback = NULL;
+#if EPOLL
+    if (osfd->registered) {
+        struct epoll_event ev = { 0 };
+
+        (void) epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+    }
+    /* epoll_wait may have already returned this entry; keep it
+     * around until ospoll_wait has finished with the event list */
+    xorg_list_append(&osfd->deleted, &ospoll->deleted);
+#endif
+#if POLL
+    ospoll->osfds[osfd->pos] = NULL;
+    ospoll->pfds[osfd->pos].fd = -1;
+    ospoll->changed = TRUE;
+    if (!ospoll->in_wait)
+        ospoll_poll_compact(ospoll);
+    free(osfd);
+#endif
+}
+
+void
+ospoll_listen(struct ospoll *ospoll, int fd, int xevents)
+{
+    struct ospollfd *osfd = ospoll_find(ospoll, fd);
+
+    if (!osfd || (osfd->xevents & xevents) == xevents)
+        return;
+
+    osfd->xevents |= xevents;
+    osfd->armed |= xevents;
+#if EPOLL
+    ospoll_epoll_update(ospoll, osfd);
+#endif
+#if POLL
+    ospoll_poll_update(ospoll, osfd);
+#endif
+}
+
+void
+ospoll_mute(struct ospoll *ospoll, int fd, int xevents)
+{
+    struct ospollfd *osfd = ospoll_find(ospoll, fd);
+
+    if (!osfd || !(osfd->xevents & xevents))
+        return;
+
+    osfd->xevents &= ~xevents;
+#if EPOLL
+    ospoll_epoll_update(ospoll, osfd);
+#endif
+#if POLL
+    ospoll_poll_update(ospoll, osfd);
+#endif
+}
+
+#if EPOLL
+#define MAX_EVENTS      256
+#endif
+
+int
+ospoll_wait(struct ospoll *ospoll, int timeout)
+{
+    int nready;
+    int i;
+
+#if EPOLL
+    struct epoll_event events[MAX_EVENTS];
+
+    nready = epoll_wait(ospoll->epoll_fd, events, MAX_EVENTS, timeout);
+    for (i = 0; i < nready; i++) {
+        struct ospollfd *osfd = events[i].data.ptr;
+        uint32_t revents = events[i].events;
+        int xevents = 0;
+
+        /* Removed by an earlier callback in this batch */
+        if (!osfd->callback)
+            continue;
+
+        if (revents & EPOLLIN)
+            xevents |= X_NOTIFY_READ;
+        if (revents & EPOLLOUT)
+            xevents |= X_NOTIFY_WRITE;
+        if (revents & (EPOLLERR | EPOLLHUP))
+            xevents |= X_NOTIFY_ERROR;
+
+        osfd->callback(osfd->fd, xevents, osfd->data);
+    }
+    ospoll_clean_deleted(ospoll);
+#endif
+#if POLL
+    nready = poll(ospoll->pfds, ospoll->num, timeout);
+    if (nready > 0) {
+        int num = ospoll->num;
+
+        ospoll->in_wait = TRUE;
+        for (i = 0; i < num; i++) {
+            struct ospollfd *osfd = ospoll->osfds[i];
+            short revents = ospoll->pfds[i].revents;
+            int xevents = 0;
+
+            ospoll->pfds[i].revents = 0;
+            if (!osfd || !revents)
+                continue;
+
+            if (revents & POLLIN)
+                xevents |= X_NOTIFY_READ;
+            if (revents & POLLOUT)
+                xevents |= X_NOTIFY_WRITE;
+            if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                xevents |= X_NOTIFY_ERROR;
+
+            if (osfd->trigger == ospoll_trigger_edge) {
+                osfd->armed &= ~(xevents & (X_NOTIFY_READ | X_NOTIFY_WRITE));
+                if (xevents & X_NOTIFY_ERROR)
+                    osfd->armed = 0;
+                ospoll_poll_update(ospoll, osfd);
+            }
+
+            osfd->callback(osfd->fd, xevents, osfd->data);
+        }
+        ospoll->in_wait = FALSE;
+        if (ospoll->changed)
+            ospoll_poll_compact(ospoll);
+    }
+#endif
+    return nready;
+}
+
+void
+ospoll_reset_events(struct ospoll *ospoll, int fd)
+{
+    struct ospollfd *osfd = ospoll_find(ospoll, fd);
+
+    if (!osfd || osfd->trigger != ospoll_trigger_edge)
+        return;
+
+    osfd->armed = osfd->xevents;
+#if EPOLL
+    /* Re-registering an edge-triggered fd makes the kernel re-evaluate
+     * readiness, so data that is already queued will be reported again */
+    if (osfd->registered)
+        ospoll_epoll_update(ospoll, osfd);
+#endif
+#if POLL
+    ospoll_poll_update(ospoll, osfd);
+#endif
+}
+
+void *
+ospoll_data(struct ospoll *ospoll, int fd)
+{
+    struct ospollfd *osfd = ospoll_find(ospoll, fd);
+
+    if (!osfd)
+        return NULL;
+    return osfd->data;
+}
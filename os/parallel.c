@@ -0,0 +1,210 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Band-parallel rendering
+ *
+ * ParallelBands splits a large rectangle into horizontal bands and runs
+ * them on a small pool of worker threads, with the calling thread doing
+ * its share.  It returns once every band is done, so callers need no
+ * synchronization of their own as long as the bands touch disjoint
+ * rows of the destination.  Workers are started on first use and then
+ * sleep until the next job; small operations never leave the caller.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <signal.h>
+
+#include "misc.h"
+#include "os.h"
+
+/* Number of threads drawing, including the main thread, at least 1.
+ * Set with -fbthreads. */
+int ParallelThreads = 1;
+
+#ifdef FBTHREADS
+
+#include <pthread.h>
+
+/* Operations below this many pixels are not worth waking anyone for */
+#define PARALLEL_MIN_PIXELS     (256 * 1024)
+/* Nor are bands shorter than this */
+#define PARALLEL_MIN_ROWS       8
+/* Bands per thread, so a slow band does not hold everybody up */
+#define PARALLEL_BANDS_PER_THREAD 4
+#define PARALLEL_MAX_THREADS    64
+
+typedef struct {
+    ParallelBandProc proc;
+    void *closure;
+    int y1, y2;
+    int rows;                   /* per band */
+    int nbands;
+    int next;                   /* next band to claim */
+    int helpers;                /* workers wanted */
+    int users;                  /* workers that joined */
+} ParallelJob;
+
+static pthread_mutex_t parallel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t parallel_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t parallel_done = PTHREAD_COND_INITIALIZER;
+static ParallelJob *parallel_job;
+static unsigned int parallel_generation;
+static int parallel_workers;
+
+static void
+ParallelRunBands(ParallelJob *job)
+{
+    int band, y1, y2;
+
+    while ((band = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+           job->nbands) {
+        y1 = job->y1 + band * job->rows;
+        y2 = min(y1 + job->rows, job->y2);
+        (*job->proc) (y1, y2, job->closure);
+    }
+}
+
+static void *
+ParallelWorker(void *arg)
+{
+    unsigned int seen = 0;
+    ParallelJob *job;
+
+    pthread_mutex_lock(&parallel_mutex);
+    for (;;) {
+        while (parallel_generation == seen)
+            pthread_cond_wait(&parallel_wake, &parallel_mutex);
+        seen = parallel_generation;
+
+        job = parallel_job;
+        if (!job || job->users >= job->helpers)
+            continue;
+        job->users++;
+        pthread_mutex_unlock(&parallel_mutex);
+
+        ParallelRunBands(job);
+
+        pthread_mutex_lock(&parallel_mutex);
+        if (--job->users == 0)
+            pthread_cond_signal(&parallel_done);
+    }
+    return NULL;
+}
+
+static int
+ParallelThreadCount(void)
+{
+    return max(min(ParallelThreads, PARALLEL_MAX_THREADS), 1);
+}
+
+/* Make sure there are at least n workers; returns how many there are */
+static int
+ParallelStartWorkers(int n)
+{
+    sigset_t set, old;
+    pthread_t thread;
+
+    if (parallel_workers >= n)
+        return parallel_workers;
+
+    /* Signals stay with the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &old);
+    while (parallel_workers < n) {
+        if (pthread_create(&thread, NULL, ParallelWorker, NULL) != 0) {
+            LogMessage(X_WARNING, "Could not start rendering thread\n");
+            break;
+        }
+        pthread_detach(thread);
+        parallel_workers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return parallel_workers;
+}
+
+/**
+ * Call proc for horizontal bands covering rows y1 to y2 - 1, in parallel
+ * if the area is large enough to pay for it.  proc may be called from
+ * any thread and for the bands in any order, so it must only write the
+ * rows it was given.
+ *
+ * @param width  width in pixels of the area, to judge its cost
+ */
+void
+ParallelBands(int y1, int y2, int width, ParallelBandProc proc, void *closure)
+{
+    ParallelJob job;
+    int threads, height = y2 - y1;
+
+    if (height <= 0)
+        return;
+
+    threads = ParallelThreadCount();
+    if (threads <= 1 || (long) width * height < PARALLEL_MIN_PIXELS ||
+        height < 2 * PARALLEL_MIN_ROWS) {
+        (*proc) (y1, y2, closure);
+        return;
+    }
+
+    job.proc = proc;
+    job.closure = closure;
+    job.y1 = y1;
+    job.y2 = y2;
+    job.rows = max(PARALLEL_MIN_ROWS,
+                   (height + threads * PARALLEL_BANDS_PER_THREAD - 1) /
+                   (threads * PARALLEL_BANDS_PER_THREAD));
+    job.nbands = (height + job.rows - 1) / job.rows;
+    job.next = 0;
+    job.users = 0;
+
+    pthread_mutex_lock(&parallel_mutex);
+    job.helpers = min(ParallelStartWorkers(threads - 1), job.nbands - 1);
+    parallel_job = &job;
+    parallel_generation++;
+    pthread_cond_broadcast(&parallel_wake);
+    pthread_mutex_unlock(&parallel_mutex);
+
+    ParallelRunBands(&job);
+
+    /* Every band has been claimed; wait for the ones still running */
+    pthread_mutex_lock(&parallel_mutex);
+    parallel_job = NULL;
+    while (job.users)
+        pthread_cond_wait(&parallel_done, &parallel_mutex);
+    pthread_mutex_unlock(&parallel_mutex);
+}
+
+#else                           /* FBTHREADS */
+
+void
+ParallelBands(int y1, int y2, int width, ParallelBandProc proc, void *closure)
+{
+    if (y2 > y1)
+        (*proc) (y1, y2, closure);
+}
+
+#endif                          /* FBTHREADS */
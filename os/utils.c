@@ -588,6 +588,8 @@ UseMsg(void)
     ErrorF
         ("-dumbSched             Disable smart scheduling, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedStats int        Log scheduler statistics every int seconds\n");
+    ErrorF("-fbthreads int         Render large operations on int threads\n");
     ErrorF("-sigstop               Enable SIGSTOP based startup\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
@@ -868,8 +870,10 @@ ProcessCommandLine(int argc, char *argv[])
 		if (LimitClients != 64 &&
 		    LimitClients != 128 &&
 		    LimitClients != 256 &&
-		    LimitClients != 512) {
-		    FatalError("maxclients must be one of 64, 128, 256 or 512\n");
+		    LimitClients != 512 &&
+		    LimitClients != 1024 &&
+		    LimitClients != 2048) {
+		    FatalError("maxclients must be one of 64, 128, 256, 512, 1024 or 2048\n");
 		}
 	    } else
 		UseMsg();
@@ -1024,6 +1028,22 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-schedStats") == 0) {
+            if (++i < argc) {
+                SmartScheduleStatsInterval = atoi(argv[i]);
+            }
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-fbthreads") == 0) {
+            if (++i < argc) {
+                ParallelThreads = atoi(argv[i]);
+                if (ParallelThreads < 1)
+                    FatalError("fbthreads must be at least 1\n");
+            }
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-render") == 0) {
             if (++i < argc) {
                 int policy = PictureParseCmapPolicy(argv[i]);
@@ -1330,6 +1350,9 @@ static sigset_t PreviousSigIOMask;
 /**
  * returns zero if this call caused SIGIO to be blocked now, non-zero if it
  * was already blocked by a previous call to this function.
+ *
+ * This also takes the input lock, so code protecting itself from SIGIO
+ * input handlers is equally protected from the input thread.
  */
 int
 OsBlockSIGIO(void)
@@ -1344,26 +1367,37 @@ OsBlockSIGIO(void)
         sigaddset(&set, SIGIO);
         sigprocmask(SIG_BLOCK, &set, &PreviousSigIOMask);
         ret = sigismember(&PreviousSigIOMask, SIGIO);
+        input_lock();
         return ret;
     }
 #endif
 #endif
+    input_lock();
     return 1;
 }
 
+/**
+ * Undoes OsBlockSIGIO in the reverse order: the input lock is dropped
+ * before SIGIO is unblocked.  An unbalanced call only warns, there is
+ * no lock to drop for it.
+ */
 void
 OsReleaseSIGIO(void)
 {
 #ifdef SIGIO
 #ifdef SIG_BLOCK
     if (--sigio_blocked == 0) {
+        input_unlock();
         sigprocmask(SIG_SETMASK, &PreviousSigIOMask, 0);
+        return;
     } else if (sigio_blocked < 0) {
         BUG_WARN(sigio_blocked < 0);
         sigio_blocked = 0;
+        return;
     }
 #endif
 #endif
+    input_unlock();
 }
 
 void
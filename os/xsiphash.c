@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * SipHash-2-4 with 128-bit output, after the reference implementation
+ * by Jean-Philippe Aumasson and Daniel J. Bernstein.  It is keyed, so
+ * with a secret key clients cannot construct collisions, and it runs
+ * several times faster than SHA-1 on short inputs.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+
+#include "misc.h"
+#include "xsiphash.h"
+
+#define ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3) do {                   \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0;          \
+        v0 = ROTL(v0, 32);                              \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;          \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;          \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2;          \
+        v2 = ROTL(v2, 32);                              \
+    } while (0)
+
+static inline uint64_t
+load64_le(const unsigned char *p)
+{
+    return ((uint64_t) p[0]) | ((uint64_t) p[1] << 8) |
+        ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+        ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+        ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline void
+store64_le(unsigned char *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+static inline void
+x_siphash_block(x_siphash_ctx *ctx, uint64_t m)
+{
+    uint64_t v0 = ctx->v[0], v1 = ctx->v[1], v2 = ctx->v[2], v3 = ctx->v[3];
+
+    v3 ^= m;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= m;
+
+    ctx->v[0] = v0;
+    ctx->v[1] = v1;
+    ctx->v[2] = v2;
+    ctx->v[3] = v3;
+}
+
+void
+x_siphash_init(x_siphash_ctx *ctx, const unsigned char key[16])
+{
+    uint64_t k0 = load64_le(key);
+    uint64_t k1 = load64_le(key + 8);
+
+    ctx->v[0] = k0 ^ 0x736f6d6570736575ULL;
+    ctx->v[1] = k1 ^ 0x646f72616e646f6dULL ^ 0xee;
+    ctx->v[2] = k0 ^ 0x6c7967656e657261ULL;
+    ctx->v[3] = k1 ^ 0x7465646279746573ULL;
+    ctx->len = 0;
+}
+
+void
+x_siphash_update(x_siphash_ctx *ctx, const void *data, size_t size)
+{
+    const unsigned char *in = data;
+    size_t have = ctx->len & 7;
+
+    ctx->len += size;
+
+    /* Top up a partial block left over from the last update */
+    if (have) {
+        size_t n = min(8 - have, size);
+
+        memcpy(ctx->tail + have, in, n);
+        in += n;
+        size -= n;
+        if (have + n < 8)
+            return;
+        x_siphash_block(ctx, load64_le(ctx->tail));
+    }
+
+    for (; size >= 8; in += 8, size -= 8)
+        x_siphash_block(ctx, load64_le(in));
+
+    memcpy(ctx->tail, in, size);
+}
+
+void
+x_siphash_final(x_siphash_ctx *ctx, unsigned char result[16])
+{
+    uint64_t v0, v1, v2, v3, b;
+    int have = ctx->len & 7;
+    int i;
+
+    b = (uint64_t) ctx->len << 56;
+    for (i = 0; i < have; i++)
+        b |= (uint64_t) ctx->tail[i] << (8 * i);
+    x_siphash_block(ctx, b);
+
+    v0 = ctx->v[0];
+    v1 = ctx->v[1];
+    v2 = ctx->v[2];
+    v3 = ctx->v[3];
+
+    v2 ^= 0xee;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    store64_le(result, v0 ^ v1 ^ v2 ^ v3);
+
+    v1 ^= 0xdd;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    store64_le(result + 8, v0 ^ v1 ^ v2 ^ v3);
+}
@@ -48,6 +48,16 @@ and Jim Haggerty of Metheus.
 
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "recordshm.h"
+
+#if defined(XTRANS_SEND_FDS) && defined(HAVE_MEMFD_CREATE)
+#define RECORD_SHM 1
+#endif
 
 #ifdef PANORAMIX
 #include "globals.h"
@@ -78,6 +88,24 @@ typedef struct {
     int numBufBytes;            /* number of bytes in replyBuffer */
     char replyBuffer[REPLY_BUF_SIZE];   /* buffered recorded protocol */
     int inFlush;                /*  are we inside RecordFlushReplyBuffer */
+
+    /* shared memory sink, see recordshm.h */
+    RecordShmHeaderRec *shm;    /* NULL when replying to pRecordingClient */
+    char *shmData;              /* data area following the header */
+    size_t shmMapSize;
+    CARD32 shmSize;             /* our copies; the recorder can write */
+    CARD32 shmHead;             /* to the whole header */
+    CARD32 shmLost;
+    CARD32 shmReplyLeft;        /* bytes of the current reply to come */
+    Bool shmReplyQueued;        /* it goes to the backlog */
+    Bool shmReplyLost;          /* it is dropped */
+    char *backlog;              /* replies that did not fit in the ring */
+    int backlogBytes;
+    int backlogSize;
+    CARD32 backlogReplyLeft;    /* of the first reply, 0 if none started */
+    ClientPtr *stalled;         /* clients held back for the recorder */
+    int numStalled;
+    OsTimerPtr shmTimer;
 } RecordContextRec, *RecordContextPtr;
 
 /*  RecordMinorOpRec - to hold minor opcode selections for extension requests
@@ -213,6 +241,280 @@ RecordFindContextOnAllContexts(RecordContextPtr pContext)
 
 /***************************************************************************/
 
+/* Shared memory sink
+ *
+ * The ring receives whole replies, never part of one.  A reply goes
+ * straight into the ring when there is room for all of it.  Otherwise
+ * it is queued in the backlog and the client it records is ignored
+ * until a timer finds that the recorder has made room and the backlog
+ * has drained.  Device events and the like have no client to hold
+ * back: their replies are queued while the backlog is under a cap, and
+ * past it dropped whole and counted as lost.
+ *
+ * The recorder can write to the header at any time, so the server keeps
+ * its own copy of each field and only ever reads back tail.
+ */
+
+#define RECORD_SHM_POLL 1       /* ms between looks at a full ring */
+#define RECORD_SHM_MAX_BACKLOG(pContext) (4 * (pContext)->shmSize)
+
+static CARD32
+RecordShmSpace(RecordContextPtr pContext)
+{
+    CARD32 tail = __atomic_load_n(&pContext->shm->tail, __ATOMIC_ACQUIRE);
+    CARD32 used = pContext->shmHead - tail;
+
+    /* a tail ahead of head, or more than a ring behind it, is bogus */
+    if (used > pContext->shmSize)
+        return 0;
+    return pContext->shmSize - used;
+}
+
+static void
+RecordShmCopy(RecordContextPtr pContext, const char *data, CARD32 len)
+{
+    CARD32 size = pContext->shmSize;
+    CARD32 at = pContext->shmHead & (size - 1);
+    CARD32 n = min(len, size - at);
+
+    memcpy(pContext->shmData + at, data, n);
+    memcpy(pContext->shmData, data + n, len - n);
+    pContext->shmHead += len;
+    __atomic_store_n(&pContext->shm->head, pContext->shmHead,
+                     __ATOMIC_RELEASE);
+}
+
+static void
+RecordShmLose(RecordContextPtr pContext, CARD32 len)
+{
+    pContext->shmLost += len;
+    __atomic_store_n(&pContext->shm->lost, pContext->shmLost,
+                     __ATOMIC_RELAXED);
+}
+
+/* Size of the reply starting at data, of which len bytes are there */
+static CARD32
+RecordShmReplySize(RecordContextPtr pContext, const char *data, int len)
+{
+    CARD32 length;
+
+    if (len < SIZEOF(xRecordEnableContextReply))
+        return len;
+    length = ((const xRecordEnableContextReply *) data)->length;
+    if (pContext->pRecordingClient->swapped)
+        swapl(&length);
+    return max(SIZEOF(xRecordEnableContextReply) + (length << 2),
+               (CARD32) len);
+}
+
+static Bool
+RecordShmReserve(RecordContextPtr pContext, CARD32 len)
+{
+    char *backlog;
+    CARD32 size;
+
+    if (len <= (CARD32) (pContext->backlogSize - pContext->backlogBytes))
+        return TRUE;
+    if (len > (CARD32) (INT_MAX - pContext->backlogBytes))
+        return FALSE;
+    size = max((CARD32) pContext->backlogSize * 2,
+               pContext->backlogBytes + len);
+    size = min(size, INT_MAX);
+    backlog = realloc(pContext->backlog, size);
+    if (!backlog)
+        return FALSE;
+    pContext->backlog = backlog;
+    pContext->backlogSize = size;
+    return TRUE;
+}
+
+static Bool
+RecordShmStall(RecordContextPtr pContext, ClientPtr pClient)
+{
+    ClientPtr *stalled;
+    int i;
+
+    if (!pClient || pClient == serverClient || pClient->clientGone ||
+        pClient->clientState == ClientStateRetained ||
+        pClient->clientState == ClientStateGone ||
+        pClient == pContext->pRecordingClient)
+        return FALSE;
+    for (i = 0; i < pContext->numStalled; i++)
+        if (pContext->stalled[i] == pClient)
+            return TRUE;
+
+    stalled = reallocarray(pContext->stalled, pContext->numStalled + 1,
+                           sizeof(ClientPtr));
+    if (!stalled)
+        return FALSE;
+    pContext->stalled = stalled;
+    pContext->stalled[pContext->numStalled++] = pClient;
+    IgnoreClient(pClient);
+    return TRUE;
+}
+
+static void
+RecordShmRelease(RecordContextPtr pContext)
+{
+    int i;
+
+    for (i = 0; i < pContext->numStalled; i++)
+        AttendClient(pContext->stalled[i]);
+    free(pContext->stalled);
+    pContext->stalled = NULL;
+    pContext->numStalled = 0;
+}
+
+/* pClient is going away; it must not be attended to later */
+static void
+RecordShmForgetClient(RecordContextPtr pContext, ClientPtr pClient)
+{
+    int i;
+
+    for (i = 0; i < pContext->numStalled; i++) {
+        if (pContext->stalled[i] == pClient) {
+            pContext->stalled[i] = pContext->stalled[--pContext->numStalled];
+            return;
+        }
+    }
+}
+
+/* Move the backlog into the ring as far as it fits.  With whole set, a
+ * reply only goes in if all of the rest of it fits.  TRUE once empty.
+ */
+static Bool
+RecordShmDrain(RecordContextPtr pContext, Bool whole)
+{
+    CARD32 space = RecordShmSpace(pContext);
+    CARD32 left = pContext->backlogReplyLeft;
+    CARD32 take;
+    int n = 0;
+
+    while (n < pContext->backlogBytes && space) {
+        if (!left)
+            left = RecordShmReplySize(pContext, pContext->backlog + n,
+                                      pContext->backlogBytes - n);
+        if (whole && left > space)
+            break;
+        take = min(min(left, (CARD32) (pContext->backlogBytes - n)), space);
+        n += take;
+        space -= take;
+        left -= take;
+    }
+    pContext->backlogReplyLeft = left;
+
+    if (n) {
+        RecordShmCopy(pContext, pContext->backlog, n);
+        pContext->backlogBytes -= n;
+        memmove(pContext->backlog, pContext->backlog + n,
+                pContext->backlogBytes);
+    }
+    if (pContext->backlogBytes)
+        return FALSE;
+    RecordShmRelease(pContext);
+    return TRUE;
+}
+
+static CARD32
+RecordShmTimer(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    return RecordShmDrain(arg, FALSE) ? 0 : RECORD_SHM_POLL;
+}
+
+/* Decide where the reply that starts with data goes, before any of it
+ * does.  Replies for a client that can be held back are never dropped.
+ */
+static void
+RecordShmStartReply(RecordContextPtr pContext, const char *data, int len)
+{
+    CARD32 size = RecordShmReplySize(pContext, data, len);
+
+    pContext->shmReplyLeft = size;
+    pContext->shmReplyQueued = FALSE;
+    pContext->shmReplyLost = FALSE;
+
+    if (!pContext->backlogBytes && RecordShmSpace(pContext) >= size)
+        return;
+
+    pContext->shmReplyQueued = TRUE;
+    if (!RecordShmStall(pContext, pContext->pBufClient) &&
+        (CARD64) pContext->backlogBytes + size >
+        RECORD_SHM_MAX_BACKLOG(pContext))
+        pContext->shmReplyLost = TRUE;
+    else if (!RecordShmReserve(pContext, size))
+        pContext->shmReplyLost = TRUE;
+}
+
+/* Like WriteToClient, including the padding to a multiple of 4 bytes */
+static void
+RecordShmWrite(RecordContextPtr pContext, const char *data, int len)
+{
+    static const char padBuffer[3];
+    CARD32 padded = pad_to_int32(len);
+    int padlen = padded - len;
+
+    if (!pContext->shmReplyLeft)
+        RecordShmStartReply(pContext, data, padded);
+    pContext->shmReplyLeft -= min(pContext->shmReplyLeft, padded);
+
+    if (pContext->shmReplyLost) {
+        RecordShmLose(pContext, padded);
+    }
+    else if (!pContext->shmReplyQueued &&
+             RecordShmSpace(pContext) >= padded) {
+        RecordShmCopy(pContext, data, len);
+        RecordShmCopy(pContext, padBuffer, padlen);
+    }
+    else if (pContext->shmReplyQueued &&
+             RecordShmReserve(pContext, padded)) {
+        memcpy(pContext->backlog + pContext->backlogBytes, data, len);
+        memset(pContext->backlog + pContext->backlogBytes + len, 0, padlen);
+        pContext->backlogBytes += padded;
+        pContext->shmTimer = TimerSet(pContext->shmTimer, 0, RECORD_SHM_POLL,
+                                      RecordShmTimer, pContext);
+    }
+    else {
+        /* only when the reply turns out longer than its header said */
+        RecordShmLose(pContext, padded);
+    }
+}
+
+/* Called when the context is disabled.  The recorder gets the queued
+ * replies that fit, and the rest is lost.
+ */
+static void
+RecordShmFinish(RecordContextPtr pContext)
+{
+    RecordShmHeaderRec *shm = pContext->shm;
+
+    RecordShmDrain(pContext, TRUE);
+    RecordShmLose(pContext, pContext->backlogBytes);
+    __atomic_store_n(&shm->flags, RECORD_SHM_END, __ATOMIC_RELEASE);
+    RecordShmRelease(pContext);
+
+    TimerFree(pContext->shmTimer);
+    pContext->shmTimer = NULL;
+    free(pContext->backlog);
+    pContext->backlog = NULL;
+    pContext->backlogBytes = pContext->backlogSize = 0;
+    pContext->backlogReplyLeft = 0;
+    pContext->shmReplyLeft = 0;
+    munmap(shm, pContext->shmMapSize);
+    pContext->shm = NULL;
+    pContext->shmData = NULL;
+}
+
+static void
+RecordWriteToRecorder(RecordContextPtr pContext, int len, void *data)
+{
+    if (pContext->shm)
+        RecordShmWrite(pContext, data, len);
+    else
+        WriteToClient(pContext->pRecordingClient, len, data);
+}
+
+/***************************************************************************/
+
 /* RecordFlushReplyBuffer
  *
  * Arguments:
@@ -224,8 +526,8 @@ RecordFindContextOnAllContexts(RecordContextPtr pContext)
  *
  * Side Effects:
  *	If the context is enabled, any buffered (recorded) protocol is written
- *	to the recording client, and the number of buffered bytes is set to
- *	zero.  If len1 is not zero, data1/len1 are then written to the
+ *	to the recording client, or its ring, and the number of buffered bytes
+ *	is set to zero.  If len1 is not zero, data1/len1 are then written to the
  *	recording client, and similarly for data2/len2 (written after
  *	data1/len1).
  */
@@ -238,13 +540,13 @@ RecordFlushReplyBuffer(RecordContextPtr pContext,
         return;
     ++pContext->inFlush;
     if (pContext->numBufBytes)
-        WriteToClient(pContext->pRecordingClient, pContext->numBufBytes,
-                      pContext->replyBuffer);
+        RecordWriteToRecorder(pContext, pContext->numBufBytes,
+                              pContext->replyBuffer);
     pContext->numBufBytes = 0;
     if (len1)
-        WriteToClient(pContext->pRecordingClient, len1, data1);
+        RecordWriteToRecorder(pContext, len1, data1);
     if (len2)
-        WriteToClient(pContext->pRecordingClient, len2, data2);
+        RecordWriteToRecorder(pContext, len2, data2);
     --pContext->inFlush;
 }                               /* RecordFlushReplyBuffer */
 
@@ -826,6 +1128,8 @@ RecordFlushAllContexts(CallbackListPtr *pcbl,
          */
         if (pContext->numBufBytes)
             RecordFlushReplyBuffer(ppAllContexts[eci], NULL, 0, NULL, 0);
+        if (pContext->backlogBytes)
+            RecordShmDrain(pContext, FALSE);
     }
 }                               /* RecordFlushAllContexts */
 
@@ -1867,6 +2171,22 @@ ProcRecordCreateContext(ClientPtr client)
     pContext->pBufClient = NULL;
     pContext->continuedReply = 0;
     pContext->inFlush = 0;
+    pContext->shm = NULL;
+    pContext->shmData = NULL;
+    pContext->shmMapSize = 0;
+    pContext->shmSize = 0;
+    pContext->shmHead = 0;
+    pContext->shmLost = 0;
+    pContext->shmReplyLeft = 0;
+    pContext->shmReplyQueued = FALSE;
+    pContext->shmReplyLost = FALSE;
+    pContext->backlog = NULL;
+    pContext->backlogBytes = 0;
+    pContext->backlogSize = 0;
+    pContext->backlogReplyLeft = 0;
+    pContext->stalled = NULL;
+    pContext->numStalled = 0;
+    pContext->shmTimer = NULL;
 
     err = RecordRegisterClients(pContext, client,
                                 (xRecordRegisterClientsReq *) stuff);
@@ -2276,16 +2596,11 @@ ProcRecordGetContext(ClientPtr client)
 }                               /* ProcRecordGetContext */
 
 static int
-ProcRecordEnableContext(ClientPtr client)
+RecordEnableContext(RecordContextPtr pContext, ClientPtr client)
 {
-    RecordContextPtr pContext;
-
-    REQUEST(xRecordEnableContextReq);
     int i;
     RecordClientsAndProtocolPtr pRCAP;
 
-    REQUEST_SIZE_MATCH(xRecordGetContextReq);
-    VERIFY_CONTEXT(pContext, stuff->context, client);
     if (pContext->pRecordingClient)
         return BadMatch;        /* already enabled */
 
@@ -2307,9 +2622,10 @@ ProcRecordEnableContext(ClientPtr client)
     }
 
     /* Disallow further request processing on this connection until
-     * the context is disabled.
+     * the context is disabled, unless the data goes to a ring.
      */
-    IgnoreClient(client);
+    if (!pContext->shm)
+        IgnoreClient(client);
     pContext->pRecordingClient = client;
 
     /* Don't allow the data connection to record itself; unregister it. */
@@ -2333,8 +2649,104 @@ ProcRecordEnableContext(ClientPtr client)
     RecordAProtocolElement(pContext, NULL, XRecordStartOfData, NULL, 0, 0, 0);
     RecordFlushReplyBuffer(pContext, NULL, 0, NULL, 0);
     return Success;
+}                               /* RecordEnableContext */
+
+static int
+ProcRecordEnableContext(ClientPtr client)
+{
+    RecordContextPtr pContext;
+
+    REQUEST(xRecordEnableContextReq);
+
+    REQUEST_SIZE_MATCH(xRecordGetContextReq);
+    VERIFY_CONTEXT(pContext, stuff->context, client);
+    return RecordEnableContext(pContext, client);
 }                               /* ProcRecordEnableContext */
 
+static int
+ProcRecordEnableContextShm(ClientPtr client)
+{
+#ifdef RECORD_SHM
+    RecordContextPtr pContext;
+    RecordShmHeaderRec *shm;
+    CARD32 size;
+    size_t mapSize;
+    int fd, err;
+
+    REQUEST(xRecordEnableContextShmReq);
+    xRecordEnableContextShmReply rep = {
+        .type = X_Reply,
+        .nfd = 1,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+        .offset = sizeof(RecordShmHeaderRec),
+    };
+
+    REQUEST_SIZE_MATCH(xRecordEnableContextShmReq);
+    VERIFY_CONTEXT(pContext, stuff->context, client);
+    if (pContext->pRecordingClient)
+        return BadMatch;
+    if (stuff->size > RECORD_SHM_MAX_SIZE) {
+        client->errorValue = stuff->size;
+        return BadValue;
+    }
+
+    /* A power of two, so the byte counts can wrap */
+    for (size = RECORD_SHM_MIN_SIZE; size < stuff->size; size <<= 1)
+        ;
+    mapSize = sizeof(RecordShmHeaderRec) + size;
+
+    /* Sealed, so the recorder cannot shrink it under us */
+    fd = memfd_create("xserver-record", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+        return BadAlloc;
+    if (ftruncate(fd, mapSize) < 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return BadAlloc;
+    }
+    shm = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED) {
+        close(fd);
+        return BadAlloc;
+    }
+
+    shm->magic = RECORD_SHM_MAGIC;
+    shm->size = size;
+    pContext->shm = shm;
+    pContext->shmData = (char *) (shm + 1);
+    pContext->shmMapSize = mapSize;
+    pContext->shmSize = size;
+    pContext->shmHead = 0;
+    pContext->shmLost = 0;
+
+    if (WriteFdToClient(client, fd, TRUE) < 0) {
+        pContext->shm = NULL;
+        munmap(shm, mapSize);
+        close(fd);
+        return BadAlloc;
+    }
+
+    err = RecordEnableContext(pContext, client);
+    if (err != Success) {
+        pContext->shm = NULL;
+        munmap(shm, mapSize);
+        return err;
+    }
+
+    rep.size = size;
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.size);
+        swapl(&rep.offset);
+    }
+    WriteToClient(client, sizeof(rep), &rep);
+    return Success;
+#else
+    return BadRequest;
+#endif
+}                               /* ProcRecordEnableContextShm */
+
 /* RecordDisableContext
  *
  * Arguments:
@@ -2363,8 +2775,11 @@ RecordDisableContext(RecordContextPtr pContext)
         RecordAProtocolElement(pContext, NULL, XRecordEndOfData, NULL, 0, 0, 0);
         RecordFlushReplyBuffer(pContext, NULL, 0, NULL, 0);
         /* Re-enable request processing on this connection. */
-        AttendClient(pContext->pRecordingClient);
+        if (!pContext->shm)
+            AttendClient(pContext->pRecordingClient);
     }
+    if (pContext->shm)
+        RecordShmFinish(pContext);
 
     for (pRCAP = pContext->pListOfRCAP; pRCAP; pRCAP = pRCAP->pNextRCAP) {
         RecordUninstallHooks(pRCAP, 0);
@@ -2481,6 +2896,8 @@ ProcRecordDispatch(ClientPtr client)
         return ProcRecordDisableContext(client);
     case X_RecordFreeContext:
         return ProcRecordFreeContext(client);
+    case X_RecordEnableContextShm:
+        return ProcRecordEnableContextShm(client);
     default:
         return BadRequest;
     }
@@ -2583,6 +3000,18 @@ SProcRecordEnableContext(ClientPtr client)
     return ProcRecordEnableContext(client);
 }                               /* SProcRecordEnableContext */
 
+static int
+SProcRecordEnableContextShm(ClientPtr client)
+{
+    REQUEST(xRecordEnableContextShmReq);
+
+    swaps(&stuff->length);
+    REQUEST_SIZE_MATCH(xRecordEnableContextShmReq);
+    swapl(&stuff->context);
+    swapl(&stuff->size);
+    return ProcRecordEnableContextShm(client);
+}                               /* SProcRecordEnableContextShm */
+
 static int
 SProcRecordDisableContext(ClientPtr client)
 {
@@ -2627,6 +3056,8 @@ SProcRecordDispatch(ClientPtr client)
         return SProcRecordDisableContext(client);
     case X_RecordFreeContext:
         return SProcRecordFreeContext(client);
+    case X_RecordEnableContextShm:
+        return SProcRecordEnableContextShm(client);
     default:
         return BadRequest;
     }
@@ -2750,6 +3181,13 @@ RecordAClientStateChange(CallbackListPtr *pcbl, void *nulldata,
                                            XRecordClientDied, NULL, 0, 0, 0);
                 RecordDeleteClientFromRCAP(pRCAP, pos);
             }
+            /* The ring sink looks at whose data it is when it goes out */
+            if (pContext->pBufClient == pClient) {
+                RecordFlushReplyBuffer(pContext, NULL, 0, NULL, 0);
+                if (!pContext->numBufBytes)
+                    pContext->pBufClient = NULL;
+            }
+            RecordShmForgetClient(pContext, pClient);
         }
 
         free(ppAllContextsCopy);
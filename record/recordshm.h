@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2016 The X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RECORDSHM_H_
+#define _RECORDSHM_H_
+
+#include <X11/Xmd.h>
+
+/*
+ * EnableContextShm: enable a context with a shared memory ring as its
+ * sink instead of the EnableContext reply stream.  Not part of the
+ * RECORD protocol proper, and the advertised version does not change;
+ * a server without it answers BadRequest.
+ *
+ * The reply carries one file descriptor, to be mapped shared.  It holds
+ * a RecordShmHeaderRec followed by the data area, and the data area
+ * receives exactly the bytes that EnableContext would have sent as
+ * replies, StartOfData to EndOfData.  The recording connection is not
+ * blocked, so DisableContext can be sent on it.
+ *
+ * head and tail count bytes, modulo 2^32; the bytes between them are
+ * at offset (count % size) in the data area, wrapping at the end.  The
+ * server only moves head and the recorder only moves tail.  When the
+ * ring fills, the server stops reading requests from the clients being
+ * recorded until the recorder catches up, and only data that cannot
+ * be held back that way is dropped, counted in lost.  Replies go into
+ * the ring or into lost whole, so the ring always parses as a sequence
+ * of replies.  The server never reads back anything in the header
+ * but tail, so writing to the other fields only misleads the recorder.
+ */
+
+#define X_RecordEnableContextShm        8
+
+typedef struct {
+    CARD8 reqType;
+    CARD8 recordReqType;
+    CARD16 length;
+    CARD32 context;
+    CARD32 size;                /* requested size of the data area */
+} xRecordEnableContextShmReq;
+#define sz_xRecordEnableContextShmReq 12
+
+typedef struct {
+    CARD8 type;
+    CARD8 nfd;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD32 size;                /* actual size of the data area */
+    CARD32 offset;              /* of the data area in the file */
+    CARD32 pad0;
+    CARD32 pad1;
+    CARD32 pad2;
+    CARD32 pad3;
+} xRecordEnableContextShmReply;
+#define sz_xRecordEnableContextShmReply 32
+
+#define RECORD_SHM_MAGIC        0x58524352      /* "XRCR" */
+#define RECORD_SHM_MIN_SIZE     (64 * 1024)
+#define RECORD_SHM_MAX_SIZE     (256 * 1024 * 1024)
+
+/* flags */
+#define RECORD_SHM_END          (1 << 0)        /* context disabled */
+
+/* In the byte order of the server */
+typedef struct {
+    CARD32 magic;
+    CARD32 size;
+    CARD32 head;                /* written by the server */
+    CARD32 tail;                /* written by the recorder */
+    CARD32 lost;
+    CARD32 flags;
+    CARD32 pad[10];
+} RecordShmHeaderRec;
+
+#endif                          /* _RECORDSHM_H_ */
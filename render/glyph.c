@@ -26,7 +26,10 @@
 #include <dix-config.h>
 #endif
 
-#include "xsha1.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "xsiphash.h"
 
 #include "misc.h"
 #include "scrnintstr.h"
@@ -161,25 +164,58 @@ FindGlyphRef(GlyphHashPtr hash,
     return gr;
 }
 
+/*
+ * Glyphs are shared between all clients, so the hash is keyed with a
+ * secret to keep one client from uploading a glyph that collides with
+ * another client's.  The key is picked once and kept for the life of
+ * the server, as the global glyph table outlives regenerations.
+ */
+static unsigned char glyphHashKey[16];
+static Bool glyphHashKeyed;
+
+static void
+GlyphHashKeyInit(void)
+{
+    CARD64 now;
+    pid_t pid;
+    int fd, i;
+
+    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (read(fd, glyphHashKey, sizeof(glyphHashKey)) ==
+            sizeof(glyphHashKey))
+            glyphHashKeyed = TRUE;
+        close(fd);
+    }
+
+    if (!glyphHashKeyed) {
+        /* Not secret, but still differs from one server to the next */
+        now = GetTimeInMicros();
+        pid = getpid();
+        for (i = 0; i < 8; i++) {
+            glyphHashKey[i] ^= now >> (8 * i);
+            glyphHashKey[i + 8] ^= (CARD64) pid >> (8 * (i & 3));
+        }
+        glyphHashKeyed = TRUE;
+    }
+}
+
 int
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20])
 {
-    void *ctx = x_sha1_init();
-    int success;
-
-    if (!ctx)
-        return BadAlloc;
-
-    success = x_sha1_update(ctx, gi, sizeof(xGlyphInfo));
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_update(ctx, bits, size);
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_final(ctx, sha1);
-    if (!success)
-        return BadAlloc;
+    x_siphash_ctx ctx;
+
+    if (!glyphHashKeyed)
+        GlyphHashKeyInit();
+
+    /* 128 bits are plenty to tell glyphs apart; the rest of the
+     * historical SHA-1 sized field is left zero */
+    x_siphash_init(&ctx, glyphHashKey);
+    x_siphash_update(&ctx, gi, sizeof(xGlyphInfo));
+    x_siphash_update(&ctx, bits, size);
+    x_siphash_final(&ctx, sha1);
+    memset(sha1 + 16, 0, 20 - 16);
     return Success;
 }
 
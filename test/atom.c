@@ -0,0 +1,112 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "os.h"
+#include "dix.h"
+
+/**
+ * Check atom interning and time 1e6 unique and 1e6 repeated names.
+ */
+
+#define NUM_ATOMS 1000000
+
+static void
+atom_name(char *buf, size_t size, int i)
+{
+    snprintf(buf, size, "_TEST_ATOM_%d", i);
+}
+
+static void
+atom_predefined(void)
+{
+    assert(MakeAtom("PRIMARY", 7, FALSE) == XA_PRIMARY);
+    assert(MakeAtom("WM_TRANSIENT_FOR", 16, FALSE) == XA_WM_TRANSIENT_FOR);
+    assert(strcmp(NameForAtom(XA_CUT_BUFFER0), "CUT_BUFFER0") == 0);
+    assert(MakeAtom("PRIMARYX", 7, FALSE) == XA_PRIMARY);
+    assert(MakeAtom("PRIMAR", 6, FALSE) == None);
+    assert(!ValidAtom(None));
+    assert(ValidAtom(XA_LAST_PREDEFINED));
+    assert(NameForAtom(XA_LAST_PREDEFINED + 1) == NULL);
+}
+
+static void
+atom_intern(void)
+{
+    CARD64 start, unique, repeated;
+    char buf[32];
+    Atom first, a;
+    int i;
+
+    first = XA_LAST_PREDEFINED + 1;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_ATOMS; i++) {
+        atom_name(buf, sizeof(buf), i);
+        a = MakeAtom(buf, strlen(buf), TRUE);
+        assert(a == first + i);
+    }
+    unique = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_ATOMS; i++) {
+        atom_name(buf, sizeof(buf), i);
+        a = MakeAtom(buf, strlen(buf), TRUE);
+        assert(a == first + i);
+    }
+    repeated = GetTimeInMicros() - start;
+
+    for (i = 0; i < NUM_ATOMS; i += 1000) {
+        atom_name(buf, sizeof(buf), i);
+        assert(strcmp(NameForAtom(first + i), buf) == 0);
+    }
+    assert(MakeAtom("_TEST_ATOM_X", 12, FALSE) == None);
+
+    if (getenv("XSERVER_TEST_BENCHMARK"))
+        printf("%d atoms: unique %.1f ns, repeated %.1f ns\n", NUM_ATOMS,
+               unique * 1000.0 / NUM_ATOMS, repeated * 1000.0 / NUM_ATOMS);
+}
+
+int
+main(int argc, char **argv)
+{
+    InitAtoms();
+    atom_predefined();
+    atom_intern();
+
+    /* atoms must come back identically after a server reset */
+    InitAtoms();
+    atom_predefined();
+    assert(MakeAtom("_TEST_ATOM_0", 12, FALSE) == None);
+    FreeAllAtoms();
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include "misc.h"
+#include "os.h"
+#include "regionstr.h"
+#include "dix.h"
+#include "scrnintstr.h"
+#include "pixmapstr.h"
+#include "gcstruct.h"
+#include "damage.h"
+#include "damagestr.h"
+
+/**
+ * Feed scattered damage to Damage objects with a rectangle cap, and
+ * check that whatever the damage holds or reports covers everything
+ * that was damaged and never has more rectangles than the cap.  Then
+ * draw through the GC wrappers, where accumulate-only damage batches
+ * boxes, and compare with damage that takes each box right away.
+ */
+
+static ScreenRec screen;
+
+/* Everything damaged so far, exactly */
+static RegionRec damaged;
+/* Everything reported so far */
+static RegionRec reported;
+static int max_rects;
+
+static Bool
+region_contains(RegionPtr outer, RegionPtr inner)
+{
+    RegionRec rest;
+    Bool contained;
+
+    RegionNull(&rest);
+    RegionSubtract(&rest, inner, outer);
+    contained = !RegionNotEmpty(&rest);
+    RegionUninit(&rest);
+    return contained;
+}
+
+static void
+damage_report(DamagePtr pDamage, RegionPtr pRegion, void *closure)
+{
+    assert(RegionNumRects(pRegion) <= max_rects);
+    RegionUnion(&reported, &reported, pRegion);
+}
+
+static void
+test_validate_gc(GCPtr pGC, unsigned long changes, DrawablePtr pDrawable)
+{
+}
+
+static void
+test_push_pixels(GCPtr pGC, PixmapPtr pBitMap, DrawablePtr pDrawable,
+                 int dx, int dy, int xOrg, int yOrg)
+{
+}
+
+static const GCFuncs test_gc_funcs = {
+    .ValidateGC = test_validate_gc,
+};
+
+static const GCOps test_gc_ops = {
+    .PushPixels = test_push_pixels,
+};
+
+static Bool
+test_create_gc(GCPtr pGC)
+{
+    pGC->funcs = &test_gc_funcs;
+    pGC->ops = &test_gc_ops;
+    return TRUE;
+}
+
+static void
+damage_init(void)
+{
+    memset(&screen, 0, sizeof(screen));
+    screenInfo.numScreens = 1;
+    screenInfo.screens[0] = &screen;
+    screen.myNum = 0;
+    screen.width = 4096;
+    screen.height = 4096;
+    screen.CreateGC = test_create_gc;
+    dixResetPrivates();
+    dixInitScreenSpecificPrivates(&screen);
+    assert(DamageSetup(&screen));
+}
+
+/* n boxes of up to 8x8 anywhere in [-x0, 4096 - x0) */
+static void
+random_region(RegionPtr pRegion, int n, int x0)
+{
+    BoxPtr boxes = calloc(n, sizeof(BoxRec));
+    int i;
+
+    assert(boxes);
+    for (i = 0; i < n; i++) {
+        boxes[i].x1 = random() % 4088 - x0;
+        boxes[i].y1 = random() % 4088 - x0;
+        boxes[i].x2 = boxes[i].x1 + 1 + random() % 8;
+        boxes[i].y2 = boxes[i].y1 + 1 + random() % 8;
+    }
+    assert(RegionInitBoxes(pRegion, boxes, n));
+    free(boxes);
+}
+
+static void
+check_damage(DamagePtr pDamage)
+{
+    RegionPtr pRegion = DamageRegion(pDamage);
+
+    assert(RegionNumRects(pRegion) <= max_rects);
+    assert(region_contains(pRegion, &damaged));
+}
+
+/*
+ * Report batches of n scattered boxes, checking the accumulated damage
+ * and, for the levels that pass regions on, the reports after each.
+ */
+static void
+damage_cap_test(DamageReportLevel level, int cap, int tile, int n, int x0)
+{
+    DamagePtr pDamage;
+    RegionRec region;
+    int i;
+
+    pDamage = DamageCreate(level == DamageReportNone ? NULL : damage_report,
+                           NULL, level, FALSE, &screen, NULL);
+    assert(pDamage);
+    DamageSetMaxRects(pDamage, cap, tile);
+    max_rects = cap;
+
+    RegionNull(&damaged);
+    RegionNull(&reported);
+    for (i = 0; i < 20; i++) {
+        random_region(&region, n, x0);
+        RegionUnion(&damaged, &damaged, &region);
+        DamageReportDamage(pDamage, &region);
+        if (level == DamageReportRawRegion)
+            assert(region_contains(&reported, &region));
+        RegionUninit(&region);
+        check_damage(pDamage);
+    }
+    if (level == DamageReportRawRegion)
+        assert(region_contains(&reported, &damaged));
+
+    RegionUninit(&damaged);
+    RegionUninit(&reported);
+    DamageDestroy(pDamage);
+}
+
+/*
+ * Damage collected exactly and then capped must still cover what was
+ * there, also once the cap is too small for any tiling to meet and it
+ * falls back to the extents; lifting the cap makes damage exact again.
+ */
+static void
+damage_set_max_rects_test(void)
+{
+    DamagePtr pDamage;
+    RegionRec region;
+
+    pDamage = DamageCreate(NULL, NULL, DamageReportNone, FALSE, &screen,
+                           NULL);
+    assert(pDamage);
+
+    random_region(&damaged, 2000, 0);
+    DamageReportDamage(pDamage, &damaged);
+    assert(RegionEqual(DamageRegion(pDamage), &damaged));
+
+    max_rects = 32;
+    DamageSetMaxRects(pDamage, max_rects, 16);
+    check_damage(pDamage);
+
+    max_rects = 1;
+    DamageSetMaxRects(pDamage, max_rects, 1);
+    check_damage(pDamage);
+
+    random_region(&region, 500, 1000);
+    RegionUnion(&damaged, &damaged, &region);
+    DamageReportDamage(pDamage, &region);
+    RegionUninit(&region);
+    check_damage(pDamage);
+
+    DamageSetMaxRects(pDamage, 0, 1);
+    DamageEmpty(pDamage);
+    random_region(&region, 500, 0);
+    DamageReportDamage(pDamage, &region);
+    assert(RegionEqual(DamageRegion(pDamage), &region));
+    RegionUninit(&region);
+
+    RegionUninit(&damaged);
+    DamageDestroy(pDamage);
+}
+
+/* n boxes of up to 16x16, or runs along a row when run is set */
+static void
+draw_boxes(GCPtr pGC, DrawablePtr pDrawable, int n, Bool run)
+{
+    int i, x = 0, y = 0;
+
+    for (i = 0; i < n; i++) {
+        if (!run || i % 32 == 0) {
+            x = random() % 1000;
+            y = random() % 1000;
+        }
+        else
+            x += 8;
+        (*pGC->ops->PushPixels) (pGC, NULL, pDrawable,
+                                 run ? 8 : 1 + random() % 16,
+                                 run ? 12 : 1 + random() % 16, x, y);
+    }
+}
+
+/*
+ * Damage without a report function batches the boxes drawn to a
+ * pixmap, while RawRegion damage on the same pixmap takes each right
+ * away.  DamageRegionAppend and DamageSubtract must flush the batch
+ * first, and the two must always end up with the same region.
+ */
+static void
+damage_batch_test(void)
+{
+    PixmapPtr pPixmap;
+    DrawablePtr pDrawable;
+    GCPtr pGC;
+    DamagePtr pBatched, pDirect;
+    RegionRec region;
+
+    pPixmap = dixAllocateScreenObjectWithPrivates(&screen, PixmapRec,
+                                                  PRIVATE_PIXMAP);
+    assert(pPixmap);
+    pDrawable = &pPixmap->drawable;
+    pDrawable->type = DRAWABLE_PIXMAP;
+    pDrawable->pScreen = &screen;
+    pDrawable->width = 1024;
+    pDrawable->height = 1024;
+
+    pGC = dixAllocateScreenObjectWithPrivates(&screen, GC, PRIVATE_GC);
+    assert(pGC);
+    pGC->pScreen = &screen;
+    pGC->miTranslate = TRUE;
+    assert((*screen.CreateGC) (pGC));
+    (*pGC->funcs->ValidateGC) (pGC, 0, pDrawable);
+
+    pBatched = DamageCreate(NULL, NULL, DamageReportNone, FALSE, &screen,
+                            NULL);
+    pDirect = DamageCreate(damage_report, NULL, DamageReportRawRegion,
+                           FALSE, &screen, NULL);
+    assert(pBatched && pDirect);
+    DamageRegister(pDrawable, pBatched);
+    DamageRegister(pDrawable, pDirect);
+    max_rects = MAXINT;
+    RegionNull(&reported);
+
+    draw_boxes(pGC, pDrawable, 100, FALSE);
+    assert(pBatched->nbatch > 0);
+    random_region(&region, 20, 0);
+    DamageRegionAppend(pDrawable, &region);
+    RegionUninit(&region);
+    assert(pBatched->nbatch == 0);
+    assert(RegionEqual(&pBatched->damage, &pDirect->damage));
+
+    draw_boxes(pGC, pDrawable, 100, FALSE);
+    assert(pBatched->nbatch > 0);
+    random_region(&region, 200, 0);
+    DamageSubtract(pBatched, &region);
+    DamageSubtract(pDirect, &region);
+    RegionUninit(&region);
+    assert(pBatched->nbatch == 0);
+    assert(RegionEqual(&pBatched->damage, &pDirect->damage));
+
+    /* enough to fill the batch several times over */
+    draw_boxes(pGC, pDrawable, 2000, TRUE);
+    draw_boxes(pGC, pDrawable, 1000, FALSE);
+    assert(RegionEqual(DamageRegion(pBatched), DamageRegion(pDirect)));
+
+    DamageUnregister(pBatched);
+    DamageUnregister(pDirect);
+    DamageDestroy(pBatched);
+    DamageDestroy(pDirect);
+    RegionUninit(&reported);
+    dixFreeObjectWithPrivates(pGC, PRIVATE_GC);
+    dixFreeObjectWithPrivates(pPixmap, PRIVATE_PIXMAP);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const DamageReportLevel levels[] = {
+        DamageReportNone, DamageReportRawRegion, DamageReportDeltaRegion,
+        DamageReportBoundingBox, DamageReportNonEmpty
+    };
+    int i;
+
+    damage_init();
+
+    for (i = 0; i < ARRAY_SIZE(levels); i++) {
+        damage_cap_test(levels[i], 64, 32, 100, 0);
+        /* boxes that straddle the origin round away from it */
+        damage_cap_test(levels[i], 64, 32, 100, 2048);
+        /* tiles too small to help for a while */
+        damage_cap_test(levels[i], 16, 1, 1000, 0);
+        damage_cap_test(levels[i], 1, 8, 50, 1000);
+    }
+
+    damage_set_max_rects_test();
+    damage_batch_test();
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "os.h"
+#include "xsha1.h"
+#include "xsiphash.h"
+#include "picturestr.h"
+#include "glyphstr.h"
+
+/**
+ * Check the glyph hash, and time it against SHA-1 on batches of glyphs
+ * shaped like what text-heavy clients upload.
+ */
+
+#define NGLYPHS 20000
+
+typedef struct {
+    xGlyphInfo info;
+    CARD8 *bits;
+    unsigned long size;
+} TestGlyph;
+
+static void
+siphash_test(void)
+{
+    /* From the SipHash reference implementation, key 00..0f, no input */
+    static const unsigned char empty[16] = {
+        0xa3, 0x81, 0x7f, 0x04, 0xba, 0x25, 0xa8, 0xe6,
+        0x6d, 0xf6, 0x72, 0x14, 0xc7, 0x55, 0x02, 0x93
+    };
+    unsigned char key[16], data[64], whole[16], split[16];
+    x_siphash_ctx ctx;
+    int i, len, at;
+
+    for (i = 0; i < sizeof(key); i++)
+        key[i] = i;
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    x_siphash_init(&ctx, key);
+    x_siphash_final(&ctx, whole);
+    assert(memcmp(whole, empty, sizeof(empty)) == 0);
+
+    /* However the input is split up, the hash is the same */
+    for (len = 0; len <= sizeof(data); len++) {
+        x_siphash_init(&ctx, key);
+        x_siphash_update(&ctx, data, len);
+        x_siphash_final(&ctx, whole);
+
+        for (at = 0; at <= len; at++) {
+            x_siphash_init(&ctx, key);
+            x_siphash_update(&ctx, data, at);
+            x_siphash_update(&ctx, data + at, (len - at) / 2);
+            x_siphash_update(&ctx, data + at + (len - at) / 2,
+                             len - at - (len - at) / 2);
+            x_siphash_final(&ctx, split);
+            assert(memcmp(whole, split, sizeof(whole)) == 0);
+        }
+    }
+}
+
+/* Glyphs of a 9 to 24 pixel font, in A8 or, for subpixel text, ARGB */
+static TestGlyph *
+make_glyphs(int n, int bpp)
+{
+    TestGlyph *glyphs = calloc(n, sizeof(TestGlyph));
+    int i, j;
+
+    assert(glyphs);
+    srandom(n * bpp);
+    for (i = 0; i < n; i++) {
+        TestGlyph *g = &glyphs[i];
+        int em = 9 + random() % 16;
+
+        g->info.width = em / 2 + random() % em;
+        g->info.height = em + random() % (em / 2);
+        g->info.x = -(random() % 3);
+        g->info.y = em;
+        g->info.xOff = g->info.width + 1;
+        g->info.yOff = 0;
+        g->size = g->info.height * ((g->info.width * bpp / 8 + 3) & ~3);
+        g->bits = malloc(g->size);
+        assert(g->bits);
+        for (j = 0; j < g->size; j++)
+            g->bits[j] = random();
+    }
+    return glyphs;
+}
+
+static void
+free_glyphs(TestGlyph *glyphs, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        free(glyphs[i].bits);
+    free(glyphs);
+}
+
+static void
+hash_glyph_test(TestGlyph *glyphs, int n)
+{
+    unsigned char a[20], b[20];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        TestGlyph *g = &glyphs[i];
+
+        assert(HashGlyph(&g->info, g->bits, g->size, a) == Success);
+        assert(HashGlyph(&g->info, g->bits, g->size, b) == Success);
+        assert(memcmp(a, b, sizeof(a)) == 0);
+        assert(memcmp(a + 16, "\0\0\0\0", 4) == 0);
+
+        /* A single bit of either the metrics or the image matters */
+        g->bits[i % g->size] ^= 1 << (i & 7);
+        assert(HashGlyph(&g->info, g->bits, g->size, b) == Success);
+        assert(memcmp(a, b, sizeof(a)) != 0);
+        g->bits[i % g->size] ^= 1 << (i & 7);
+
+        g->info.xOff++;
+        assert(HashGlyph(&g->info, g->bits, g->size, b) == Success);
+        assert(memcmp(a, b, sizeof(a)) != 0);
+        g->info.xOff--;
+    }
+}
+
+static CARD64
+time_hash(TestGlyph *glyphs, int n)
+{
+    unsigned char hash[20];
+    CARD64 start = GetTimeInMicros();
+    int i;
+
+    for (i = 0; i < n; i++)
+        HashGlyph(&glyphs[i].info, glyphs[i].bits, glyphs[i].size, hash);
+    return GetTimeInMicros() - start;
+}
+
+static CARD64
+time_sha1(TestGlyph *glyphs, int n)
+{
+    unsigned char hash[20];
+    CARD64 start = GetTimeInMicros();
+    void *ctx;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        ctx = x_sha1_init();
+        assert(ctx);
+        x_sha1_update(ctx, &glyphs[i].info, sizeof(xGlyphInfo));
+        x_sha1_update(ctx, glyphs[i].bits, glyphs[i].size);
+        x_sha1_final(ctx, hash);
+    }
+    return GetTimeInMicros() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        int bpp;
+    } batches[] = {
+        { "a8", 8 },
+        { "argb", 32 },
+    };
+    Bool bench = getenv("XSERVER_TEST_BENCHMARK") != NULL;
+    TestGlyph *glyphs;
+    CARD64 hash, sha1;
+    int i;
+
+    siphash_test();
+
+    for (i = 0; i < ARRAY_SIZE(batches); i++) {
+        glyphs = make_glyphs(NGLYPHS, batches[i].bpp);
+        hash_glyph_test(glyphs, NGLYPHS);
+
+        if (bench) {
+            hash = time_hash(glyphs, NGLYPHS);
+            sha1 = time_sha1(glyphs, NGLYPHS);
+            printf("%d %-4s glyphs: HashGlyph %6.2f ms, SHA-1 %6.2f ms "
+                   "(%.2fx)\n", NGLYPHS, batches[i].name, hash / 1000.0,
+                   sha1 / 1000.0, (double) sha1 / max(hash, 1));
+        }
+
+        free_glyphs(glyphs, NGLYPHS);
+    }
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pixman.h>
+#include "misc.h"
+#include "os.h"
+#include "fb.h"
+#include "mi.h"
+
+/**
+ * Check that band-parallel composites, fills and copies of a 4K
+ * framebuffer match the single-threaded result, and that fbCopyNtoN
+ * and fbSolidBoxClipped draw the same with several threads as with
+ * one, including copies that overlap within a pixmap.  With
+ * XSERVER_TEST_BENCHMARK set in the environment, also time the 4K
+ * operations with 1 up to one thread per CPU.
+ */
+
+#define WIDTH   3840
+#define HEIGHT  2160
+#define REPEAT  10
+
+#define PIX_WIDTH   1031
+#define PIX_HEIGHT  1021
+
+typedef struct {
+    pixman_image_t *src, *mask, *dst;
+    uint32_t *src_bits, *dst_bits;
+    int x, y, width;
+    int op;
+} BandTest;
+
+enum { op_composite, op_fill, op_copy };
+
+static void
+test_band(int y1, int y2, void *closure)
+{
+    BandTest *t = closure;
+
+    assert(y1 >= t->y && y1 < y2 && y2 <= HEIGHT);
+
+    switch (t->op) {
+    case op_composite:
+        pixman_image_composite(PIXMAN_OP_OVER, t->src, t->mask, t->dst,
+                               t->x, y1 - t->y, 0, y1 - t->y, t->x, y1,
+                               t->width, y2 - y1);
+        break;
+    case op_fill:
+        pixman_fill(t->dst_bits, WIDTH, 32, t->x, y1, t->width, y2 - y1,
+                    0x80402010);
+        break;
+    case op_copy:
+        pixman_blt(t->src_bits, t->dst_bits, WIDTH, WIDTH, 32, 32,
+                   t->x, y1, t->x, y1, t->width, y2 - y1);
+        break;
+    }
+}
+
+static uint32_t *
+make_bits(unsigned seed, int n)
+{
+    uint32_t *bits = malloc(n * 4);
+    int i;
+
+    assert(bits);
+    srandom(seed);
+    for (i = 0; i < n; i++)
+        bits[i] = random();
+    return bits;
+}
+
+static CARD64
+run(BandTest *t, int threads, int op, int repeat)
+{
+    CARD64 start;
+    int i;
+
+    ParallelThreads = threads;
+    t->op = op;
+    start = GetTimeInMicros();
+    for (i = 0; i < repeat; i++)
+        ParallelBands(t->y, HEIGHT, t->width, test_band, t);
+    return (GetTimeInMicros() - start) / repeat;
+}
+
+static void
+init_pixmap(PixmapPtr pPixmap, uint32_t *bits)
+{
+    memset(pPixmap, 0, sizeof(*pPixmap));
+    pPixmap->drawable.type = DRAWABLE_PIXMAP;
+    pPixmap->drawable.depth = 24;
+    pPixmap->drawable.bitsPerPixel = 32;
+    pPixmap->drawable.width = PIX_WIDTH;
+    pPixmap->drawable.height = PIX_HEIGHT;
+    pPixmap->devKind = PIX_WIDTH * 4;
+    pPixmap->devPrivate.ptr = bits;
+}
+
+/*
+ * The destination region: the whole pixmap, where the source is in
+ * bounds, less a hole so that the copy has several boxes per band.
+ */
+static void
+copy_region(RegionPtr region, int dx, int dy)
+{
+    BoxRec box = {
+        .x1 = max(0, -dx),
+        .y1 = max(0, -dy),
+        .x2 = min(PIX_WIDTH, PIX_WIDTH - dx),
+        .y2 = min(PIX_HEIGHT, PIX_HEIGHT - dy)
+    };
+    BoxRec hole = { 300, 200, 700, 800 };
+    RegionRec holeRegion;
+
+    RegionInit(region, &box, 1);
+    RegionInit(&holeRegion, &hole, 1);
+    RegionSubtract(region, region, &holeRegion);
+    RegionUninit(&holeRegion);
+}
+
+/*
+ * Copy the region from (x + dx, y + dy) to (x, y) with miCopyRegion and
+ * fbCopyNtoN on threads, and compare with the expected result computed
+ * pixel by pixel from the original contents.
+ */
+static void
+fb_copy_test(int threads, int dx, int dy, Bool overlap)
+{
+    uint32_t *src_bits = make_bits(4, PIX_WIDTH * PIX_HEIGHT);
+    uint32_t *dst_bits, *expect;
+    PixmapRec src, dst;
+    RegionRec region;
+    BoxPtr pbox;
+    int nbox, x, y;
+
+    dst_bits = overlap ? src_bits : make_bits(5, PIX_WIDTH * PIX_HEIGHT);
+    expect = malloc(PIX_WIDTH * PIX_HEIGHT * 4);
+    assert(expect);
+    memcpy(expect, dst_bits, PIX_WIDTH * PIX_HEIGHT * 4);
+
+    init_pixmap(&src, src_bits);
+    init_pixmap(&dst, dst_bits);
+    copy_region(&region, dx, dy);
+
+    for (nbox = RegionNumRects(&region), pbox = RegionRects(&region);
+         nbox--; pbox++)
+        for (y = pbox->y1; y < pbox->y2; y++)
+            for (x = pbox->x1; x < pbox->x2; x++)
+                expect[y * PIX_WIDTH + x] =
+                    src_bits[(y + dy) * PIX_WIDTH + x + dx];
+
+    ParallelThreads = threads;
+    miCopyRegion(&src.drawable, overlap ? &src.drawable : &dst.drawable,
+                 NULL, &region, dx, dy, fbCopyNtoN, 0, NULL);
+    assert(memcmp(dst_bits, expect, PIX_WIDTH * PIX_HEIGHT * 4) == 0);
+
+    RegionUninit(&region);
+    if (!overlap)
+        free(dst_bits);
+    free(src_bits);
+    free(expect);
+}
+
+static void
+fb_copy_tests(int threads)
+{
+    static const int deltas[][2] = {
+        {0, 37}, {0, -37}, {29, 0}, {-29, 0},
+        {13, 17}, {-13, 17}, {13, -17}, {-13, -17}, {0, 1}, {0, -1}
+    };
+    int i;
+
+    for (i = 0; i < (int) ARRAY_SIZE(deltas); i++) {
+        fb_copy_test(threads, deltas[i][0], deltas[i][1], TRUE);
+        fb_copy_test(threads, deltas[i][0], deltas[i][1], FALSE);
+    }
+}
+
+/* A clipped solid fill must not depend on how it was split in bands */
+static void
+fb_solid_test(int threads)
+{
+    uint32_t *reference = make_bits(6, PIX_WIDTH * PIX_HEIGHT);
+    uint32_t *bits = make_bits(6, PIX_WIDTH * PIX_HEIGHT);
+    PixmapRec pixmap;
+    RegionRec clip;
+
+    copy_region(&clip, 0, 0);
+
+    init_pixmap(&pixmap, reference);
+    ParallelThreads = 1;
+    fbSolidBoxClipped(&pixmap.drawable, &clip, 3, 5, PIX_WIDTH - 2,
+                      PIX_HEIGHT - 7, 0x00ff00ff, 0x12345678);
+
+    init_pixmap(&pixmap, bits);
+    ParallelThreads = threads;
+    fbSolidBoxClipped(&pixmap.drawable, &clip, 3, 5, PIX_WIDTH - 2,
+                      PIX_HEIGHT - 7, 0x00ff00ff, 0x12345678);
+    assert(memcmp(bits, reference, PIX_WIDTH * PIX_HEIGHT * 4) == 0);
+
+    RegionUninit(&clip);
+    free(reference);
+    free(bits);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *names[] = { "composite", "fill", "copy" };
+    BandTest t;
+    uint32_t *orig, *reference, *mask_bits;
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Bool bench = getenv("XSERVER_TEST_BENCHMARK") != NULL;
+    int threads, op, repeat = bench ? REPEAT : 1;
+    CARD64 usec, single;
+
+    ncpus = min(max(ncpus, 2), 8);
+
+    for (threads = 1; threads <= 4; threads++) {
+        fb_copy_tests(threads);
+        fb_solid_test(threads);
+    }
+
+    t.src_bits = make_bits(1, WIDTH * HEIGHT);
+    t.dst_bits = make_bits(2, WIDTH * HEIGHT);
+    mask_bits = make_bits(3, WIDTH * HEIGHT);
+    orig = make_bits(2, WIDTH * HEIGHT);
+    reference = malloc(WIDTH * HEIGHT * 4);
+    assert(reference);
+
+    t.src = pixman_image_create_bits(PIXMAN_a8r8g8b8, WIDTH, HEIGHT,
+                                     t.src_bits, WIDTH * 4);
+    t.mask = pixman_image_create_bits(PIXMAN_a8r8g8b8, WIDTH, HEIGHT,
+                                      mask_bits, WIDTH * 4);
+    pixman_image_set_component_alpha(t.mask, TRUE);
+    t.dst = pixman_image_create_bits(PIXMAN_a8r8g8b8, WIDTH, HEIGHT,
+                                     t.dst_bits, WIDTH * 4);
+    /* an odd rectangle, so bands do not line up with anything */
+    t.x = 3;
+    t.y = 5;
+    t.width = WIDTH - 7;
+
+    for (op = op_composite; op <= op_copy; op++) {
+        memcpy(t.dst_bits, orig, WIDTH * HEIGHT * 4);
+        single = run(&t, 1, op, repeat);
+        memcpy(reference, t.dst_bits, WIDTH * HEIGHT * 4);
+        if (bench)
+            printf("%dx%d %-9s 1 thread  %6.2f ms\n", WIDTH, HEIGHT,
+                   names[op], single / 1000.0);
+
+        for (threads = 2; threads <= (bench ? ncpus : 2); threads++) {
+            memcpy(t.dst_bits, orig, WIDTH * HEIGHT * 4);
+            usec = run(&t, threads, op, repeat);
+            assert(memcmp(t.dst_bits, reference, WIDTH * HEIGHT * 4) == 0);
+            if (bench)
+                printf("%dx%d %-9s %d threads %6.2f ms (%.2fx)\n", WIDTH,
+                       HEIGHT, names[op], threads, usec / 1000.0,
+                       (double) single / max(usec, 1));
+        }
+    }
+
+    pixman_image_unref(t.src);
+    pixman_image_unref(t.mask);
+    pixman_image_unref(t.dst);
+    free(t.src_bits);
+    free(t.dst_bits);
+    free(mask_bits);
+    free(orig);
+    free(reference);
+
+    return 0;
+}
@@ -0,0 +1,432 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include <X11/extensions/shapeconst.h>
+#include "misc.h"
+#include "os.h"
+#include "regionstr.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+#include "inputstr.h"
+#include "mi.h"
+
+/**
+ * Map, unmap, restack, move and resize a few hundred overlapping top-level
+ * windows, some with borders, input shapes or unhittable, and check after
+ * each change that miXYToWindow finds the same window as a plain walk of
+ * the root's children, at random points and on either side of window
+ * edges.  The root is not a multiple of the grid's cell size, and for a
+ * while there are too few mapped windows for the grid to be used.
+ */
+
+#define NUM_WINDOWS     300
+#define NUM_OPS         600
+#define NUM_POINTS      500
+#define ROOT_WIDTH      1000
+#define ROOT_HEIGHT     700
+
+static ScreenRec screen;
+static WindowRec root;
+static WindowRec windows[NUM_WINDOWS];
+static WindowOptRec optional[NUM_WINDOWS];
+static SpriteRec sprite;
+
+static Bool
+test_position_window(WindowPtr pWin, int x, int y)
+{
+    return TRUE;
+}
+
+static void
+test_copy_window(WindowPtr pWin, DDXPointRec ptOldOrg, RegionPtr prgnSrc)
+{
+}
+
+static void
+test_window_exposures(WindowPtr pWin, RegionPtr prgn)
+{
+}
+
+static void
+test_paint_window(WindowPtr pWin, RegionPtr prgn, int what)
+{
+}
+
+static void
+init_window(WindowPtr pWin, WindowPtr pParent, int x, int y, int w, int h,
+            int bw)
+{
+    pWin->parent = pParent;
+    pWin->drawable.type = DRAWABLE_WINDOW;
+    pWin->drawable.class = InputOutput;
+    pWin->drawable.depth = 24;
+    pWin->drawable.pScreen = &screen;
+    pWin->drawable.x = x + bw;
+    pWin->drawable.y = y + bw;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->origin.x = x + bw;
+    pWin->origin.y = y + bw;
+    pWin->borderWidth = bw;
+    pWin->borderIsPixel = TRUE;
+    pWin->visibility = VisibilityNotViewable;
+    RegionNull(&pWin->clipList);
+    RegionNull(&pWin->borderClip);
+    RegionNull(&pWin->winSize);
+    RegionNull(&pWin->borderSize);
+    if (pParent) {
+        SetWinSize(pWin);
+        SetBorderSize(pWin);
+    }
+}
+
+static void
+pick_init(void)
+{
+    BoxRec box = { 0, 0, ROOT_WIDTH, ROOT_HEIGHT };
+    WindowPtr pWin;
+    int i, bw;
+
+    dixResetPrivates();
+    memset(&screen, 0, sizeof(screen));
+    screenInfo.numScreens = 1;
+    screenInfo.screens[0] = &screen;
+    assert(miPickInit(&screen));
+
+    screen.MarkWindow = miMarkWindow;
+    screen.MarkOverlappedWindows = miMarkOverlappedWindows;
+    screen.MarkUnrealizedWindow = miMarkUnrealizedWindow;
+    screen.ValidateTree = miValidateTree;
+    screen.HandleExposures = miHandleValidateExposures;
+    screen.PositionWindow = test_position_window;
+    screen.CopyWindow = test_copy_window;
+    screen.WindowExposures = test_window_exposures;
+    screen.PaintWindow = test_paint_window;
+    screen.root = &root;
+    screen.width = ROOT_WIDTH;
+    screen.height = ROOT_HEIGHT;
+
+    init_window(&root, NullWindow, 0, 0, ROOT_WIDTH, ROOT_HEIGHT, 0);
+    RegionReset(&root.winSize, &box);
+    RegionReset(&root.borderSize, &box);
+    RegionCopy(&root.clipList, &root.winSize);
+    RegionCopy(&root.borderClip, &root.winSize);
+    root.mapped = root.realized = root.viewable = TRUE;
+    root.visibility = VisibilityUnobscured;
+
+    /* all unmapped, anywhere from a pixel to half the root, some off it */
+    srandom(NUM_WINDOWS);
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        pWin = &windows[i];
+        bw = random() % 4 ? 0 : 1 + random() % 5;
+        init_window(pWin, &root,
+                    random() % (ROOT_WIDTH + 100) - 100,
+                    random() % (ROOT_HEIGHT + 100) - 100,
+                    1 + random() % (i % 10 ? 80 : ROOT_WIDTH / 2),
+                    1 + random() % (i % 10 ? 80 : ROOT_HEIGHT / 2), bw);
+        pWin->optional = &optional[i];
+        pWin->prevSib = root.lastChild;
+        if (root.lastChild)
+            root.lastChild->nextSib = pWin;
+        else
+            root.firstChild = pWin;
+        root.lastChild = pWin;
+    }
+
+    sprite.spriteTraceSize = 1;
+    sprite.spriteTrace = calloc(sprite.spriteTraceSize, sizeof(WindowPtr));
+    assert(sprite.spriteTrace);
+    sprite.spriteTrace[0] = &root;
+}
+
+static void
+pick_fini(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        if (optional[i].inputShape)
+            RegionDestroy(optional[i].inputShape);
+        RegionUninit(&windows[i].clipList);
+        RegionUninit(&windows[i].borderClip);
+        RegionUninit(&windows[i].winSize);
+        RegionUninit(&windows[i].borderSize);
+    }
+    RegionUninit(&root.clipList);
+    RegionUninit(&root.borderClip);
+    RegionUninit(&root.winSize);
+    RegionUninit(&root.borderSize);
+    free(sprite.spriteTrace);
+    miPickFini(&screen);
+}
+
+/* What dix does for a MapWindow on a top-level window without children */
+static void
+map_window(WindowPtr pWin)
+{
+    WindowPtr pLayerWin;
+
+    pWin->mapped = TRUE;
+    pWin->realized = TRUE;
+    pWin->viewable = TRUE;
+    if ((*screen.MarkOverlappedWindows) (pWin, pWin, &pLayerWin)) {
+        (*screen.ValidateTree) (&root, pLayerWin, VTMap);
+        (*screen.HandleExposures) (&root);
+    }
+}
+
+/* and for an UnmapWindow */
+static void
+unmap_window(WindowPtr pWin)
+{
+    WindowPtr pLayerWin;
+
+    (*screen.MarkOverlappedWindows) (pWin, pWin->nextSib, &pLayerWin);
+    (*screen.MarkWindow) (&root);
+    pWin->mapped = FALSE;
+    pWin->realized = FALSE;
+    pWin->viewable = FALSE;
+    (*screen.MarkUnrealizedWindow) (pWin, pWin, FALSE);
+    (*screen.ValidateTree) (&root, pWin, VTUnmap);
+    (*screen.HandleExposures) (&root);
+}
+
+/* and for a ConfigureWindow with only a stack mode */
+static void
+restack_window(WindowPtr pWin, WindowPtr pSib)
+{
+    WindowPtr pFirstChange, pLayerWin;
+
+    if (pSib == pWin)
+        pSib = pWin->nextSib;
+    pFirstChange = MoveWindowInStack(pWin, pSib);
+    if (pWin->viewable &&
+        (*screen.MarkOverlappedWindows) (pWin, pFirstChange, &pLayerWin)) {
+        (*screen.ValidateTree) (&root, pFirstChange, VTStack);
+        (*screen.HandleExposures) (&root);
+    }
+}
+
+static void
+configure_window(WindowPtr pWin)
+{
+    int x = pWin->origin.x - wBorderWidth(pWin) + random() % 129 - 64;
+    int y = pWin->origin.y - wBorderWidth(pWin) + random() % 129 - 64;
+
+    if (random() % 2)
+        miMoveWindow(pWin, x, y, pWin->nextSib, VTMove);
+    else
+        miResizeWindow(pWin, x, y, 1 + random() % 200,
+                       1 + random() % 200, pWin->nextSib);
+}
+
+/* Toggle an input shape of one or two boxes, leaving holes in the window */
+static void
+shape_window(WindowPtr pWin)
+{
+    BoxRec boxes[2];
+    int i;
+
+    if (wInputShape(pWin)) {
+        RegionDestroy(wInputShape(pWin));
+        pWin->optional->inputShape = NULL;
+    }
+    else {
+        for (i = 0; i < 2; i++) {
+            boxes[i].x1 = random() % pWin->drawable.width;
+            boxes[i].y1 = random() % pWin->drawable.height;
+            boxes[i].x2 = boxes[i].x1 + 1 + random() % pWin->drawable.width;
+            boxes[i].y2 = boxes[i].y1 + 1 + random() % pWin->drawable.height;
+        }
+        pWin->optional->inputShape = RegionCreate(&boxes[0], 1);
+        assert(pWin->optional->inputShape);
+        if (random() % 2) {
+            RegionRec extra;
+
+            RegionInit(&extra, &boxes[1], 1);
+            assert(RegionUnion(wInputShape(pWin), wInputShape(pWin), &extra));
+            RegionUninit(&extra);
+        }
+    }
+    miSetShape(pWin, ShapeInput);
+}
+
+/* What rootless does when a window goes on or off screen */
+static void
+hide_window(WindowPtr pWin)
+{
+    pWin->unhittable = !pWin->unhittable;
+    miPickInvalidate(&screen);
+}
+
+static void
+random_op(void)
+{
+    WindowPtr pWin = &windows[random() % NUM_WINDOWS];
+
+    switch (random() % 6) {
+    case 0:
+        if (pWin->mapped)
+            unmap_window(pWin);
+        else
+            map_window(pWin);
+        break;
+    case 1:
+        restack_window(pWin, root.firstChild);
+        break;
+    case 2:
+        restack_window(pWin, &windows[random() % NUM_WINDOWS]);
+        break;
+    case 3:
+        configure_window(pWin);
+        break;
+    case 4:
+        shape_window(pWin);
+        break;
+    case 5:
+        if (random() % 4 == 0)
+            hide_window(pWin);
+        break;
+    }
+}
+
+/* Where the pointer would be found without the grid */
+static WindowPtr
+walk_xy(int x, int y)
+{
+    WindowPtr pWin;
+    BoxRec box;
+    int bw;
+
+    for (pWin = root.firstChild; pWin; pWin = pWin->nextSib) {
+        bw = wBorderWidth(pWin);
+        if (pWin->mapped && !pWin->unhittable &&
+            x >= pWin->drawable.x - bw &&
+            x < pWin->drawable.x + (int) pWin->drawable.width + bw &&
+            y >= pWin->drawable.y - bw &&
+            y < pWin->drawable.y + (int) pWin->drawable.height + bw &&
+            (!wInputShape(pWin) ||
+             RegionContainsPoint(wInputShape(pWin), x - pWin->drawable.x,
+                                 y - pWin->drawable.y, &box)))
+            return pWin;
+    }
+    return &root;
+}
+
+static void
+check_xy(int x, int y)
+{
+    WindowPtr pWin;
+
+    if (x < 0 || x >= ROOT_WIDTH || y < 0 || y >= ROOT_HEIGHT)
+        return;
+    pWin = walk_xy(x, y);
+    assert(miXYToWindow(&screen, &sprite, x, y) == pWin);
+    assert(sprite.spriteTraceGood == (pWin == &root ? 1 : 2));
+}
+
+/* Just inside and outside each corner of pWin's border */
+static void
+check_edges(WindowPtr pWin)
+{
+    int bw = wBorderWidth(pWin);
+    int xs[] = {
+        pWin->drawable.x - bw - 1, pWin->drawable.x - bw,
+        pWin->drawable.x + pWin->drawable.width + bw - 1,
+        pWin->drawable.x + pWin->drawable.width + bw
+    };
+    int ys[] = {
+        pWin->drawable.y - bw - 1, pWin->drawable.y - bw,
+        pWin->drawable.y + pWin->drawable.height + bw - 1,
+        pWin->drawable.y + pWin->drawable.height + bw
+    };
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(xs); i++)
+        for (j = 0; j < ARRAY_SIZE(ys); j++)
+            check_xy(xs[i], ys[j]);
+}
+
+static void
+check_pick(Bool all_edges)
+{
+    int i;
+
+    for (i = 0; i < NUM_POINTS; i++)
+        check_xy(random() % ROOT_WIDTH, random() % ROOT_HEIGHT);
+    for (i = 0; i < NUM_WINDOWS; i++)
+        if (all_edges || windows[i].mapped)
+            check_edges(&windows[i]);
+}
+
+static void
+pick_test(void)
+{
+    int i;
+
+    pick_init();
+
+    /* one by one, past the point where the grid kicks in */
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        map_window(&windows[i]);
+        if (i < 64 || i % 16 == 0)
+            check_pick(FALSE);
+    }
+    check_pick(TRUE);
+
+    for (i = 0; i < NUM_OPS; i++) {
+        random_op();
+        check_pick(i % 50 == 0);
+    }
+
+    /* down to a handful and back */
+    for (i = 0; i < NUM_WINDOWS - 8; i++) {
+        if (windows[i].mapped)
+            unmap_window(&windows[i]);
+        if (i % 16 == 0)
+            check_pick(FALSE);
+    }
+    check_pick(TRUE);
+    for (i = 0; i < NUM_WINDOWS; i++)
+        if (!windows[i].mapped)
+            map_window(&windows[i]);
+    check_pick(TRUE);
+
+    pick_fini();
+}
+
+int
+main(int argc, char **argv)
+{
+    pick_test();
+
+    return 0;
+}
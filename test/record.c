@@ -0,0 +1,405 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include <X11/extensions/recordproto.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "extinit.h"
+#include "extnsionst.h"
+#include "privates.h"
+#include "protocol-versions.h"
+#include "recordshm.h"
+
+/**
+ * Record a couple of clients into a shared memory ring, with
+ * WriteToClient, WriteFdToClient, IgnoreClient and AttendClient
+ * wrapped.  Overflow the ring, let one of the recorded clients go away
+ * while it is held back and another take its slot, then disable the
+ * context with replies still queued.  Everything the ring received
+ * must parse as whole replies matching what was recorded, whatever
+ * did not make it must be counted in lost, and every client that was
+ * ignored must be attended to exactly once.  The recorder scribbling
+ * over the header must not make the server write outside the ring.
+ */
+
+#define RING_SIZE       RECORD_SHM_MIN_SIZE
+
+static ClientRec server_client, recorder, client_a, client_b, client_c;
+static int record_base;
+
+static int reply_fd = -1;
+static char reply[64];
+
+static RecordShmHeaderRec *shm;
+static char *ring;
+static size_t map_size;
+
+/* What the recorder has read out of the ring so far */
+static char *stream;
+static size_t stream_len, stream_size;
+
+/* What it should find there, one entry per reply */
+typedef struct {
+    int category;
+    ClientPtr client;
+    int len;                    /* of the recorded request */
+    int fill;
+} Expected;
+
+static Expected expected[64];
+static int num_expected;
+static CARD32 expected_lost;
+
+void
+__wrap_WriteToClient(ClientPtr client, int len, void *data)
+{
+    assert(client == &recorder);
+    assert(len <= sizeof(reply));
+    memcpy(reply, data, len);
+}
+
+int
+__wrap_WriteFdToClient(ClientPtr client, int fd, Bool do_close)
+{
+    assert(client == &recorder);
+    assert(do_close);
+    reply_fd = fd;
+    return 0;
+}
+
+void
+__wrap_IgnoreClient(ClientPtr client)
+{
+    client->ignoreCount++;
+}
+
+void
+__wrap_AttendClient(ClientPtr client)
+{
+    assert(client->ignoreCount > 0);
+    client->ignoreCount--;
+}
+
+static void
+init_test_client(ClientPtr client, int i)
+{
+    memset(client, 0, sizeof(*client));
+    InitClient(client, i, (void *) NULL);
+    assert(dixAllocatePrivates(&client->devPrivates, PRIVATE_CLIENT));
+    client->requestVector = ProcVector;
+    client->clientState = ClientStateRunning;
+    clients[i] = client;
+}
+
+static void
+record_init(void)
+{
+    ExtensionEntry *ext;
+
+    dixResetPrivates();
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    if (!InitClientResources(serverClient))
+        FatalError("couldn't init server resources");
+    RecordExtensionInit();
+    ext = CheckExtension(RECORD_NAME);
+    assert(ext);
+    record_base = ext->base;
+
+    init_test_client(&recorder, 1);
+    assert(InitClientResources(&recorder));
+    init_test_client(&client_a, 2);
+    init_test_client(&client_b, 3);
+}
+
+static int
+dispatch(void *req, int len)
+{
+    xReq *r = req;
+
+    r->reqType = record_base;
+    r->length = len / 4;
+    recorder.requestBuffer = req;
+    recorder.req_len = len / 4;
+    return ProcVector[record_base] (&recorder);
+}
+
+/* A NoOperation of len bytes from client, as Dispatch would run it */
+static void
+send_request(ClientPtr client, int len, int fill)
+{
+    char *buf = malloc(len);
+    xReq *req = (xReq *) buf;
+
+    assert(buf);
+    memset(buf, fill, len);
+    req->reqType = X_NoOperation;
+    req->length = len / 4;
+    client->requestBuffer = buf;
+    client->req_len = len / 4;
+    client->majorOp = X_NoOperation;
+    client->sequence++;
+    assert((*client->requestVector[X_NoOperation]) (client) == Success);
+    CallCallbacks(&FlushCallback, NULL);
+    free(buf);
+
+    expected[num_expected++] = (Expected) {
+        XRecordFromClient, client, len, fill
+    };
+}
+
+static void
+query_version(void)
+{
+    xRecordQueryVersionReq req = {
+        .recordReqType = X_RecordQueryVersion,
+        .majorVersion = SERVER_RECORD_MAJOR_VERSION,
+        .minorVersion = SERVER_RECORD_MINOR_VERSION,
+    };
+    xRecordQueryVersionReply *rep = (xRecordQueryVersionReply *) reply;
+
+    assert(dispatch(&req, sizeof(req)) == Success);
+    assert(rep->majorVersion == SERVER_RECORD_MAJOR_VERSION);
+    assert(rep->minorVersion == SERVER_RECORD_MINOR_VERSION);
+}
+
+static XID
+create_context(void)
+{
+    struct {
+        xRecordCreateContextReq req;
+        CARD32 clients[2];
+        xRecordRange range;
+    } r = {
+        .req.recordReqType = X_RecordCreateContext,
+        .req.context = recorder.clientAsMask | 1,
+        .req.nClients = 2,
+        .req.nRanges = 1,
+        .clients = { client_a.clientAsMask, client_b.clientAsMask },
+        .range.coreRequestsFirst = X_NoOperation,
+        .range.coreRequestsLast = X_NoOperation,
+        .range.clientDied = xTrue,
+    };
+
+    assert(dispatch(&r, sizeof(r)) == Success);
+    return r.req.context;
+}
+
+static int
+enable_context_shm(XID context)
+{
+    xRecordEnableContextShmReq req = {
+        .recordReqType = X_RecordEnableContextShm,
+        .context = context,
+        .size = 0,
+    };
+
+    return dispatch(&req, sizeof(req));
+}
+
+static void
+disable_context(XID context)
+{
+    xRecordDisableContextReq req = {
+        .recordReqType = X_RecordDisableContext,
+        .context = context,
+    };
+
+    assert(dispatch(&req, sizeof(req)) == Success);
+    expected[num_expected++] = (Expected) { XRecordEndOfData };
+}
+
+/* Move whatever is in the ring to the stream, as a recorder would */
+static void
+read_ring(void)
+{
+    CARD32 head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+    CARD32 tail = shm->tail;
+    CARD32 at;
+
+    assert(head - tail <= RING_SIZE);
+    if (stream_len + (head - tail) > stream_size) {
+        stream_size = (stream_len + (head - tail)) * 2;
+        stream = realloc(stream, stream_size);
+        assert(stream);
+    }
+    for (; tail != head; tail++) {
+        at = tail & (RING_SIZE - 1);
+        stream[stream_len++] = ring[at];
+    }
+    __atomic_store_n(&shm->tail, tail, __ATOMIC_RELEASE);
+}
+
+/* Read and let the server move its backlog in until it is empty */
+static void
+drain(void)
+{
+    CARD32 head;
+
+    do {
+        read_ring();
+        head = shm->head;
+        CallCallbacks(&FlushCallback, NULL);
+    } while (shm->head != head);
+}
+
+/* The stream must hold exactly the expected replies, whole */
+static void
+check_stream(void)
+{
+    xRecordEnableContextReply *rep;
+    size_t off = 0;
+    int i, j, len;
+    unsigned char *data;
+
+    for (i = 0; i < num_expected; i++) {
+        assert(off + sizeof(*rep) <= stream_len);
+        rep = (xRecordEnableContextReply *) (stream + off);
+        data = (unsigned char *) (rep + 1);
+        assert(rep->type == X_Reply);
+        assert(rep->category == expected[i].category);
+        assert(off + sizeof(*rep) + rep->length * 4 <= stream_len);
+
+        len = expected[i].len;
+        assert(rep->length * 4 == len);
+        if (expected[i].client) {
+            assert(rep->idBase == expected[i].client->clientAsMask);
+            assert(data[0] == X_NoOperation);
+            for (j = 4; j < len; j++)
+                assert(data[j] == expected[i].fill);
+        }
+        off += sizeof(*rep) + len;
+    }
+    assert(off == stream_len);
+    assert(shm->lost == expected_lost);
+}
+
+static void
+record_shm_test(void)
+{
+    xRecordEnableContextShmReply *rep = (xRecordEnableContextShmReply *) reply;
+    NewClientInfoRec info = { .client = &client_b };
+    XID context;
+    CARD32 head;
+    int i;
+
+    /* the advertised version does not change */
+    query_version();
+    context = create_context();
+    assert(enable_context_shm(context) == Success);
+
+    assert(reply_fd >= 0);
+    assert(rep->nfd == 1);
+    assert(rep->size == RING_SIZE);
+    map_size = rep->offset + rep->size;
+    shm = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+               reply_fd, 0);
+    assert(shm != MAP_FAILED);
+    assert(shm->magic == RECORD_SHM_MAGIC);
+    assert(shm->size == RING_SIZE);
+    ring = (char *) shm + rep->offset;
+    expected[num_expected++] = (Expected) { XRecordStartOfData };
+
+    /* only tail is read back, and one ahead of head leaves no room */
+    shm->size = ~0;
+    shm->lost = ~0;
+    head = shm->head;
+    shm->tail = head + 4;
+    send_request(&client_a, 16384, 'a');
+    assert(client_a.ignoreCount == 1);
+    assert(shm->head == head);
+    shm->tail = 0;
+    shm->lost = 0;
+    CallCallbacks(&FlushCallback, NULL);
+    assert(client_a.ignoreCount == 0);
+
+    /* three go straight in, the fourth holds client_a back */
+    for (i = 1; i < 4; i++)
+        send_request(&client_a, 16384, 'a' + i);
+    assert(client_a.ignoreCount == 1);
+    send_request(&client_b, 16384, 'B');
+    assert(client_b.ignoreCount == 1);
+
+    /* way past the cap on the backlog, but none of it is lost */
+    for (i = 0; i < 3; i++)
+        send_request(&client_a, 102400, 'e' + i);
+    assert(client_a.ignoreCount == 1);
+    assert(shm->lost == 0);
+
+    /* client_b goes away while held back, its ClientDied cannot be held
+     * back and is over the cap, and client_c takes over its slot */
+    client_b.clientState = ClientStateGone;
+    client_b.clientGone = TRUE;
+    CallCallbacks(&ClientStateCallback, &info);
+    expected_lost += sizeof(xRecordEnableContextReply);
+    init_test_client(&client_c, client_b.index);
+
+    drain();
+    assert(client_a.ignoreCount == 0);
+    assert(client_b.ignoreCount == 1);
+    assert(client_c.ignoreCount == 0);
+
+    /* disable with a reply half in the ring, and more queued after it
+     * than the ring can take at once */
+    send_request(&client_a, 102400, 'h');
+    send_request(&client_a, 40960, 'i');
+    assert(client_a.ignoreCount == 1);
+    read_ring();
+    disable_context(context);
+    assert(client_a.ignoreCount == 0);
+    assert(shm->flags & RECORD_SHM_END);
+
+    /* the last request and EndOfData did not fit */
+    expected_lost += 2 * sizeof(xRecordEnableContextReply) + 40960;
+    num_expected -= 2;
+    read_ring();
+    check_stream();
+
+    munmap(shm, map_size);
+    close(reply_fd);
+    free(stream);
+}
+
+int
+main(int argc, char **argv)
+{
+#if defined(XTRANS_SEND_FDS) && defined(HAVE_MEMFD_CREATE)
+    record_init();
+    record_shm_test();
+    return 0;
+#else
+    return 77;
+#endif
+}
@@ -0,0 +1,230 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "misc.h"
+#include "os.h"
+#include "resource.h"
+#include "dix.h"
+#include "dixstruct.h"
+
+/**
+ * Exercise the per-client resource table with 1e3 up to 1e6 resources
+ * owned by one client.  With XSERVER_TEST_BENCHMARK set in the
+ * environment, also time insert, lookup and free.
+ */
+
+static ClientRec server_client;
+static ClientRec test_client;
+static RESTYPE test_type, test_type2;
+static int deleted;
+
+static int
+test_delete(void *value, XID id)
+{
+    deleted++;
+    return Success;
+}
+
+static void
+count_resource(void *value, XID id, void *cdata)
+{
+    int *count = cdata;
+
+    (*count)++;
+}
+
+static void
+resource_init(void)
+{
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    if (!InitClientResources(serverClient))
+        FatalError("couldn't init server resources");
+
+    test_type = CreateNewResourceType(test_delete, "TestResource");
+    test_type2 = CreateNewResourceType(test_delete, "TestResource2");
+    assert(test_type && test_type2);
+
+    InitClient(&test_client, 1, (void *) NULL);
+    assert(InitClientResources(&test_client));
+}
+
+static XID
+test_id(int i)
+{
+    return test_client.clientAsMask | (XID) (i + 1);
+}
+
+struct walk_state {
+    unsigned char *seen;
+    int next;                   /* next id to add during the walk */
+    int grow;                   /* resources added per visit */
+};
+
+static void
+walk_resource(void *value, XID id, void *cdata)
+{
+    struct walk_state *walk = cdata;
+    int i;
+
+    walk->seen[(intptr_t) value]++;
+    for (i = 0; i < walk->grow; i++)
+        assert(AddResource(test_id(walk->next++), test_type2, NULL));
+}
+
+static void
+resource_table_test(int n)
+{
+    void *value;
+    int i, count;
+
+    deleted = 0;
+    for (i = 0; i < n; i++)
+        assert(AddResource(test_id(i), test_type, (void *) (intptr_t) i));
+
+    for (i = 0; i < n; i++) {
+        assert(dixLookupResourceByType(&value, test_id(i), test_type,
+                                       NULL, DixReadAccess) == Success);
+        assert(value == (void *) (intptr_t) i);
+    }
+    assert(dixLookupResourceByType(&value, test_id(n), test_type,
+                                   NULL, DixReadAccess) != Success);
+
+    count = 0;
+    FindClientResourcesByType(&test_client, test_type, count_resource, &count);
+    assert(count == n);
+
+    /* several resources may share an id */
+    assert(AddResource(test_id(0), test_type2, NULL));
+    assert(dixLookupResourceByType(&value, test_id(0), test_type,
+                                   NULL, DixReadAccess) == Success);
+    FreeResourceByType(test_id(0), test_type2, FALSE);
+    assert(deleted == 1);
+    assert(dixLookupResourceByType(&value, test_id(0), test_type2,
+                                   NULL, DixReadAccess) != Success);
+    assert(dixLookupResourceByType(&value, test_id(0), test_type,
+                                   NULL, DixReadAccess) == Success);
+
+    assert(ChangeResourceValue(test_id(1), test_type, &count));
+    assert(dixLookupResourceByType(&value, test_id(1), test_type,
+                                   NULL, DixReadAccess) == Success);
+    assert(value == &count);
+
+    /* free every other resource, then make sure the rest survive */
+    for (i = 0; i < n; i += 2)
+        FreeResource(test_id(i), RT_NONE);
+    assert(deleted == 1 + (n + 1) / 2);
+    for (i = 0; i < n; i++)
+        assert((dixLookupResourceByType(&value, test_id(i), test_type,
+                                        NULL, DixReadAccess) == Success)
+               == (i & 1));
+
+    FreeClientResources(&test_client);
+    assert(deleted == 1 + n);
+    assert(InitClientResources(&test_client));
+}
+
+/*
+ * Resources added from the walk callback push the table through a
+ * rebuild; the walk must pick up where it was and see every resource
+ * that was there when it started exactly once.
+ */
+static void
+resource_walk_test(int n, int grow)
+{
+    struct walk_state walk;
+    int i;
+
+    for (i = 0; i < n; i++)
+        assert(AddResource(test_id(i), test_type, (void *) (intptr_t) i));
+
+    walk.seen = calloc(n, 1);
+    walk.next = n;
+    walk.grow = grow;
+    assert(walk.seen);
+    FindClientResourcesByType(&test_client, test_type, walk_resource, &walk);
+    for (i = 0; i < n; i++)
+        assert(walk.seen[i] == 1);
+    free(walk.seen);
+
+    FreeClientResources(&test_client);
+    assert(InitClientResources(&test_client));
+}
+
+static void
+resource_bench(int n)
+{
+    CARD64 start, insert, lookup, removal;
+    void *value;
+    int i;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < n; i++)
+        AddResource(test_id(i), test_type, NULL);
+    insert = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < n; i++)
+        dixLookupResourceByType(&value, test_id(i), test_type,
+                                NULL, DixReadAccess);
+    lookup = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < n; i++)
+        FreeResource(test_id(i), RT_NONE);
+    removal = GetTimeInMicros() - start;
+
+    printf("%8d resources: insert %6.1f ns, lookup %6.1f ns, free %6.1f ns\n",
+           n, insert * 1000.0 / n, lookup * 1000.0 / n, removal * 1000.0 / n);
+}
+
+int
+main(int argc, char **argv)
+{
+    int n;
+
+    resource_init();
+
+    for (n = 1000; n <= 1000000; n *= 10)
+        resource_table_test(n);
+
+    for (n = 100; n <= 10000; n *= 10) {
+        resource_walk_test(n, 0);
+        resource_walk_test(n, 1);
+        resource_walk_test(n + n / 3, 1);
+        resource_walk_test(n, 2);
+    }
+
+    if (getenv("XSERVER_TEST_BENCHMARK"))
+        for (n = 1000; n <= 1000000; n *= 10)
+            resource_bench(n);
+
+    return 0;
+}
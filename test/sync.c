@@ -0,0 +1,376 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <X11/X.h>
+#include <X11/extensions/syncproto.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "extinit.h"
+#include "extnsionst.h"
+#include "resource.h"
+#include "scrnintstr.h"
+#include "syncsrv.h"
+
+/**
+ * Create thousands of alarms on a system counter, move the counter around
+ * and change and destroy alarms at random, and check every alarm's test
+ * value and the counter's bracket values against a straightforward model
+ * of the protocol.
+ */
+
+#define NUM_ALARMS      4000
+#define NUM_STEPS       3000
+#define RANGE           (1LL << 36)
+
+typedef struct {
+    XID id;
+    int live;
+    int type;
+    int64_t value;
+    int64_t delta;
+} TestAlarm;
+
+static TestAlarm alarms[NUM_ALARMS];
+static ClientRec client;
+static SyncCounter *counter;
+static int64_t counter_value;
+static int sync_base;
+
+static struct {
+    int has_less, has_greater;
+    int64_t less, greater;
+} brackets;
+
+static int64_t
+from_sync(CARD64 v)
+{
+    return (int64_t) (((uint64_t) XSyncValueHigh32(v) << 32) |
+                      XSyncValueLow32(v));
+}
+
+static CARD64
+to_sync(int64_t v)
+{
+    CARD64 r;
+
+    XSyncIntsToValue(&r, (unsigned int) v, (int) (v >> 32));
+    return r;
+}
+
+static int64_t
+random_value(void)
+{
+    return (((int64_t) random() << 16) ^ random()) % RANGE - RANGE / 2;
+}
+
+static void
+test_query_value(void *pCounter, CARD64 *value_return)
+{
+    *value_return = to_sync(counter_value);
+}
+
+static void
+test_bracket_values(void *pCounter, CARD64 *pless, CARD64 *pgreater)
+{
+    brackets.has_less = pless != NULL;
+    brackets.has_greater = pgreater != NULL;
+    if (pless)
+        brackets.less = from_sync(*pless);
+    if (pgreater)
+        brackets.greater = from_sync(*pgreater);
+}
+
+/* The model */
+
+static Bool
+model_check(int type, int64_t test, int64_t oldval, int64_t newval)
+{
+    switch (type) {
+    case XSyncPositiveTransition:
+        return oldval < test && newval >= test;
+    case XSyncNegativeTransition:
+        return oldval > test && newval <= test;
+    case XSyncPositiveComparison:
+        return newval >= test;
+    default:
+        return newval <= test;
+    }
+}
+
+static void
+model_fire(TestAlarm *a)
+{
+    do
+        a->value += a->delta;
+    while (model_check(a->type, a->value, counter_value, counter_value));
+}
+
+static void
+check_model(void)
+{
+    int64_t less = INT64_MIN, greater = INT64_MAX;
+    int has_less = 0, has_greater = 0;
+    int i, seen = 0;
+
+    for (i = 0; i < NUM_ALARMS; i++) {
+        TestAlarm *a = &alarms[i];
+        SyncAlarm *pAlarm;
+        Bool above, below;
+
+        if (!a->live)
+            continue;
+        seen++;
+
+        assert(dixLookupResourceByClass((void **) &pAlarm, a->id,
+                                        RC_ANY, NULL, DixReadAccess) ==
+               Success);
+        assert(from_sync(pAlarm->trigger.test_value) == a->value);
+        assert(pAlarm->state == XSyncAlarmActive);
+
+        /* an exact hit on a transition's threshold counts as a bound */
+        above = a->value > counter_value ||
+            (a->type == XSyncPositiveTransition && a->value == counter_value);
+        below = a->value < counter_value ||
+            (a->type == XSyncNegativeTransition && a->value == counter_value);
+        if (above && a->value < greater) {
+            greater = a->value;
+            has_greater = 1;
+        }
+        else if (below && a->value > less) {
+            less = a->value;
+            has_less = 1;
+        }
+    }
+    assert(seen > 0);
+
+    assert(brackets.has_greater == has_greater);
+    assert(brackets.has_less == has_less);
+    if (has_greater)
+        assert(brackets.greater == greater);
+    if (has_less)
+        assert(brackets.less == less);
+}
+
+/* Requests */
+
+static int
+dispatch(void *req, int len)
+{
+    xReq *r = req;
+
+    r->reqType = sync_base;
+    r->length = len / 4;
+    client.requestBuffer = req;
+    client.req_len = len / 4;
+    return ProcVector[sync_base] (&client);
+}
+
+static void
+set_attributes(CARD32 *values, TestAlarm *a)
+{
+    values[0] = XSyncAbsolute;
+    values[1] = (CARD32) (a->value >> 32);
+    values[2] = (CARD32) a->value;
+    values[3] = a->type;
+    values[4] = (CARD32) (a->delta >> 32);
+    values[5] = (CARD32) a->delta;
+    values[6] = xFalse;
+}
+
+static void
+random_alarm(TestAlarm *a)
+{
+    a->type = random() % 4;
+    a->value = random_value();
+    /* big enough steps that firing never loops for long */
+    a->delta = RANGE / 256 + random() % (RANGE / 64);
+    if (a->type == XSyncNegativeTransition ||
+        a->type == XSyncNegativeComparison)
+        a->delta = -a->delta;
+}
+
+static void
+create_alarm(TestAlarm *a, XID id)
+{
+    struct {
+        xSyncCreateAlarmReq req;
+        CARD32 values[8];
+    } r = {
+        .req.syncReqType = X_SyncCreateAlarm,
+        .req.id = id,
+        .req.valueMask = XSyncCACounter | XSyncCAValueType | XSyncCAValue |
+            XSyncCATestType | XSyncCADelta | XSyncCAEvents,
+    };
+
+    random_alarm(a);
+    a->id = id;
+    a->live = 1;
+    r.values[0] = counter->sync.id;
+    set_attributes(&r.values[1], a);
+    assert(dispatch(&r, sizeof(r)) == Success);
+
+    if (model_check(a->type, a->value, counter_value, counter_value))
+        model_fire(a);
+}
+
+static void
+change_alarm(TestAlarm *a)
+{
+    struct {
+        xSyncChangeAlarmReq req;
+        CARD32 values[6];
+    } r = {
+        .req.syncReqType = X_SyncChangeAlarm,
+        .req.alarm = a->id,
+        .req.valueMask = XSyncCAValueType | XSyncCAValue |
+            XSyncCATestType | XSyncCADelta,
+    };
+    CARD32 values[7];
+
+    random_alarm(a);
+    set_attributes(values, a);
+    memcpy(r.values, values, sizeof(r.values));
+    assert(dispatch(&r, sizeof(r)) == Success);
+
+    if (model_check(a->type, a->value, counter_value, counter_value))
+        model_fire(a);
+}
+
+static uint64_t
+change_counter(int64_t newval)
+{
+    int64_t oldval = counter_value;
+    uint64_t start, time;
+    int i;
+
+    counter_value = newval;
+    start = GetTimeInMicros();
+    SyncChangeCounter(counter, to_sync(newval));
+    time = GetTimeInMicros() - start;
+
+    for (i = 0; i < NUM_ALARMS; i++)
+        if (alarms[i].live &&
+            model_check(alarms[i].type, alarms[i].value, oldval, newval))
+            model_fire(&alarms[i]);
+    return time;
+}
+
+static void
+sync_init(void)
+{
+    ExtensionEntry *ext;
+    static ClientRec server_client;
+
+    dixResetPrivates();
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    if (!InitClientResources(serverClient))
+        FatalError("couldn't init server resources");
+    SyncExtensionInit();
+    ext = CheckExtension(SYNC_NAME);
+    assert(ext);
+    sync_base = ext->base;
+
+    InitClient(&client, 1, (void *) NULL);
+    clients[1] = &client;
+    assert(InitClientResources(&client));
+
+    counter = SyncCreateSystemCounter("TEST", to_sync(0), to_sync(1),
+                                      XSyncCounterUnrestricted,
+                                      test_query_value, test_bracket_values);
+    assert(counter);
+}
+
+static void
+sync_trigger_index_test(void)
+{
+    uint64_t time = 0;
+    int i, step, changes = 0;
+
+    srandom(0);
+    for (i = 0; i < NUM_ALARMS; i++)
+        create_alarm(&alarms[i], client.clientAsMask | (i + 1));
+    check_model();
+
+    for (step = 0; step < NUM_STEPS; step++) {
+        TestAlarm *a = &alarms[random() % NUM_ALARMS];
+        int64_t newval;
+
+        switch (random() % 8) {
+        case 0:
+            if (a->live) {
+                FreeResource(a->id, RT_NONE);
+                a->live = 0;
+            }
+            else
+                create_alarm(a, a->id);
+            break;
+        case 1:
+            if (a->live)
+                change_alarm(a);
+            break;
+        case 2:
+            /* no change still fires comparisons */
+            newval = counter_value;
+            goto change;
+        case 3:
+            /* land exactly on a threshold */
+            newval = a->value;
+            goto change;
+        case 4:
+            newval = counter_value + random() % 256;
+            goto change;
+        default:
+            newval = random_value();
+ change:
+            time += change_counter(newval);
+            changes++;
+            break;
+        }
+        check_model();
+    }
+
+    if (getenv("XSERVER_TEST_BENCHMARK"))
+        printf("%d alarms: %.1f us per counter change\n", NUM_ALARMS,
+               (double) time / changes);
+
+    for (i = 0; i < NUM_ALARMS; i++)
+        if (alarms[i].live)
+            FreeResource(alarms[i].id, RT_NONE);
+}
+
+int
+main(int argc, char **argv)
+{
+    sync_init();
+    sync_trigger_index_test();
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "misc.h"
+#include "os.h"
+
+/**
+ * Arm, cancel and run 1e5 timers and check none fires early, late or
+ * after being cancelled.
+ */
+
+#define NUM_TIMERS      100000
+#define MAX_DELAY       500
+
+typedef struct {
+    OsTimerPtr timer;
+    CARD32 deadline;
+    int fired;
+    int rearm;
+} TestTimer;
+
+static TestTimer tests[NUM_TIMERS];
+
+static CARD32
+test_callback(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    TestTimer *t = arg;
+
+    assert(t->timer == timer);
+    assert((INT32) (now - t->deadline) >= 0);
+    /* we check every millisecond; allow for a loaded machine */
+    assert((INT32) (now - t->deadline) < 250);
+    t->fired++;
+    if (t->rearm) {
+        t->rearm--;
+        t->deadline = now + 5;
+        return 5;
+    }
+    return 0;
+}
+
+static void
+run_timers(CARD32 until)
+{
+    while ((INT32) (GetTimeInMillis() - until) <= 0) {
+        TimerCheck();
+        usleep(1000);
+    }
+    TimerCheck();
+}
+
+static void
+timer_wheel_test(void)
+{
+    CARD64 start, set, cancel;
+    CARD32 now;
+    int i, fired;
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        tests[i].fired = 0;
+        tests[i].rearm = (i % 1000) == 0 ? 3 : 0;
+        tests[i].timer = TimerSet(NULL, 0, 0, test_callback, &tests[i]);
+        assert(tests[i].timer);
+    }
+
+    srandom(0);
+    now = GetTimeInMillis();
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_TIMERS; i++) {
+        CARD32 delay = 100 + random() % MAX_DELAY;
+
+        tests[i].deadline = now + delay;
+        TimerSet(tests[i].timer, TimerAbsolute, now + delay,
+                 test_callback, &tests[i]);
+    }
+    set = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 1; i < NUM_TIMERS; i += 2)
+        TimerCancel(tests[i].timer);
+    cancel = GetTimeInMicros() - start;
+
+    run_timers(now + 100 + MAX_DELAY + 20);
+
+    fired = 0;
+    for (i = 0; i < NUM_TIMERS; i++) {
+        if (i & 1)
+            assert(tests[i].fired == 0);
+        else {
+            assert(tests[i].fired == ((i % 1000) == 0 ? 4 : 1));
+            fired++;
+        }
+        TimerFree(tests[i].timer);
+    }
+    assert(fired == NUM_TIMERS / 2);
+
+    if (getenv("XSERVER_TEST_BENCHMARK"))
+        printf("%d timers: set %.1f ns, cancel %.1f ns\n", NUM_TIMERS,
+               set * 1000.0 / NUM_TIMERS,
+               cancel * 1000.0 / (NUM_TIMERS / 2));
+}
+
+static void
+timer_misc_test(void)
+{
+    TestTimer t = { 0 }, far = { 0 };
+    CARD32 now = GetTimeInMillis();
+
+    /* timers beyond the top level of the wheel, and re-arming them */
+    far.deadline = now + 0x7fffffff;
+    far.timer = TimerSet(NULL, 0, 0x7fffffff, test_callback, &far);
+    far.timer = TimerSet(far.timer, 0, 3600 * 1000, test_callback, &far);
+
+    /* an absolute time in the past runs right away */
+    t.deadline = now - 10;
+    t.timer = TimerSet(NULL, 0, 0, test_callback, &t);
+    TimerSet(t.timer, TimerAbsolute, now - 10, test_callback, &t);
+    assert(t.fired == 1);
+
+    /* forcing an armed timer runs it once; a disarmed one not at all */
+    t.deadline = now;
+    TimerSet(t.timer, 0, 50, test_callback, &t);
+    assert(TimerForce(t.timer));
+    assert(t.fired == 2);
+    assert(!TimerForce(t.timer));
+
+    /* TimerForceOld runs the pending callback before re-arming */
+    t.deadline = now;
+    TimerSet(t.timer, 0, 50, test_callback, &t);
+    TimerSet(t.timer, TimerForceOld, 20, test_callback, &t);
+    assert(t.fired == 3);
+    t.deadline = GetTimeInMillis() + 20;
+    run_timers(GetTimeInMillis() + 40);
+    assert(t.fired == 4);
+
+    /* setting a timer to 0 disarms it */
+    TimerSet(t.timer, 0, 10, test_callback, &t);
+    TimerSet(t.timer, 0, 0, test_callback, &t);
+    run_timers(GetTimeInMillis() + 20);
+    assert(t.fired == 4);
+
+    assert(far.fired == 0);
+    TimerFree(far.timer);
+    TimerFree(t.timer);
+}
+
+int
+main(int argc, char **argv)
+{
+    TimerInit();
+    timer_misc_test();
+    timer_wheel_test();
+
+    /* a server reset frees any timers still armed */
+    TimerSet(NULL, 0, 1000, test_callback, NULL);
+    TimerInit();
+
+    return 0;
+}
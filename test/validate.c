@@ -0,0 +1,308 @@
+/**
+ * Copyright © 2016 The X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include "misc.h"
+#include "os.h"
+#include "regionstr.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+#include "mi.h"
+
+/**
+ * Fill a root window with thousands of small top-level windows, restack
+ * and move them at random through the mi window code, and check the clip
+ * lists against ones computed from scratch. Then time restacks and moves
+ * in trees of 1000 to 50000 windows.
+ */
+
+#define NUM_OPS         400
+#define CHECK_WINDOWS   1000
+#define CHECK_EVERY     20
+
+static ScreenRec screen;
+static WindowRec root;
+static WindowPtr windows;
+static int num_windows;
+
+static Bool
+test_position_window(WindowPtr pWin, int x, int y)
+{
+    return TRUE;
+}
+
+static void
+test_copy_window(WindowPtr pWin, DDXPointRec ptOldOrg, RegionPtr prgnSrc)
+{
+}
+
+static void
+test_window_exposures(WindowPtr pWin, RegionPtr prgn)
+{
+}
+
+static void
+test_paint_window(WindowPtr pWin, RegionPtr prgn, int what)
+{
+}
+
+static void
+init_window(WindowPtr pWin, WindowPtr pParent, int x, int y, int w, int h,
+            int bw)
+{
+    pWin->parent = pParent;
+    pWin->drawable.type = DRAWABLE_WINDOW;
+    pWin->drawable.class = InputOutput;
+    pWin->drawable.depth = 24;
+    pWin->drawable.pScreen = &screen;
+    pWin->drawable.x = x + bw;
+    pWin->drawable.y = y + bw;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->origin.x = x + bw;
+    pWin->origin.y = y + bw;
+    pWin->borderWidth = bw;
+    pWin->borderIsPixel = TRUE;
+    pWin->mapped = TRUE;
+    pWin->realized = TRUE;
+    pWin->viewable = TRUE;
+    pWin->visibility = VisibilityNotViewable;
+    RegionNull(&pWin->clipList);
+    RegionNull(&pWin->borderClip);
+    RegionNull(&pWin->winSize);
+    RegionNull(&pWin->borderSize);
+    if (pParent) {
+        SetWinSize(pWin);
+        SetBorderSize(pWin);
+    }
+}
+
+/*
+ * n windows laid out in rows, one to each 64x64 cell. Windows in a row
+ * share their height and border, so that before anything moves nothing
+ * overlaps and the root clip list holds a few rectangles per window.
+ */
+static void
+tree_init(int n)
+{
+    WindowPtr pWin;
+    BoxRec box;
+    int side, i, x, y = 0, w, h = 0, bw = 0;
+
+    for (side = 64; side * side < 64 * 64 * n && side < 32000; side += 64)
+        ;
+    box.x1 = box.y1 = 0;
+    box.x2 = box.y2 = side;
+
+    screen.MarkWindow = miMarkWindow;
+    screen.MarkOverlappedWindows = miMarkOverlappedWindows;
+    screen.ValidateTree = miValidateTree;
+    screen.HandleExposures = miHandleValidateExposures;
+    screen.PositionWindow = test_position_window;
+    screen.CopyWindow = test_copy_window;
+    screen.WindowExposures = test_window_exposures;
+    screen.PaintWindow = test_paint_window;
+    screen.root = &root;
+    screen.width = side;
+    screen.height = side;
+
+    memset(&root, 0, sizeof(root));
+    init_window(&root, NullWindow, 0, 0, side, side, 0);
+    RegionReset(&root.winSize, &box);
+    RegionReset(&root.borderSize, &box);
+    RegionCopy(&root.clipList, &root.winSize);
+    RegionCopy(&root.borderClip, &root.winSize);
+    root.visibility = VisibilityUnobscured;
+
+    num_windows = n;
+    windows = calloc(n, sizeof(WindowRec));
+    assert(windows);
+    srandom(n);
+    for (i = 0; i < n; i++) {
+        if (i % (side / 64) == 0) {
+            bw = random() % 2;
+            h = 32 + random() % 24;
+            y = i / (side / 64) * 64 + random() % (64 - h - 2 * bw);
+        }
+        w = 16 + random() % 40;
+        x = i % (side / 64) * 64 + random() % (64 - w - 2 * bw);
+        pWin = &windows[i];
+        init_window(pWin, &root, x, y, w, h, bw);
+        pWin->prevSib = root.lastChild;
+        if (root.lastChild)
+            root.lastChild->nextSib = pWin;
+        else
+            root.firstChild = pWin;
+        root.lastChild = pWin;
+    }
+
+    for (pWin = root.firstChild; pWin; pWin = pWin->nextSib)
+        miMarkWindow(pWin);
+    miMarkWindow(&root);
+    miValidateTree(&root, NullWindow, VTMap);
+    miHandleValidateExposures(&root);
+}
+
+static void
+tree_fini(void)
+{
+    int i;
+
+    for (i = 0; i < num_windows; i++) {
+        RegionUninit(&windows[i].clipList);
+        RegionUninit(&windows[i].borderClip);
+        RegionUninit(&windows[i].winSize);
+        RegionUninit(&windows[i].borderSize);
+    }
+    free(windows);
+    RegionUninit(&root.clipList);
+    RegionUninit(&root.borderClip);
+    RegionUninit(&root.winSize);
+    RegionUninit(&root.borderSize);
+}
+
+/* What dix does for a ConfigureWindow with only a stack mode */
+static void
+restack_window(WindowPtr pWin, WindowPtr pSib)
+{
+    WindowPtr pFirstChange, pLayerWin;
+
+    if (pSib == pWin)
+        pSib = pWin->nextSib;
+    pFirstChange = MoveWindowInStack(pWin, pSib);
+    if ((*screen.MarkOverlappedWindows) (pWin, pFirstChange, &pLayerWin)) {
+        (*screen.ValidateTree) (&root, pFirstChange, VTStack);
+        (*screen.HandleExposures) (&root);
+    }
+}
+
+static void
+move_window(WindowPtr pWin)
+{
+    int x = pWin->origin.x - wBorderWidth(pWin) + random() % 65 - 32;
+    int y = pWin->origin.y - wBorderWidth(pWin) + random() % 65 - 32;
+
+    miMoveWindow(pWin, x, y, pWin->nextSib, VTMove);
+}
+
+static void
+random_op(Bool move)
+{
+    WindowPtr pWin = &windows[random() % num_windows];
+
+    if (move)
+        move_window(pWin);
+    else if (random() % 2)
+        restack_window(pWin, root.firstChild);
+    else
+        restack_window(pWin, &windows[random() % num_windows]);
+}
+
+/* Compute every clip list top down, as if the whole tree was mapped anew */
+static void
+check_clips(void)
+{
+    RegionRec covered, expected;
+    WindowPtr pWin;
+
+    RegionNull(&covered);
+    RegionNull(&expected);
+    for (pWin = root.firstChild; pWin; pWin = pWin->nextSib) {
+        RegionIntersect(&expected, &pWin->borderSize, &root.winSize);
+        RegionSubtract(&expected, &expected, &covered);
+        assert(RegionEqual(&pWin->borderClip, &expected));
+        RegionIntersect(&expected, &expected, &pWin->winSize);
+        assert(RegionEqual(&pWin->clipList, &expected));
+        assert(!pWin->valdata);
+        RegionUnion(&covered, &covered, &pWin->borderSize);
+    }
+    RegionSubtract(&expected, &root.winSize, &covered);
+    assert(RegionEqual(&root.clipList, &expected));
+    assert(!root.valdata);
+    RegionUninit(&covered);
+    RegionUninit(&expected);
+}
+
+static void
+validate_check_test(void)
+{
+    int i;
+
+    tree_init(CHECK_WINDOWS);
+    check_clips();
+    for (i = 0; i < NUM_OPS; i++) {
+        random_op(i % 2);
+        if (i % CHECK_EVERY == 0)
+            check_clips();
+    }
+    check_clips();
+    tree_fini();
+}
+
+static void
+validate_time_test(int n)
+{
+    CARD64 start, restack, move;
+    int i;
+
+    tree_init(n);
+
+    /* moves first, so that there are overlapping windows to restack */
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_OPS; i++)
+        random_op(TRUE);
+    move = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_OPS; i++)
+        random_op(FALSE);
+    restack = GetTimeInMicros() - start;
+
+    printf("%5d windows: %7.1f us per move, %7.1f us per restack "
+           "(%d root clip rectangles)\n", n, (double) move / NUM_OPS,
+           (double) restack / NUM_OPS, (int) RegionNumRects(&root.clipList));
+
+    tree_fini();
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int sizes[] = { 1000, 5000, 20000, 50000 };
+    int i;
+
+    validate_check_test();
+
+    if (getenv("XSERVER_TEST_BENCHMARK"))
+        for (i = 0; i < ARRAY_SIZE(sizes); i++)
+            validate_time_test(sizes[i]);
+
+    return 0;
+}
@@ -32,6 +32,11 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <stdio.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <dirent.h>
+#include <utime.h>
+#endif
 #include <X11/X.h>
 #include <X11/Xos.h>
 #include <X11/Xproto.h>
@@ -44,6 +49,7 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <xkbsrv.h>
 #include <X11/extensions/XI.h>
 #include "xkb.h"
+#include "xsha1.h"
 
         /*
          * If XKM_OUTPUT_DIR specifies a path without a leading slash, it is
@@ -71,7 +77,13 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 static unsigned
 LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn);
 
-static void
+/**
+ * Pick the directory xkbcomp writes its output to.  Returns TRUE if it
+ * is the server's own XKM_OUTPUT_DIR, which is the only place compiled
+ * keymaps are cached: files in a world-writable temporary directory
+ * cannot be trusted on the next run.
+ */
+static Bool
 OutputDirectory(char *outdir, size_t size)
 {
 #ifndef WIN32
@@ -79,6 +91,7 @@ OutputDirectory(char *outdir, size_t size)
     if (access(XKM_OUTPUT_DIR, W_OK | X_OK) == 0 &&
         (strlen(XKM_OUTPUT_DIR) < size)) {
         (void) strcpy(outdir, XKM_OUTPUT_DIR);
+        return TRUE;
     }
     else
 #else
@@ -91,8 +104,119 @@ OutputDirectory(char *outdir, size_t size)
     if (strlen("/tmp/") < size) {
         (void) strcpy(outdir, "/tmp/");
     }
+    return FALSE;
+}
+
+/* Compiled keymaps are cached under this prefix, followed by a hash */
+#define XKM_CACHE_PREFIX "cache-"
+#define XKM_CACHE_NAME_LEN (sizeof(XKM_CACHE_PREFIX) - 1 + 40)
+
+/* Least recently used keymaps beyond this many are removed */
+#define XKM_CACHE_MAX_ENTRIES 32
+
+static Bool
+XkbIsCachedKeymap(const char *keymap)
+{
+    return strncmp(keymap, XKM_CACHE_PREFIX, strlen(XKM_CACHE_PREFIX)) == 0 &&
+        strlen(keymap) == XKM_CACHE_NAME_LEN;
 }
 
+/* Directories of the XKB data xkbcomp reads its components from */
+static const char *xkb_data_dirs[] = {
+    "", "keycodes", "types", "compat", "symbols", "geometry", "rules"
+};
+
+/**
+ * Name the compiled keymap after a hash of everything that goes into
+ * compiling it: the xkbcomp input and command line, the size and
+ * modification time of the xkbcomp binary standing in for its version,
+ * and the modification times of the XKB data directories, which change
+ * whenever a package update replaces the files in them.
+ */
+static Bool
+XkbCacheKeymapName(const char *input, size_t len, const char *cmd,
+                   const char *xkbcomp, char *name, size_t size)
+{
+    unsigned char sha1[20];
+    char path[PATH_MAX];
+    struct stat st;
+    void *ctx;
+    int i, n;
+
+    ctx = x_sha1_init();
+    if (!ctx)
+        return FALSE;
+
+    if (xkbcomp && stat(xkbcomp, &st) == 0) {
+        x_sha1_update(ctx, &st.st_size, sizeof(st.st_size));
+        x_sha1_update(ctx, &st.st_mtime, sizeof(st.st_mtime));
+    }
+    for (i = 0; XkbBaseDirectory && i < (int) ARRAY_SIZE(xkb_data_dirs); i++) {
+        n = snprintf(path, sizeof(path), "%s/%s", XkbBaseDirectory,
+                     xkb_data_dirs[i]);
+        if (n >= 0 && n < (int) sizeof(path) && stat(path, &st) == 0)
+            x_sha1_update(ctx, &st.st_mtime, sizeof(st.st_mtime));
+    }
+    x_sha1_update(ctx, (void *) cmd, strlen(cmd) + 1);
+    if (!x_sha1_update(ctx, (void *) input, len) ||
+        !x_sha1_final(ctx, sha1))
+        return FALSE;
+
+    if (size <= XKM_CACHE_NAME_LEN)
+        return FALSE;
+    strcpy(name, XKM_CACHE_PREFIX);
+    for (i = 0; i < (int) sizeof(sha1); i++)
+        snprintf(name + strlen(XKM_CACHE_PREFIX) + 2 * i, 3, "%02x", sha1[i]);
+    return TRUE;
+}
+
+#ifndef WIN32
+/**
+ * Remove the least recently used compiled keymaps from dir until at
+ * most XKM_CACHE_MAX_ENTRIES are left.  Reusing a keymap refreshes its
+ * modification time.
+ */
+static void
+XkbPruneKeymapCache(const char *dir)
+{
+    char path[PATH_MAX], oldest[XKM_CACHE_NAME_LEN + 5];
+    time_t oldest_mtime = 0;
+    struct dirent *ent;
+    struct stat st;
+    int entries, n;
+    DIR *d;
+
+    do {
+        d = opendir(dir);
+        if (!d)
+            return;
+        entries = 0;
+        oldest[0] = '\0';
+        while ((ent = readdir(d))) {
+            if (strlen(ent->d_name) != XKM_CACHE_NAME_LEN + 4 ||
+                strcmp(ent->d_name + XKM_CACHE_NAME_LEN, ".xkm") != 0 ||
+                strncmp(ent->d_name, XKM_CACHE_PREFIX,
+                        strlen(XKM_CACHE_PREFIX)) != 0)
+                continue;
+            n = snprintf(path, sizeof(path), "%s%s", dir, ent->d_name);
+            if (n < 0 || n >= (int) sizeof(path) || stat(path, &st) != 0)
+                continue;
+            if (!entries++ || st.st_mtime < oldest_mtime) {
+                oldest_mtime = st.st_mtime;
+                strcpy(oldest, ent->d_name);
+            }
+        }
+        closedir(d);
+
+        if (entries <= XKM_CACHE_MAX_ENTRIES)
+            return;
+        n = snprintf(path, sizeof(path), "%s%s", dir, oldest);
+        if (n < 0 || n >= (int) sizeof(path) || unlink(path) != 0)
+            return;
+    } while (entries - 1 > XKM_CACHE_MAX_ENTRIES);
+}
+#endif
+
 /**
  * Callback invoked by XkbRunXkbComp. Write to out to talk to xkbcomp.
  */
@@ -101,6 +225,10 @@ typedef void (*xkbcomp_buffer_callback)(FILE *out, void *userdata);
 /**
  * Start xkbcomp, let the callback write into xkbcomp's stdin. When done,
  * return a strdup'd copy of the file name we've written to.
+ *
+ * Where the output directory allows it, the result is cached: the input
+ * is rendered into memory first and hashed, and if a keymap compiled
+ * from the same input already exists xkbcomp is not run at all.
  */
 static char *
 RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
@@ -112,6 +240,7 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
     char *xkbbasedirflag = NULL;
     const char *xkbbindir = emptystring;
     const char *xkbbindirsep = emptystring;
+    Bool cache;
 
 #ifdef WIN32
     /* WIN32 has no popen. The input must be stored in a file which is
@@ -120,11 +249,14 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
     const char *xkmfile = tmpname;
 #else
     const char *xkmfile = "-";
+    char cached[PATH_MAX];
+    char *input = NULL;
+    size_t input_len = 0;
 #endif
 
     snprintf(keymap, sizeof(keymap), "server-%s", display);
 
-    OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
+    cache = OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
 
 #ifdef WIN32
     strcpy(tmpname, Win32TempDir());
@@ -148,6 +280,60 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
         }
     }
 
+#ifndef WIN32
+    cached[0] = '\0';
+    if (cache) {
+        char *xkbcomp = NULL;
+
+        out = open_memstream(&input, &input_len);
+        if (out) {
+            (*callback)(out, userdata);
+            if (fclose(out) != 0) {
+                free(input);
+                input = NULL;
+            }
+        }
+        if (XkbBinDirectory != NULL &&
+            asprintf(&xkbcomp, "%s%sxkbcomp", xkbbindir, xkbbindirsep) == -1)
+            xkbcomp = NULL;
+        if (input &&
+            asprintf(&buf, "%s -w %d %s", xkbcomp ? xkbcomp : "xkbcomp",
+                     ((xkbDebugFlags < 2) ? 1 :
+                      ((xkbDebugFlags > 10) ? 10 : (int) xkbDebugFlags)),
+                     xkbbasedirflag ? xkbbasedirflag : "") != -1) {
+            if (!XkbCacheKeymapName(input, input_len, buf, xkbcomp,
+                                    cached, sizeof(cached)))
+                cached[0] = '\0';
+            free(buf);
+            buf = NULL;
+        }
+        free(xkbcomp);
+
+        if (cached[0] != '\0') {
+            char path[PATH_MAX];
+            int n;
+
+            n = snprintf(path, sizeof(path), "%s%s.xkm", xkm_output_dir,
+                         cached);
+            if (n >= 0 && n < (int) sizeof(path) &&
+                access(path, R_OK) == 0) {
+                LogMessageVerb(X_INFO, 4, "XKB: Reusing compiled keymap %s\n",
+                               path);
+                (void) utime(path, NULL);
+                free(xkbbasedirflag);
+                free(input);
+                return xnfstrdup(cached);
+            }
+            /* Compile under a name of our own, then move it into place */
+            snprintf(keymap, sizeof(keymap), "%s-%s", cached, display);
+        }
+        else if (input) {
+            free(input);
+            input = NULL;
+        }
+    }
+#endif
+
     if (asprintf(&buf,
                  "\"%s%sxkbcomp\" -w %d %s -xkm \"%s\" "
                  "-em1 %s -emp %s -eml %s \"%s%s.xkm\"",
@@ -164,6 +350,9 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
     if (!buf) {
         LogMessage(X_ERROR,
                    "XKB: Could not invoke xkbcomp: not enough memory\n");
+#ifndef WIN32
+        free(input);
+#endif
         return NULL;
     }
 
@@ -175,7 +364,12 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
 
     if (out != NULL) {
         /* Now write to xkbcomp */
-        (*callback)(out, userdata);
+#ifndef WIN32
+        if (input)
+            fwrite(input, input_len, 1, out);
+        else
+#endif
+            (*callback)(out, userdata);
 
 #ifndef WIN32
         if (Pclose(out) == 0)
@@ -188,6 +382,20 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
             free(buf);
 #ifdef WIN32
             unlink(tmpname);
+#else
+            free(input);
+            if (cached[0] != '\0') {
+                char from[PATH_MAX], to[PATH_MAX];
+
+                snprintf(from, sizeof(from), "%s%s.xkm", xkm_output_dir,
+                         keymap);
+                snprintf(to, sizeof(to), "%s%s.xkm", xkm_output_dir, cached);
+                if (rename(from, to) == 0) {
+                    XkbPruneKeymapCache(xkm_output_dir);
+                    return xnfstrdup(cached);
+                }
+                LogMessage(X_WARNING, "XKB: Could not cache keymap %s\n", to);
+            }
 #endif
             return xnfstrdup(keymap);
         }
@@ -205,6 +413,9 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
         LogMessage(X_ERROR, "Could not open file %s\n", tmpname);
 #endif
     }
+#ifndef WIN32
+    free(input);
+#endif
     free(buf);
     return NULL;
 }
@@ -293,6 +504,14 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
     }
 
     have = LoadXKM(want, need, map_name, xkbRtrn);
+    if (!have && XkbIsCachedKeymap(map_name)) {
+        /* LoadXKM removed the unusable cache entry, compile it afresh */
+        free(map_name);
+        map_name = RunXkbComp(xkb_write_keymap_string_cb, &map);
+        if (!map_name)
+            return 0;
+        have = LoadXKM(want, need, map_name, xkbRtrn);
+    }
     free(map_name);
 
     return have;
@@ -348,6 +567,11 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
         return 0;
     }
     missing = XkmReadFile(file, need, want, xkbRtrn);
+    if (*xkbRtrn != NULL && (missing & need) && XkbIsCachedKeymap(keymap)) {
+        /* a damaged cache entry; have it compiled again */
+        XkbFreeKeyboard(*xkbRtrn, XkbAllComponentsMask, TRUE);
+        *xkbRtrn = NULL;
+    }
     if (*xkbRtrn == NULL) {
         LogMessage(X_ERROR, "Error loading keymap %s\n", fileName);
         fclose(file);
@@ -359,7 +583,9 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
                (*xkbRtrn)->defined);
     }
     fclose(file);
-    (void) unlink(fileName);
+    /* Cached keymaps stay around for the next server */
+    if (!XkbIsCachedKeymap(keymap))
+        (void) unlink(fileName);
     return (need | want) & (~missing);
 }
 
@@ -371,6 +597,7 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
                         XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen)
 {
     XkbDescPtr xkb;
+    unsigned have;
 
     *xkbRtrn = NULL;
     if ((keybd == NULL) || (keybd->key == NULL) ||
@@ -391,7 +618,15 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
         return 0;
     }
 
-    return LoadXKM(want, need, nameRtrn, xkbRtrn);
+    have = LoadXKM(want, need, nameRtrn, xkbRtrn);
+    if (!have && XkbIsCachedKeymap(nameRtrn)) {
+        /* LoadXKM removed the unusable cache entry, compile it afresh */
+        if (!XkbDDXCompileKeymapByNames(xkb, names, want, need,
+                                        nameRtrn, nameRtrnLen))
+            return 0;
+        have = LoadXKM(want, need, nameRtrn, xkbRtrn);
+    }
+    return have;
 }
 
 Bool